@@ -0,0 +1,235 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# ============================================================
+# Concurrent single-row inserters on the shared zone map
+# ============================================================
+#
+# Spins up an ephemeral PG cluster with pg_sorted_heap preloaded and a
+# compacted sorted_heap table at fillfactor 50, so single-row inserts
+# fill the free half of pages the meta page entries cover.  Several
+# sessions insert keys spread over the whole key range at once (some in
+# transactions that roll back), widening the shared copy's entries by
+# compare-and-swap under its shared lock.  Afterwards, and again after a
+# restart has dropped the shared copy, pruned range counts must match
+# unpruned ones: a widening lost to a racing writer, or not written to
+# the meta page at commit, would prune a page holding a matching row.
+#
+# Usage: ./scripts/test_concurrent_inserters.sh [tmp_root] [port]
+
+TMP_ROOT="${1:-${TMPDIR:-/tmp}}"
+PORT="${2:-65489}"
+BASE_ROWS=8000
+INSERTERS=4
+ROWS_PER_INSERTER=1000
+RANGES=300
+
+if [[ "$TMP_ROOT" != /* ]]; then
+  echo "tmp_root must be absolute: $TMP_ROOT" >&2; exit 2
+fi
+if ! [[ "$PORT" =~ ^[0-9]+$ ]] || [ "$PORT" -le 1024 ] || [ "$PORT" -ge 65535 ]; then
+  echo "port must be 1025..65534" >&2; exit 2
+fi
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+if command -v pg_config >/dev/null 2>&1; then
+  PG_BINDIR="$(pg_config --bindir)"
+else
+  PG_BINDIR="/opt/homebrew/Cellar/postgresql@18/18.1_1/bin"
+fi
+
+TMP_DIR=""
+WORKER_PIDS=()
+pass=0; fail=0; total=0
+
+check() {
+  local name="$1" expected="$2" actual="$3"
+  total=$((total + 1))
+  if [ "$expected" = "$actual" ]; then
+    echo "  PASS: $name"
+    pass=$((pass + 1))
+  else
+    echo "  FAIL: $name (expected=$expected actual=$actual)"
+    fail=$((fail + 1))
+  fi
+}
+
+cleanup() {
+  for pid in "${WORKER_PIDS[@]:-}"; do
+    kill "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+  done
+  WORKER_PIDS=()
+  if [ -n "$TMP_DIR" ] && [ -d "$TMP_DIR/data" ]; then
+    "$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -m immediate stop >/dev/null 2>&1 || true
+  fi
+  if [ -n "$TMP_DIR" ]; then
+    rm -rf "$TMP_DIR"
+  fi
+}
+trap cleanup EXIT
+
+# --- Create ephemeral cluster, extension preloaded ---
+TMP_DIR="$(mktemp -d "$TMP_ROOT/pg_sorted_heap_inserters.XXXXXX")"
+make -C "$ROOT_DIR" install >/dev/null 2>&1 || true
+"$PG_BINDIR/initdb" -D "$TMP_DIR/data" -A trust --no-locale >/dev/null 2>&1
+cat >> "$TMP_DIR/data/postgresql.conf" <<'PGCONF'
+shared_preload_libraries = 'pg_sorted_heap'
+log_min_messages = warning
+PGCONF
+"$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -l "$TMP_DIR/postmaster.log" \
+  -o "-k $TMP_DIR -p $PORT" -w start >/dev/null
+
+PSQL() {
+  "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -v ON_ERROR_STOP=1 -qtAX "$@"
+}
+
+PSQL -c "CREATE EXTENSION pg_sorted_heap"
+
+# Base keys are multiples of 10; inserters add the keys in between
+PSQL <<SQL
+CREATE TABLE zm_ins(
+    id bigint PRIMARY KEY,
+    val text
+) USING sorted_heap WITH (fillfactor = 50);
+
+INSERT INTO zm_ins
+  SELECT g * 10, repeat('x', 80)
+  FROM generate_series(1, $BASE_ROWS) g;
+
+SELECT sorted_heap_compact('zm_ins'::regclass);
+VACUUM zm_ins;
+SQL
+
+echo "Setup: ${BASE_ROWS} rows at fillfactor 50, compacted"
+echo "  $(PSQL -c "SELECT sorted_heap_zonemap_stats('zm_ins'::regclass)")"
+
+# Pruned vs unpruned count for $RANGES ranges spread over the keys; the
+# number of ranges whose counts differ
+compare_ranges() {
+  PSQL <<SQL
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+DO \$\$
+DECLARE
+  lo bigint;
+  pruned bigint;
+  unpruned bigint;
+  bad int := 0;
+BEGIN
+  FOR i IN 0 .. $RANGES - 1 LOOP
+    lo := i * ($BASE_ROWS * 10 / $RANGES);
+    PERFORM set_config('sorted_heap.enable_scan_pruning', 'on', true);
+    EXECUTE format('SELECT count(*) FROM zm_ins WHERE id BETWEEN %s AND %s',
+                   lo, lo + 40) INTO pruned;
+    PERFORM set_config('sorted_heap.enable_scan_pruning', 'off', true);
+    EXECUTE format('SELECT count(*) FROM zm_ins WHERE id BETWEEN %s AND %s',
+                   lo, lo + 40) INTO unpruned;
+    IF pruned <> unpruned THEN
+      bad := bad + 1;
+      RAISE WARNING 'range [%, %]: pruned % unpruned %',
+        lo, lo + 40, pruned, unpruned;
+    END IF;
+  END LOOP;
+  RAISE NOTICE 'mismatched_ranges=%', bad;
+END
+\$\$;
+SQL
+}
+
+mismatches() {
+  compare_ranges 2>&1 | sed -n 's/.*mismatched_ranges=\([0-9]*\).*/\1/p'
+}
+
+# ============================================================
+# Concurrent inserters
+# ============================================================
+echo ""
+echo "=== ${INSERTERS} sessions inserting single rows ==="
+
+# Inserter w adds keys g * 10 + w; every tenth row goes in a transaction
+# that rolls back, so its widening stays in the shared copy only
+inserter() {
+  local w="$1"
+  seq 1 "$ROWS_PER_INSERTER" |
+    awk -v w="$w" -v base="$BASE_ROWS" '{
+      g = (($1 * 7919 + w * 104729) % base) + 1
+      id = g * 10 + w
+      if ($1 % 10 == 0)
+        printf "BEGIN; INSERT INTO zm_ins VALUES (%d, %s); ROLLBACK;\n", -id, "'"'"'rolled back'"'"'"
+      else
+        printf "INSERT INTO zm_ins VALUES (%d, %s);\n", id, "'"'"'inserted'"'"'"
+    }' |
+    "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX \
+      -v ON_ERROR_STOP=1 >/dev/null
+}
+
+WORKER_PIDS=()
+for w in $(seq 1 "$INSERTERS"); do
+  inserter "$w" &
+  WORKER_PIDS+=($!)
+done
+inserter_failed=0
+for pid in "${WORKER_PIDS[@]}"; do
+  wait "$pid" || inserter_failed=$((inserter_failed + 1))
+done
+WORKER_PIDS=()
+
+check "inserters_ok" "0" "$inserter_failed"
+
+# 7919 is prime to BASE_ROWS, so no inserter repeats a key
+expected_new=$((INSERTERS * ROWS_PER_INSERTER * 9 / 10))
+check "inserted_rows" "$expected_new" \
+  "$(PSQL -c "SET sorted_heap.enable_scan_pruning = off;
+    SELECT count(*) FROM zm_ins WHERE id > 0 AND id % 10 <> 0")"
+check "rolled_back_rows_absent" "0" \
+  "$(PSQL -c "SET sorted_heap.enable_scan_pruning = off;
+    SELECT count(*) FROM zm_ins WHERE id < 0")"
+check "zone_map_still_prunes" "t" \
+  "$(PSQL -c "SET enable_seqscan = off; SET enable_indexscan = off;
+    SET enable_bitmapscan = off;
+    EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF)
+    SELECT count(*) FROM zm_ins WHERE id BETWEEN 100 AND 200" |
+    grep -Eq "pruned [1-9]" && echo t || echo f)"
+check "shared_copy_in_use" "t" \
+  "$(PSQL -c "SELECT entries > 0 FROM sorted_heap_zonemap_shared()
+    WHERE relid = 'zm_ins'::regclass")"
+
+# ============================================================
+# Verification
+# ============================================================
+echo ""
+echo "=== Pruned vs unpruned counts ==="
+
+check "ranges_match_shared_copy" "0" "$(mismatches)"
+
+pruned_new=$(PSQL -c "SET enable_seqscan = off; SET enable_indexscan = off;
+  SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ins WHERE id % 10 <> 0 AND id BETWEEN 1 AND $((BASE_ROWS * 10 + 9))")
+check "inserted_rows_not_pruned" "$expected_new" "$pruned_new"
+
+# A restart drops the shared copy: the zone map comes back from the meta
+# page, which holds the committed widenings only
+"$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -m fast -w restart \
+  -l "$TMP_DIR/postmaster.log" -o "-k $TMP_DIR -p $PORT" >/dev/null
+
+check "ranges_match_after_restart" "0" "$(mismatches)"
+
+pruned_new=$(PSQL -c "SET enable_seqscan = off; SET enable_indexscan = off;
+  SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ins WHERE id % 10 <> 0 AND id BETWEEN 1 AND $((BASE_ROWS * 10 + 9))")
+check "inserted_rows_not_pruned_after_restart" "$expected_new" "$pruned_new"
+
+# ============================================================
+# Summary
+# ============================================================
+echo ""
+if [ "$fail" -eq 0 ]; then
+  echo "concurrent_inserters_test status=ok pass=$pass fail=$fail total=$total"
+else
+  echo "concurrent_inserters_test status=FAIL pass=$pass fail=$fail total=$total"
+  exit 1
+fi
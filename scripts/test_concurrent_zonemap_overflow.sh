@@ -0,0 +1,178 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# ============================================================
+# Concurrent overflow zone map extension vs single-row inserts
+# ============================================================
+#
+# Spins up an ephemeral PG cluster with a sorted_heap table whose zone
+# map already has an overflow run.  COPY batches extend the run past the
+# end of the table while background workers insert single rows with
+# negative keys, which land in the same new pages.  A worker whose
+# zone map copy predates an extension must still get its key into the
+# entry that now covers its page: afterwards the pruned custom scan must
+# find every negative key the sequential scan finds.
+#
+# Usage: ./scripts/test_concurrent_zonemap_overflow.sh [tmp_root] [port]
+
+TMP_ROOT="${1:-${TMPDIR:-/tmp}}"
+PORT="${2:-65499}"
+INITIAL_ROWS=60000
+COPY_ROWS=20000
+COPY_ROUNDS=15
+WORKERS=4
+
+if [[ "$TMP_ROOT" != /* ]]; then
+  echo "tmp_root must be absolute: $TMP_ROOT" >&2; exit 2
+fi
+if ! [[ "$PORT" =~ ^[0-9]+$ ]] || [ "$PORT" -le 1024 ] || [ "$PORT" -ge 65535 ]; then
+  echo "port must be 1025..65534" >&2; exit 2
+fi
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+if command -v pg_config >/dev/null 2>&1; then
+  PG_BINDIR="$(pg_config --bindir)"
+else
+  PG_BINDIR="/opt/homebrew/Cellar/postgresql@18/18.1_1/bin"
+fi
+
+TMP_DIR=""
+WORKER_PIDS=()
+pass=0; fail=0; total=0
+
+check() {
+  local name="$1" expected="$2" actual="$3"
+  total=$((total + 1))
+  if [ "$expected" = "$actual" ]; then
+    echo "  PASS: $name"
+    pass=$((pass + 1))
+  else
+    echo "  FAIL: $name (expected=$expected actual=$actual)"
+    fail=$((fail + 1))
+  fi
+}
+
+cleanup() {
+  for pid in "${WORKER_PIDS[@]:-}"; do
+    kill "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+  done
+  WORKER_PIDS=()
+  if [ -n "$TMP_DIR" ] && [ -d "$TMP_DIR/data" ]; then
+    "$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -m immediate stop >/dev/null 2>&1 || true
+  fi
+  if [ -n "$TMP_DIR" ]; then
+    rm -rf "$TMP_DIR"
+  fi
+}
+trap cleanup EXIT
+
+# --- Create ephemeral cluster ---
+TMP_DIR="$(mktemp -d "$TMP_ROOT/pg_sorted_heap_zm_overflow.XXXXXX")"
+make -C "$ROOT_DIR" install >/dev/null 2>&1 || true
+"$PG_BINDIR/initdb" -D "$TMP_DIR/data" -A trust --no-locale >/dev/null 2>&1
+"$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -l "$TMP_DIR/postmaster.log" \
+  -o "-k $TMP_DIR -p $PORT" start >/dev/null
+
+PSQL() {
+  "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -v ON_ERROR_STOP=1 -qtAX "$@"
+}
+
+PSQL -c "CREATE EXTENSION pg_sorted_heap"
+
+# --- Schema + initial data: enough pages for an overflow run ---
+PSQL <<SQL
+CREATE TABLE zm_ovfl(
+    id bigint PRIMARY KEY,
+    val text
+) USING sorted_heap;
+
+INSERT INTO zm_ovfl
+  SELECT g, repeat('x', 80)
+  FROM generate_series(1, $INITIAL_ROWS) g;
+
+SELECT sorted_heap_compact('zm_ovfl'::regclass);
+SQL
+
+echo "Setup: ${INITIAL_ROWS} rows, compacted"
+echo "  $(PSQL -c "SELECT sorted_heap_zonemap_stats('zm_ovfl'::regclass)")"
+
+# --- Workers ---
+# Single rows with negative keys: below every entry's min, so a page
+# holding one is pruned for "id < 0" unless its entry took the key.
+single_worker() {
+  local w="$1" n=0
+  while [ ! -f "$TMP_DIR/copy_done" ]; do
+    n=$((n + 1))
+    "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX \
+      -c "INSERT INTO zm_ovfl VALUES (-($n * $WORKERS + $w), 'single')" \
+      >/dev/null 2>&1 || true
+  done
+  echo "$n" > "$TMP_DIR/singles_done_$w"
+}
+
+# COPY goes through multi_insert, which extends the overflow run
+copy_worker() {
+  local round start
+  for round in $(seq 1 "$COPY_ROUNDS"); do
+    start=$((INITIAL_ROWS + (round - 1) * COPY_ROWS + 1))
+    seq "$start" $((start + COPY_ROWS - 1)) |
+      awk '{ printf "%s\t%s\n", $1, "copy" }' |
+      "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX \
+        -c "COPY zm_ovfl FROM STDIN" >/dev/null
+  done
+  touch "$TMP_DIR/copy_done"
+}
+
+echo ""
+echo "=== COPY extends the overflow run during single-row inserts ==="
+
+WORKER_PIDS=()
+for w in $(seq 1 "$WORKERS"); do
+  single_worker "$w" &
+  WORKER_PIDS+=($!)
+done
+copy_worker
+
+for pid in "${WORKER_PIDS[@]}"; do
+  wait "$pid" 2>/dev/null || true
+done
+WORKER_PIDS=()
+
+singles=0
+for w in $(seq 1 "$WORKERS"); do
+  singles=$((singles + $(cat "$TMP_DIR/singles_done_$w" 2>/dev/null || echo 0)))
+done
+echo "  single-row inserts attempted: $singles"
+echo "  $(PSQL -c "SELECT sorted_heap_zonemap_stats('zm_ovfl'::regclass)")"
+
+# --- Verification, before anything rebuilds the zone map ---
+seq_neg=$(PSQL -c "SET sorted_heap.enable_scan_pruning = off;
+  SET enable_indexscan = off; SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ovfl WHERE id < 0")
+pruned_neg=$(PSQL -c "SET enable_seqscan = off;
+  SET enable_indexscan = off; SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ovfl WHERE id < 0")
+check "negative_keys_not_pruned" "$seq_neg" "$pruned_neg"
+
+seq_all=$(PSQL -c "SET sorted_heap.enable_scan_pruning = off;
+  SET enable_indexscan = off; SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ovfl WHERE id > $INITIAL_ROWS")
+pruned_all=$(PSQL -c "SET enable_seqscan = off;
+  SET enable_indexscan = off; SET enable_bitmapscan = off;
+  SELECT count(*) FROM zm_ovfl WHERE id > $INITIAL_ROWS")
+check "copied_keys_not_pruned" "$seq_all" "$pruned_all"
+check "copied_rows" "$((COPY_ROWS * COPY_ROUNDS))" "$seq_all"
+
+# ============================================================
+# Summary
+# ============================================================
+echo ""
+if [ "$fail" -eq 0 ]; then
+  echo "concurrent_zonemap_overflow_test status=ok pass=$pass fail=$fail total=$total"
+else
+  echo "concurrent_zonemap_overflow_test status=FAIL pass=$pass fail=$fail total=$total"
+  exit 1
+fi
@@ -47,7 +47,7 @@ check() {
 
 # --- Cluster lifecycle helpers ---
 create_cluster() {
-  local name="$1"
+  local name="$1" preload="${2:-}"
   local dir
   dir=$(mktemp -d "$TMP_ROOT/pg_sorted_heap_crash_${name}.XXXXXX")
 
@@ -57,6 +57,9 @@ log_min_messages = warning
 checkpoint_timeout = 30s
 max_wal_size = 64MB
 PGCONF
+  if [ -n "$preload" ]; then
+    echo "shared_preload_libraries = 'pg_sorted_heap'" >> "$dir/data/postgresql.conf"
+  fi
 
   echo "$dir"
 }
@@ -312,6 +315,48 @@ scenario_crash_during_online_compact() {
   destroy_cluster "$dir"
 }
 
+# ============================================================
+# Scenario 5: Crash after committed zone map widening (preloaded:
+# meta page entries are replayed from sorted_heap's own WAL records)
+# ============================================================
+scenario_crash_after_widening() {
+  echo "=== Scenario 5: Crash after zone map widening ==="
+  local port=$((BASE_PORT + 4))
+  local dir
+  dir=$(create_cluster "widen" preload)
+
+  start_cluster "$dir" "$port"
+  PSQL_CMD "$dir" "$port" -c "CREATE EXTENSION pg_sorted_heap"
+  PSQL_CMD "$dir" "$port" -c "
+    CREATE TABLE crash_widen(id int PRIMARY KEY, val text)
+      USING sorted_heap WITH (fillfactor = 90);
+    INSERT INTO crash_widen SELECT g, repeat('x', 400)
+      FROM generate_series(1, 100) g;
+    SELECT sorted_heap_rebuild_zonemap('crash_widen'::regclass);
+    CHECKPOINT;
+  " >/dev/null
+  PSQL_CMD "$dir" "$port" -c "UPDATE crash_widen SET id = 1005 WHERE id = 5"
+
+  crash_cluster "$dir"
+  start_cluster "$dir" "$port"
+
+  local widened
+  widened=$(PSQL_CMD "$dir" "$port" -c \
+    "SELECT sorted_heap_zonemap_stats('crash_widen'::regclass) LIKE '%[1:1..1005]%'")
+  check "widen_crash_entry_replayed" "t" "$widened"
+
+  local found
+  found=$(PSQL_CMD "$dir" "$port" -c "
+    SET enable_indexscan = off;
+    SET enable_bitmapscan = off;
+    SELECT count(*) FROM crash_widen WHERE id = 1005;
+  ")
+  check "widen_crash_row_found" "1" "$found"
+
+  echo "  widened=$widened found=$found"
+  destroy_cluster "$dir"
+}
+
 # ============================================================
 # Run all scenarios
 # ============================================================
@@ -322,6 +367,8 @@ echo ""
 scenario_crash_during_zm_rebuild
 echo ""
 scenario_crash_during_online_compact
+echo ""
+scenario_crash_after_widening
 
 # ============================================================
 # Summary
@@ -0,0 +1,311 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# ============================================================
+# Shared zone map cache (shared_preload_libraries)
+# ============================================================
+#
+# Spins up an ephemeral PG cluster with pg_sorted_heap preloaded, so
+# zone maps live in the shared cache instead of each backend.  Covers:
+#   1. Concurrent sessions: readers compare pruned and unpruned counts
+#      in one snapshot while writers insert and COPY.
+#   2. A second backend adopts the copy the first one loaded.
+#   3. Invalidation: a backend holding the shared copy sees the zone map
+#      another backend rebuilt (compact, rebuild_zonemap).
+#   4. Drop: the shared entry of a dropped table is freed, also while
+#      another backend still holds it.
+#
+# Usage: ./scripts/test_shared_zonemap.sh [tmp_root] [port]
+
+TMP_ROOT="${1:-${TMPDIR:-/tmp}}"
+PORT="${2:-65487}"
+INITIAL_ROWS=60000
+COPY_ROWS=5000
+COPY_ROUNDS=6
+READERS=3
+WRITERS=2
+
+if [[ "$TMP_ROOT" != /* ]]; then
+  echo "tmp_root must be absolute: $TMP_ROOT" >&2; exit 2
+fi
+if ! [[ "$PORT" =~ ^[0-9]+$ ]] || [ "$PORT" -le 1024 ] || [ "$PORT" -ge 65535 ]; then
+  echo "port must be 1025..65534" >&2; exit 2
+fi
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+if command -v pg_config >/dev/null 2>&1; then
+  PG_BINDIR="$(pg_config --bindir)"
+else
+  PG_BINDIR="/opt/homebrew/Cellar/postgresql@18/18.1_1/bin"
+fi
+
+TMP_DIR=""
+WORKER_PIDS=()
+pass=0; fail=0; total=0
+
+check() {
+  local name="$1" expected="$2" actual="$3"
+  total=$((total + 1))
+  if [ "$expected" = "$actual" ]; then
+    echo "  PASS: $name"
+    pass=$((pass + 1))
+  else
+    echo "  FAIL: $name (expected=$expected actual=$actual)"
+    fail=$((fail + 1))
+  fi
+}
+
+cleanup() {
+  for pid in "${WORKER_PIDS[@]:-}"; do
+    kill "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+  done
+  WORKER_PIDS=()
+  if [ -n "$TMP_DIR" ] && [ -d "$TMP_DIR/data" ]; then
+    "$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -m immediate stop >/dev/null 2>&1 || true
+  fi
+  if [ -n "$TMP_DIR" ]; then
+    rm -rf "$TMP_DIR"
+  fi
+}
+trap cleanup EXIT
+
+# --- Create ephemeral cluster, extension preloaded ---
+TMP_DIR="$(mktemp -d "$TMP_ROOT/pg_sorted_heap_zm_shared.XXXXXX")"
+make -C "$ROOT_DIR" install >/dev/null 2>&1 || true
+"$PG_BINDIR/initdb" -D "$TMP_DIR/data" -A trust --no-locale >/dev/null 2>&1
+cat >> "$TMP_DIR/data/postgresql.conf" <<'PGCONF'
+shared_preload_libraries = 'pg_sorted_heap'
+log_min_messages = warning
+PGCONF
+"$PG_BINDIR/pg_ctl" -D "$TMP_DIR/data" -l "$TMP_DIR/postmaster.log" \
+  -o "-k $TMP_DIR -p $PORT" start >/dev/null
+
+PSQL() {
+  "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -v ON_ERROR_STOP=1 -qtAX "$@"
+}
+
+# A nested session, run from inside another one with \!
+NESTED="$PG_BINDIR/psql -h $TMP_DIR -p $PORT postgres -v ON_ERROR_STOP=1 -qtAX"
+
+# Force the pruned custom scan; one line, so \! commands can use it
+PRUNED="SET enable_seqscan = off; SET enable_indexscan = off; SET enable_bitmapscan = off"
+
+PSQL -c "CREATE EXTENSION pg_sorted_heap"
+
+PSQL <<SQL
+CREATE TABLE zm_shared(
+    id bigint PRIMARY KEY,
+    val text
+) USING sorted_heap;
+
+INSERT INTO zm_shared
+  SELECT g, repeat('x', 80)
+  FROM generate_series(1, $INITIAL_ROWS) g;
+
+SELECT sorted_heap_compact('zm_shared'::regclass);
+SQL
+
+relid=$(PSQL -c "SELECT 'zm_shared'::regclass::oid")
+echo "Setup: ${INITIAL_ROWS} rows, compacted (relid $relid)"
+
+# ============================================================
+# 1. Concurrent sessions
+# ============================================================
+echo ""
+echo "=== Readers vs writers on the shared zone map ==="
+
+# Both counts in one snapshot: they differ only if pruning skipped a
+# block holding a matching row.
+reader() {
+  local r="$1" n=0 lo hi out
+  while [ ! -f "$TMP_DIR/writers_done" ]; do
+    n=$((n + 1))
+    lo=$(( (n * 7919 + r * 104729) % (INITIAL_ROWS + COPY_ROWS * COPY_ROUNDS) ))
+    hi=$((lo + 500))
+    out=$("$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX <<SQL 2>/dev/null || true
+$PRUNED;
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT count(*) FROM zm_shared WHERE id BETWEEN $lo AND $hi
+   OR id BETWEEN -$hi AND -$lo;
+SET LOCAL sorted_heap.enable_scan_pruning = off;
+SELECT count(*) FROM zm_shared WHERE id BETWEEN $lo AND $hi
+   OR id BETWEEN -$hi AND -$lo;
+COMMIT;
+SQL
+)
+    if [ -n "$out" ] && [ "$(echo "$out" | sort -u | wc -l)" -ne 1 ]; then
+      echo "$lo $hi: $(echo "$out" | tr '\n' ' ')" >> "$TMP_DIR/mismatch_$r"
+    fi
+  done
+  echo "$n" > "$TMP_DIR/reads_done_$r"
+}
+
+# Single rows with negative keys land in pages the entries do not cover
+single_writer() {
+  local w="$1" n=0
+  while [ ! -f "$TMP_DIR/writers_done" ]; do
+    n=$((n + 1))
+    "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX \
+      -c "INSERT INTO zm_shared VALUES (-($n * $WRITERS + $w), 'single')" \
+      >/dev/null 2>&1 || true
+  done
+}
+
+copy_writer() {
+  local round start
+  for round in $(seq 1 "$COPY_ROUNDS"); do
+    start=$((INITIAL_ROWS + (round - 1) * COPY_ROWS + 1))
+    seq "$start" $((start + COPY_ROWS - 1)) |
+      awk '{ printf "%s\t%s\n", $1, "copy" }' |
+      "$PG_BINDIR/psql" -h "$TMP_DIR" -p "$PORT" postgres -qtAX \
+        -c "COPY zm_shared FROM STDIN" >/dev/null
+  done
+  touch "$TMP_DIR/writers_done"
+}
+
+WORKER_PIDS=()
+for r in $(seq 1 "$READERS"); do
+  reader "$r" &
+  WORKER_PIDS+=($!)
+done
+for w in $(seq 1 "$WRITERS"); do
+  single_writer "$w" &
+  WORKER_PIDS+=($!)
+done
+copy_writer
+
+for pid in "${WORKER_PIDS[@]}"; do
+  wait "$pid" 2>/dev/null || true
+done
+WORKER_PIDS=()
+
+reads=0
+for r in $(seq 1 "$READERS"); do
+  reads=$((reads + $(cat "$TMP_DIR/reads_done_$r" 2>/dev/null || echo 0)))
+done
+mismatches=$(cat "$TMP_DIR"/mismatch_* 2>/dev/null | wc -l | tr -d ' ')
+echo "  reader snapshots compared: $reads"
+if [ "$mismatches" != "0" ]; then
+  head -5 "$TMP_DIR"/mismatch_*
+fi
+check "readers_pruned_eq_unpruned" "0" "$mismatches"
+
+seq_neg=$(PSQL -c "SET sorted_heap.enable_scan_pruning = off;
+  SELECT count(*) FROM zm_shared WHERE id < 0")
+pruned_neg=$(PSQL -c "$PRUNED; SELECT count(*) FROM zm_shared WHERE id < 0")
+check "negative_keys_not_pruned" "$seq_neg" "$pruned_neg"
+
+pruned_copy=$(PSQL -c "$PRUNED;
+  SELECT count(*) FROM zm_shared WHERE id > $INITIAL_ROWS")
+check "copied_keys_not_pruned" "$((COPY_ROWS * COPY_ROUNDS))" "$pruned_copy"
+
+check "shared_entry_loaded" "t" \
+  "$(PSQL -c "SELECT entries > 0 AND bytes > 0
+    FROM sorted_heap_zonemap_shared() WHERE relid = $relid")"
+
+# ============================================================
+# 2. A second backend adopts the first one's copy
+# ============================================================
+echo ""
+echo "=== Second backend adopts the shared copy ==="
+
+# The first session keeps its copy pinned while the nested one scans
+out=$(PSQL <<SQL
+$PRUNED;
+SELECT count(*) FROM zm_shared WHERE id BETWEEN 100 AND 200;
+\! $NESTED -c "$PRUNED; SELECT count(*) FROM zm_shared WHERE id BETWEEN 100 AND 200" -c "SELECT backends FROM sorted_heap_zonemap_shared() WHERE relid = $relid" > $TMP_DIR/nested.out
+SQL
+)
+mapfile -t nested < "$TMP_DIR/nested.out"
+check "adopt_first_count" "101" "$out"
+check "adopt_second_count" "101" "${nested[0]:-}"
+check "adopt_two_backends" "2" "${nested[1]:-}"
+
+# ============================================================
+# 3. Invalidation after a rebuild by another backend
+# ============================================================
+echo ""
+echo "=== Holder sees another backend's rebuild ==="
+
+# compact writes new storage, rebuild_zonemap a new run in place; rows
+# inserted after each must not be pruned by the holder's old copy
+max_id=$((INITIAL_ROWS + COPY_ROWS * COPY_ROUNDS))
+out=$(PSQL <<SQL
+$PRUNED;
+SELECT count(*) FROM zm_shared WHERE id BETWEEN 1 AND $max_id;
+\! $NESTED -c "SELECT sorted_heap_compact('zm_shared'::regclass)" -c "INSERT INTO zm_shared SELECT g, 'after compact' FROM generate_series($max_id + 1, $max_id + 1000) g" >/dev/null
+SELECT count(*) FROM zm_shared WHERE id > $max_id;
+SELECT count(*) FROM zm_shared WHERE id BETWEEN 1 AND $max_id;
+\! $NESTED -c "SELECT sorted_heap_rebuild_zonemap('zm_shared'::regclass)" -c "INSERT INTO zm_shared SELECT g, 'after rebuild' FROM generate_series($max_id + 1001, $max_id + 2000) g" >/dev/null
+SELECT count(*) FROM zm_shared WHERE id > $max_id + 1000;
+SELECT count(*) FROM zm_shared WHERE id > $max_id;
+SQL
+)
+mapfile -t lines <<< "$out"
+check "before_compact" "$max_id" "${lines[0]:-}"
+check "after_compact_new_rows" "1000" "${lines[1]:-}"
+check "after_compact_old_rows" "$max_id" "${lines[2]:-}"
+check "after_rebuild_new_rows" "1000" "${lines[3]:-}"
+check "after_rebuild_all_new_rows" "2000" "${lines[4]:-}"
+
+# Only this session holds it now; the others let go as they exited
+check "shared_entry_after_rebuild" "t" \
+  "$(PSQL -c "$PRUNED; SELECT count(*) FROM zm_shared WHERE id = 1" \
+    -c "SELECT s.entries > 0 AND s.backends = 1
+    FROM sorted_heap_zonemap_shared() s WHERE s.relid = $relid" | tail -1)"
+
+# ============================================================
+# 4. Drop
+# ============================================================
+echo ""
+echo "=== Dropped tables leave no shared entry ==="
+
+PSQL <<SQL
+CREATE TABLE zm_drop(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO zm_drop SELECT g, 'x' FROM generate_series(1, 20000) g;
+SELECT sorted_heap_compact('zm_drop'::regclass);
+SQL
+drop_relid=$(PSQL -c "SELECT 'zm_drop'::regclass::oid")
+
+# Dropped by another backend while this one holds the entry
+out=$(PSQL <<SQL
+$PRUNED;
+SELECT count(*) FROM zm_drop WHERE id < 10;
+SELECT count(*) FROM sorted_heap_zonemap_shared() WHERE relid = $drop_relid;
+\! $NESTED -c "DROP TABLE zm_drop"
+SELECT count(*) FROM sorted_heap_zonemap_shared() WHERE relid = $drop_relid;
+SQL
+)
+mapfile -t lines <<< "$out"
+check "drop_held_count" "9" "${lines[0]:-}"
+check "drop_held_entry" "1" "${lines[1]:-}"
+check "drop_held_freed" "0" "${lines[2]:-}"
+
+# Create, scan and drop repeatedly: nothing accumulates
+for i in $(seq 1 20); do
+  PSQL <<SQL >/dev/null
+CREATE TABLE zm_churn(id int PRIMARY KEY) USING sorted_heap;
+INSERT INTO zm_churn SELECT generate_series(1, 2000);
+SELECT sorted_heap_compact('zm_churn'::regclass);
+$PRUNED;
+SELECT count(*) FROM zm_churn WHERE id < 10;
+DROP TABLE zm_churn;
+SQL
+done
+check "drop_churn_freed" "0" \
+  "$(PSQL -c "SELECT count(*) FROM sorted_heap_zonemap_shared() s
+    WHERE NOT EXISTS (SELECT 1 FROM pg_class c WHERE c.oid = s.relid)")"
+
+# ============================================================
+# Summary
+# ============================================================
+echo ""
+if [ "$fail" -eq 0 ]; then
+  echo "shared_zonemap_test status=ok pass=$pass fail=$fail total=$total"
+else
+  echo "shared_zonemap_test status=FAIL pass=$pass fail=$fail total=$total"
+  exit 1
+fi
@@ -250,6 +250,37 @@ RETURNS void
 AS '$libdir/pg_sorted_heap', 'sorted_heap_rebuild_zonemap_sql'
 LANGUAGE C STRICT;
 
+CREATE FUNCTION @extschema@.sorted_heap_set_zone_pages(regclass, integer)
+RETURNS void
+AS '$libdir/pg_sorted_heap', 'sorted_heap_set_zone_pages_sql'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION @extschema@.sorted_heap_zonemap_memory(
+  OUT relid regclass,
+  OUT entries bigint,
+  OUT bytes bigint,
+  OUT shared boolean
+) RETURNS SETOF record
+AS '$libdir/pg_sorted_heap', 'sorted_heap_zonemap_memory'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION @extschema@.sorted_heap_zonemap_shared(
+  OUT relid oid,
+  OUT entries bigint,
+  OUT bytes bigint,
+  OUT backends integer
+) RETURNS SETOF record
+AS '$libdir/pg_sorted_heap', 'sorted_heap_zonemap_shared'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION @extschema@.sorted_heap_zone_filter_selftest(
+  OUT kernel text,
+  OUT cases integer,
+  OUT mismatches integer
+) RETURNS SETOF record
+AS '$libdir/pg_sorted_heap', 'sorted_heap_zone_filter_selftest'
+LANGUAGE C STRICT;
+
 CREATE FUNCTION @extschema@.sorted_heap_scan_stats(
   OUT total_scans bigint,
   OUT blocks_scanned bigint,
@@ -986,7 +986,7 @@ SELECT count(*) AS sh5_point_count FROM sh5_scan WHERE id = 500;
 -- Test SH5-5: Full scan (no WHERE) — all rows
 SELECT count(*) AS sh5_full_count FROM sh5_scan;
 
--- Test SH5-6: INSERT invalidates zone map, falls back to seq scan
+-- Test SH5-6: INSERT keeps the zone map, still a SortedHeapScan
 INSERT INTO sh5_scan VALUES (2001, 'extra');
 SELECT sh5_plan_contains(
     'SELECT * FROM sh5_scan WHERE id BETWEEN 100 AND 200',
@@ -1026,6 +1026,18 @@ BEGIN
 END;
 $$ LANGUAGE plpgsql;
 
+-- Helper: Scanned Blocks of the plan node at path node (the top node
+-- if empty), e.g. '{Plans,0}' for the scan under a Limit
+CREATE FUNCTION sh6_scanned(query text, node text[] DEFAULT '{}') RETURNS int AS $$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF, FORMAT JSON) '
+        || query INTO plan;
+    RETURN ((plan->0->'Plan') #> node ->> 'Scanned Blocks')::int;
+END;
+$$ LANGUAGE plpgsql;
+
 -- Setup
 CREATE TABLE sh6_guc(id int PRIMARY KEY, val text) USING sorted_heap;
 CREATE TEMP TABLE sh6_src AS
@@ -1244,7 +1256,7 @@ INSERT INTO sh8_intint
 SELECT sorted_heap_compact('sh8_intint'::regclass);
 SELECT
     CASE WHEN sorted_heap_zonemap_stats('sh8_intint'::regclass)
-              LIKE 'version=6%pk_typid=23 pk_typid2=23%flags=valid%'
+              LIKE 'version=8%pk_typid=23 pk_typid2=23%flags=valid%'
          THEN 'sh8_intint_zonemap_ok'
          ELSE 'sh8_intint_zonemap_FAIL: ' || sorted_heap_zonemap_stats('sh8_intint'::regclass)
     END AS sh8_1_result;
@@ -1280,7 +1292,7 @@ INSERT INTO sh8_ts
 SELECT sorted_heap_compact('sh8_ts'::regclass);
 SELECT
     CASE WHEN sorted_heap_zonemap_stats('sh8_ts'::regclass)
-              LIKE 'version=6%pk_typid=23 pk_typid2=1114%flags=valid%'
+              LIKE 'version=8%pk_typid=23 pk_typid2=1114%flags=valid%'
          THEN 'sh8_ts_zonemap_ok'
          ELSE 'sh8_ts_zonemap_FAIL: ' || sorted_heap_zonemap_stats('sh8_ts'::regclass)
     END AS sh8_4_result;
@@ -1294,7 +1306,7 @@ SELECT sorted_heap_compact('sh8_text'::regclass);
 -- pk_typid2 should be 0 (InvalidOid) — text not supported
 SELECT
     CASE WHEN sorted_heap_zonemap_stats('sh8_text'::regclass)
-              LIKE 'version=6%pk_typid=23 pk_typid2=0%flags=valid%'
+              LIKE 'version=8%pk_typid=23 pk_typid2=0%flags=valid%'
          THEN 'sh8_text_degradation_ok'
          ELSE 'sh8_text_degradation_FAIL: ' || sorted_heap_zonemap_stats('sh8_text'::regclass)
     END AS sh8_5_result;
@@ -1307,7 +1319,7 @@ INSERT INTO sh8_single SELECT g, repeat('w', 40) FROM generate_series(1, 300) g;
 SELECT sorted_heap_compact('sh8_single'::regclass);
 SELECT
     CASE WHEN sorted_heap_zonemap_stats('sh8_single'::regclass)
-              LIKE 'version=6%pk_typid=23 pk_typid2=0%flags=valid%'
+              LIKE 'version=8%pk_typid=23 pk_typid2=0%flags=valid%'
          THEN 'sh8_single_ok'
          ELSE 'sh8_single_FAIL: ' || sorted_heap_zonemap_stats('sh8_single'::regclass)
     END AS sh8_6_result;
@@ -1741,9 +1753,9 @@ INSERT INTO sh14_big
 
 SELECT sorted_heap_compact('sh14_big'::regclass);
 
--- SH14-2: Zone map stats should show full meta page + overflow with chain
+-- SH14-2: Zone map stats should show full meta page + one directory run
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh14_big'::regclass)
-                 LIKE '%nentries=250%flags=valid%total_overflow_pages=%'
+                 LIKE '%nentries=250%flags=valid%overflow_runs=1%'
          THEN 'sh14_overflow_chain_ok'
          ELSE 'sh14_overflow_chain_FAIL: ' ||
               sorted_heap_zonemap_stats('sh14_big'::regclass)
@@ -1776,10 +1788,10 @@ DROP TABLE sh14_big;
 -- SH15-1: Create table, compact → zone map valid (flags=valid)
 CREATE TABLE sh15_vac(
     id int PRIMARY KEY,
-    val int
+    val text
 ) USING sorted_heap;
 
-INSERT INTO sh15_vac SELECT g, g FROM generate_series(1, 5000) g;
+INSERT INTO sh15_vac SELECT g, repeat('x', 400) FROM generate_series(1, 5000) g;
 SELECT sorted_heap_compact('sh15_vac'::regclass);
 
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
@@ -1788,28 +1800,28 @@ SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
          ELSE 'sh15_zm_FAIL'
     END AS sh15_1_result;
 
--- SH15-2: Single-row INSERTs to overflow onto new page → invalidate zone map
--- After compact, zm_nentries covers all pages. We need INSERTs that spill
--- to a new page (zmidx >= zm_nentries).
+-- SH15-2: Single-row INSERTs onto new pages past the overflow run → the
+-- zone map stays valid but those pages are read unpruned (tail_unsorted).
+-- 5000 rows of 432 bytes fill 278 pages, more than the meta page covers.
 DO $$
 BEGIN
     FOR i IN 5001..5500 LOOP
-        INSERT INTO sh15_vac VALUES (i, i);
+        INSERT INTO sh15_vac VALUES (i, repeat('x', 400));
     END LOOP;
 END;
 $$;
 
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
-                 NOT LIKE '%flags=valid%'
-         THEN 'sh15_zm_invalidated_ok'
-         ELSE 'sh15_zm_still_valid_FAIL'
+                 LIKE '%flags=valid%tail_unsorted%'
+         THEN 'sh15_zm_tail_unsorted_ok'
+         ELSE 'sh15_zm_tail_FAIL'
     END AS sh15_2_result;
 
--- SH15-3: VACUUM should rebuild zone map (zone map becomes valid again)
+-- SH15-3: VACUUM should rebuild zone map (zone map covers the tail again)
 VACUUM sh15_vac;
 
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
-                 LIKE '%flags=valid%'
+                 NOT LIKE '%tail_unsorted%'
          THEN 'sh15_vacuum_rebuilt_zm_ok'
          ELSE 'sh15_vacuum_rebuild_FAIL: ' ||
               sorted_heap_zonemap_stats('sh15_vac'::regclass)
@@ -1831,11 +1843,11 @@ RESET enable_indexscan;
 RESET enable_bitmapscan;
 
 -- SH15-5: GUC off → VACUUM does NOT rebuild zone map
--- First invalidate again
+-- First leave an uncovered tail again
 DO $$
 BEGIN
     FOR i IN 5501..6000 LOOP
-        INSERT INTO sh15_vac VALUES (i, i);
+        INSERT INTO sh15_vac VALUES (i, repeat('x', 400));
     END LOOP;
 END;
 $$;
@@ -1844,7 +1856,7 @@ SET sorted_heap.vacuum_rebuild_zonemap = off;
 VACUUM sh15_vac;
 
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
-                 NOT LIKE '%flags=valid%'
+                 LIKE '%tail_unsorted%'
          THEN 'sh15_guc_off_no_rebuild_ok'
          ELSE 'sh15_guc_off_FAIL'
     END AS sh15_5_result;
@@ -1854,7 +1866,7 @@ RESET sorted_heap.vacuum_rebuild_zonemap;
 VACUUM sh15_vac;
 
 SELECT CASE WHEN sorted_heap_zonemap_stats('sh15_vac'::regclass)
-                 LIKE '%flags=valid%'
+                 NOT LIKE '%tail_unsorted%'
          THEN 'sh15_guc_on_rebuild_ok'
          ELSE 'sh15_guc_on_FAIL: ' ||
               sorted_heap_zonemap_stats('sh15_vac'::regclass)
@@ -2062,12 +2074,805 @@ SELECT count(*) AS sh17_point_check FROM sh17 WHERE id = 500;
 SELECT count(*) AS sh17_range_check FROM sh17 WHERE id BETWEEN 100 AND 200;
 SELECT count(*) AS sh17_mixed_check FROM sh17 WHERE id > 50 AND id < 200;
 
+-- SH17-5: Parallel-aware scan with runtime bounds.  The leader resolves
+-- the Params before publishing ranges, so workers see the real range.
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+PREPARE sh17_par(int,int) AS
+  SELECT count(*) FROM sh17 WHERE id BETWEEN $1 AND $2;
+SELECT sh6_plan_contains('EXECUTE sh17_par(100, 5000)', 'Gather')
+  AS sh17_par_gather;
+EXECUTE sh17_par(100, 5000);
+EXECUTE sh17_par(9000, 9999);
+PREPARE sh17_par_point(int) AS SELECT * FROM sh17 WHERE id = $1;
+EXECUTE sh17_par_point(500);
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
 RESET plan_cache_mode;
 RESET enable_indexscan;
 RESET enable_bitmapscan;
 DEALLOCATE ALL;
 DROP TABLE sh17;
 
+-- ================================================================
+-- SH18: Non-contiguous block ranges (read stream)
+-- Three batches loaded out of order leave an unsorted zone map; a
+-- range spanning the first and third batch must skip the middle one.
+-- ================================================================
+
+CREATE TABLE sh18(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh18 SELECT g, repeat('x', 80) FROM generate_series(1, 2000) g;
+INSERT INTO sh18 SELECT g, repeat('x', 80) FROM generate_series(100001, 102000) g;
+INSERT INTO sh18 SELECT g, repeat('x', 80) FROM generate_series(2001, 4000) g;
+SELECT sorted_heap_rebuild_zonemap('sh18'::regclass);
+ANALYZE sh18;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH18-1: block list has more than one range
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh18 WHERE id BETWEEN 1500 AND 2500',
+    'ranges') AS sh18_multi_range;
+SELECT count(*) AS sh18_multi_range_count
+FROM sh18 WHERE id BETWEEN 1500 AND 2500;
+
+-- SH18-2: prepared statement resolves the same ranges at runtime
+PREPARE sh18_range(int, int) AS
+  SELECT count(*) FROM sh18 WHERE id BETWEEN $1 AND $2;
+SET plan_cache_mode = force_generic_plan;
+EXECUTE sh18_range(1500, 2500);
+RESET plan_cache_mode;
+DEALLOCATE sh18_range;
+
+-- SH18-3: parallel scan hands out only the qualifying ranges
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+SELECT count(*) AS sh18_parallel_count
+FROM sh18 WHERE id BETWEEN 1500 AND 2500;
+SELECT count(*) AS sh18_parallel_far
+FROM sh18 WHERE id > 101990;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh18;
+
+-- ================================================================
+-- SH19: Page-level pruning counters
+-- Every block is either read (Scanned) or never touched (Pruned).
+-- ================================================================
+
+CREATE TABLE sh19(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh19 SELECT g, repeat('x', 80) FROM generate_series(1, 2000) g;
+INSERT INTO sh19 SELECT g, repeat('x', 80) FROM generate_series(100001, 102000) g;
+INSERT INTO sh19 SELECT g, repeat('x', 80) FROM generate_series(2001, 4000) g;
+SELECT sorted_heap_rebuild_zonemap('sh19'::regclass);
+ANALYZE sh19;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+CREATE FUNCTION sh19_blocks(query text, OUT scanned int, OUT pruned int)
+AS $$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF, FORMAT JSON) '
+        || query INTO plan;
+    scanned := (plan->0->'Plan'->>'Scanned Blocks')::int;
+    pruned := (plan->0->'Plan'->>'Pruned Blocks')::int;
+END;
+$$ LANGUAGE plpgsql;
+
+-- SH19-1: scanned + pruned covers the whole relation, most blocks pruned
+SELECT scanned + pruned = pg_relation_size('sh19') / current_setting('block_size')::int
+           AS sh19_all_accounted,
+       pruned > scanned AS sh19_mostly_pruned
+FROM sh19_blocks('SELECT * FROM sh19 WHERE id BETWEEN 1500 AND 2500');
+
+-- SH19-2: nothing matches → nothing read
+SELECT scanned AS sh19_none_scanned
+FROM sh19_blocks('SELECT * FROM sh19 WHERE id BETWEEN 50000 AND 60000');
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP FUNCTION sh19_blocks(text);
+DROP TABLE sh19;
+
+-- ================================================================
+-- SH20: pk = ANY(array) / IN-lists
+-- Each key is looked up in the zone map on its own, so keys far apart
+-- read only their own pages.
+-- ================================================================
+
+CREATE TABLE sh20(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh20 SELECT g, repeat('x', 80) FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh20'::regclass);
+ANALYZE sh20;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH20-1: Const IN-list → one range per distant key
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh20 WHERE id IN (5, 2000, 3990)',
+    'in 3 ranges') AS sh20_in_ranges;
+SELECT count(*) AS sh20_in_count
+FROM sh20 WHERE id IN (5, 2000, 3990, 5000, NULL);
+
+-- SH20-2: duplicate keys and keys sharing a page read one block
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh20 WHERE id = ANY(ARRAY[9, 7, 7, 8])',
+    'Zone Map: 1 of') AS sh20_same_page;
+SELECT count(*) AS sh20_same_page_count
+FROM sh20 WHERE id = ANY(ARRAY[9, 7, 7, 8]);
+
+-- SH20-3: IN-list combined with a range; bigint keys on an int PK
+SELECT count(*) AS sh20_in_range_count
+FROM sh20 WHERE id IN (5, 2000, 3990) AND id > 100;
+SELECT count(*) AS sh20_bigint_count
+FROM sh20 WHERE id = ANY(ARRAY[5, 3990, 9999999999]::bigint[]);
+
+-- SH20-4: prepared = ANY($1) resolves its keys at runtime
+PREPARE sh20_any(int[]) AS SELECT count(*) FROM sh20 WHERE id = ANY($1);
+SET plan_cache_mode = force_generic_plan;
+EXECUTE sh20_any(ARRAY[5, 2000, 3990]);
+EXECUTE sh20_any(ARRAY[]::int[]);
+EXECUTE sh20_any(NULL);
+RESET plan_cache_mode;
+DEALLOCATE sh20_any;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh20;
+
+-- ================================================================
+-- SH21: OR of PK ranges
+-- A disjunction of column 1 ranges becomes a union of intervals, each
+-- looked up in the zone map on its own.
+-- ================================================================
+
+CREATE TABLE sh21(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh21 SELECT g, repeat('x', 80) FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh21'::regclass);
+ANALYZE sh21;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH21-1: two BETWEENs → one range per branch
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh21 WHERE (id BETWEEN 10 AND 20) OR (id BETWEEN 3000 AND 3100)',
+    'in 2 ranges') AS sh21_or_ranges;
+SELECT count(*) AS sh21_or_count
+FROM sh21 WHERE (id BETWEEN 10 AND 20) OR (id BETWEEN 3000 AND 3100);
+
+-- SH21-2: strict bounds, IN-lists and out-of-range ends in one OR
+SELECT count(*) AS sh21_mixed_count
+FROM sh21 WHERE (id > 10 AND id < 20) OR id IN (2000, 2001)
+             OR (id >= 3990 AND id <= 5000);
+
+-- SH21-3: a branch on another column spoils the OR
+SELECT count(*) AS sh21_spoiled_count
+FROM sh21 WHERE id < 5 OR val = 'nope';
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh21 WHERE id < 5 OR val = ''nope''',
+    'SortedHeapScan') AS sh21_spoiled_custom;
+
+-- SH21-4: OR intersected with a range
+SELECT count(*) AS sh21_and_count
+FROM sh21 WHERE (id < 100 OR id > 3900) AND id BETWEEN 50 AND 3950;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh21;
+
+-- ================================================================
+-- SH22: parameterized scans for nested loop joins on the PK
+-- The inner SortedHeapScan turns each outer row's join key into bounds
+-- and reads only the blocks holding it.
+-- ================================================================
+
+CREATE TABLE sh22(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh22 SELECT g, repeat('x', 80) FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh22'::regclass);
+ANALYZE sh22;
+CREATE TABLE sh22_keys(k bigint);
+INSERT INTO sh22_keys VALUES (5), (2000), (3990), (9999), (NULL);
+ANALYZE sh22_keys;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+
+-- SH22-1: equi-join probes the PK per outer row (bigint keys, int PK)
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh22_keys k JOIN sh22 s ON s.id = k.k',
+    'SortedHeapScan') AS sh22_param_scan;
+SELECT count(*) AS sh22_eq_count
+FROM sh22_keys k JOIN sh22 s ON s.id = k.k;
+
+-- SH22-2: range join clauses on outer expressions
+SELECT count(*) AS sh22_range_count
+FROM sh22_keys k JOIN sh22 s ON s.id > k.k AND s.id <= k.k + 2;
+
+-- SH22-3: outer side from a function scan
+SELECT count(*) AS sh22_unnest_count
+FROM unnest(ARRAY[1, 4000, 4001]) u(k) JOIN sh22 s ON s.id = u.k;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+DROP TABLE sh22_keys;
+DROP TABLE sh22;
+
+-- ================================================================
+-- SH23: ordered scans (PK pathkeys)
+-- Pages in the zone map's sorted prefix come back in PK order, so
+-- ORDER BY pk and merge joins need no Sort node.
+-- ================================================================
+
+CREATE TABLE sh23(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh23 SELECT g, repeat('x', 80) FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh23'::regclass);
+ANALYZE sh23;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH23-1: ORDER BY pk over a pruned range needs no Sort
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh23 WHERE id BETWEEN 100 AND 2000 ORDER BY id',
+    'SortedHeapScan') AS sh23_ordered_scan,
+       sh6_plan_contains(
+    'SELECT * FROM sh23 WHERE id BETWEEN 100 AND 2000 ORDER BY id',
+    'Sort Key') AS sh23_range_sort;
+SELECT id AS sh23_id FROM sh23 WHERE id > 3990 ORDER BY id LIMIT 3;
+
+-- SH23-2: without any bound the whole table is read in order
+SELECT sh6_plan_contains('SELECT * FROM sh23 ORDER BY id',
+                         'Sort Key') AS sh23_full_sort;
+SELECT id AS sh23_id FROM sh23 ORDER BY id LIMIT 3;
+
+-- SH23-3: merge join on the PK without Sort nodes
+SET enable_hashjoin = off;
+SET enable_nestloop = off;
+SELECT sh6_plan_contains(
+    'SELECT * FROM sh23 a JOIN sh23 b ON a.id = b.id',
+    'Merge Join') AS sh23_merge_join,
+       sh6_plan_contains(
+    'SELECT * FROM sh23 a JOIN sh23 b ON a.id = b.id',
+    'Sort Key') AS sh23_merge_sort;
+SELECT count(*) AS sh23_merge_count FROM sh23 a JOIN sh23 b ON a.id = b.id;
+RESET enable_hashjoin;
+RESET enable_nestloop;
+
+-- SH23-4: a key inserted out of order still sorts first
+INSERT INTO sh23 VALUES (0, 'z');
+SELECT id AS sh23_id FROM sh23 ORDER BY id LIMIT 3;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh23;
+
+-- ================================================================
+-- SH24: backward ordered scans
+-- ORDER BY pk DESC walks the ranges from their high end, so a top-N
+-- query stops after the last few pages.
+-- ================================================================
+
+CREATE TABLE sh24(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh24 SELECT g, repeat('x', 80) FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh24'::regclass);
+ANALYZE sh24;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH24-1: top-N by pk DESC needs no Sort and reads only the last pages
+SELECT sh6_plan_contains('SELECT * FROM sh24 ORDER BY id DESC LIMIT 5',
+                         'Sort Key') AS sh24_desc_sort;
+SELECT sh6_scanned('SELECT * FROM sh24 ORDER BY id DESC LIMIT 5',
+                   '{Plans,0}') <= 2
+       AS sh24_few_pages;
+SELECT id AS sh24_id FROM sh24 ORDER BY id DESC LIMIT 5;
+
+-- SH24-2: backward within a pruned range
+SELECT id AS sh24_id FROM sh24 WHERE id < 3000 ORDER BY id DESC LIMIT 3;
+
+-- SH24-3: several ranges are walked last to first
+SELECT id AS sh24_id FROM sh24 WHERE id IN (5, 2000, 3990) ORDER BY id DESC;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh24;
+
+-- ================================================================
+-- SH25: LIMIT-paced scans
+-- Under a LIMIT the read stream is held to a block budget, so keyset
+-- pagination reads a page or two; filters that reject rows widen it.
+-- ================================================================
+
+CREATE TABLE sh25(id bigint PRIMARY KEY, grp int, val text) USING sorted_heap;
+INSERT INTO sh25 SELECT g, g % 500, repeat('x', 80)
+FROM generate_series(1, 4000) g;
+SELECT sorted_heap_compact('sh25'::regclass);
+ANALYZE sh25;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+SET plan_cache_mode = force_generic_plan;
+
+-- SH25-1: keyset pagination gets a budget and reads a page or two
+PREPARE sh25_page(bigint) AS
+    SELECT id FROM sh25 WHERE id > $1 ORDER BY id LIMIT 10;
+SELECT sh6_plan_contains('EXECUTE sh25_page(2000)', 'Block Budget')
+       AS sh25_budget;
+SELECT sh6_scanned('EXECUTE sh25_page(2000)', '{Plans,0}') <= 2 AS sh25_few_pages;
+EXECUTE sh25_page(2000);
+
+-- SH25-2: a selective filter spends the budget; the scan resumes
+SELECT id AS sh25_id FROM sh25 WHERE id > 100 AND grp = 0
+ORDER BY id LIMIT 3;
+
+-- SH25-3: no budget when a Sort or a join needs every row
+SELECT sh6_plan_contains('SELECT * FROM sh25 WHERE id > 100 ORDER BY val LIMIT 5',
+                         'Block Budget') AS sh25_sorted_budget;
+
+RESET plan_cache_mode;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DEALLOCATE sh25_page;
+DROP TABLE sh25;
+
+-- ================================================================
+-- SH26: in-page binary search
+-- A page whose tuples are still in PK order after compaction is
+-- binary-searched by point and narrow-range lookups.
+-- ================================================================
+
+CREATE TABLE sh26(id int PRIMARY KEY, val text) USING sorted_heap;
+INSERT INTO sh26 SELECT g, repeat('x', 80) FROM generate_series(1, 2000) g;
+SELECT sorted_heap_compact('sh26'::regclass);
+ANALYZE sh26;
+
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+CREATE FUNCTION sh26_searched(query text) RETURNS int AS $$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF, FORMAT JSON) '
+        || query INTO plan;
+    RETURN COALESCE((plan->0->'Plan'->>'Searched Blocks')::int, 0);
+END;
+$$ LANGUAGE plpgsql;
+
+-- SH26-1: the first lookup checks the page's order, the next searches it
+SELECT sh26_searched('SELECT * FROM sh26 WHERE id = 1000') AS sh26_first;
+SELECT sh26_searched('SELECT * FROM sh26 WHERE id = 1000') AS sh26_second;
+SELECT id AS sh26_id FROM sh26 WHERE id = 1000;
+
+-- SH26-2: narrow ranges and IN-lists take one window per interval
+SELECT id AS sh26_id FROM sh26 WHERE id BETWEEN 998 AND 1002;
+SELECT id AS sh26_id FROM sh26 WHERE id IN (997, 1000, 1003);
+SELECT id AS sh26_id FROM sh26 WHERE id > 999 AND id < 1001;
+
+-- SH26-3: a change to the page retires what was known of its order
+DELETE FROM sh26 WHERE id = 1000;
+SELECT count(*) AS sh26_deleted FROM sh26 WHERE id = 1000;
+SELECT count(*) AS sh26_deleted FROM sh26 WHERE id = 1000;
+SELECT id AS sh26_id FROM sh26 WHERE id BETWEEN 999 AND 1001;
+
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP FUNCTION sh26_searched(text);
+DROP TABLE sh26;
+
+-- ================================================================
+-- SH27: Lazily read zone map overflow pages
+-- ================================================================
+-- ~18 rows per page: 12000 rows fill the meta page's 250 entries and
+-- spill into overflow pages, read only when a lookup reaches them.
+CREATE TABLE sh27(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh27 SELECT g, repeat('x', 400) FROM generate_series(1, 12000) g;
+SELECT sorted_heap_compact('sh27'::regclass);
+ANALYZE sh27;
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH27-1: point lookups in the last overflow page, the first one, and
+-- the meta page's range each read one data page
+SELECT sh6_scanned('SELECT id FROM sh27 WHERE id = 11990') AS sh27_last;
+SELECT sh6_scanned('SELECT id FROM sh27 WHERE id = 5000') AS sh27_first;
+SELECT sh6_scanned('SELECT id FROM sh27 WHERE id = 100') AS sh27_meta;
+SELECT id AS sh27_id FROM sh27 WHERE id IN (100, 5000, 11990);
+
+-- SH27-2: ranges spanning the meta page and overflow entries
+SELECT count(*) AS sh27_span FROM sh27 WHERE id BETWEEN 4000 AND 10000;
+SELECT count(*) AS sh27_tail FROM sh27 WHERE id > 11900;
+
+-- SH27-3: after a rebuild the overflow pages are read again on demand
+SELECT sorted_heap_rebuild_zonemap('sh27'::regclass);
+SELECT sh6_scanned('SELECT id FROM sh27 WHERE id = 11990') AS sh27_rebuilt;
+SELECT id AS sh27_id FROM sh27 WHERE id = 11990;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh27;
+
+-- ================================================================
+-- SH28: Super-zone summaries for zone maps that are not sorted
+-- ================================================================
+-- 18 rows per page: three runs of 3996 keys, stored highest run first,
+-- give 666 full pages whose zone map is not sorted.  Rebuild writes its
+-- overflow pages and three super-zone summaries.
+CREATE TABLE sh28(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh28 SELECT g, repeat('x', 400) FROM generate_series(1, 11988) g
+    ORDER BY (g - 1) / 3996 DESC, g;
+SELECT sorted_heap_rebuild_zonemap('sh28'::regclass);
+SELECT sorted_heap_zonemap_stats('sh28'::regclass)
+    LIKE '%flags=valid overflow_pages=1 overflow_runs=1 packed%' AS sh28_unsorted;
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH28-1: point lookups in each run read one data page
+SELECT sh6_scanned('SELECT id FROM sh28 WHERE id = 11000') AS sh28_first_run;
+SELECT sh6_scanned('SELECT id FROM sh28 WHERE id = 6000') AS sh28_middle_run;
+SELECT sh6_scanned('SELECT id FROM sh28 WHERE id = 100') AS sh28_last_run;
+SELECT id AS sh28_id FROM sh28 WHERE id IN (100, 6000, 11000) ORDER BY id;
+
+-- SH28-2: ranges crossing run boundaries
+SELECT count(*) AS sh28_span FROM sh28 WHERE id BETWEEN 3990 AND 4010;
+SELECT count(*) AS sh28_tail FROM sh28 WHERE id > 11900;
+SELECT count(*) AS sh28_in FROM sh28 WHERE id IN (1, 3996, 3997, 7993, 11988);
+
+-- SH28-3: a row inserted into the first page widens its super-zone too
+DELETE FROM sh28 WHERE id = 7993;
+VACUUM sh28;
+INSERT INTO sh28 VALUES (0, repeat('x', 400));
+SELECT sh6_scanned('SELECT id FROM sh28 WHERE id = 0') AS sh28_widened;
+SELECT id AS sh28_id FROM sh28 WHERE id = 0;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh28;
+
+-- ================================================================
+-- SH29: Several pages per zone map entry
+-- ================================================================
+-- 18 rows per page: 3600 rows fill 200 pages, summarised by 13 zones of
+-- 16 pages (the last one holding 8).
+CREATE TABLE sh29(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh29 SELECT g, repeat('x', 400) FROM generate_series(1, 3600) g;
+SELECT sorted_heap_set_zone_pages('sh29'::regclass, 16);
+ANALYZE sh29;
+SELECT sorted_heap_zonemap_stats('sh29'::regclass)
+    LIKE '%nentries=13 %zone_pages=16 [1:1..288]%' AS sh29_zones;
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH29-1: a point lookup reads its whole zone; the last zone ends with
+-- the table
+SELECT sh6_scanned('SELECT id FROM sh29 WHERE id = 1000') AS sh29_zone;
+SELECT sh6_scanned('SELECT id FROM sh29 WHERE id = 3600') AS sh29_last_zone;
+SELECT id AS sh29_id FROM sh29 WHERE id IN (1000, 3600) ORDER BY id;
+SELECT count(*) AS sh29_range FROM sh29 WHERE id BETWEEN 500 AND 700;
+
+-- SH29-2: a row on a new page inside the last zone widens that zone
+INSERT INTO sh29 VALUES (5000, repeat('x', 400));
+SELECT sh6_scanned('SELECT id FROM sh29 WHERE id = 5000') AS sh29_widened;
+SELECT id AS sh29_id FROM sh29 WHERE id = 5000;
+
+-- SH29-3: TRUNCATE and compaction keep the granularity
+TRUNCATE sh29;
+SELECT sorted_heap_zonemap_stats('sh29'::regclass)
+    LIKE '%zone_pages=16%' AS sh29_truncated;
+INSERT INTO sh29 SELECT g, repeat('x', 400) FROM generate_series(1, 3600) g;
+SELECT sorted_heap_compact('sh29'::regclass);
+SELECT sorted_heap_zonemap_stats('sh29'::regclass)
+    LIKE '%nentries=13 %zone_pages=16%' AS sh29_compacted;
+
+-- SH29-4: sizes out of range are rejected; back to one page per entry
+SELECT sorted_heap_set_zone_pages('sh29'::regclass, 0);
+SELECT sorted_heap_set_zone_pages('sh29'::regclass, 1);
+SELECT sorted_heap_zonemap_stats('sh29'::regclass)
+    NOT LIKE '%zone_pages%' AS sh29_per_page;
+SELECT sh6_scanned('SELECT id FROM sh29 WHERE id = 1000') AS sh29_page;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh29;
+
+-- ================================================================
+-- SH30: Zone map kept across relcache invalidations
+-- ================================================================
+-- 4986 rows fill 277 pages exactly: the meta page's 250 entries plus a
+-- packed overflow page and super-zone summaries.
+CREATE TABLE sh30(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh30 SELECT g, repeat('x', 400) FROM generate_series(1, 4986) g;
+SELECT sorted_heap_rebuild_zonemap('sh30'::regclass);
+ANALYZE sh30;
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH30-1: an invalidation that leaves the meta page alone keeps pruning
+ALTER TABLE sh30 SET (fillfactor = 100);
+SELECT sh6_scanned('SELECT id FROM sh30 WHERE id = 4900') AS sh30_overflow;
+SELECT sh6_scanned('SELECT id FROM sh30 WHERE id = 100') AS sh30_meta;
+
+-- SH30-2: a meta page entry widened since the zone map was read is
+-- picked up along with its super-zone (which 4900 now also meets), and
+-- the overflow entries stay
+DELETE FROM sh30 WHERE id = 10;
+VACUUM sh30;
+INSERT INTO sh30 VALUES (6000, repeat('x', 400));
+ALTER TABLE sh30 SET (fillfactor = 100);
+SELECT sh6_scanned('SELECT id FROM sh30 WHERE id = 6000') AS sh30_widened;
+SELECT sh6_scanned('SELECT id FROM sh30 WHERE id = 4900') AS sh30_overflow_kept;
+SELECT id AS sh30_id FROM sh30 WHERE id IN (10, 4900, 6000) ORDER BY id;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh30;
+
+-- ================================================================
+-- SH31: Zone map memory cap and accounting
+-- ================================================================
+-- 100 rows fill 6 pages (18 per page): one zone map entry each.
+CREATE TABLE sh31a(id int PRIMARY KEY, padding text) USING sorted_heap;
+CREATE TABLE sh31b(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh31a SELECT g, repeat('x', 400) FROM generate_series(1, 100) g;
+INSERT INTO sh31b SELECT g, repeat('x', 400) FROM generate_series(1, 100) g;
+SELECT sorted_heap_rebuild_zonemap('sh31a'::regclass);
+SELECT sorted_heap_rebuild_zonemap('sh31b'::regclass);
+
+SHOW sorted_heap.zonemap_cache_size;
+
+-- SH31-1: each scanned relation's zone map is cached and accounted for
+SELECT id AS sh31a_id FROM sh31a WHERE id = 5;
+SELECT id AS sh31b_id FROM sh31b WHERE id = 50;
+SELECT relid, entries, bytes > 0 AS has_bytes, shared
+FROM sorted_heap_zonemap_memory()
+WHERE relid::text LIKE 'sh31%' ORDER BY relid::text;
+
+-- SH31-2: past the cap, loading one zone map drops the least recently
+-- used others; a dropped zone map is reloaded on next use
+SET sorted_heap.zonemap_cache_size = 0;
+SELECT sorted_heap_rebuild_zonemap('sh31a');
+SELECT id AS sh31a_reloaded FROM sh31a WHERE id = 6;
+SELECT relid AS sh31_cached_a FROM sorted_heap_zonemap_memory()
+WHERE relid::text LIKE 'sh31%' ORDER BY relid::text;
+SELECT sorted_heap_rebuild_zonemap('sh31b');
+SELECT id AS sh31b_reloaded FROM sh31b WHERE id = 60;
+SELECT relid AS sh31_cached_b FROM sorted_heap_zonemap_memory()
+WHERE relid::text LIKE 'sh31%' ORDER BY relid::text;
+
+RESET sorted_heap.zonemap_cache_size;
+DROP TABLE sh31a;
+DROP TABLE sh31b;
+
+-- ================================================================
+-- SH32: UPDATE widens the new row version's zone map entry
+-- ================================================================
+-- At fillfactor 90 a page takes 16 rows on insert but has room for two
+-- more, so a non-HOT update keeps the new version on the old page.
+CREATE TABLE sh32(id int PRIMARY KEY, padding text)
+    USING sorted_heap WITH (fillfactor = 90);
+INSERT INTO sh32 SELECT g, repeat('x', 400) FROM generate_series(1, 100) g;
+SELECT sorted_heap_rebuild_zonemap('sh32'::regclass);
+-- 4160 rows fill 260 pages: entries 250-259 are in an overflow page
+CREATE TABLE sh32_ovfl(id int PRIMARY KEY, padding text)
+    USING sorted_heap WITH (fillfactor = 90);
+INSERT INTO sh32_ovfl SELECT g, repeat('x', 400) FROM generate_series(1, 4160) g;
+SELECT sorted_heap_rebuild_zonemap('sh32_ovfl'::regclass);
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH32-1: a meta page entry is widened; the moved key is found by a
+-- pruned scan of its one page
+UPDATE sh32 SET id = 1005 WHERE id = 5;
+SELECT id AS sh32_moved FROM sh32 WHERE id = 1005;
+SELECT sh6_scanned('SELECT id FROM sh32 WHERE id = 1005') AS sh32_meta_scanned;
+SELECT count(*) AS sh32_count FROM sh32 WHERE id BETWEEN 1 AND 2000;
+
+-- SH32-2: an entry in a packed overflow page is widened and repacked
+UPDATE sh32_ovfl SET id = 9000 WHERE id = 4100;
+SELECT id AS sh32_ovfl_moved FROM sh32_ovfl WHERE id = 9000;
+SELECT sh6_scanned('SELECT id FROM sh32_ovfl WHERE id = 9000') AS sh32_ovfl_scanned;
+SELECT id AS sh32_ovfl_near FROM sh32_ovfl WHERE id BETWEEN 4099 AND 4101 ORDER BY id;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh32;
+DROP TABLE sh32_ovfl;
+
+-- ================================================================
+-- SH33: Single-row INSERTs past the zone map keep pruning on
+-- ================================================================
+CREATE TABLE sh33(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh33 SELECT g, repeat('x', 400) FROM generate_series(1, 36) g;
+SELECT sorted_heap_rebuild_zonemap('sh33'::regclass);
+-- 4986 rows: 277 data pages, then a packed overflow page and a
+-- super-zone page
+CREATE TABLE sh33_tail(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh33_tail SELECT g, repeat('x', 400) FROM generate_series(1, 4986) g;
+SELECT sorted_heap_rebuild_zonemap('sh33_tail'::regclass);
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH33-1: a row on a new page past the meta page's entries gets an
+-- appended entry; the zone map stays valid
+INSERT INTO sh33 VALUES (500, repeat('x', 400));
+SELECT sh6_scanned('SELECT id FROM sh33 WHERE id = 500') AS sh33_appended;
+SELECT sh6_scanned('SELECT id FROM sh33 WHERE id = 10') AS sh33_first;
+SELECT id AS sh33_id FROM sh33 WHERE id IN (10, 500) ORDER BY id;
+
+-- SH33-2: past the overflow run the page stays uncovered but is always
+-- read, while covered pages are still pruned
+INSERT INTO sh33_tail VALUES (9000, repeat('x', 400));
+SELECT sh6_scanned('SELECT id FROM sh33_tail WHERE id = 9000') AS sh33_tail_new;
+SELECT sh6_scanned('SELECT id FROM sh33_tail WHERE id = 100') AS sh33_tail_old;
+SELECT id AS sh33_tail_id FROM sh33_tail WHERE id IN (100, 9000) ORDER BY id;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh33;
+DROP TABLE sh33_tail;
+
+-- ================================================================
+-- SH34: COPY past the meta page's entries keeps the zone map prunable
+-- ================================================================
+-- 4986 rows: 277 data pages, then a packed overflow page and a
+-- super-zone page
+CREATE TABLE sh34(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh34 SELECT g, repeat('x', 400) FROM generate_series(1, 4986) g;
+SELECT sorted_heap_rebuild_zonemap('sh34'::regclass);
+-- 1800 rows: 100 data pages, all entries in the meta page
+CREATE TABLE sh34_fresh(id int PRIMARY KEY, padding text) USING sorted_heap;
+INSERT INTO sh34_fresh SELECT g, repeat('x', 400) FROM generate_series(1, 1800) g;
+SELECT sorted_heap_rebuild_zonemap('sh34_fresh'::regclass);
+
+CREATE TABLE sh34_src(id int, padding text);
+INSERT INTO sh34_src SELECT g, repeat('x', 400) FROM generate_series(5001, 6800) g;
+COPY sh34_src TO '/tmp/sh34_more.csv' CSV;
+TRUNCATE sh34_src;
+INSERT INTO sh34_src SELECT g, repeat('x', 400) FROM generate_series(2001, 5600) g;
+COPY sh34_src TO '/tmp/sh34_fresh.csv' CSV;
+DROP TABLE sh34_src;
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH34-1: COPY past the overflow run appends entries to it; the new
+-- rows are pruned like the old ones and nothing is left uncovered
+COPY sh34 FROM '/tmp/sh34_more.csv' CSV;
+SELECT sorted_heap_zonemap_stats('sh34'::regclass)
+    LIKE '%flags=valid overflow_pages=1 overflow_runs=1 packed%'
+    AND sorted_heap_zonemap_stats('sh34'::regclass) NOT LIKE '%tail_unsorted%'
+    AS sh34_extended;
+SELECT sh6_scanned('SELECT id FROM sh34 WHERE id = 6000') AS sh34_new;
+SELECT sh6_scanned('SELECT id FROM sh34 WHERE id = 100') AS sh34_old;
+SELECT count(*) AS sh34_count FROM sh34 WHERE id BETWEEN 4900 AND 5100;
+
+-- SH34-2: COPY past the meta page's 250 entries starts an overflow run
+COPY sh34_fresh FROM '/tmp/sh34_fresh.csv' CSV;
+SELECT sorted_heap_zonemap_stats('sh34_fresh'::regclass)
+    LIKE '%nentries=250 %flags=valid overflow_pages=1 overflow_runs=1 packed%'
+    AND sorted_heap_zonemap_stats('sh34_fresh'::regclass) NOT LIKE '%tail_unsorted%'
+    AS sh34_fresh_run;
+SELECT sh6_scanned('SELECT id FROM sh34_fresh WHERE id = 5000') AS sh34_fresh_new;
+SELECT count(*) AS sh34_fresh_count FROM sh34_fresh WHERE id BETWEEN 1700 AND 2100;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh34;
+DROP TABLE sh34_fresh;
+
+-- ================================================================
+-- SH35: Zone map widenings are written to the meta page at commit
+-- ================================================================
+CREATE TABLE sh35(id int PRIMARY KEY, padding text)
+    USING sorted_heap WITH (fillfactor = 90);
+INSERT INTO sh35 SELECT g, repeat('x', 400) FROM generate_series(1, 100) g;
+SELECT sorted_heap_rebuild_zonemap('sh35'::regclass);
+
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+
+-- SH35-1: inside the transaction only the cached entry is widened; the
+-- meta page is written at commit
+BEGIN;
+UPDATE sh35 SET id = 1005 WHERE id = 5;
+SELECT sorted_heap_zonemap_stats('sh35'::regclass) LIKE '%[1:1..16]%'
+    AS sh35_meta_unchanged;
+SELECT sh6_scanned('SELECT id FROM sh35 WHERE id = 1005') AS sh35_scanned;
+SELECT id AS sh35_moved FROM sh35 WHERE id = 1005;
+COMMIT;
+SELECT sorted_heap_zonemap_stats('sh35'::regclass) LIKE '%[1:1..1005]%'
+    AS sh35_meta_widened;
+
+-- SH35-2: a rolled back widening never reaches the meta page
+BEGIN;
+UPDATE sh35 SET id = 2000 WHERE id = 20;
+ROLLBACK;
+SELECT sorted_heap_zonemap_stats('sh35'::regclass) LIKE '%[2:17..32]%'
+    AS sh35_rollback_unchanged;
+SELECT count(*) AS sh35_count FROM sh35 WHERE id BETWEEN 1 AND 2000;
+
+-- SH35-3: parallel workers load the zone map without the leader's
+-- deferred widenings; they get them through DSM, so a worker does not
+-- prune the page holding the transaction's own new row
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+SET parallel_leader_participation = off;
+BEGIN;
+INSERT INTO sh35 VALUES (3000, 'new');
+SELECT sh6_plan_contains('SELECT id FROM sh35 WHERE id = 3000', 'Gather')
+    AS sh35_par_gather;
+SELECT id AS sh35_par_new FROM sh35 WHERE id = 3000;
+SELECT count(*) AS sh35_par_count FROM sh35 WHERE id BETWEEN 2500 AND 3500;
+COMMIT;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+RESET parallel_leader_participation;
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE sh35;
+
+-- ================================================================
+-- SH36: Vectorised zone map filter kernels agree with the scalar loop
+-- ================================================================
+-- Every kernel this CPU runs (the set differs by machine) is compared
+-- with the scalar loop on empty, full-word, partial-word and unaligned
+-- runs, unset and column-2-less entries, and boundary and empty boxes
+SELECT bool_or(kernel = 'scalar') AS sh36_has_scalar,
+       min(cases) > 0 AS sh36_ran,
+       sum(mismatches) AS sh36_mismatches
+FROM sorted_heap_zone_filter_selftest();
+
 DROP FUNCTION sh6_plan_contains(text, text);
+DROP FUNCTION sh6_scanned(text, text[]);
 
 DROP EXTENSION pg_sorted_heap;
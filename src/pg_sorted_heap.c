@@ -1540,9 +1540,31 @@ _PG_init(void)
 							 0,
 							 NULL, NULL, NULL);
 
+	DefineCustomIntVariable("sorted_heap.zonemap_cache_size",
+							"Maximum backend-local memory for cached zone maps.",
+							"Least recently used zone maps are dropped past this; -1 means no limit. When preloaded, the server's value also caps the shared zone map cache.",
+							&sorted_heap_zonemap_cache_size,
+							65536,
+							-1, MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("sorted_heap.custom_wal",
+							 "Log zone map meta page changes with the sorted_heap WAL resource manager.",
+							 "Takes effect only when preloaded; standbys must preload the library too. Off uses generic WAL records.",
+							 &sorted_heap_custom_wal,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
 	MarkGUCPrefixReserved("sorted_heap");
 
 	CacheRegisterRelcacheCallback(pg_sorted_heap_relcache_callback, (Datum) 0);
 	CacheRegisterRelcacheCallback(sorted_heap_relcache_callback, (Datum) 0);
+	RegisterXactCallback(sorted_heap_xact_callback, NULL);
+	sorted_heap_rmgr_init();
+	sorted_heap_zmcache_init();
 	sorted_heap_scan_init();
 }
@@ -10,24 +10,38 @@
  * to heap, producing physically sorted runs.  After placement, per-page
  * min/max of the first PK column (int2/4/8 only) are recorded in a
  * persistent zone map stored in the meta page.
- * Scans, deletes, updates, and vacuum all delegate to heap.
+ * Single-row inserts and updates widen the zone map entry of the page
+ * they land on.  Scans, deletes, and vacuum all delegate to heap.
  */
 #include "postgres.h"
 
+#include "access/bufmask.h"
 #include "access/generic_xlog.h"
 #include "access/heapam.h"
 #include "access/multixact.h"
+#include "access/relation.h"
 #include "access/stratnum.h"
 #include "access/tableam.h"
+#include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogutils.h"
 #include "catalog/index.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_class.h"
 #include "commands/cluster.h"
+#include "funcapi.h"
 #include "catalog/pg_index.h"
+#include "lib/dshash.h"
 #include "miscadmin.h"
 #include "nodes/execnodes.h"
+#include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
 #include "storage/bufpage.h"
 #include "storage/checksum.h"
+#include "storage/ipc.h"
+#include "storage/lmgr.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
@@ -83,16 +97,55 @@ PG_FUNCTION_INFO_V1(sorted_heap_tableam_handler);
 PG_FUNCTION_INFO_V1(sorted_heap_zonemap_stats);
 PG_FUNCTION_INFO_V1(sorted_heap_compact);
 PG_FUNCTION_INFO_V1(sorted_heap_rebuild_zonemap_sql);
+PG_FUNCTION_INFO_V1(sorted_heap_set_zone_pages_sql);
 PG_FUNCTION_INFO_V1(sorted_heap_merge);
+PG_FUNCTION_INFO_V1(sorted_heap_zonemap_memory);
+PG_FUNCTION_INFO_V1(sorted_heap_zonemap_shared);
 
 /* ----------------------------------------------------------------
  *  Forward declarations
  * ---------------------------------------------------------------- */
 static void sorted_heap_init_meta_page_smgr(const RelFileLocator *rlocator,
-											ProcNumber backend, bool need_wal);
+											ProcNumber backend, bool need_wal,
+											uint32 zone_pages);
 static void sorted_heap_relinfo_invalidate(Oid relid);
 /* sorted_heap_zonemap_load is declared in sorted_heap.h (non-static) */
+static void sorted_heap_zonemap_attach(Relation rel, SortedHeapRelInfo *info);
+static void sorted_heap_zonemap_release(SortedHeapRelInfo *info);
+static void sorted_heap_zonemap_lock(SortedHeapRelInfo *info);
+static void sorted_heap_zonemap_unlock(SortedHeapRelInfo *info);
+static void sorted_heap_zmcache_forget(Oid relid);
+static BlockNumber sorted_heap_overflow_dir_block(SortedHeapRelInfo *info,
+												  uint32 page);
 static void sorted_heap_zonemap_flush(Relation rel, SortedHeapRelInfo *info);
+static void sorted_heap_zonemap_enforce_cap(SortedHeapRelInfo *keep);
+static bool sorted_heap_zonemap_revalidate(Relation rel,
+										   SortedHeapRelInfo *info);
+static inline void sorted_heap_entry_clear(SortedHeapZoneMapEntry *e);
+static bool sorted_heap_entry_merge(SortedHeapZoneMapEntry *e,
+									const SortedHeapZoneMapEntry *by);
+static bool sorted_heap_zonemap_apply_pending(SortedHeapRelInfo *info);
+static bool sorted_heap_zonemap_has_pending(Oid relid);
+static void sorted_heap_zonemap_defer(Relation rel, SortedHeapRelInfo *info,
+									  uint32 idx,
+									  const SortedHeapZoneMapEntry *by);
+static void sorted_heap_zonemap_invalidate(Relation rel,
+										   SortedHeapRelInfo *info);
+static bool sorted_heap_entry_widen(SortedHeapRelInfo *info,
+									SortedHeapZoneMapEntry *e,
+									TupleTableSlot *slot);
+static void sorted_heap_zonemap_append(Relation rel, SortedHeapRelInfo *info,
+									   uint32 idx);
+static bool sorted_heap_zonemap_note_overflow(Relation rel,
+											  SortedHeapRelInfo *info,
+											  uint32 first,
+											  const SortedHeapZoneMapEntry *by,
+											  uint32 n, uint32 end);
+static bool sorted_heap_zonemap_extend_overflow(Relation rel,
+												SortedHeapRelInfo *info,
+												uint32 end);
+static bool sorted_heap_zonemap_mark_tail(Relation rel,
+										  SortedHeapRelInfo *info);
 /* sorted_heap_rebuild_zonemap_internal is declared in sorted_heap.h (non-static) */
 
 static void sorted_heap_relation_set_new_filelocator(Relation rel,
@@ -116,6 +169,13 @@ static void sorted_heap_relation_copy_for_cluster(Relation OldTable,
 static void sorted_heap_tuple_insert(Relation rel, TupleTableSlot *slot,
 									 CommandId cid, int options,
 									 struct BulkInsertStateData *bistate);
+static TM_Result sorted_heap_tuple_update(Relation rel, ItemPointer otid,
+										  TupleTableSlot *slot, CommandId cid,
+										  Snapshot snapshot, Snapshot crosscheck,
+										  bool wait, TM_FailureData *tmfd,
+										  LockTupleMode *lockmode,
+										  TU_UpdateIndexes *update_indexes);
+static void sorted_heap_zonemap_note_tuple(Relation rel, TupleTableSlot *slot);
 static void sorted_heap_multi_insert(Relation rel, TupleTableSlot **slots,
 									 int nslots, CommandId cid, int options,
 									 struct BulkInsertStateData *bistate);
@@ -146,9 +206,30 @@ static bool sorted_heap_am_initialized = false;
 TableAmRoutine sorted_heap_am_routine;
 static HTAB *sorted_heap_relinfo_hash = NULL;
 
+/* Backend-local zone maps and the relinfo hash; LRU clock for eviction */
+MemoryContext sorted_heap_zonemap_context = NULL;
+static uint64 sorted_heap_zm_clock = 0;
+
+/*
+ * Meta page entries this transaction widened but has not written yet,
+ * per relation (see sorted_heap_zonemap_defer).  Lives in
+ * TopTransactionContext; NULL when there are none.
+ */
+typedef struct SortedHeapZmPending
+{
+	Oid			relid;								/* hash key */
+	RelFileNumber relnumber;
+	SortedHeapZoneMapEntry entries[SORTED_HEAP_ZONEMAP_CACHE_MAX];
+} SortedHeapZmPending;
+
+static HTAB *sorted_heap_pending_hash = NULL;
+
 /* GUC: rebuild zone map during VACUUM when invalid */
 bool sorted_heap_vacuum_rebuild_zonemap = true;
 
+/* GUC: cap on backend-local zone map memory, in kB (-1: no limit) */
+int sorted_heap_zonemap_cache_size = 65536;
+
 /* ----------------------------------------------------------------
  *  Handler + initialization
  * ---------------------------------------------------------------- */
@@ -179,9 +260,12 @@ sorted_heap_init_routine(void)
 	sorted_heap_am_routine.relation_copy_for_cluster =
 		sorted_heap_relation_copy_for_cluster;
 
-	/* Single-row insert — invalidates zone map valid flag */
+	/* Single-row insert — widens or appends zone map entries */
 	sorted_heap_am_routine.tuple_insert = sorted_heap_tuple_insert;
 
+	/* Update — widens the zone map entry of the new version's page */
+	sorted_heap_am_routine.tuple_update = sorted_heap_tuple_update;
+
 	/* Bulk insert — sort batch by PK + update zone map */
 	sorted_heap_am_routine.multi_insert = sorted_heap_multi_insert;
 
@@ -267,6 +351,706 @@ sorted_heap_key_to_int64(Datum value, Oid typid, int64 *out)
 	}
 }
 
+/* ----------------------------------------------------------------
+ *  Shared zone map cache
+ *
+ *  Loaded via shared_preload_libraries, each relation's zone map is
+ *  kept once for the whole cluster instead of once per backend: a
+ *  dshash table in a DSA area, keyed by (database, relation), leads to
+ *  a block holding the meta page entries (CACHE_MAX slots) followed by
+ *  the overflow entries, the super-zone summaries if any, and, when the
+ *  overflow entries are read lazily, one read flag per overflow page (set
+ *  under the entry's lock once the page is in).  Backends point their SortedHeapRelInfo into
+ *  that block, so scans read it in place and writers widen it in place.
+ *
+ *  Writers widen and flush under the entry's LWLock, so each flush
+ *  carries every backend's widenings.  Readers take no lock: between
+ *  reloads an entry only ever widens, and 8-byte stores are single-copy
+ *  atomic (where they are not, the cache stays backend-local).  A reload
+ *  (compaction, merge, rebuild) installs a new block and bumps the
+ *  generation; backends adopt it on their next sorted_heap_get_relinfo(),
+ *  or at once from the relcache callback.  A replaced block is freed once
+ *  the last backend reading it lets go.
+ *
+ *  Each backend pointing a SortedHeapRelInfo at an entry pins it (under
+ *  the dshash partition lock), so an entry is only removed when unpinned:
+ *  on DROP by the last backend to let go, and, when a block does not fit
+ *  in the area, with every other unpinned entry.  The blocks live in an
+ *  area of their own capped at the server's sorted_heap.zonemap_cache_size;
+ *  a zone map that still does not fit stays backend-local.
+ * ---------------------------------------------------------------- */
+#ifdef PG_HAVE_8BYTE_SINGLE_COPY_ATOMICITY
+#define SORTED_HEAP_ZM_SHARED_OK	true
+#else
+#define SORTED_HEAP_ZM_SHARED_OK	false
+#endif
+
+typedef struct SortedHeapZmKey
+{
+	Oid			dbid;
+	Oid			relid;
+} SortedHeapZmKey;
+
+typedef struct SortedHeapZmShared
+{
+	SortedHeapZmKey key;			/* hash key */
+	uint32		npinned;			/* backends pointing at this entry;
+									 * under the partition lock */
+	bool		dropped;			/* remove at npinned 0 */
+	LWLock		lock;				/* writers, block replacement; shared
+									 * for adopting and in-place widening */
+	pg_atomic_uint64 generation;	/* bumped whenever fields below change */
+	bool		loaded;				/* block holds relnumber's zone map */
+	RelFileNumber relnumber;
+	bool		scan_valid;
+	bool		sorted;
+	bool		tail_unsorted;
+	uint32		zone_pages;
+	uint16		nentries;
+	uint32		overflow_nentries;
+	uint32		overflow_npages;
+	uint32		overflow_per_page;
+	bool		overflow_packed;
+	bool		overflow_lazy;		/* block ends with per-page read flags */
+	bool		overflow_dir;
+	BlockNumber	overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS];
+	uint32		nsuper;				/* super-zones after the entries */
+	uint32		super_npages;
+	dsa_pointer	block;				/* SortedHeapZmBlock, or invalid */
+} SortedHeapZmShared;
+
+typedef struct SortedHeapZmBlock
+{
+	pg_atomic_uint32 refcount;		/* backends that adopted it */
+	bool		retired;			/* replaced: free at refcount 0 */
+	SortedHeapZoneMapEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} SortedHeapZmBlock;
+
+/* Fixed-size part in main shared memory: where the areas live */
+typedef struct SortedHeapZmControl
+{
+	LWLock	   *lock;				/* serializes creating the areas */
+	int			tranche_id;
+	int			cache_size;			/* block area cap in kB, -1: none */
+	dsa_handle	area;				/* the dshash table */
+	dshash_table_handle table;
+	dsa_handle	block_area;			/* SortedHeapZmBlocks */
+} SortedHeapZmControl;
+
+static SortedHeapZmControl *sh_zm_control = NULL;
+static dsa_area *sh_zm_area = NULL;
+static dsa_area *sh_zm_blocks = NULL;
+static dshash_table *sh_zm_table = NULL;
+
+static dshash_parameters sh_zm_params = {
+	sizeof(SortedHeapZmKey),
+	sizeof(SortedHeapZmShared),
+	dshash_memcmp,
+	dshash_memhash,
+	dshash_memcpy,
+	0							/* tranche_id, set on attach */
+};
+
+void
+sorted_heap_zmcache_shmem_request(void)
+{
+	RequestAddinShmemSpace(MAXALIGN(sizeof(SortedHeapZmControl)));
+	RequestNamedLWLockTranche("sorted_heap zone map", 1);
+}
+
+void
+sorted_heap_zmcache_shmem_startup(void)
+{
+	bool		found;
+
+	sh_zm_control = ShmemInitStruct("sorted_heap zone map cache",
+									sizeof(SortedHeapZmControl),
+									&found);
+	if (!found)
+	{
+		sh_zm_control->lock =
+			&(GetNamedLWLockTranche("sorted_heap zone map"))->lock;
+		sh_zm_control->tranche_id = LWLockNewTrancheId();
+		/* The server's setting; sessions may change theirs for local maps */
+		sh_zm_control->cache_size = sorted_heap_zonemap_cache_size;
+		sh_zm_control->area = DSA_HANDLE_INVALID;
+		sh_zm_control->table = DSHASH_HANDLE_INVALID;
+		sh_zm_control->block_area = DSA_HANDLE_INVALID;
+	}
+}
+
+/*
+ * Let go of the adopted block; caller holds zm_shared->lock, in either
+ * mode (a block is only retired under the exclusive lock).
+ */
+static void
+sorted_heap_zm_unref_locked(SortedHeapRelInfo *info)
+{
+	SortedHeapZmBlock *block;
+
+	if (!DsaPointerIsValid(info->zm_block))
+		return;
+
+	block = dsa_get_address(sh_zm_blocks, info->zm_block);
+	Assert(pg_atomic_read_u32(&block->refcount) > 0);
+	if (pg_atomic_sub_fetch_u32(&block->refcount, 1) == 0 && block->retired)
+		dsa_free(sh_zm_blocks, info->zm_block);
+
+	info->zm_block = InvalidDsaPointer;
+	info->zm_entries = NULL;
+	info->zm_overflow = NULL;
+	info->zm_overflow_loaded = NULL;
+	info->zm_super = NULL;
+	info->zm_nsuper = 0;
+	info->zm_super_npages = 0;
+	info->zm_nentries = 0;
+	info->zm_overflow_nentries = 0;
+	info->zm_total_entries = 0;
+	info->zm_loaded = false;
+}
+
+/*
+ * Point info at the current block (if any).  The caller holds zs->lock,
+ * shared unless this transaction has deferred entries for the relation,
+ * which are merged into the block here.
+ */
+static void
+sorted_heap_zm_adopt_locked(SortedHeapRelInfo *info, SortedHeapZmShared *zs)
+{
+	SortedHeapZmBlock *block;
+
+	sorted_heap_zm_unref_locked(info);
+	info->zm_generation = pg_atomic_read_u64(&zs->generation);
+	if (!zs->loaded)
+		return;
+
+	block = dsa_get_address(sh_zm_blocks, zs->block);
+	pg_atomic_fetch_add_u32(&block->refcount, 1);
+	info->zm_block = zs->block;
+	info->zm_entries = block->entries;
+	info->zm_overflow = block->entries + SORTED_HEAP_ZONEMAP_CACHE_MAX;
+	info->zm_super = (zs->nsuper > 0) ?
+		info->zm_overflow + zs->overflow_nentries : NULL;
+	info->zm_nsuper = zs->nsuper;
+	info->zm_super_npages = zs->super_npages;
+	info->zm_overflow_loaded = zs->overflow_lazy ?
+		(bool *) (info->zm_overflow + zs->overflow_nentries +
+				  zs->nsuper) : NULL;
+	info->zm_overflow_dir = zs->overflow_dir;
+	memcpy(info->zm_overflow_blocks, zs->overflow_blocks,
+		   sizeof(zs->overflow_blocks));
+	info->zm_nentries = zs->nentries;
+	info->zm_overflow_nentries = zs->overflow_nentries;
+	info->zm_total_entries = zs->nentries + zs->overflow_nentries;
+	info->zm_overflow_npages = zs->overflow_npages;
+	info->zm_overflow_per_page = zs->overflow_per_page;
+	info->zm_overflow_packed = zs->overflow_packed;
+	info->zm_scan_valid = zs->scan_valid;
+	info->zm_sorted = zs->sorted;
+	info->zm_tail_unsorted = zs->tail_unsorted;
+	info->zm_zone_pages = zs->zone_pages;
+	info->zm_loaded = true;
+
+	/* A reload from disk lacks this transaction's deferred widenings */
+	if (sorted_heap_zonemap_apply_pending(info) && zs->sorted)
+	{
+		zs->sorted = false;
+		info->zm_generation = pg_atomic_add_fetch_u64(&zs->generation, 1);
+	}
+}
+
+/*
+ * Detach zs from its block, freeing it unless a backend still reads it;
+ * caller holds zs->lock exclusively.
+ */
+static void
+sorted_heap_zm_retire_locked(SortedHeapZmShared *zs)
+{
+	SortedHeapZmBlock *block;
+
+	if (!DsaPointerIsValid(zs->block))
+		return;
+
+	block = dsa_get_address(sh_zm_blocks, zs->block);
+	if (pg_atomic_read_u32(&block->refcount) == 0)
+		dsa_free(sh_zm_blocks, zs->block);
+	else
+		block->retired = true;
+	zs->block = InvalidDsaPointer;
+}
+
+/*
+ * Publish info's freshly read, backend-local zone map as the shared copy;
+ * caller holds zs->lock.  False if the area is out of memory.
+ */
+static bool
+sorted_heap_zm_install_locked(Relation rel, SortedHeapRelInfo *info,
+							  SortedHeapZmShared *zs)
+{
+	Size		size;
+	dsa_pointer	dp;
+	SortedHeapZmBlock *block;
+
+	size = offsetof(SortedHeapZmBlock, entries) +
+		((Size) SORTED_HEAP_ZONEMAP_CACHE_MAX + info->zm_overflow_nentries +
+		 info->zm_nsuper) * sizeof(SortedHeapZoneMapEntry);
+	if (info->zm_overflow_loaded != NULL)
+		size += info->zm_overflow_npages * sizeof(bool);
+	dp = dsa_allocate_extended(sh_zm_blocks, size,
+							   DSA_ALLOC_HUGE | DSA_ALLOC_NO_OOM |
+							   DSA_ALLOC_ZERO);
+	if (!DsaPointerIsValid(dp))
+		return false;
+
+	block = dsa_get_address(sh_zm_blocks, dp);
+	pg_atomic_init_u32(&block->refcount, 0);
+	memcpy(block->entries, info->zm_entries,
+		   info->zm_nentries * sizeof(SortedHeapZoneMapEntry));
+	if (info->zm_overflow_nentries > 0)
+		memcpy(block->entries + SORTED_HEAP_ZONEMAP_CACHE_MAX,
+			   info->zm_overflow,
+			   info->zm_overflow_nentries * sizeof(SortedHeapZoneMapEntry));
+	if (info->zm_nsuper > 0)
+		memcpy(block->entries + SORTED_HEAP_ZONEMAP_CACHE_MAX +
+			   info->zm_overflow_nentries,
+			   info->zm_super,
+			   info->zm_nsuper * sizeof(SortedHeapZoneMapEntry));
+	if (info->zm_overflow_loaded != NULL)
+		memcpy(block->entries + SORTED_HEAP_ZONEMAP_CACHE_MAX +
+			   info->zm_overflow_nentries + info->zm_nsuper,
+			   info->zm_overflow_loaded,
+			   info->zm_overflow_npages * sizeof(bool));
+
+	sorted_heap_zm_retire_locked(zs);
+	zs->block = dp;
+	zs->relnumber = rel->rd_locator.relNumber;
+	zs->scan_valid = info->zm_scan_valid;
+	zs->sorted = info->zm_sorted;
+	zs->tail_unsorted = info->zm_tail_unsorted;
+	zs->zone_pages = info->zm_zone_pages;
+	zs->nentries = info->zm_nentries;
+	zs->overflow_nentries = info->zm_overflow_nentries;
+	zs->overflow_npages = info->zm_overflow_npages;
+	zs->overflow_per_page = info->zm_overflow_per_page;
+	zs->overflow_packed = info->zm_overflow_packed;
+	zs->overflow_lazy = (info->zm_overflow_loaded != NULL);
+	zs->overflow_dir = info->zm_overflow_dir;
+	memcpy(zs->overflow_blocks, info->zm_overflow_blocks,
+		   sizeof(zs->overflow_blocks));
+	zs->nsuper = info->zm_nsuper;
+	zs->super_npages = info->zm_super_npages;
+	zs->loaded = true;
+	pg_atomic_fetch_add_u64(&zs->generation, 1);
+	return true;
+}
+
+/* Let go of zs; the last backend to do so removes a dropped entry */
+static void
+sorted_heap_zmcache_unpin(SortedHeapZmShared *zs)
+{
+	SortedHeapZmKey key = zs->key;
+
+	zs = dshash_find(sh_zm_table, &key, true);
+	Assert(zs != NULL && zs->npinned > 0);
+	if (--zs->npinned == 0 && zs->dropped)
+	{
+		/* No backend holds a block without a pin */
+		if (DsaPointerIsValid(zs->block))
+			dsa_free(sh_zm_blocks, zs->block);
+		dshash_delete_entry(sh_zm_table, zs);
+	}
+	else
+		dshash_release_lock(sh_zm_table, zs);
+}
+
+/*
+ * Release every adopted block and pinned entry on backend exit.  A
+ * backend dying inside a writer section leaves that one reference
+ * behind; the block and entry are then kept until restart.
+ */
+static void
+sorted_heap_zmcache_detach(int code, Datum arg)
+{
+	HASH_SEQ_STATUS status;
+	SortedHeapRelInfo *info;
+
+	if (sorted_heap_relinfo_hash == NULL)
+		return;
+
+	hash_seq_init(&status, sorted_heap_relinfo_hash);
+	while ((info = hash_seq_search(&status)) != NULL)
+	{
+		if (info->zm_shared == NULL ||
+			LWLockHeldByMe(&info->zm_shared->lock))
+			continue;
+		LWLockAcquire(&info->zm_shared->lock, LW_EXCLUSIVE);
+		sorted_heap_zm_unref_locked(info);
+		LWLockRelease(&info->zm_shared->lock);
+		sorted_heap_zmcache_unpin(info->zm_shared);
+		info->zm_shared = NULL;
+	}
+}
+
+/*
+ * Attach to the cache, creating the areas on first use.  False if the
+ * cache is unavailable (library not preloaded), in which case zone maps
+ * stay backend-local.
+ */
+static bool
+sorted_heap_zmcache_attach(void)
+{
+	MemoryContext oldcxt;
+
+	if (sh_zm_table != NULL)
+		return true;
+	if (sh_zm_control == NULL || !SORTED_HEAP_ZM_SHARED_OK)
+		return false;
+
+	LWLockRegisterTranche(sh_zm_control->tranche_id, "sorted_heap zone map");
+	sh_zm_params.tranche_id = sh_zm_control->tranche_id;
+
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	LWLockAcquire(sh_zm_control->lock, LW_EXCLUSIVE);
+	if (sh_zm_control->area == DSA_HANDLE_INVALID)
+	{
+		/*
+		 * The table gets an area of its own: dshash inserts cannot fail
+		 * softly, so only the blocks' area is capped.
+		 */
+		sh_zm_area = dsa_create(sh_zm_control->tranche_id);
+		dsa_pin(sh_zm_area);
+		dsa_pin_mapping(sh_zm_area);
+		sh_zm_table = dshash_create(sh_zm_area, &sh_zm_params, NULL);
+		sh_zm_blocks = dsa_create(sh_zm_control->tranche_id);
+		dsa_pin(sh_zm_blocks);
+		dsa_pin_mapping(sh_zm_blocks);
+		if (sh_zm_control->cache_size >= 0)
+			dsa_set_size_limit(sh_zm_blocks,
+							   (Size) sh_zm_control->cache_size * 1024);
+		sh_zm_control->area = dsa_get_handle(sh_zm_area);
+		sh_zm_control->table = dshash_get_hash_table_handle(sh_zm_table);
+		sh_zm_control->block_area = dsa_get_handle(sh_zm_blocks);
+	}
+	else
+	{
+		sh_zm_area = dsa_attach(sh_zm_control->area);
+		dsa_pin_mapping(sh_zm_area);
+		sh_zm_table = dshash_attach(sh_zm_area, &sh_zm_params,
+									sh_zm_control->table, NULL);
+		sh_zm_blocks = dsa_attach(sh_zm_control->block_area);
+		dsa_pin_mapping(sh_zm_blocks);
+	}
+	LWLockRelease(sh_zm_control->lock);
+	MemoryContextSwitchTo(oldcxt);
+
+	before_shmem_exit(sorted_heap_zmcache_detach, (Datum) 0);
+	return true;
+}
+
+/*
+ * The relation's shared entry, pinned for the caller until it calls
+ * sorted_heap_zmcache_unpin().  If create, an entry is made (empty) on
+ * first use, and a dropped one whose OID was reused is taken back.
+ * NULL when the cache is unavailable, or without create if there is no
+ * entry.
+ */
+static SortedHeapZmShared *
+sorted_heap_zmcache_pin(Oid relid, bool create)
+{
+	SortedHeapZmKey key;
+	SortedHeapZmShared *zs;
+	bool		found;
+
+	if (!sorted_heap_zmcache_attach())
+		return NULL;
+
+	key.dbid = MyDatabaseId;
+	key.relid = relid;
+	if (create)
+		zs = dshash_find_or_insert(sh_zm_table, &key, &found);
+	else
+	{
+		zs = dshash_find(sh_zm_table, &key, true);
+		if (zs == NULL)
+			return NULL;
+		found = true;
+	}
+	if (!found)
+	{
+		zs->npinned = 0;
+		zs->dropped = false;
+		LWLockInitialize(&zs->lock, sh_zm_control->tranche_id);
+		pg_atomic_init_u64(&zs->generation, 0);
+		zs->loaded = false;
+		zs->relnumber = InvalidRelFileNumber;
+		zs->scan_valid = false;
+		zs->sorted = false;
+		zs->tail_unsorted = false;
+		zs->nentries = 0;
+		zs->overflow_nentries = 0;
+		zs->overflow_npages = 0;
+		zs->overflow_per_page = SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		zs->overflow_packed = false;
+		zs->overflow_lazy = false;
+		zs->overflow_dir = false;
+		zs->nsuper = 0;
+		zs->super_npages = 0;
+		zs->block = InvalidDsaPointer;
+	}
+	else if (create)
+		zs->dropped = false;
+	zs->npinned++;
+	dshash_release_lock(sh_zm_table, zs);
+
+	return zs;
+}
+
+/*
+ * Make room in the block area: remove every entry no backend has pinned,
+ * with its block.  True if any block was freed.
+ */
+static bool
+sorted_heap_zmcache_evict(void)
+{
+	dshash_seq_status status;
+	SortedHeapZmShared *zs;
+	bool		freed = false;
+
+	dshash_seq_init(&status, sh_zm_table, true);
+	while ((zs = dshash_seq_next(&status)) != NULL)
+	{
+		if (zs->npinned > 0)
+			continue;
+		if (DsaPointerIsValid(zs->block))
+		{
+			dsa_free(sh_zm_blocks, zs->block);
+			freed = true;
+		}
+		dshash_delete_current(&status);
+	}
+	dshash_seq_term(&status);
+
+	return freed;
+}
+
+/* Make every backend re-read the relation's zone map from disk */
+static void
+sorted_heap_zmcache_forget(Oid relid)
+{
+	SortedHeapZmShared *zs = sorted_heap_zmcache_pin(relid, false);
+
+	if (zs == NULL)
+		return;
+
+	LWLockAcquire(&zs->lock, LW_EXCLUSIVE);
+	if (zs->loaded)
+	{
+		sorted_heap_zm_retire_locked(zs);
+		zs->loaded = false;
+		pg_atomic_fetch_add_u64(&zs->generation, 1);
+	}
+	LWLockRelease(&zs->lock);
+	sorted_heap_zmcache_unpin(zs);
+}
+
+/*
+ * The relation is being dropped: free its block now (or once the last
+ * backend reading it lets go), and the entry once nobody has it pinned.
+ * Backends still pointing at it let go from the relcache callback.  If
+ * the drop rolls back, the next sorted_heap_zmcache_pin() takes the
+ * entry back.
+ */
+static void
+sorted_heap_zmcache_drop(Oid relid)
+{
+	SortedHeapZmShared *zs = sorted_heap_zmcache_pin(relid, false);
+
+	if (zs == NULL)
+		return;
+
+	LWLockAcquire(&zs->lock, LW_EXCLUSIVE);
+	sorted_heap_zm_retire_locked(zs);
+	zs->loaded = false;
+	pg_atomic_fetch_add_u64(&zs->generation, 1);
+	LWLockRelease(&zs->lock);
+
+	/* Under the partition lock, like npinned */
+	zs = dshash_find(sh_zm_table, &zs->key, true);
+	zs->dropped = true;
+	dshash_release_lock(sh_zm_table, zs);
+	sorted_heap_zmcache_unpin(zs);
+}
+
+static object_access_hook_type prev_object_access_hook = NULL;
+
+/* Free a dropped table's shared zone map (sorted_heap_zmcache_drop) */
+static void
+sorted_heap_object_access(ObjectAccessType access, Oid classId,
+						  Oid objectId, int subId, void *arg)
+{
+	if (prev_object_access_hook)
+		prev_object_access_hook(access, classId, objectId, subId, arg);
+
+	if (access == OAT_DROP && classId == RelationRelationId && subId == 0)
+		sorted_heap_zmcache_drop(objectId);
+}
+
+/* Called from _PG_init() */
+void
+sorted_heap_zmcache_init(void)
+{
+	prev_object_access_hook = object_access_hook;
+	object_access_hook = sorted_heap_object_access;
+}
+
+/* Drop info's zone map: free the local copy or let go of the shared one */
+static void
+sorted_heap_zonemap_release(SortedHeapRelInfo *info)
+{
+	if (info->zm_shared != NULL)
+	{
+		LWLockAcquire(&info->zm_shared->lock, LW_EXCLUSIVE);
+		sorted_heap_zm_unref_locked(info);
+		LWLockRelease(&info->zm_shared->lock);
+		sorted_heap_zmcache_unpin(info->zm_shared);
+		info->zm_shared = NULL;
+	}
+	else
+	{
+		if (info->zm_entries != NULL)
+			pfree(info->zm_entries);
+		if (info->zm_overflow != NULL)
+			pfree(info->zm_overflow);
+		if (info->zm_overflow_loaded != NULL)
+			pfree(info->zm_overflow_loaded);
+		if (info->zm_super != NULL)
+			pfree(info->zm_super);
+		info->zm_entries = NULL;
+		info->zm_overflow = NULL;
+		info->zm_overflow_loaded = NULL;
+		info->zm_super = NULL;
+	}
+
+	info->zm_nentries = 0;
+	info->zm_overflow_nentries = 0;
+	info->zm_total_entries = 0;
+	info->zm_nsuper = 0;
+	info->zm_super_npages = 0;
+	info->zm_loaded = false;
+}
+
+/* Backend-local bytes held for info: its zone map unless shared, page order */
+static Size
+sorted_heap_zonemap_local_bytes(SortedHeapRelInfo *info)
+{
+	Size		bytes = 0;
+
+	if (info->zm_shared == NULL)
+	{
+		if (info->zm_entries != NULL)
+			bytes += GetMemoryChunkSpace(info->zm_entries);
+		if (info->zm_overflow != NULL)
+			bytes += GetMemoryChunkSpace(info->zm_overflow);
+		if (info->zm_overflow_loaded != NULL)
+			bytes += GetMemoryChunkSpace(info->zm_overflow_loaded);
+		if (info->zm_super != NULL)
+			bytes += GetMemoryChunkSpace(info->zm_super);
+	}
+	if (info->page_order != NULL)
+		bytes += GetMemoryChunkSpace(info->page_order);
+	return bytes;
+}
+
+/*
+ * Keep backend-local zone maps within sorted_heap.zonemap_cache_size by
+ * dropping the least recently used relations' copies; the next lookup
+ * reloads them.  keep, just loaded, always stays, so a zone map larger
+ * than the cap still works.  Dropping one mid-scan is safe: lookups check
+ * zm_total_entries, and the scan reads on unpruned.
+ */
+static void
+sorted_heap_zonemap_enforce_cap(SortedHeapRelInfo *keep)
+{
+	Size		limit;
+
+	if (sorted_heap_zonemap_cache_size < 0 || sorted_heap_relinfo_hash == NULL)
+		return;
+	limit = (Size) sorted_heap_zonemap_cache_size * 1024;
+
+	for (;;)
+	{
+		HASH_SEQ_STATUS status;
+		SortedHeapRelInfo *info;
+		SortedHeapRelInfo *victim = NULL;
+		Size		total = 0;
+
+		hash_seq_init(&status, sorted_heap_relinfo_hash);
+		while ((info = hash_seq_search(&status)) != NULL)
+		{
+			Size		bytes = sorted_heap_zonemap_local_bytes(info);
+
+			total += bytes;
+			if (info != keep && bytes > 0 &&
+				(victim == NULL || info->zm_last_used < victim->zm_last_used))
+				victim = info;
+		}
+
+		if (total <= limit || victim == NULL)
+			break;
+
+		if (victim->zm_shared == NULL)
+			sorted_heap_zonemap_release(victim);
+		if (victim->page_order != NULL)
+		{
+			pfree(victim->page_order);
+			victim->page_order = NULL;
+		}
+	}
+}
+
+/*
+ * Writers widen the zone map and flush it between these two calls.  With
+ * the shared cache that is done under the entry's lock, after adopting
+ * any reload by another backend; callers must recheck zm_loaded, which is
+ * false if the shared copy was dropped meanwhile.
+ */
+static void
+sorted_heap_zonemap_lock(SortedHeapRelInfo *info)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
+
+	if (zs == NULL)
+		return;
+
+	LWLockAcquire(&zs->lock, LW_EXCLUSIVE);
+	if (info->zm_generation != pg_atomic_read_u64(&zs->generation))
+		sorted_heap_zm_adopt_locked(info, zs);
+}
+
+/* Publish whatever counts and flags the writer changed, then unlock */
+static void
+sorted_heap_zonemap_unlock(SortedHeapRelInfo *info)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
+
+	if (zs == NULL)
+		return;
+
+	if (info->zm_loaded &&
+		(zs->nentries != info->zm_nentries ||
+		 zs->scan_valid != info->zm_scan_valid ||
+		 zs->sorted != info->zm_sorted ||
+		 zs->tail_unsorted != info->zm_tail_unsorted))
+	{
+		zs->nentries = info->zm_nentries;
+		zs->scan_valid = info->zm_scan_valid;
+		zs->sorted = info->zm_sorted;
+		zs->tail_unsorted = info->zm_tail_unsorted;
+		info->zm_generation = pg_atomic_add_fetch_u64(&zs->generation, 1);
+	}
+	LWLockRelease(&zs->lock);
+}
+
 /* ----------------------------------------------------------------
  *  PK detection infrastructure
  *
@@ -282,10 +1066,14 @@ sorted_heap_ensure_relinfo_hash(void)
 	if (sorted_heap_relinfo_hash != NULL)
 		return;
 
+	sorted_heap_zonemap_context =
+		AllocSetContextCreate(TopMemoryContext, "sorted_heap zone maps",
+							  ALLOCSET_DEFAULT_SIZES);
+
 	memset(&ctl, 0, sizeof(ctl));
 	ctl.keysize = sizeof(Oid);
 	ctl.entrysize = sizeof(SortedHeapRelInfo);
-	ctl.hcxt = TopMemoryContext;
+	ctl.hcxt = sorted_heap_zonemap_context;
 	sorted_heap_relinfo_hash = hash_create("sorted_heap relinfo",
 										   32, &ctl,
 										   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
@@ -310,14 +1098,32 @@ sorted_heap_get_relinfo(Relation rel)
 		info->zm_loaded = false;
 		info->zm_sorted = false;
 		info->zm_pk_typid = InvalidOid;
+		info->zm_tail_unsorted = false;
+		info->zm_zone_pages = 1;
 		info->zm_nentries = 0;
+		info->zm_entries = NULL;
 		info->zm_overflow = NULL;
 		info->zm_overflow_nentries = 0;
 		info->zm_total_entries = 0;
 		info->zm_overflow_npages = 0;
+		info->zm_overflow_per_page = SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		info->zm_overflow_packed = false;
 		info->zm_col2_usable = false;
 		info->zm_pk_typid2 = InvalidOid;
+		info->zm_overflow_loaded = NULL;
+		info->zm_overflow_dir = false;
+		info->zm_super = NULL;
+		info->zm_nsuper = 0;
+		info->zm_super_npages = 0;
+		info->zm_stale = false;
+		info->zm_meta_lsn = InvalidXLogRecPtr;
+		info->zm_relnumber = InvalidRelFileNumber;
+		info->zm_shared = NULL;
+		info->zm_block = InvalidDsaPointer;
+		info->zm_generation = 0;
+		info->page_order = NULL;
 	}
+	info->zm_last_used = ++sorted_heap_zm_clock;
 
 	if (!info->pk_probed)
 	{
@@ -461,25 +1267,65 @@ sorted_heap_get_relinfo(Relation rel)
 		info->pk_probed = true;
 	}
 
+	/* After a relcache invalidation, keep what the meta page still backs */
+	if (info->zm_stale)
+	{
+		info->zm_stale = false;
+		if (info->zm_loaded &&
+			(!info->zm_usable || !sorted_heap_zonemap_revalidate(rel, info)))
+			sorted_heap_zonemap_release(info);
+	}
+
 	/* Auto-load zone map if usable PK and not yet loaded */
 	if (info->zm_usable && !info->zm_loaded)
 	{
 		BlockNumber nblocks = RelationGetNumberOfBlocks(rel);
 
 		if (nblocks > 1)		/* meta page + at least 1 data page */
-			sorted_heap_zonemap_load(rel, info);
+			sorted_heap_zonemap_attach(rel, info);
 	}
+	/* Another backend reloaded or changed the shared copy */
+	else if (info->zm_shared != NULL &&
+			 info->zm_generation !=
+			 pg_atomic_read_u64(&info->zm_shared->generation))
+		sorted_heap_zonemap_attach(rel, info);
 
 	return info;
 }
 
+/*
+ * Flag info's zone map for a check on next use.  A shared copy is simply
+ * re-adopted (it is left mapped until then), unless another backend has
+ * replaced it or the relation is being dropped: that one is let go now,
+ * so its block can be freed even if this backend never looks at the
+ * relation again.  A backend-local copy is kept and revalidated against
+ * the meta page, since most invalidations (ANALYZE, unrelated DDL, sinval
+ * resets) leave the zone map as it was.
+ */
+static void
+sorted_heap_zonemap_mark_stale(SortedHeapRelInfo *info)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
+
+	if (zs != NULL)
+	{
+		if (!LWLockHeldByMe(&zs->lock) &&
+			(zs->dropped ||
+			 info->zm_generation != pg_atomic_read_u64(&zs->generation)))
+			sorted_heap_zonemap_release(info);
+		else
+			info->zm_loaded = false;
+	}
+	else if (info->zm_loaded)
+		info->zm_stale = true;
+}
+
 /*
  * Relcache invalidation callback.
  *
  * When an index is created or dropped, PG fires relcache invalidation
  * for the parent table.  We clear pk_probed so the next multi_insert
- * re-discovers the (possibly new) PK.  Also clear zm_loaded so the
- * zone map is re-read from disk.
+ * re-discovers the (possibly new) PK, and mark the zone map stale.
  */
 void
 sorted_heap_relcache_callback(Datum arg, Oid relid)
@@ -496,14 +1342,12 @@ sorted_heap_relcache_callback(Datum arg, Oid relid)
 		if (info != NULL)
 		{
 			info->pk_probed = false;
-			info->zm_loaded = false;
-			if (info->zm_overflow)
+			sorted_heap_zonemap_mark_stale(info);
+			if (info->page_order)
 			{
-				pfree(info->zm_overflow);
-				info->zm_overflow = NULL;
+				pfree(info->page_order);
+				info->page_order = NULL;
 			}
-			info->zm_overflow_nentries = 0;
-			info->zm_total_entries = 0;
 		}
 	}
 	else
@@ -516,14 +1360,12 @@ sorted_heap_relcache_callback(Datum arg, Oid relid)
 		while ((info = hash_seq_search(&status)) != NULL)
 		{
 			info->pk_probed = false;
-			info->zm_loaded = false;
-			if (info->zm_overflow)
+			sorted_heap_zonemap_mark_stale(info);
+			if (info->page_order)
 			{
-				pfree(info->zm_overflow);
-				info->zm_overflow = NULL;
+				pfree(info->page_order);
+				info->page_order = NULL;
 			}
-			info->zm_overflow_nentries = 0;
-			info->zm_total_entries = 0;
 		}
 	}
 }
@@ -536,30 +1378,457 @@ sorted_heap_relinfo_invalidate(Oid relid)
 {
 	SortedHeapRelInfo *info;
 
+	/* The zone map on disk changed: no backend may keep the shared copy */
+	sorted_heap_zmcache_forget(relid);
+
 	if (sorted_heap_relinfo_hash == NULL)
 		return;
 
 	info = hash_search(sorted_heap_relinfo_hash, &relid, HASH_FIND, NULL);
-	if (info != NULL && info->zm_overflow != NULL)
+	if (info != NULL)
+		sorted_heap_zonemap_release(info);
+	if (info != NULL && info->page_order != NULL)
 	{
-		pfree(info->zm_overflow);
-		info->zm_overflow = NULL;
+		pfree(info->page_order);
+		info->page_order = NULL;
 	}
 
 	hash_search(sorted_heap_relinfo_hash, &relid, HASH_REMOVE, NULL);
 }
 
 /* ----------------------------------------------------------------
- *  Zone map load / flush
+ *  Packed overflow pages (v8)
+ *
+ *  Compacted tables have nearly identical neighbouring zone map
+ *  entries, so deltas between them need a few bits where the plain
+ *  format spends 32 bytes.  Bits are stored LSB first.
  * ---------------------------------------------------------------- */
 
-/*
- * Load zone map from meta page into relinfo cache.
- * Handles v2/v3 meta pages gracefully, and v4 backward compatibility
- * (16-byte entries expanded to 32-byte v5 format).
- */
-void
-sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
+/* Special space of a packed page: as much of the page as PageInit allows */
+#define SORTED_HEAP_PACKED_SPECIAL_SIZE \
+	(BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXIMUM_ALIGNOF)
+#define SORTED_HEAP_PACKED_DATA_BYTES \
+	(SORTED_HEAP_PACKED_SPECIAL_SIZE - \
+	 offsetof(SortedHeapPackedOverflowPageData, shpo_data))
+
+/* Map a wrapped int64 difference to small unsigned values and back */
+static inline uint64
+sorted_heap_zigzag(uint64 delta)
+{
+	return (delta << 1) ^ (uint64) ((int64) delta >> 63);
+}
+
+static inline uint64
+sorted_heap_unzigzag(uint64 z)
+{
+	return (z >> 1) ^ (0 - (z & 1));
+}
+
+static inline int
+sorted_heap_bit_width(uint64 v)
+{
+	return (v == 0) ? 0 : pg_leftmost_one_pos64(v) + 1;
+}
+
+static void
+sorted_heap_put_bits(uint8 *data, uint64 *pos, uint64 v, int nbits)
+{
+	int			done = 0;
+
+	while (done < nbits)
+	{
+		int			off = *pos & 7;
+		int			take = Min(8 - off, nbits - done);
+
+		data[*pos >> 3] |= (uint8) (((v >> done) & ((1U << take) - 1)) << off);
+		done += take;
+		*pos += take;
+	}
+}
+
+static uint64
+sorted_heap_get_bits(const uint8 *data, uint64 *pos, int nbits)
+{
+	uint64		v = 0;
+	int			done = 0;
+
+	while (done < nbits)
+	{
+		int			off = *pos & 7;
+		int			take = Min(8 - off, nbits - done);
+
+		v |= (uint64) ((data[*pos >> 3] >> off) & ((1U << take) - 1)) << done;
+		done += take;
+		*pos += take;
+	}
+	return v;
+}
+
+/*
+ * Pack entries[0..n) into po, the special space of a page initialized
+ * with SORTED_HEAP_PACKED_SPECIAL_SIZE.  False if they do not fit, or
+ * hold something the format cannot reproduce exactly (a sentinel paired
+ * with a real bound, max < min, column 2 on a table without one).
+ */
+static bool
+sorted_heap_pack_overflow(const SortedHeapZoneMapEntry *entries, uint32 n,
+						  bool col2, SortedHeapPackedOverflowPageData *po)
+{
+	uint64		prev = 0;
+	uint64		prev2 = 0;
+	bool		have = false;
+	bool		have2 = false;
+	int			bits[4] = {0, 0, 0, 0};
+	uint32		nfull = 0;
+	uint32		ntracked = 0;
+	uint32		bitmap_bytes = (n + 7) / 8;
+	uint8	   *empty = po->shpo_data;
+	uint8	   *untracked = po->shpo_data + bitmap_bytes;
+	uint8	   *stream = col2 ? untracked + bitmap_bytes : untracked;
+	uint64		pos = 0;
+
+	if (n > SORTED_HEAP_PACKED_ENTRIES_PER_PAGE)
+		return false;
+
+	/* Pass 1: widths, and whether the entries can be packed at all */
+	for (uint32 i = 0; i < n; i++)
+	{
+		const SortedHeapZoneMapEntry *e = &entries[i];
+
+		if (e->zme_min == PG_INT64_MAX)
+		{
+			if (e->zme_max != PG_INT64_MIN || e->zme_min2 != PG_INT64_MAX ||
+				e->zme_max2 != PG_INT64_MIN)
+				return false;
+			continue;
+		}
+		if (e->zme_max < e->zme_min)
+			return false;
+		if (!have)
+			prev = (uint64) e->zme_min;
+		have = true;
+		bits[0] = Max(bits[0], sorted_heap_bit_width(
+			sorted_heap_zigzag((uint64) e->zme_min - prev)));
+		bits[1] = Max(bits[1], sorted_heap_bit_width(
+			(uint64) e->zme_max - (uint64) e->zme_min));
+		prev = (uint64) e->zme_min;
+		nfull++;
+
+		if (e->zme_min2 == PG_INT64_MAX)
+		{
+			if (e->zme_max2 != PG_INT64_MIN)
+				return false;
+			continue;
+		}
+		if (!col2 || e->zme_max2 < e->zme_min2)
+			return false;
+		if (!have2)
+			prev2 = (uint64) e->zme_min2;
+		have2 = true;
+		bits[2] = Max(bits[2], sorted_heap_bit_width(
+			sorted_heap_zigzag((uint64) e->zme_min2 - prev2)));
+		bits[3] = Max(bits[3], sorted_heap_bit_width(
+			(uint64) e->zme_max2 - (uint64) e->zme_min2));
+		prev2 = (uint64) e->zme_min2;
+		ntracked++;
+	}
+
+	if ((Size) (stream - po->shpo_data) +
+		((uint64) nfull * (bits[0] + bits[1]) +
+		 (uint64) ntracked * (bits[2] + bits[3]) + 7) / 8 >
+		SORTED_HEAP_PACKED_DATA_BYTES)
+		return false;
+
+	/* Pass 2: write */
+	po->shpo_flags = col2 ? SHPO_FLAG_COL2 : 0;
+	for (int k = 0; k < 4; k++)
+		po->shpo_bits[k] = (uint8) bits[k];
+	memset(po->shpo_padding, 0, sizeof(po->shpo_padding));
+	po->shpo_base = 0;
+	po->shpo_base2 = 0;
+	memset(po->shpo_data, 0, SORTED_HEAP_PACKED_DATA_BYTES);
+
+	have = have2 = false;
+	for (uint32 i = 0; i < n; i++)
+	{
+		const SortedHeapZoneMapEntry *e = &entries[i];
+
+		if (e->zme_min == PG_INT64_MAX)
+		{
+			empty[i / 8] |= 1 << (i % 8);
+			continue;
+		}
+		if (!have)
+			prev = (uint64) (po->shpo_base = e->zme_min);
+		have = true;
+		sorted_heap_put_bits(stream, &pos,
+							 sorted_heap_zigzag((uint64) e->zme_min - prev),
+							 bits[0]);
+		sorted_heap_put_bits(stream, &pos,
+							 (uint64) e->zme_max - (uint64) e->zme_min,
+							 bits[1]);
+		prev = (uint64) e->zme_min;
+
+		if (!col2)
+			continue;
+		if (e->zme_min2 == PG_INT64_MAX)
+		{
+			untracked[i / 8] |= 1 << (i % 8);
+			continue;
+		}
+		if (!have2)
+			prev2 = (uint64) (po->shpo_base2 = e->zme_min2);
+		have2 = true;
+		sorted_heap_put_bits(stream, &pos,
+							 sorted_heap_zigzag((uint64) e->zme_min2 - prev2),
+							 bits[2]);
+		sorted_heap_put_bits(stream, &pos,
+							 (uint64) e->zme_max2 - (uint64) e->zme_min2,
+							 bits[3]);
+		prev2 = (uint64) e->zme_min2;
+	}
+
+	po->shpo_nentries = n;
+	return true;
+}
+
+/*
+ * Decode the first count entries of a packed page into out.  False if
+ * the page's widths and bitmaps ask for more bits than it holds.
+ */
+static bool
+sorted_heap_unpack_overflow(const SortedHeapPackedOverflowPageData *po,
+							uint32 count, SortedHeapZoneMapEntry *out)
+{
+	uint32		n = po->shpo_nentries;
+	bool		col2 = (po->shpo_flags & SHPO_FLAG_COL2) != 0;
+	uint32		bitmap_bytes = (n + 7) / 8;
+	const uint8 *empty = po->shpo_data;
+	const uint8 *untracked = po->shpo_data + bitmap_bytes;
+	const uint8 *stream = col2 ? untracked + bitmap_bytes : untracked;
+	uint64		prev = (uint64) po->shpo_base;
+	uint64		prev2 = (uint64) po->shpo_base2;
+	uint64		nfull;
+	uint64		ntracked = 0;
+	uint64		pos = 0;
+
+	if (n > SORTED_HEAP_PACKED_ENTRIES_PER_PAGE || count > n)
+		return false;
+	for (int k = 0; k < 4; k++)
+		if (po->shpo_bits[k] > 64)
+			return false;
+
+	nfull = n - pg_popcount((const char *) empty, bitmap_bytes);
+	if (col2)
+		ntracked = nfull - pg_popcount((const char *) untracked, bitmap_bytes);
+	if ((Size) (stream - po->shpo_data) +
+		(nfull * (po->shpo_bits[0] + po->shpo_bits[1]) +
+		 ntracked * (po->shpo_bits[2] + po->shpo_bits[3]) + 7) / 8 >
+		SORTED_HEAP_PACKED_DATA_BYTES)
+		return false;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		SortedHeapZoneMapEntry *e = &out[i];
+
+		if (empty[i / 8] & (1 << (i % 8)))
+		{
+			e->zme_min = PG_INT64_MAX;
+			e->zme_max = PG_INT64_MIN;
+			e->zme_min2 = PG_INT64_MAX;
+			e->zme_max2 = PG_INT64_MIN;
+			continue;
+		}
+		prev += sorted_heap_unzigzag(sorted_heap_get_bits(stream, &pos,
+														  po->shpo_bits[0]));
+		e->zme_min = (int64) prev;
+		e->zme_max = (int64) (prev + sorted_heap_get_bits(stream, &pos,
+														  po->shpo_bits[1]));
+
+		if (!col2 || (untracked[i / 8] & (1 << (i % 8))))
+		{
+			e->zme_min2 = PG_INT64_MAX;
+			e->zme_max2 = PG_INT64_MIN;
+			continue;
+		}
+		prev2 += sorted_heap_unzigzag(sorted_heap_get_bits(stream, &pos,
+														   po->shpo_bits[2]));
+		e->zme_min2 = (int64) prev2;
+		e->zme_max2 = (int64) (prev2 + sorted_heap_get_bits(stream, &pos,
+															po->shpo_bits[3]));
+	}
+	return true;
+}
+
+/*
+ * Lay out an overflow page holding src[0..count) in page, packed or
+ * plain, with page_index and (plain only) the chain link next.  Super-zone
+ * pages are plain overflow pages.  The page is marked full so heap never
+ * uses it.  False if the entries do not pack.
+ */
+static bool
+sorted_heap_overflow_page_init(Page page, const SortedHeapZoneMapEntry *src,
+							   uint32 count, uint32 page_index, bool packed,
+							   bool col2, BlockNumber next)
+{
+	if (packed)
+	{
+		SortedHeapPackedOverflowPageData *po;
+
+		PageInit(page, BLCKSZ, SORTED_HEAP_PACKED_SPECIAL_SIZE);
+		po = (SortedHeapPackedOverflowPageData *) PageGetSpecialPointer(page);
+		po->shpo_magic = SORTED_HEAP_MAGIC;
+		po->shpo_page_index = page_index;
+		if (!sorted_heap_pack_overflow(src, count, col2, po))
+			return false;
+	}
+	else
+	{
+		SortedHeapOverflowPageData *ovfl;
+
+		PageInit(page, BLCKSZ, sizeof(SortedHeapOverflowPageData));
+		ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(page);
+		ovfl->shmo_magic = SORTED_HEAP_MAGIC;
+		ovfl->shmo_nentries = count;
+		ovfl->shmo_page_index = page_index;
+		ovfl->shmo_next_block = next;
+		ovfl->shmo_padding = 0;
+		memcpy(ovfl->shmo_entries, src, count * sizeof(SortedHeapZoneMapEntry));
+	}
+
+	/* Mark page as full so heap never uses it */
+	((PageHeader) page)->pd_lower = ((PageHeader) page)->pd_upper;
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *  Zone map load / flush
+ * ---------------------------------------------------------------- */
+
+/*
+ * Widen super-zone summary s by page entry e.  Column 2 of s is dropped
+ * (min2 = PG_INT64_MAX) as soon as one of its pages holding data does not
+ * track column 2, and is never picked up again until the next rebuild.
+ */
+static void
+sorted_heap_superzone_widen(SortedHeapZoneMapEntry *s,
+							const SortedHeapZoneMapEntry *e)
+{
+	bool		first = (s->zme_min == PG_INT64_MAX);
+
+	if (e->zme_min == PG_INT64_MAX)
+		return;					/* no data on the page */
+
+	if (first || e->zme_min < s->zme_min)
+		s->zme_min = e->zme_min;
+	if (first || e->zme_max > s->zme_max)
+		s->zme_max = e->zme_max;
+
+	if (e->zme_min2 == PG_INT64_MAX)
+	{
+		s->zme_min2 = PG_INT64_MAX;
+		s->zme_max2 = PG_INT64_MIN;
+	}
+	else if (first)
+	{
+		s->zme_min2 = e->zme_min2;
+		s->zme_max2 = e->zme_max2;
+	}
+	else if (s->zme_min2 != PG_INT64_MAX)
+	{
+		if (e->zme_min2 < s->zme_min2)
+			s->zme_min2 = e->zme_min2;
+		if (e->zme_max2 > s->zme_max2)
+			s->zme_max2 = e->zme_max2;
+	}
+}
+
+/*
+ * Read the super-zone summary pages rebuild wrote after the overflow
+ * pages of a v7 directory, then fold the meta page entries (which may
+ * have widened since) into them.  Without a complete, matching set the
+ * table is left without super-zones and scans walk every entry.
+ */
+static void
+sorted_heap_zonemap_read_super(Relation rel, SortedHeapRelInfo *info)
+{
+	SortedHeapOverflowExtent *ext =
+		(SortedHeapOverflowExtent *) info->zm_overflow_blocks;
+	uint32		dir_npages = 0;
+	uint32		nsuper;
+	uint32		npages;
+	uint32		p;
+
+	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+		dir_npages += ext[i].soe_npages;
+
+	nsuper = (info->zm_total_entries + SORTED_HEAP_SUPERZONE_PAGES - 1) /
+		SORTED_HEAP_SUPERZONE_PAGES;
+	npages = (nsuper + SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE - 1) /
+		SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+	if (nsuper == 0 || dir_npages < info->zm_overflow_npages + npages)
+		return;
+
+	for (p = 0; p < npages; p++)
+		(void) PrefetchBuffer(rel, MAIN_FORKNUM,
+							  sorted_heap_overflow_dir_block(info,
+															 info->zm_overflow_npages + p));
+
+	info->zm_super = (SortedHeapZoneMapEntry *)
+		MemoryContextAllocZero(sorted_heap_zonemap_context,
+							   nsuper * sizeof(SortedHeapZoneMapEntry));
+
+	for (p = 0; p < npages; p++)
+	{
+		uint32		at = info->zm_overflow_npages + p;
+		uint32		start = p * SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		uint32		count = Min(SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
+								nsuper - start);
+		Buffer		buf;
+		Page		pg;
+		SortedHeapOverflowPageData *ovfl;
+		bool		match;
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM,
+								 sorted_heap_overflow_dir_block(info, at),
+								 RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		pg = BufferGetPage(buf);
+		ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+
+		match = !PageIsNew(pg) &&
+			PageGetSpecialSize(pg) ==
+			MAXALIGN(sizeof(SortedHeapOverflowPageData)) &&
+			ovfl->shmo_magic == SORTED_HEAP_MAGIC &&
+			ovfl->shmo_page_index == (uint16) at &&
+			ovfl->shmo_nentries == count;
+		if (match)
+			memcpy(&info->zm_super[start], ovfl->shmo_entries,
+				   count * sizeof(SortedHeapZoneMapEntry));
+		UnlockReleaseBuffer(buf);
+
+		if (!match)
+		{
+			pfree(info->zm_super);
+			info->zm_super = NULL;
+			return;
+		}
+	}
+
+	for (uint32 i = 0; i < info->zm_nentries; i++)
+		sorted_heap_superzone_widen(&info->zm_super[i / SORTED_HEAP_SUPERZONE_PAGES],
+									&info->zm_entries[i]);
+	info->zm_nsuper = nsuper;
+	info->zm_super_npages = npages;
+}
+
+/*
+ * Read zone map from meta page into relinfo's backend-local arrays.
+ * Handles v2/v3 meta pages gracefully, and v4 backward compatibility
+ * (16-byte entries expanded to 32-byte v5 format).
+ */
+static void
+sorted_heap_zonemap_read(Relation rel, SortedHeapRelInfo *info)
 {
 	Buffer		metabuf;
 	Page		metapage;
@@ -567,11 +1836,21 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 	uint32		magic;
 	uint32		version;
 
+	info->zm_overflow_per_page = SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+	info->zm_overflow_packed = false;
+	info->zm_zone_pages = 1;
+
 	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
 								 RBM_NORMAL, NULL);
 	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
 	metapage = BufferGetPage(metabuf);
 
+	/* Every meta page change is WAL-logged: its LSN dates this copy */
+	info->zm_stale = false;
+	info->zm_meta_lsn = RelationNeedsWAL(rel) ?
+		BufferGetLSNAtomic(metabuf) : InvalidXLogRecPtr;
+	info->zm_relnumber = rel->rd_locator.relNumber;
+
 	special = (char *) PageGetSpecialPointer(metapage);
 
 	/* Read magic and version from common header prefix */
@@ -582,6 +1861,7 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 	{
 		info->zm_nentries = 0;
 		info->zm_scan_valid = false;
+		info->zm_tail_unsorted = false;
 		info->zm_overflow_nentries = 0;
 		info->zm_total_entries = 0;
 		info->zm_overflow_npages = 0;
@@ -614,6 +1894,8 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 		info->zm_scan_valid =
 			(meta4->shm_flags & SHM_FLAG_ZONEMAP_VALID) != 0;
 		info->zm_sorted = false;	/* v3/v4 format predates sorted flag */
+		info->zm_tail_unsorted =
+			(meta4->shm_flags & SHM_FLAG_ZM_TAIL_UNSORTED) != 0;
 
 		if (version >= 4)
 		{
@@ -642,7 +1924,7 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 			}
 
 			info->zm_overflow = (SortedHeapZoneMapEntry *)
-				MemoryContextAllocZero(TopMemoryContext,
+				MemoryContextAllocZero(sorted_heap_zonemap_context,
 									   max_overflow *
 									   sizeof(SortedHeapZoneMapEntry));
 
@@ -712,10 +1994,54 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 			(meta->shm_flags & SHM_FLAG_ZONEMAP_VALID) != 0;
 		info->zm_sorted =
 			(meta->shm_flags & SHM_FLAG_ZM_SORTED) != 0;
+		info->zm_tail_unsorted =
+			(meta->shm_flags & SHM_FLAG_ZM_TAIL_UNSORTED) != 0;
+		info->zm_zone_pages =
+			Max((meta->shm_flags & SHM_ZONE_PAGES_MASK) >> SHM_ZONE_PAGES_SHIFT, 1);
 
 		info->zm_overflow_npages = meta_ovfl_npages;
 		info->zm_total_entries = n;
 
+		/*
+		 * v6 meta pages that record the overflow entry count, and every
+		 * v7 one: size the overflow array now and read each overflow page
+		 * when a lookup first touches it, so planning a point query reads
+		 * only the pages its binary search visits.
+		 */
+		if (meta_ovfl_npages > 0 && version >= 6 &&
+			meta->shm_overflow_nentries > 0)
+		{
+			uint32		total_overflow = meta->shm_overflow_nentries;
+
+			info->zm_overflow_dir = (version >= 7);
+			if (version >= 8 && (meta->shm_flags & SHM_FLAG_ZM_PACKED))
+			{
+				info->zm_overflow_packed = true;
+				info->zm_overflow_per_page = SORTED_HEAP_PACKED_ENTRIES_PER_PAGE;
+			}
+			memcpy(info->zm_overflow_blocks, meta->shm_overflow_blocks,
+				   sizeof(info->zm_overflow_blocks));
+			UnlockReleaseBuffer(metabuf);
+
+			info->zm_overflow_npages =
+				(total_overflow + info->zm_overflow_per_page - 1) /
+				info->zm_overflow_per_page;
+			info->zm_overflow = (SortedHeapZoneMapEntry *)
+				MemoryContextAllocZero(sorted_heap_zonemap_context,
+									   total_overflow *
+									   sizeof(SortedHeapZoneMapEntry));
+			info->zm_overflow_loaded = (bool *)
+				MemoryContextAllocZero(sorted_heap_zonemap_context,
+									   info->zm_overflow_npages *
+									   sizeof(bool));
+			info->zm_overflow_nentries = total_overflow;
+			info->zm_total_entries = n + total_overflow;
+			if (info->zm_overflow_dir)
+				sorted_heap_zonemap_read_super(rel, info);
+			info->zm_loaded = true;
+			return;		/* already released metabuf */
+		}
+
 		/* Read overflow pages if present */
 		if (meta_ovfl_npages > 0)
 		{
@@ -745,7 +2071,7 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 			}
 
 			info->zm_overflow = (SortedHeapZoneMapEntry *)
-				MemoryContextAllocZero(TopMemoryContext,
+				MemoryContextAllocZero(sorted_heap_zonemap_context,
 									   alloc_overflow *
 									   sizeof(SortedHeapZoneMapEntry));
 
@@ -887,1001 +2213,3331 @@ sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 }
 
 /*
- * Flush zone map from relinfo cache to meta page via GenericXLog.
- * Version-aware: writes v4 (16-byte) or v5 (32-byte) entries
- * depending on the on-disk format.
+ * (Re)load zone map from disk into relinfo cache.  With the shared cache
+ * the result replaces the shared copy, so every backend picks it up.  If
+ * the block area is full, unpinned entries are evicted once; if it still
+ * does not fit, the copy stays backend-local.
  */
-static void
-sorted_heap_zonemap_flush(Relation rel, SortedHeapRelInfo *info)
+void
+sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info)
 {
-	Buffer				metabuf;
-	Page				metapage;
-	GenericXLogState   *state;
-	char			   *special;
-	uint32				version;
+	SortedHeapZmShared *zs = sorted_heap_zmcache_pin(RelationGetRelid(rel),
+													 true);
+	bool		installed = false;
+
+	sorted_heap_zonemap_release(info);
+	info->zm_entries = (SortedHeapZoneMapEntry *)
+		MemoryContextAllocZero(sorted_heap_zonemap_context,
+							   SORTED_HEAP_ZONEMAP_CACHE_MAX *
+							   sizeof(SortedHeapZoneMapEntry));
+	sorted_heap_zonemap_read(rel, info);
+	(void) sorted_heap_zonemap_apply_pending(info);
 
-	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
-								 RBM_NORMAL, NULL);
-	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+	if (zs == NULL)
+	{
+		sorted_heap_zonemap_enforce_cap(info);
+		return;
+	}
 
-	state = GenericXLogStart(rel);
-	metapage = GenericXLogRegisterBuffer(state, metabuf, 0);
-	special = (char *) PageGetSpecialPointer(metapage);
+	for (int attempt = 0; !installed && attempt < 2; attempt++)
+	{
+		if (attempt > 0 && !sorted_heap_zmcache_evict())
+			break;
 
-	/* Read on-disk version */
-	memcpy(&version, special + sizeof(uint32), sizeof(uint32));
+		LWLockAcquire(&zs->lock, LW_EXCLUSIVE);
+		installed = sorted_heap_zm_install_locked(rel, info, zs);
+		if (installed)
+		{
+			SortedHeapZoneMapEntry *entries = info->zm_entries;
+			SortedHeapZoneMapEntry *overflow = info->zm_overflow;
+			SortedHeapZoneMapEntry *super = info->zm_super;
+			bool	   *overflow_loaded = info->zm_overflow_loaded;
+
+			info->zm_overflow_loaded = NULL;
+			info->zm_shared = zs;
+			sorted_heap_zm_adopt_locked(info, zs);
+			LWLockRelease(&zs->lock);
+
+			pfree(entries);
+			if (overflow != NULL)
+				pfree(overflow);
+			if (super != NULL)
+				pfree(super);
+			if (overflow_loaded != NULL)
+				pfree(overflow_loaded);
+		}
+		else
+			LWLockRelease(&zs->lock);
+	}
 
-	if (version >= 5)
+	if (!installed)
 	{
-		/* v5: write 32-byte entries directly */
-		SortedHeapMetaPageData *meta = (SortedHeapMetaPageData *) special;
-		uint16		n = Min(info->zm_nentries, SORTED_HEAP_ZONEMAP_MAX);
+		sorted_heap_zmcache_unpin(zs);	/* out of shared memory: stay local */
+		sorted_heap_zonemap_enforce_cap(info);
+	}
+}
 
-		Assert(meta->shm_magic == SORTED_HEAP_MAGIC);
+/*
+ * Make info's zone map current: adopt the shared copy if it holds this
+ * relation's current storage, else load it from disk.
+ */
+static void
+sorted_heap_zonemap_attach(Relation rel, SortedHeapRelInfo *info)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
 
-		meta->shm_zonemap_nentries = n;
-		meta->shm_zonemap_pk_typid = info->zm_pk_typid;
-		meta->shm_zonemap_pk_typid2 = info->zm_pk_typid2;
-		meta->shm_flags &= ~SHM_FLAG_ZM_SORTED;	/* INSERT may break monotonicity */
-		memcpy(meta->shm_zonemap, info->zm_entries,
-			   n * sizeof(SortedHeapZoneMapEntry));
-	}
-	else
+	if (zs == NULL)
+		zs = sorted_heap_zmcache_pin(RelationGetRelid(rel), true);
+	if (zs != NULL)
 	{
-		/* v4/v3: write 16-byte entries (col1 only) */
-		SortedHeapMetaPageDataV4 *meta4 = (SortedHeapMetaPageDataV4 *) special;
-		uint16		n = Min(info->zm_nentries, SORTED_HEAP_ZONEMAP_MAX_V4);
-		int			i;
+		bool		adopted = false;
 
-		Assert(meta4->shm_magic == SORTED_HEAP_MAGIC);
-
-		meta4->shm_zonemap_nentries = n;
-		meta4->shm_zonemap_pk_typid = info->zm_pk_typid;
+		if (info->zm_shared != zs)
+		{
+			sorted_heap_zonemap_release(info);
+			info->zm_shared = zs;	/* keeps the pin */
+		}
 
-		for (i = 0; i < n; i++)
+		/*
+		 * Adopting only takes a block reference, so readers share the
+		 * lock.  Merging this transaction's deferred entries into the
+		 * block takes it exclusively, as a reload from disk
+		 * (sorted_heap_zonemap_load) does.
+		 */
+		LWLockAcquire(&zs->lock,
+					  sorted_heap_zonemap_has_pending(info->relid) ?
+					  LW_EXCLUSIVE : LW_SHARED);
+		if (zs->loaded && zs->relnumber == rel->rd_locator.relNumber)
 		{
-			meta4->shm_zonemap[i].zme_min = info->zm_entries[i].zme_min;
-			meta4->shm_zonemap[i].zme_max = info->zm_entries[i].zme_max;
+			sorted_heap_zm_adopt_locked(info, zs);
+			adopted = true;
 		}
+		LWLockRelease(&zs->lock);
+
+		if (adopted)
+			return;
 	}
 
-	GenericXLogFinish(state);
-	UnlockReleaseBuffer(metabuf);
+	sorted_heap_zonemap_load(rel, info);
 }
 
-/* ----------------------------------------------------------------
- *  Zone map rebuild — full table scan
- *
- *  Scans all tuples in a relation, computes per-page min/max of the
- *  first PK column, and writes the result to the meta page.  Used by
- *  relation_copy_for_cluster (CLUSTER path) and the standalone
- *  sorted_heap_rebuild_zonemap() SQL function.
- * ---------------------------------------------------------------- */
-void
-sorted_heap_rebuild_zonemap_internal(Relation rel, Oid pk_typid,
-									 AttrNumber pk_attnum,
-									 Oid pk_typid2,
-									 AttrNumber pk_attnum2)
+/*
+ * Bring a stale backend-local zone map up to date without re-reading it
+ * all.  Unchanged meta page LSN: nothing to do.  Otherwise, if the
+ * overflow directory, entry count and format are as they were, the meta
+ * page entries and flags are copied in and folded into the super-zones,
+ * provided no overflow page changed either.  Those are rewritten by
+ * rebuild, by sorted_heap_zonemap_widen_overflow, which logs the run's
+ * first page in the same record as the meta page, and by
+ * sorted_heap_zonemap_extend_overflow, which also changes the overflow
+ * entry count.  So a run rewritten after this copy was read, even at the
+ * same blocks, shows in its first page's LSN.  False if a full reload
+ * is needed.
+ */
+static bool
+sorted_heap_zonemap_revalidate(Relation rel, SortedHeapRelInfo *info)
 {
-	SortedHeapZoneMapEntry *entries;
-	uint32			nentries = 0;
-	uint32			max_entries;
-	uint32			alloc_entries;
-	TableScanDesc	scan;
-	TupleTableSlot *slot;
-	Buffer			metabuf;
-	Page			metapage;
-	GenericXLogState *gxlog_state;
+	Buffer		metabuf;
 	SortedHeapMetaPageData *meta;
-	uint16			meta_nentries;
-	uint32			overflow_npages = 0;
-	BlockNumber		overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS];
-	bool			track_col2 = OidIsValid(pk_typid2);
+	XLogRecPtr	lsn;
+	bool		kept = false;
 
-	/* Only supported PK types get zone maps.
-	 * Cannot probe with sorted_heap_key_to_int64(Int32GetDatum(0), ...)
-	 * because pointer-based types (UUID, text) would dereference NULL. */
-	switch (pk_typid)
+	if (info->zm_shared != NULL || XLogRecPtrIsInvalid(info->zm_meta_lsn) ||
+		info->zm_relnumber != rel->rd_locator.relNumber)
+		return false;
+
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+	lsn = BufferGetLSNAtomic(metabuf);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(BufferGetPage(metabuf));
+
+	if (lsn == info->zm_meta_lsn)
+		kept = true;
+	else if (meta->shm_magic == SORTED_HEAP_MAGIC &&
+			 meta->shm_version >= 5 &&
+			 meta->shm_zonemap_pk_typid == info->zm_pk_typid &&
+			 meta->shm_zonemap_pk_typid2 == info->zm_pk_typid2 &&
+			 meta->shm_overflow_nentries == info->zm_overflow_nentries &&
+			 ((meta->shm_flags & SHM_FLAG_ZM_PACKED) != 0) ==
+			 info->zm_overflow_packed &&
+			 Max((meta->shm_flags & SHM_ZONE_PAGES_MASK) >>
+				 SHM_ZONE_PAGES_SHIFT, 1) == info->zm_zone_pages &&
+			 (info->zm_overflow_nentries == 0 ||
+			  (info->zm_overflow_dir &&
+			   memcmp(meta->shm_overflow_blocks, info->zm_overflow_blocks,
+					  sizeof(info->zm_overflow_blocks)) == 0)))
 	{
-		case INT2OID:
-		case INT4OID:
-		case INT8OID:
-		case TIMESTAMPOID:
-		case TIMESTAMPTZOID:
-		case DATEOID:
-		case UUIDOID:
-		case TEXTOID:
-		case VARCHAROID:
-			break;		/* supported */
-		default:
-			return;		/* not supported */
+		uint16		n = Min(meta->shm_zonemap_nentries,
+							SORTED_HEAP_ZONEMAP_MAX);
+
+		memcpy(info->zm_entries, meta->shm_zonemap,
+			   n * sizeof(SortedHeapZoneMapEntry));
+		info->zm_nentries = n;
+		info->zm_total_entries = n + info->zm_overflow_nentries;
+		info->zm_scan_valid =
+			(meta->shm_flags & SHM_FLAG_ZONEMAP_VALID) != 0;
+		info->zm_sorted = (meta->shm_flags & SHM_FLAG_ZM_SORTED) != 0;
+		info->zm_tail_unsorted =
+			(meta->shm_flags & SHM_FLAG_ZM_TAIL_UNSORTED) != 0;
+		if (info->zm_super != NULL)
+		{
+			for (uint16 i = 0; i < n; i++)
+				sorted_heap_superzone_widen(&info->zm_super[i / SORTED_HEAP_SUPERZONE_PAGES],
+											&info->zm_entries[i]);
+		}
+		(void) sorted_heap_zonemap_apply_pending(info);
+		kept = true;
 	}
+	UnlockReleaseBuffer(metabuf);
 
-	/*
-	 * Dynamic allocation: start with a reasonable initial size, grow as needed.
-	 * No hard cap — zone map covers all data pages in the relation.
-	 */
-	alloc_entries = Max(SORTED_HEAP_ZONEMAP_MAX +
-						(uint32) SORTED_HEAP_META_OVERFLOW_SLOTS *
-						SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
-						1024);
-	max_entries = alloc_entries;
-
-	entries = (SortedHeapZoneMapEntry *)
-		palloc(max_entries * sizeof(SortedHeapZoneMapEntry));
-
-	/* Initialize to sentinel */
-	for (uint32 i = 0; i < max_entries; i++)
+	if (kept && lsn != info->zm_meta_lsn && info->zm_overflow_nentries > 0)
 	{
-		entries[i].zme_min = PG_INT64_MAX;
-		entries[i].zme_max = PG_INT64_MIN;
-		entries[i].zme_min2 = PG_INT64_MAX;
-		entries[i].zme_max2 = PG_INT64_MIN;
+		BlockNumber	first = sorted_heap_overflow_dir_block(info, 0);
+
+		if (first >= RelationGetNumberOfBlocks(rel))
+			kept = false;
+		else
+		{
+			Buffer		buf;
+
+			buf = ReadBufferExtended(rel, MAIN_FORKNUM, first,
+									 RBM_NORMAL, NULL);
+			LockBuffer(buf, BUFFER_LOCK_SHARE);
+			if (BufferGetLSNAtomic(buf) > info->zm_meta_lsn)
+				kept = false;
+			UnlockReleaseBuffer(buf);
+		}
 	}
 
-	/* Scan all tuples, build per-page min/max */
-	slot = table_slot_create(rel, NULL);
-	scan = table_beginscan(rel, SnapshotAny, 0, NULL);
+	if (kept)
+		info->zm_meta_lsn = lsn;
+	return kept;
+}
 
-	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
-	{
-		BlockNumber		blk;
-		uint32			zmidx;
-		Datum			val;
-		bool			isnull;
-		int64			key;
-		SortedHeapZoneMapEntry *e;
+/* Block of overflow page 'page' per a v7 directory, or InvalidBlockNumber */
+static BlockNumber
+sorted_heap_overflow_dir_block(SortedHeapRelInfo *info, uint32 page)
+{
+	SortedHeapOverflowExtent *ext =
+		(SortedHeapOverflowExtent *) info->zm_overflow_blocks;
 
-		blk = ItemPointerGetBlockNumber(&slot->tts_tid);
-		if (blk < 1)
-			continue;			/* skip meta page */
-		zmidx = blk - 1;
+	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+	{
+		if (ext[i].soe_npages == 0)
+			break;
+		if (page < ext[i].soe_npages)
+			return ext[i].soe_start + page;
+		page -= ext[i].soe_npages;
+	}
+	return InvalidBlockNumber;
+}
 
-		/* Grow entries array if needed */
-		if (zmidx >= max_entries)
+/*
+ * Read overflow page 'page' into info->zm_overflow.  v7 finds it in the
+ * directory.  For v6, rebuild wrote overflow pages contiguously, so page
+ * i beyond the meta page's slots is looked for at zm_overflow_blocks[0]
+ * + i first; if that block is not it, the chain is followed from the
+ * last meta slot.
+ */
+static void
+sorted_heap_zonemap_read_overflow(Relation rel, SortedHeapRelInfo *info,
+								  uint32 page)
+{
+	uint32		start = page * info->zm_overflow_per_page;
+	uint32		count = Min(info->zm_overflow_per_page,
+							info->zm_overflow_nentries - start);
+	Size		special_size = info->zm_overflow_packed ?
+		SORTED_HEAP_PACKED_SPECIAL_SIZE :
+		MAXALIGN(sizeof(SortedHeapOverflowPageData));
+	BlockNumber	blk;
+	uint32		at;
+	bool		guessed = false;
+
+	if (info->zm_overflow_dir)
+		blk = sorted_heap_overflow_dir_block(info, page);
+	else if (page < SORTED_HEAP_META_OVERFLOW_SLOTS)
+		blk = info->zm_overflow_blocks[page];
+	else
+	{
+		blk = info->zm_overflow_blocks[0] + page;
+		guessed = true;
+		if (blk >= RelationGetNumberOfBlocks(rel))
 		{
-			uint32	new_max = Max(max_entries * 2, zmidx + 1);
-
-			entries = (SortedHeapZoneMapEntry *)
-				repalloc(entries, new_max * sizeof(SortedHeapZoneMapEntry));
-
-			for (uint32 i = max_entries; i < new_max; i++)
-			{
-				entries[i].zme_min = PG_INT64_MAX;
-				entries[i].zme_max = PG_INT64_MIN;
-				entries[i].zme_min2 = PG_INT64_MAX;
-				entries[i].zme_max2 = PG_INT64_MIN;
-			}
-			max_entries = new_max;
+			blk = info->zm_overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS - 1];
+			guessed = false;
 		}
+	}
+	if (info->zm_overflow_dir || guessed)
+		at = page;
+	else
+		at = Min(page, SORTED_HEAP_META_OVERFLOW_SLOTS - 1);
 
-		val = slot_getattr(slot, pk_attnum, &isnull);
-		if (isnull)
-			continue;
-		if (!sorted_heap_key_to_int64(val, pk_typid, &key))
-			continue;
-
-		e = &entries[zmidx];
-		if (e->zme_min == PG_INT64_MAX)
+	while (blk != InvalidBlockNumber)
+	{
+		Buffer		buf;
+		Page		pg;
+		SortedHeapOverflowPageData *ovfl;
+		BlockNumber	next = InvalidBlockNumber;
+		bool		match;
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, blk, RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		pg = BufferGetPage(buf);
+		ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+
+		/* page_index is 16 bits wide and wraps on huge tables */
+		match = !PageIsNew(pg) &&
+			PageGetSpecialSize(pg) == special_size &&
+			ovfl->shmo_magic == SORTED_HEAP_MAGIC &&
+			ovfl->shmo_page_index == (uint16) at;
+
+		if (match && at == page && info->zm_overflow_packed)
 		{
-			e->zme_min = key;
-			e->zme_max = key;
+			/* Decode straight into the cache */
+			match = sorted_heap_unpack_overflow((SortedHeapPackedOverflowPageData *) ovfl,
+												count,
+												&info->zm_overflow[start]);
+			UnlockReleaseBuffer(buf);
+			if (match)
+				return;
+			break;
 		}
-		else
+		if (match && at == page)
 		{
-			if (key < e->zme_min)
-				e->zme_min = key;
-			if (key > e->zme_max)
-				e->zme_max = key;
+			memcpy(&info->zm_overflow[start], ovfl->shmo_entries,
+				   Min(count, ovfl->shmo_nentries) *
+				   sizeof(SortedHeapZoneMapEntry));
+			UnlockReleaseBuffer(buf);
+			return;
 		}
+		if (match)
+			next = ovfl->shmo_next_block;
+		UnlockReleaseBuffer(buf);
 
-		/* Track column 2 min/max */
-		if (track_col2)
+		if (guessed)
 		{
-			Datum	val2;
-			bool	isnull2;
-			int64	key2;
-
-			val2 = slot_getattr(slot, pk_attnum2, &isnull2);
-			if (!isnull2 &&
-				sorted_heap_key_to_int64(val2, pk_typid2, &key2))
-			{
-				if (e->zme_min2 == PG_INT64_MAX)
-				{
-					e->zme_min2 = key2;
-					e->zme_max2 = key2;
-				}
-				else
-				{
-					if (key2 < e->zme_min2)
-						e->zme_min2 = key2;
-					if (key2 > e->zme_max2)
-						e->zme_max2 = key2;
-				}
-			}
+			/* Not laid out contiguously: walk the chain instead */
+			guessed = false;
+			blk = info->zm_overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS - 1];
+			at = SORTED_HEAP_META_OVERFLOW_SLOTS - 1;
+			continue;
 		}
-
-		if (zmidx >= nentries)
-			nentries = zmidx + 1;
+		if (!match || info->zm_overflow_dir)
+			break;
+		blk = next;
+		at++;
 	}
 
-	table_endscan(scan);
-	ExecDropSingleTupleTableSlot(slot);
+	ereport(ERROR,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("zone map overflow page %u of \"%s\" not found",
+					page, RelationGetRelationName(rel)),
+			 errhint("Run sorted_heap_rebuild_zonemap() on the table.")));
+}
 
-	/* Split entries: first 250 go to meta page, rest to overflow pages */
-	meta_nentries = Min(nentries, SORTED_HEAP_ZONEMAP_MAX);
+/*
+ * Prefetch the overflow pages holding entries [first_idx, end_idx) that
+ * have not been read yet, so a window walk that is about to touch them
+ * issues their reads together.  Only a v7 directory says where they are
+ * without reading anything; the caller holds a lock on the relation.
+ */
+void
+sorted_heap_zonemap_prefetch(SortedHeapRelInfo *info, uint32 first_idx,
+							 uint32 end_idx)
+{
+	Relation	rel = NULL;
+	uint32		first_page;
+	uint32		last_page;
 
-	/* Initialize overflow block numbers */
-	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_SLOTS; i++)
-		overflow_blocks[i] = InvalidBlockNumber;
+	if (info->zm_overflow_loaded == NULL || !info->zm_overflow_dir)
+		return;
+	first_idx = Max(first_idx, info->zm_nentries);
+	end_idx = Min(end_idx, info->zm_total_entries);
+	if (first_idx >= end_idx)
+		return;
 
-	/* Create overflow pages if needed (v6: linked list, no hard cap) */
-	if (nentries > SORTED_HEAP_ZONEMAP_MAX)
+	first_page = (first_idx - info->zm_nentries) / info->zm_overflow_per_page;
+	last_page = (end_idx - 1 - info->zm_nentries) / info->zm_overflow_per_page;
+
+	for (uint32 page = first_page; page <= last_page; page++)
 	{
-		uint32		overflow_entries = nentries - SORTED_HEAP_ZONEMAP_MAX;
-		SMgrRelation srel = RelationGetSmgr(rel);
-		BlockNumber	next_blk = smgrnblocks(srel, MAIN_FORKNUM);
-		RelFileLocator rlocator = rel->rd_locator;
-		BlockNumber *all_ovfl_blocks;
+		BlockNumber	blk;
 
-		overflow_npages =
-			(overflow_entries + SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE - 1) /
-			SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		if (info->zm_overflow_loaded[page])
+			continue;
+		blk = sorted_heap_overflow_dir_block(info, page);
+		if (blk == InvalidBlockNumber)
+			break;
+		if (rel == NULL)
+			rel = table_open(info->relid, NoLock);
+		(void) PrefetchBuffer(rel, MAIN_FORKNUM, blk);
+	}
+
+	if (rel != NULL)
+		table_close(rel, NoLock);
+}
 
-		/* No hard cap — allocate block number tracking for all pages */
-		all_ovfl_blocks = (BlockNumber *)
-			palloc(overflow_npages * sizeof(BlockNumber));
+/*
+ * Read an overflow page of info's zone map on first access (see
+ * sorted_heap_get_zm_entry).  The caller holds a lock on the relation.
+ * For the shared copy the read happens under the entry's lock, and the
+ * page's flag is set only after its entries are in place.
+ */
+void
+sorted_heap_zonemap_fault(SortedHeapRelInfo *info, uint32 page)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
+	Relation	rel;
 
-		/* Pass 1: allocate and write all overflow pages */
-		for (uint32 p = 0; p < overflow_npages; p++)
+	if (zs != NULL)
+	{
+		LWLockAcquire(&zs->lock, LW_EXCLUSIVE);
+		if (info->zm_overflow_loaded[page])
 		{
-			PGAlignedBlock	aligned_buf;
-			Page			ovfl_page;
-			SortedHeapOverflowPageData *ovfl;
-			uint32			start = SORTED_HEAP_ZONEMAP_MAX +
-				(uint32) p * SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
-			uint32			count = Min(SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
-										nentries - start);
+			LWLockRelease(&zs->lock);
+			return;
+		}
+	}
 
-			ovfl_page = (Page) aligned_buf.data;
-			PageInit(ovfl_page, BLCKSZ,
-					 sizeof(SortedHeapOverflowPageData));
+	rel = table_open(info->relid, NoLock);
+	sorted_heap_zonemap_read_overflow(rel, info, page);
+	table_close(rel, NoLock);
 
-			/* Mark page as full so heap never uses it */
-			((PageHeader) ovfl_page)->pd_lower =
-				((PageHeader) ovfl_page)->pd_upper;
+	pg_write_barrier();
+	info->zm_overflow_loaded[page] = true;
 
-			ovfl = (SortedHeapOverflowPageData *)
-				PageGetSpecialPointer(ovfl_page);
-			ovfl->shmo_magic = SORTED_HEAP_MAGIC;
-			ovfl->shmo_nentries = count;
-			ovfl->shmo_page_index = p;
-			ovfl->shmo_next_block = InvalidBlockNumber;	/* set in pass 2 */
-			ovfl->shmo_padding = 0;
-			memcpy(ovfl->shmo_entries, &entries[start],
-				   count * sizeof(SortedHeapZoneMapEntry));
+	if (zs != NULL)
+		LWLockRelease(&zs->lock);
+}
 
-			/* WAL-log, then checksum, then write */
-			log_newpage(&rlocator, MAIN_FORKNUM, next_blk,
-						ovfl_page, true);
-			PageSetChecksumInplace(ovfl_page, next_blk);
-			smgrextend(srel, MAIN_FORKNUM, next_blk,
-					   aligned_buf.data, false);
+/* ----------------------------------------------------------------
+ *  Meta page entry writes and their WAL record
+ *
+ *  Zone map maintenance rewrites a few meta page entries at a time.
+ *  When the library is preloaded, a custom resource manager logs that
+ *  as one typed record: the entry range and its new values, plus the
+ *  header fields that go with them.  Redo copies them back without
+ *  diffing pages.  Otherwise, or with sorted_heap.custom_wal off, the
+ *  same change goes through GenericXLog.  Standbys replaying these
+ *  records must preload the library too.
+ * ---------------------------------------------------------------- */
 
-			all_ovfl_blocks[p] = next_blk;
-			next_blk++;
-		}
+/* Custom rmgr ID; see wiki.postgresql.org/wiki/CustomWALResourceManagers */
+#define SORTED_HEAP_RMGR_ID				139
 
-		/*
-		 * Pass 2: set next_block pointers for pages beyond meta slots.
-		 * Pages 0..min(overflow_npages,32)-1 are referenced from meta page.
-		 * If overflow_npages > 32, page 31's next_block → page 32,
-		 * page 32's next_block → page 33, etc.
-		 */
-		if (overflow_npages > SORTED_HEAP_META_OVERFLOW_SLOTS)
-		{
-			uint32	chain_start = SORTED_HEAP_META_OVERFLOW_SLOTS - 1;
+#define XLOG_SORTED_HEAP_META_ENTRIES	0x00
 
-			for (uint32 p = chain_start; p < overflow_npages; p++)
-			{
-				Buffer		ovfl_buf;
-				Page		ovfl_page;
-				GenericXLogState *ovfl_state;
-				SortedHeapOverflowPageData *ovfl;
+/*
+ * Set meta page entries [first, first + count) to the 32-byte entries
+ * in block 0's data (v3/v4 pages keep column 1 only), and the header
+ * fields below.  Wider fields first, so the logged bytes hold no
+ * padding.
+ */
+typedef struct xl_sorted_heap_meta_entries
+{
+	uint32		flags;			/* new shm_flags */
+	Oid			pk_typid;
+	Oid			pk_typid2;		/* ignored on v3/v4 pages */
+	uint16		first;
+	uint16		count;
+	uint16		nentries;		/* new shm_zonemap_nentries */
+} xl_sorted_heap_meta_entries;
 
-				ovfl_buf = ReadBufferExtended(rel, MAIN_FORKNUM,
-											  all_ovfl_blocks[p],
-											  RBM_NORMAL, NULL);
-				LockBuffer(ovfl_buf, BUFFER_LOCK_EXCLUSIVE);
+#define SizeOfSortedHeapMetaEntries \
+	(offsetof(xl_sorted_heap_meta_entries, nentries) + sizeof(uint16))
 
-				ovfl_state = GenericXLogStart(rel);
-				ovfl_page = GenericXLogRegisterBuffer(ovfl_state,
-													  ovfl_buf, 0);
-				ovfl = (SortedHeapOverflowPageData *)
-					PageGetSpecialPointer(ovfl_page);
+/* GUC: log meta page entry changes with the custom rmgr when registered */
+bool sorted_heap_custom_wal = true;
 
-				if (p + 1 < overflow_npages)
-					ovfl->shmo_next_block = all_ovfl_blocks[p + 1];
-				else
-					ovfl->shmo_next_block = InvalidBlockNumber;
+static bool sorted_heap_rmgr_registered = false;
 
-				GenericXLogFinish(ovfl_state);
-				UnlockReleaseBuffer(ovfl_buf);
-			}
-		}
+/*
+ * Read page's zone map entries (as 32-byte entries) and header fields
+ * into ents and hdr.  Returns the page's entry capacity, or 0 if it is
+ * not a meta page with a zone map.
+ */
+static uint16
+sorted_heap_meta_get_entries(Page page, xl_sorted_heap_meta_entries *hdr,
+							 SortedHeapZoneMapEntry *ents)
+{
+	char	   *special = (char *) PageGetSpecialPointer(page);
+	uint32		magic;
+	uint32		version;
+
+	memcpy(&magic, special, sizeof(uint32));
+	memcpy(&version, special + sizeof(uint32), sizeof(uint32));
+	hdr->first = 0;
+	hdr->count = 0;
 
-		/* Copy first 32 (or fewer) block numbers to meta page array */
-		for (uint32 p = 0; p < Min(overflow_npages,
-								   SORTED_HEAP_META_OVERFLOW_SLOTS); p++)
-			overflow_blocks[p] = all_ovfl_blocks[p];
+	if (magic != SORTED_HEAP_MAGIC || version < 3)
+		return 0;
+	if (version >= 5)
+	{
+		SortedHeapMetaPageData *meta = (SortedHeapMetaPageData *) special;
 
-		pfree(all_ovfl_blocks);
+		hdr->nentries = Min(meta->shm_zonemap_nentries,
+							SORTED_HEAP_ZONEMAP_MAX);
+		hdr->flags = meta->shm_flags;
+		hdr->pk_typid = meta->shm_zonemap_pk_typid;
+		hdr->pk_typid2 = meta->shm_zonemap_pk_typid2;
+		memcpy(ents, meta->shm_zonemap,
+			   hdr->nentries * sizeof(SortedHeapZoneMapEntry));
+		return SORTED_HEAP_ZONEMAP_MAX;
 	}
+	else
+	{
+		SortedHeapMetaPageDataV4 *meta4 = (SortedHeapMetaPageDataV4 *) special;
 
-	/* Write zone map to meta page */
-	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
-								 RBM_NORMAL, NULL);
-	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+		hdr->nentries = Min(meta4->shm_zonemap_nentries,
+							SORTED_HEAP_ZONEMAP_MAX_V4);
+		hdr->flags = meta4->shm_flags;
+		hdr->pk_typid = meta4->shm_zonemap_pk_typid;
+		hdr->pk_typid2 = InvalidOid;
+		for (uint16 i = 0; i < hdr->nentries; i++)
+		{
+			sorted_heap_entry_clear(&ents[i]);
+			ents[i].zme_min = meta4->shm_zonemap[i].zme_min;
+			ents[i].zme_max = meta4->shm_zonemap[i].zme_max;
+		}
+		return SORTED_HEAP_ZONEMAP_MAX_V4;
+	}
+}
 
-	gxlog_state = GenericXLogStart(rel);
-	metapage = GenericXLogRegisterBuffer(gxlog_state, metabuf, 0);
-	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
-	meta->shm_zonemap_nentries = meta_nentries;
-	meta->shm_zonemap_pk_typid = pk_typid;
-	meta->shm_zonemap_pk_typid2 = pk_typid2;
-	meta->shm_flags |= SHM_FLAG_ZONEMAP_VALID;
+/* Apply hdr and its hdr->count entries to page; used by do and redo */
+static void
+sorted_heap_meta_set_entries(Page page, const xl_sorted_heap_meta_entries *hdr,
+							 const SortedHeapZoneMapEntry *vals)
+{
+	char	   *special = (char *) PageGetSpecialPointer(page);
+	uint32		version;
 
-	/* Check if entries are monotonically sorted (enables binary search) */
+	memcpy(&version, special + sizeof(uint32), sizeof(uint32));
+	if (version >= 5)
 	{
-		bool	is_sorted = true;
-		int64	prev_max = PG_INT64_MIN;
+		SortedHeapMetaPageData *meta = (SortedHeapMetaPageData *) special;
 
-		for (uint32 j = 0; j < nentries && is_sorted; j++)
+		Assert(hdr->first + hdr->count <= SORTED_HEAP_ZONEMAP_MAX);
+		memcpy(&meta->shm_zonemap[hdr->first], vals,
+			   hdr->count * sizeof(SortedHeapZoneMapEntry));
+		meta->shm_zonemap_nentries = hdr->nentries;
+		meta->shm_flags = hdr->flags;
+		meta->shm_zonemap_pk_typid = hdr->pk_typid;
+		meta->shm_zonemap_pk_typid2 = hdr->pk_typid2;
+	}
+	else
+	{
+		SortedHeapMetaPageDataV4 *meta4 = (SortedHeapMetaPageDataV4 *) special;
+
+		Assert(hdr->first + hdr->count <= SORTED_HEAP_ZONEMAP_MAX_V4);
+		for (uint16 i = 0; i < hdr->count; i++)
 		{
-			if (entries[j].zme_min == PG_INT64_MAX)
-				continue;			/* skip empty pages */
-			if (entries[j].zme_min < prev_max)
-				is_sorted = false;
-			prev_max = entries[j].zme_max;
+			meta4->shm_zonemap[hdr->first + i].zme_min = vals[i].zme_min;
+			meta4->shm_zonemap[hdr->first + i].zme_max = vals[i].zme_max;
 		}
-		if (is_sorted)
-			meta->shm_flags |= SHM_FLAG_ZM_SORTED;
+		meta4->shm_zonemap_nentries = hdr->nentries;
+		meta4->shm_flags = hdr->flags;
+		meta4->shm_zonemap_pk_typid = hdr->pk_typid;
+	}
+}
+
+/*
+ * Make the meta page in metabuf (exclusively locked) hold the header
+ * fields in want and entries ents[0 .. want->nentries), logging only
+ * the range of entries that differ.  False if the page already does.
+ */
+static bool
+sorted_heap_meta_write(Relation rel, Buffer metabuf,
+					   xl_sorted_heap_meta_entries *want,
+					   const SortedHeapZoneMapEntry *ents)
+{
+	xl_sorted_heap_meta_entries cur;
+	SortedHeapZoneMapEntry *old;
+	uint16		cap;
+	int			lo = -1;
+	int			hi = -1;
+
+	old = palloc(SORTED_HEAP_ZONEMAP_CACHE_MAX * sizeof(SortedHeapZoneMapEntry));
+	cap = sorted_heap_meta_get_entries(BufferGetPage(metabuf), &cur, old);
+	Assert(cap > 0 && want->nentries <= cap);
+
+	for (uint16 i = 0; i < want->nentries; i++)
+	{
+		bool		same;
+
+		if (i >= cur.nentries)
+			same = false;
+		else if (cap == SORTED_HEAP_ZONEMAP_MAX)
+			same = memcmp(&old[i], &ents[i],
+						  sizeof(SortedHeapZoneMapEntry)) == 0;
 		else
-			meta->shm_flags &= ~SHM_FLAG_ZM_SORTED;
+			same = old[i].zme_min == ents[i].zme_min &&
+				old[i].zme_max == ents[i].zme_max;
+		if (!same)
+		{
+			if (lo < 0)
+				lo = i;
+			hi = i;
+		}
 	}
+	pfree(old);
 
-	memcpy(meta->shm_zonemap, entries,
-		   meta_nentries * sizeof(SortedHeapZoneMapEntry));
+	if (lo < 0 && want->nentries == cur.nentries &&
+		want->flags == cur.flags && want->pk_typid == cur.pk_typid &&
+		(cap != SORTED_HEAP_ZONEMAP_MAX || want->pk_typid2 == cur.pk_typid2))
+		return false;
 
-	/* Write overflow metadata (meta page stores up to 32 block numbers) */
-	meta->shm_overflow_npages = Min(overflow_npages,
-									SORTED_HEAP_META_OVERFLOW_SLOTS);
-	memcpy(meta->shm_overflow_blocks, overflow_blocks,
-		   sizeof(overflow_blocks));
+	want->first = (lo < 0) ? 0 : lo;
+	want->count = (lo < 0) ? 0 : hi - lo + 1;
 
-	GenericXLogFinish(gxlog_state);
-	UnlockReleaseBuffer(metabuf);
+	if (sorted_heap_rmgr_registered && sorted_heap_custom_wal)
+	{
+		Page		page = BufferGetPage(metabuf);
 
-	pfree(entries);
+		START_CRIT_SECTION();
+		sorted_heap_meta_set_entries(page, want, &ents[want->first]);
+		MarkBufferDirty(metabuf);
+		if (RelationNeedsWAL(rel))
+		{
+			XLogRecPtr	recptr;
+
+			XLogBeginInsert();
+			XLogRegisterData((char *) want, SizeOfSortedHeapMetaEntries);
+			XLogRegisterBuffer(0, metabuf, REGBUF_STANDARD);
+			XLogRegisterBufData(0, (char *) &ents[want->first],
+								want->count * sizeof(SortedHeapZoneMapEntry));
+			recptr = XLogInsert(SORTED_HEAP_RMGR_ID,
+								XLOG_SORTED_HEAP_META_ENTRIES);
+			PageSetLSN(page, recptr);
+		}
+		END_CRIT_SECTION();
+	}
+	else
+	{
+		GenericXLogState *state = GenericXLogStart(rel);
+		Page		page = GenericXLogRegisterBuffer(state, metabuf, 0);
 
-	/* Invalidate relinfo cache so next access re-reads */
-	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+		sorted_heap_meta_set_entries(page, want, &ents[want->first]);
+		GenericXLogFinish(state);
+	}
+	return true;
 }
 
-/* ----------------------------------------------------------------
- *  Meta page initialization via smgr
- *
- *  During relation_set_new_filelocator (CREATE TABLE / TRUNCATE),
- *  rel->rd_locator still points to the OLD filenode.  We bypass the
- *  buffer manager and write the meta page directly to the correct
- *  locator using smgrextend + log_newpage.
- * ---------------------------------------------------------------- */
+/*
+ * Set and clear meta page flags.  Concurrent writers mostly find them
+ * already so, which a share lock is enough to see; only the first one
+ * takes the exclusive lock and logs the change.
+ */
 static void
-sorted_heap_init_meta_page_smgr(const RelFileLocator *rlocator,
-								ProcNumber backend, bool need_wal)
+sorted_heap_meta_update_flags(Relation rel, uint32 set, uint32 clear)
 {
-	SMgrRelation		srel;
-	PGAlignedBlock		buf;
-	Page				page;
+	Buffer		metabuf;
 	SortedHeapMetaPageData *meta;
-	RelFileLocator		rlocator_copy;
-
-	srel = smgropen(*rlocator, backend);
+	uint32		flags;
 
-	page = (Page) buf.data;
-	PageInit(page, BLCKSZ, sizeof(SortedHeapMetaPageData));
-
-	/* Mark page as full so heap never tries to use block 0 for data */
-	((PageHeader) page)->pd_lower = ((PageHeader) page)->pd_upper;
-
-	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(page);
-	meta->shm_magic = SORTED_HEAP_MAGIC;
-	meta->shm_version = SORTED_HEAP_VERSION;
-	meta->shm_flags = 0;
-	meta->shm_pk_index_oid = InvalidOid;
-	meta->shm_zonemap_nentries = 0;
-	meta->shm_overflow_npages = 0;
-	meta->shm_zonemap_pk_typid = InvalidOid;
-	meta->shm_zonemap_pk_typid2 = InvalidOid;
-	meta->shm_padding = 0;
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(BufferGetPage(metabuf));
+	flags = meta->shm_flags;
 
-	/* Initialize zone map entries to sentinel */
-	for (int i = 0; i < SORTED_HEAP_ZONEMAP_MAX; i++)
+	if (((flags | set) & ~clear) != flags)
 	{
-		meta->shm_zonemap[i].zme_min = PG_INT64_MAX;
-		meta->shm_zonemap[i].zme_max = PG_INT64_MIN;
-		meta->shm_zonemap[i].zme_min2 = PG_INT64_MAX;
-		meta->shm_zonemap[i].zme_max2 = PG_INT64_MIN;
+		xl_sorted_heap_meta_entries hdr;
+		SortedHeapZoneMapEntry *ents;
+
+		LockBuffer(metabuf, BUFFER_LOCK_UNLOCK);
+		LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+		ents = palloc(SORTED_HEAP_ZONEMAP_CACHE_MAX *
+					  sizeof(SortedHeapZoneMapEntry));
+		if (sorted_heap_meta_get_entries(BufferGetPage(metabuf), &hdr,
+										 ents) > 0)
+		{
+			hdr.flags = (hdr.flags | set) & ~clear;
+			(void) sorted_heap_meta_write(rel, metabuf, &hdr, ents);
+		}
+		pfree(ents);
 	}
+	UnlockReleaseBuffer(metabuf);
+}
 
-	/* Initialize overflow block pointers */
-	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_SLOTS; i++)
-		meta->shm_overflow_blocks[i] = InvalidBlockNumber;
+static void
+sorted_heap_rmgr_redo(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	xl_sorted_heap_meta_entries *xlrec;
+	Buffer		buf;
 
-	/* WAL-log first (sets LSN on page), then checksum, then write */
-	if (need_wal)
+	if (info != XLOG_SORTED_HEAP_META_ENTRIES)
+		elog(PANIC, "sorted_heap_rmgr_redo: unknown op code %u", info);
+
+	xlrec = (xl_sorted_heap_meta_entries *) XLogRecGetData(record);
+	if (XLogReadBufferForRedo(record, 0, &buf) == BLK_NEEDS_REDO)
 	{
-		rlocator_copy = *rlocator;
-		log_newpage(&rlocator_copy, MAIN_FORKNUM,
-					SORTED_HEAP_META_BLOCK, page, true);
+		Page		page = BufferGetPage(buf);
+		Size		len;
+		char	   *vals = XLogRecGetBlockData(record, 0, &len);
+
+		Assert(len == xlrec->count * sizeof(SortedHeapZoneMapEntry));
+		sorted_heap_meta_set_entries(page, xlrec,
+									 (SortedHeapZoneMapEntry *) vals);
+		PageSetLSN(page, record->EndRecPtr);
+		MarkBufferDirty(buf);
 	}
-
-	PageSetChecksumInplace(page, SORTED_HEAP_META_BLOCK);
-	smgrextend(srel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
-			   buf.data, false);
+	if (BufferIsValid(buf))
+		UnlockReleaseBuffer(buf);
 }
 
-/* ----------------------------------------------------------------
- *  DDL lifecycle callbacks
- * ---------------------------------------------------------------- */
 static void
-sorted_heap_relation_set_new_filelocator(Relation rel,
-										 const RelFileLocator *rlocator,
-										 char persistence,
-										 TransactionId *freezeXid,
-										 MultiXactId *minmulti)
+sorted_heap_rmgr_desc(StringInfo buf, XLogReaderState *record)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
-
-	heap->relation_set_new_filelocator(rel, rlocator, persistence,
-									   freezeXid, minmulti);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
 
-	/* Write meta page to the NEW file using its locator directly */
-	sorted_heap_init_meta_page_smgr(rlocator, rel->rd_backend,
-									persistence == RELPERSISTENCE_PERMANENT);
+	if (info == XLOG_SORTED_HEAP_META_ENTRIES)
+	{
+		xl_sorted_heap_meta_entries *xlrec =
+			(xl_sorted_heap_meta_entries *) XLogRecGetData(record);
 
-	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+		appendStringInfo(buf, "entries %u..%u nentries %u flags 0x%04x",
+						 xlrec->first, xlrec->first + xlrec->count,
+						 xlrec->nentries, xlrec->flags);
+	}
 }
 
-static void
-sorted_heap_relation_nontransactional_truncate(Relation rel)
+static const char *
+sorted_heap_rmgr_identify(uint8 info)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
-
-	heap->relation_nontransactional_truncate(rel);
-	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+	if ((info & ~XLR_INFO_MASK) == XLOG_SORTED_HEAP_META_ENTRIES)
+		return "META_ENTRIES";
+	return NULL;
 }
 
 static void
-sorted_heap_relation_copy_data(Relation rel,
-							   const RelFileLocator *newrlocator)
+sorted_heap_rmgr_mask(char *pagedata, BlockNumber blkno)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	mask_page_lsn_and_checksum(pagedata);
+}
 
-	heap->relation_copy_data(rel, newrlocator);
+static const RmgrData sorted_heap_rmgr = {
+	.rm_name = "sorted_heap",
+	.rm_redo = sorted_heap_rmgr_redo,
+	.rm_desc = sorted_heap_rmgr_desc,
+	.rm_identify = sorted_heap_rmgr_identify,
+	.rm_mask = sorted_heap_rmgr_mask,
+};
+
+/*
+ * Register the resource manager; only possible while preloading, so
+ * otherwise meta page writes keep using GenericXLog.
+ */
+void
+sorted_heap_rmgr_init(void)
+{
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+	RegisterCustomRmgr(SORTED_HEAP_RMGR_ID, &sorted_heap_rmgr);
+	sorted_heap_rmgr_registered = true;
 }
 
-/* ----------------------------------------------------------------
- *  Vacuum callback — delegate to heap, then rebuild zone map if invalid
- * ---------------------------------------------------------------- */
+/*
+ * Flush zone map from relinfo cache to meta page.  Version-aware:
+ * v3/v4 pages keep column 1 only.  Entries the page already has are
+ * merged rather than overwritten, so a widening another backend wrote
+ * at commit is kept even if this copy predates it.
+ */
 static void
-sorted_heap_relation_vacuum(Relation rel, struct VacuumParams *params,
-							BufferAccessStrategy bstrategy)
+sorted_heap_zonemap_flush(Relation rel, SortedHeapRelInfo *info)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	Buffer		metabuf;
+	xl_sorted_heap_meta_entries hdr;
+	SortedHeapZoneMapEntry *ents;
+	uint16		cap;
+	uint16		n;
 
-	/* Step 1: delegate to heap vacuum (actual tuple cleanup) */
-	heap->relation_vacuum(rel, params, bstrategy);
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
 
-	/* Step 2: rebuild zone map if invalid and GUC enabled */
-	if (sorted_heap_vacuum_rebuild_zonemap &&
-		RelationGetNumberOfBlocks(rel) > SORTED_HEAP_META_BLOCK)
+	ents = palloc(SORTED_HEAP_ZONEMAP_CACHE_MAX * sizeof(SortedHeapZoneMapEntry));
+	cap = sorted_heap_meta_get_entries(BufferGetPage(metabuf), &hdr, ents);
+	Assert(cap > 0);
+
+	n = Min(info->zm_nentries, cap);
+	for (uint16 i = 0; i < n; i++)
 	{
-		Buffer		metabuf;
-		Page		metapage;
-		SortedHeapMetaPageData *meta;
-		bool		need_rebuild = false;
+		if (i < hdr.nentries)
+			(void) sorted_heap_entry_merge(&ents[i], &info->zm_entries[i]);
+		else
+			ents[i] = info->zm_entries[i];
+	}
+	hdr.nentries = Max(hdr.nentries, n);
+	hdr.pk_typid = info->zm_pk_typid;
+	hdr.pk_typid2 = info->zm_pk_typid2;
+	hdr.flags &= ~SHM_FLAG_ZM_SORTED;	/* INSERT may break monotonicity */
 
-		metabuf = ReadBufferExtended(rel, MAIN_FORKNUM,
-									 SORTED_HEAP_META_BLOCK, RBM_NORMAL,
-									 NULL);
-		LockBuffer(metabuf, BUFFER_LOCK_SHARE);
-		metapage = BufferGetPage(metabuf);
-		meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+	(void) sorted_heap_meta_write(rel, metabuf, &hdr, ents);
+	pfree(ents);
+	UnlockReleaseBuffer(metabuf);
+}
 
-		if (meta->shm_magic == SORTED_HEAP_MAGIC &&
-			!(meta->shm_flags & SHM_FLAG_ZONEMAP_VALID))
-			need_rebuild = true;
+/* ----------------------------------------------------------------
+ *  Deferred zone map writes
+ *
+ *  Widening a meta page entry for a row this transaction placed is
+ *  only needed once the row can be seen by others, i.e. at commit.
+ *  Until then the widened entries are kept in sorted_heap_pending_hash
+ *  (and in the cached copy, for this backend's scans) and written in
+ *  one record per relation just before the commit record: the custom
+ *  rmgr's META_ENTRIES record when sorted_heap.custom_wal is on and the
+ *  library is preloaded, else a GenericXLog one (see
+ *  sorted_heap_meta_write).  A crash before that record loses only
+ *  entries for rows that never committed.  Entries appended past the meta page's count and overflow
+ *  page changes are still written at once.
+ * ---------------------------------------------------------------- */
 
-		UnlockReleaseBuffer(metabuf);
+/* This transaction's deferred entries for rel, created empty if none */
+static SortedHeapZmPending *
+sorted_heap_zonemap_pending_entry(Relation rel)
+{
+	Oid			relid = RelationGetRelid(rel);
+	SortedHeapZmPending *pending;
+	bool		found;
 
-		if (need_rebuild)
-		{
-			SortedHeapRelInfo *info = sorted_heap_get_relinfo(rel);
+	if (sorted_heap_pending_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(SortedHeapZmPending);
+		ctl.hcxt = TopTransactionContext;
+		sorted_heap_pending_hash = hash_create("sorted_heap pending zone maps",
+											   8, &ctl,
+											   HASH_ELEM | HASH_BLOBS |
+											   HASH_CONTEXT);
+	}
 
-			if (info->zm_usable)
-				sorted_heap_rebuild_zonemap_internal(rel,
-					info->zm_pk_typid, info->attNums[0],
-					info->zm_col2_usable ? info->zm_pk_typid2 : InvalidOid,
-					info->zm_col2_usable ? info->attNums[1] : 0);
-		}
+	pending = hash_search(sorted_heap_pending_hash, &relid, HASH_ENTER,
+						  &found);
+	if (!found)
+	{
+		pending->relnumber = rel->rd_locator.relNumber;
+		for (int i = 0; i < SORTED_HEAP_ZONEMAP_CACHE_MAX; i++)
+			sorted_heap_entry_clear(&pending->entries[i]);
 	}
+	return pending;
 }
 
+/* Record that this transaction widened info's entry idx by by */
 static void
-sorted_heap_relation_copy_for_cluster(Relation OldTable,
-									  Relation NewTable,
-									  Relation OldIndex,
-									  bool use_sort,
-									  TransactionId OldestXmin,
-									  TransactionId *xid_cutoff,
-									  MultiXactId *multi_cutoff,
-									  double *num_tuples,
-									  double *tups_vacuumed,
-									  double *tups_recently_dead)
+sorted_heap_zonemap_defer(Relation rel, SortedHeapRelInfo *info, uint32 idx,
+						  const SortedHeapZoneMapEntry *by)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
-	SortedHeapRelInfo *old_info;
+	SortedHeapZmPending *pending = sorted_heap_zonemap_pending_entry(rel);
 
-	/* Let heap copy data (sorted by OldIndex if use_sort) */
-	heap->relation_copy_for_cluster(OldTable, NewTable, OldIndex,
-									use_sort, OldestXmin,
-									xid_cutoff, multi_cutoff,
-									num_tuples, tups_vacuumed,
-									tups_recently_dead);
+	Assert(idx < SORTED_HEAP_ZONEMAP_CACHE_MAX);
 
-	/*
-	 * Rebuild zone map on NewTable from actual page contents.
-	 * NewTable has no indexes yet (PG rebuilds them after this callback),
-	 * so we get PK metadata from OldTable which has the same schema.
-	 */
-	old_info = sorted_heap_get_relinfo(OldTable);
-	if (old_info->zm_usable)
-		sorted_heap_rebuild_zonemap_internal(NewTable,
-											 old_info->zm_pk_typid,
-											 old_info->attNums[0],
-											 old_info->zm_pk_typid2,
-											 old_info->zm_col2_usable ?
-											 old_info->attNums[1] : 0);
+	(void) sorted_heap_entry_merge(&pending->entries[idx], by);
+	info->zm_sorted = false;
 }
 
-/* ----------------------------------------------------------------
- *  Sorted multi_insert
- *
- *  If a PK exists, sort the incoming batch of slot pointers by PK
- *  using qsort_arg + SortSupport, then delegate to heap's
- *  multi_insert.  After placement, update zone map with per-page
- *  min/max of the first PK column.
- * ---------------------------------------------------------------- */
-
-/* Comparison context passed through qsort_arg */
-typedef struct SortedHeapCmpCtx
+/* Whether this transaction has deferred entries for relid */
+static bool
+sorted_heap_zonemap_has_pending(Oid relid)
 {
-	SortedHeapRelInfo *info;
-	SortSupportData   *sortKeys;
-} SortedHeapCmpCtx;
+	return sorted_heap_pending_hash != NULL &&
+		hash_search(sorted_heap_pending_hash, &relid, HASH_FIND,
+					NULL) != NULL;
+}
 
-static int
-sorted_heap_cmp_slots(const void *a, const void *b, void *arg)
+/*
+ * Re-widen a freshly read or adopted copy of the zone map by this
+ * transaction's deferred entries.  True if any entry changed.
+ */
+static bool
+sorted_heap_zonemap_apply_pending(SortedHeapRelInfo *info)
 {
-	SortedHeapCmpCtx *ctx = (SortedHeapCmpCtx *) arg;
-	TupleTableSlot *sa = *(TupleTableSlot *const *) a;
-	TupleTableSlot *sb = *(TupleTableSlot *const *) b;
-	int		i;
+	SortedHeapZmPending *pending;
+	bool		changed = false;
 
-	for (i = 0; i < ctx->info->nkeys; i++)
-	{
-		Datum	val1,
-				val2;
-		bool	null1,
-				null2;
-		int		cmp;
+	if (sorted_heap_pending_hash == NULL || !info->zm_loaded)
+		return false;
 
-		val1 = slot_getattr(sa, ctx->info->attNums[i], &null1);
-		val2 = slot_getattr(sb, ctx->info->attNums[i], &null2);
+	pending = hash_search(sorted_heap_pending_hash, &info->relid, HASH_FIND,
+						  NULL);
+	if (pending == NULL)
+		return false;
 
-		cmp = ApplySortComparator(val1, null1, val2, null2,
-								  &ctx->sortKeys[i]);
-		if (cmp != 0)
-			return cmp;
+	for (uint32 i = 0; i < info->zm_nentries; i++)
+	{
+		if (!sorted_heap_entry_merge(&info->zm_entries[i],
+									 &pending->entries[i]))
+			continue;
+		if (info->zm_super != NULL)
+			sorted_heap_superzone_widen(&info->zm_super[i / SORTED_HEAP_SUPERZONE_PAGES],
+										&info->zm_entries[i]);
+		changed = true;
 	}
-	return 0;
+	if (changed)
+		info->zm_sorted = false;
+	return changed;
 }
 
-static void
-sorted_heap_multi_insert(Relation rel, TupleTableSlot **slots,
-						 int nslots, CommandId cid, int options,
-						 struct BulkInsertStateData *bistate)
+/*
+ * Parallel queries.  A worker's zone map comes from disk or the shared
+ * copy, neither of which has the leader's deferred entries, so it would
+ * prune pages holding rows the leader's transaction placed.  The leader
+ * copies its entries into the scan's DSM segment (pending_size bytes,
+ * 0 if it has none) and each worker adopts them as its own, so that
+ * every copy it loads or revalidates is widened by them too.  Workers
+ * never write them: only XACT_EVENT_PRE_COMMIT does.
+ */
+Size
+sorted_heap_zonemap_pending_size(Relation rel)
 {
-	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
-	SortedHeapRelInfo *info;
+	if (!sorted_heap_zonemap_has_pending(RelationGetRelid(rel)))
+		return 0;
+	return SORTED_HEAP_ZONEMAP_CACHE_MAX * sizeof(SortedHeapZoneMapEntry);
+}
 
-	info = sorted_heap_get_relinfo(rel);
+void
+sorted_heap_zonemap_pending_save(Relation rel, SortedHeapZoneMapEntry *dest)
+{
+	Oid			relid = RelationGetRelid(rel);
+	SortedHeapZmPending *pending;
 
-	/* Phase 2: sort batch by PK */
-	if (OidIsValid(info->pk_index_oid) && nslots > 1)
-	{
-		SortSupportData *sortKeys;
-		SortedHeapCmpCtx ctx;
-		int				i;
+	pending = hash_search(sorted_heap_pending_hash, &relid, HASH_FIND, NULL);
+	Assert(pending != NULL);
+	memcpy(dest, pending->entries,
+		   SORTED_HEAP_ZONEMAP_CACHE_MAX * sizeof(SortedHeapZoneMapEntry));
+}
 
-		sortKeys = palloc0(sizeof(SortSupportData) * info->nkeys);
-		for (i = 0; i < info->nkeys; i++)
-		{
-			sortKeys[i].ssup_cxt = CurrentMemoryContext;
-			sortKeys[i].ssup_collation = info->sortCollations[i];
-			sortKeys[i].ssup_nulls_first = info->nullsFirst[i];
-			sortKeys[i].ssup_attno = info->attNums[i];
-			PrepareSortSupportFromOrderingOp(info->sortOperators[i],
-											  &sortKeys[i]);
-		}
+void
+sorted_heap_zonemap_pending_adopt(Relation rel,
+								  const SortedHeapZoneMapEntry *src)
+{
+	SortedHeapZmPending *pending = sorted_heap_zonemap_pending_entry(rel);
+	SortedHeapRelInfo *info;
 
-		ctx.info = info;
-		ctx.sortKeys = sortKeys;
+	for (int i = 0; i < SORTED_HEAP_ZONEMAP_CACHE_MAX; i++)
+		(void) sorted_heap_entry_merge(&pending->entries[i], &src[i]);
 
-		qsort_arg(slots, nslots, sizeof(TupleTableSlot *),
-				   sorted_heap_cmp_slots, &ctx);
+	/* The copy the scan already holds was loaded without them */
+	info = sorted_heap_get_relinfo(rel);
+	sorted_heap_zonemap_lock(info);
+	(void) sorted_heap_zonemap_apply_pending(info);
+	sorted_heap_zonemap_unlock(info);
+}
 
-		pfree(sortKeys);
-	}
+/*
+ * Merge pending's entries into rel's meta page.  Nothing is logged if
+ * the page already covers them (a flush or rebuild got there first).
+ */
+static void
+sorted_heap_zonemap_write_pending(Relation rel, SortedHeapZmPending *pending)
+{
+	Buffer		metabuf;
+	xl_sorted_heap_meta_entries hdr;
+	SortedHeapZoneMapEntry *ents;
 
-	/* Delegate to heap */
-	heap->multi_insert(rel, slots, nslots, cid, options, bistate);
+	/* Truncated or rewritten since: the new file has its own zone map */
+	if (rel->rd_locator.relNumber != pending->relnumber ||
+		RelationGetNumberOfBlocks(rel) <= SORTED_HEAP_META_BLOCK)
+		return;
 
-	/* Phase 3: update zone map from placed tuples */
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	ents = palloc(SORTED_HEAP_ZONEMAP_CACHE_MAX * sizeof(SortedHeapZoneMapEntry));
+
+	/*
+	 * Committers whose rows share zones usually find an earlier one has
+	 * covered them; a share lock is enough to see that, so they do not
+	 * queue for the exclusive one.
+	 */
+	for (int mode = BUFFER_LOCK_SHARE;; mode = BUFFER_LOCK_EXCLUSIVE)
+	{
+		bool		changed = false;
+
+		LockBuffer(metabuf, mode);
+		if (sorted_heap_meta_get_entries(BufferGetPage(metabuf), &hdr,
+										 ents) > 0)
+		{
+			for (uint16 i = 0; i < hdr.nentries; i++)
+				changed |= sorted_heap_entry_merge(&ents[i],
+												   &pending->entries[i]);
+		}
+		if (changed && mode == BUFFER_LOCK_EXCLUSIVE)
+		{
+			hdr.flags &= ~SHM_FLAG_ZM_SORTED;
+			(void) sorted_heap_meta_write(rel, metabuf, &hdr, ents);
+		}
+		if (!changed || mode == BUFFER_LOCK_EXCLUSIVE)
+			break;
+		LockBuffer(metabuf, BUFFER_LOCK_UNLOCK);
+	}
+	pfree(ents);
+	UnlockReleaseBuffer(metabuf);
+}
+
+/*
+ * Transaction callback: write deferred entries before the commit (or
+ * PREPARE) record, so that no committed row is ever outside its page's
+ * entry on disk.  On abort they are simply dropped; the cached copy
+ * stays wider than needed, which only costs pruning.
+ */
+void
+sorted_heap_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PRE_PREPARE:
+			if (sorted_heap_pending_hash != NULL)
+			{
+				HASH_SEQ_STATUS status;
+				SortedHeapZmPending *pending;
+
+				hash_seq_init(&status, sorted_heap_pending_hash);
+				while ((pending = hash_seq_search(&status)) != NULL)
+				{
+					Relation	rel;
+					SortedHeapRelInfo *info = NULL;
+
+					/* We still hold the lock taken to modify it */
+					rel = try_relation_open(pending->relid, NoLock);
+					if (rel == NULL)
+						continue;	/* dropped by this transaction */
+					sorted_heap_zonemap_write_pending(rel, pending);
+					relation_close(rel, NoLock);
+
+					/* Make sure the shared copy has them too */
+					if (sorted_heap_relinfo_hash != NULL)
+						info = hash_search(sorted_heap_relinfo_hash,
+										   &pending->relid, HASH_FIND, NULL);
+					if (info != NULL && info->zm_shared != NULL)
+					{
+						sorted_heap_zonemap_lock(info);
+						(void) sorted_heap_zonemap_apply_pending(info);
+						sorted_heap_zonemap_unlock(info);
+					}
+				}
+			}
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			/* Freed with TopTransactionContext */
+			sorted_heap_pending_hash = NULL;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *  Zone map rebuild — full table scan
+ *
+ *  Scans all tuples in a relation, computes per-page min/max of the
+ *  first PK column, and writes the result to the meta page.  Used by
+ *  relation_copy_for_cluster (CLUSTER path) and the standalone
+ *  sorted_heap_rebuild_zonemap() SQL function.
+ * ---------------------------------------------------------------- */
+void
+sorted_heap_rebuild_zonemap_internal(Relation rel, Oid pk_typid,
+									 AttrNumber pk_attnum,
+									 Oid pk_typid2,
+									 AttrNumber pk_attnum2)
+{
+	SortedHeapZoneMapEntry *entries;
+	uint32			nentries = 0;
+	uint32			max_entries;
+	uint32			alloc_entries;
+	TableScanDesc	scan;
+	TupleTableSlot *slot;
+	Buffer			metabuf;
+	Page			metapage;
+	GenericXLogState *gxlog_state;
+	SortedHeapMetaPageData *meta;
+	uint16			meta_nentries;
+	uint32			overflow_npages = 0;
+	SortedHeapOverflowExtent overflow_dir[SORTED_HEAP_META_OVERFLOW_EXTENTS];
+	bool			track_col2 = OidIsValid(pk_typid2);
+	bool			packed = false;
+	uint32			zone_pages;
+
+	/* Only supported PK types get zone maps.
+	 * Cannot probe with sorted_heap_key_to_int64(Int32GetDatum(0), ...)
+	 * because pointer-based types (UUID, text) would dereference NULL. */
+	switch (pk_typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case DATEOID:
+		case UUIDOID:
+		case TEXTOID:
+		case VARCHAROID:
+			break;		/* supported */
+		default:
+			return;		/* not supported */
+	}
+
+	/*
+	 * Dynamic allocation: start with a reasonable initial size, grow as needed.
+	 * No hard cap — zone map covers all data pages in the relation.
+	 */
+	alloc_entries = Max(SORTED_HEAP_ZONEMAP_MAX +
+						(uint32) SORTED_HEAP_META_OVERFLOW_SLOTS *
+						SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
+						1024);
+	max_entries = alloc_entries;
+
+	entries = (SortedHeapZoneMapEntry *)
+		palloc(max_entries * sizeof(SortedHeapZoneMapEntry));
+
+	/* Initialize to sentinel */
+	for (uint32 i = 0; i < max_entries; i++)
+	{
+		entries[i].zme_min = PG_INT64_MAX;
+		entries[i].zme_max = PG_INT64_MIN;
+		entries[i].zme_min2 = PG_INT64_MAX;
+		entries[i].zme_max2 = PG_INT64_MIN;
+	}
+
+	/* Scan all tuples, build per-zone min/max */
+	zone_pages = sorted_heap_meta_zone_pages(rel);
+	slot = table_slot_create(rel, NULL);
+	scan = table_beginscan(rel, SnapshotAny, 0, NULL);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		BlockNumber		blk;
+		uint32			zmidx;
+		Datum			val;
+		bool			isnull;
+		int64			key;
+		SortedHeapZoneMapEntry *e;
+
+		blk = ItemPointerGetBlockNumber(&slot->tts_tid);
+		if (blk < 1)
+			continue;			/* skip meta page */
+		zmidx = (blk - 1) / zone_pages;
+
+		/* Grow entries array if needed */
+		if (zmidx >= max_entries)
+		{
+			uint32	new_max = Max(max_entries * 2, zmidx + 1);
+
+			entries = (SortedHeapZoneMapEntry *)
+				repalloc(entries, new_max * sizeof(SortedHeapZoneMapEntry));
+
+			for (uint32 i = max_entries; i < new_max; i++)
+			{
+				entries[i].zme_min = PG_INT64_MAX;
+				entries[i].zme_max = PG_INT64_MIN;
+				entries[i].zme_min2 = PG_INT64_MAX;
+				entries[i].zme_max2 = PG_INT64_MIN;
+			}
+			max_entries = new_max;
+		}
+
+		val = slot_getattr(slot, pk_attnum, &isnull);
+		if (isnull)
+			continue;
+		if (!sorted_heap_key_to_int64(val, pk_typid, &key))
+			continue;
+
+		e = &entries[zmidx];
+		if (e->zme_min == PG_INT64_MAX)
+		{
+			e->zme_min = key;
+			e->zme_max = key;
+		}
+		else
+		{
+			if (key < e->zme_min)
+				e->zme_min = key;
+			if (key > e->zme_max)
+				e->zme_max = key;
+		}
+
+		/* Track column 2 min/max */
+		if (track_col2)
+		{
+			Datum	val2;
+			bool	isnull2;
+			int64	key2;
+
+			val2 = slot_getattr(slot, pk_attnum2, &isnull2);
+			if (!isnull2 &&
+				sorted_heap_key_to_int64(val2, pk_typid2, &key2))
+			{
+				if (e->zme_min2 == PG_INT64_MAX)
+				{
+					e->zme_min2 = key2;
+					e->zme_max2 = key2;
+				}
+				else
+				{
+					if (key2 < e->zme_min2)
+						e->zme_min2 = key2;
+					if (key2 > e->zme_max2)
+						e->zme_max2 = key2;
+				}
+			}
+		}
+
+		if (zmidx >= nentries)
+			nentries = zmidx + 1;
+	}
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	/* Split entries: first 250 go to meta page, rest to overflow pages */
+	meta_nentries = Min(nentries, SORTED_HEAP_ZONEMAP_MAX);
+
+	/* Initialize overflow directory */
+	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+	{
+		overflow_dir[i].soe_start = InvalidBlockNumber;
+		overflow_dir[i].soe_npages = 0;
+	}
+
+	/*
+	 * Create overflow pages if needed (v7: one run of consecutive pages,
+	 * recorded in the meta page's directory; no hard cap), followed by the
+	 * super-zone summary pages.  Holding the extension lock keeps
+	 * concurrent inserts from extending the relation in between, so the
+	 * run stays contiguous.  Overflow pages are packed (v8) if every one
+	 * of them fits.
+	 */
+	if (nentries > SORTED_HEAP_ZONEMAP_MAX)
+	{
+		uint32		overflow_entries = nentries - SORTED_HEAP_ZONEMAP_MAX;
+		uint32		per_page;
+		uint32		nsuper;
+		uint32		super_npages;
+		SortedHeapZoneMapEntry *super;
+		SMgrRelation srel;
+		BlockNumber	next_blk;
+		RelFileLocator rlocator = rel->rd_locator;
+		PGAlignedBlock scratch;
+
+		packed = true;
+		for (uint32 start = SORTED_HEAP_ZONEMAP_MAX;
+			 packed && start < nentries;
+			 start += SORTED_HEAP_PACKED_ENTRIES_PER_PAGE)
+			packed = sorted_heap_pack_overflow(&entries[start],
+											   Min(SORTED_HEAP_PACKED_ENTRIES_PER_PAGE,
+												   nentries - start),
+											   track_col2,
+											   (SortedHeapPackedOverflowPageData *) scratch.data);
+		per_page = packed ? SORTED_HEAP_PACKED_ENTRIES_PER_PAGE :
+			SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+
+		overflow_npages = (overflow_entries + per_page - 1) / per_page;
+
+		nsuper = (nentries + SORTED_HEAP_SUPERZONE_PAGES - 1) /
+			SORTED_HEAP_SUPERZONE_PAGES;
+		super_npages = (nsuper + SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE - 1) /
+			SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		super = (SortedHeapZoneMapEntry *)
+			palloc(nsuper * sizeof(SortedHeapZoneMapEntry));
+		for (uint32 i = 0; i < nsuper; i++)
+		{
+			super[i].zme_min = PG_INT64_MAX;
+			super[i].zme_max = PG_INT64_MIN;
+			super[i].zme_min2 = PG_INT64_MAX;
+			super[i].zme_max2 = PG_INT64_MIN;
+		}
+		for (uint32 i = 0; i < nentries; i++)
+			sorted_heap_superzone_widen(&super[i / SORTED_HEAP_SUPERZONE_PAGES],
+										&entries[i]);
+
+		LockRelationForExtension(rel, ExclusiveLock);
+		srel = RelationGetSmgr(rel);
+		next_blk = smgrnblocks(srel, MAIN_FORKNUM);
+		overflow_dir[0].soe_start = next_blk;
+		overflow_dir[0].soe_npages = overflow_npages + super_npages;
+
+		for (uint32 p = 0; p < overflow_npages + super_npages; p++)
+		{
+			PGAlignedBlock	aligned_buf;
+			Page			ovfl_page;
+			bool			is_super = (p >= overflow_npages);
+			SortedHeapZoneMapEntry *src = is_super ? super : entries;
+			uint32			start = is_super ?
+				(p - overflow_npages) * SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE :
+				SORTED_HEAP_ZONEMAP_MAX + p * per_page;
+			uint32			count = Min(is_super ?
+										SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE :
+										per_page,
+										(is_super ? nsuper : nentries) - start);
+
+			ovfl_page = (Page) aligned_buf.data;
+			/* Chain kept for readers that walk it; summaries are not on it */
+			if (!sorted_heap_overflow_page_init(ovfl_page, &src[start], count, p,
+												packed && !is_super, track_col2,
+												(p + 1 < overflow_npages) ?
+												next_blk + 1 : InvalidBlockNumber))
+				elog(ERROR, "zone map overflow page %u no longer packs", p);
+
+			/* WAL-log, then checksum, then write */
+			log_newpage(&rlocator, MAIN_FORKNUM, next_blk,
+						ovfl_page, true);
+			PageSetChecksumInplace(ovfl_page, next_blk);
+			smgrextend(srel, MAIN_FORKNUM, next_blk,
+					   aligned_buf.data, false);
+
+			next_blk++;
+		}
+
+		UnlockRelationForExtension(rel, ExclusiveLock);
+		pfree(super);
+	}
+
+	/* Write zone map to meta page */
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+
+	gxlog_state = GenericXLogStart(rel);
+	metapage = GenericXLogRegisterBuffer(gxlog_state, metabuf, 0);
+	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+	meta->shm_zonemap_nentries = meta_nentries;
+	meta->shm_zonemap_pk_typid = pk_typid;
+	meta->shm_zonemap_pk_typid2 = pk_typid2;
+	meta->shm_flags |= SHM_FLAG_ZONEMAP_VALID;
+	meta->shm_flags &= ~SHM_FLAG_ZM_TAIL_UNSORTED;
+	if (packed)
+		meta->shm_flags |= SHM_FLAG_ZM_PACKED;
+	else
+		meta->shm_flags &= ~SHM_FLAG_ZM_PACKED;
+
+	/* Check if entries are monotonically sorted (enables binary search) */
+	{
+		bool	is_sorted = true;
+		int64	prev_max = PG_INT64_MIN;
+
+		for (uint32 j = 0; j < nentries && is_sorted; j++)
+		{
+			if (entries[j].zme_min == PG_INT64_MAX)
+				continue;			/* skip empty pages */
+			if (entries[j].zme_min < prev_max)
+				is_sorted = false;
+			prev_max = entries[j].zme_max;
+		}
+		if (is_sorted)
+			meta->shm_flags |= SHM_FLAG_ZM_SORTED;
+		else
+			meta->shm_flags &= ~SHM_FLAG_ZM_SORTED;
+	}
+
+	memcpy(meta->shm_zonemap, entries,
+		   meta_nentries * sizeof(SortedHeapZoneMapEntry));
+
+	/* Write overflow directory; this also brings older meta pages to v7 */
+	StaticAssertStmt(sizeof(overflow_dir) ==
+					 sizeof(meta->shm_overflow_blocks),
+					 "overflow directory must fill the meta page's slots");
+	meta->shm_version = SORTED_HEAP_VERSION;
+	meta->shm_overflow_npages = (overflow_npages > 0) ? 1 : 0;
+	meta->shm_overflow_nentries = (nentries > SORTED_HEAP_ZONEMAP_MAX) ?
+		nentries - SORTED_HEAP_ZONEMAP_MAX : 0;
+	memcpy(meta->shm_overflow_blocks, overflow_dir, sizeof(overflow_dir));
+
+	GenericXLogFinish(gxlog_state);
+	UnlockReleaseBuffer(metabuf);
+
+	pfree(entries);
+
+	/* Invalidate relinfo cache so next access re-reads */
+	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+}
+
+/* ----------------------------------------------------------------
+ *  Meta page initialization via smgr
+ *
+ *  During relation_set_new_filelocator (CREATE TABLE / TRUNCATE),
+ *  rel->rd_locator still points to the OLD filenode.  We bypass the
+ *  buffer manager and write the meta page directly to the correct
+ *  locator using smgrextend + log_newpage.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_init_meta_page_smgr(const RelFileLocator *rlocator,
+								ProcNumber backend, bool need_wal,
+								uint32 zone_pages)
+{
+	SMgrRelation		srel;
+	PGAlignedBlock		buf;
+	Page				page;
+	SortedHeapMetaPageData *meta;
+	RelFileLocator		rlocator_copy;
+
+	srel = smgropen(*rlocator, backend);
+
+	page = (Page) buf.data;
+	PageInit(page, BLCKSZ, sizeof(SortedHeapMetaPageData));
+
+	/* Mark page as full so heap never tries to use block 0 for data */
+	((PageHeader) page)->pd_lower = ((PageHeader) page)->pd_upper;
+
+	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(page);
+	meta->shm_magic = SORTED_HEAP_MAGIC;
+	meta->shm_version = SORTED_HEAP_VERSION;
+	meta->shm_flags = (zone_pages > 1) ? zone_pages << SHM_ZONE_PAGES_SHIFT : 0;
+	meta->shm_pk_index_oid = InvalidOid;
+	meta->shm_zonemap_nentries = 0;
+	meta->shm_overflow_npages = 0;
+	meta->shm_zonemap_pk_typid = InvalidOid;
+	meta->shm_zonemap_pk_typid2 = InvalidOid;
+	meta->shm_overflow_nentries = 0;
+
+	/* Initialize zone map entries to sentinel */
+	for (int i = 0; i < SORTED_HEAP_ZONEMAP_MAX; i++)
+	{
+		meta->shm_zonemap[i].zme_min = PG_INT64_MAX;
+		meta->shm_zonemap[i].zme_max = PG_INT64_MIN;
+		meta->shm_zonemap[i].zme_min2 = PG_INT64_MAX;
+		meta->shm_zonemap[i].zme_max2 = PG_INT64_MIN;
+	}
+
+	/* Initialize overflow block pointers */
+	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_SLOTS; i++)
+		meta->shm_overflow_blocks[i] = InvalidBlockNumber;
+
+	/* WAL-log first (sets LSN on page), then checksum, then write */
+	if (need_wal)
+	{
+		rlocator_copy = *rlocator;
+		log_newpage(&rlocator_copy, MAIN_FORKNUM,
+					SORTED_HEAP_META_BLOCK, page, true);
+	}
+
+	PageSetChecksumInplace(page, SORTED_HEAP_META_BLOCK);
+	smgrextend(srel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+			   buf.data, false);
+}
+
+/* ----------------------------------------------------------------
+ *  Zone granularity
+ *
+ *  Pages per zone map entry live in the meta page's flags, so they
+ *  survive reloads; rewrites (TRUNCATE, CLUSTER, merge, online compact)
+ *  carry them over to the new storage.
+ * ---------------------------------------------------------------- */
+
+/* Pages per zone map entry recorded on rel's meta page (1 if none) */
+uint32
+sorted_heap_meta_zone_pages(Relation rel)
+{
+	SMgrRelation srel = RelationGetSmgr(rel);
+	Buffer		metabuf;
+	SortedHeapMetaPageData *meta;
+	uint32		zone_pages = 1;
+
+	if (!smgrexists(srel, MAIN_FORKNUM) ||
+		smgrnblocks(srel, MAIN_FORKNUM) <= SORTED_HEAP_META_BLOCK)
+		return 1;
+
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(BufferGetPage(metabuf));
+	if (meta->shm_magic == SORTED_HEAP_MAGIC && meta->shm_version >= 5)
+		zone_pages = Max((meta->shm_flags & SHM_ZONE_PAGES_MASK) >>
+						 SHM_ZONE_PAGES_SHIFT, 1);
+	UnlockReleaseBuffer(metabuf);
+
+	return zone_pages;
+}
+
+/*
+ * Record a new zone granularity on rel's meta page.  The entries there
+ * describe the old one, so the zone map is marked invalid in the same
+ * record; callers rebuild it.
+ */
+void
+sorted_heap_set_zone_pages(Relation rel, uint32 zone_pages)
+{
+	Buffer		metabuf;
+	GenericXLogState *state;
+	SortedHeapMetaPageData *meta;
+
+	Assert(zone_pages >= 1 && zone_pages <= SORTED_HEAP_ZONE_PAGES_MAX);
+
+	if (sorted_heap_meta_zone_pages(rel) == zone_pages)
+		return;
+
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+
+	state = GenericXLogStart(rel);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(GenericXLogRegisterBuffer(state, metabuf, 0));
+	meta->shm_flags &= ~(SHM_ZONE_PAGES_MASK | SHM_FLAG_ZONEMAP_VALID |
+						 SHM_FLAG_ZM_SORTED | SHM_FLAG_ZM_TAIL_UNSORTED);
+	if (zone_pages > 1)
+		meta->shm_flags |= zone_pages << SHM_ZONE_PAGES_SHIFT;
+	GenericXLogFinish(state);
+	UnlockReleaseBuffer(metabuf);
+
+	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+}
+
+/* ----------------------------------------------------------------
+ *  DDL lifecycle callbacks
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_relation_set_new_filelocator(Relation rel,
+										 const RelFileLocator *rlocator,
+										 char persistence,
+										 TransactionId *freezeXid,
+										 MultiXactId *minmulti)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	uint32		zone_pages = 1;
+
+	/* TRUNCATE keeps the zone granularity; CREATE TABLE has no old file */
+	if (!RelFileLocatorEquals(rel->rd_locator, *rlocator))
+		zone_pages = sorted_heap_meta_zone_pages(rel);
+
+	heap->relation_set_new_filelocator(rel, rlocator, persistence,
+									   freezeXid, minmulti);
+
+	/* Write meta page to the NEW file using its locator directly */
+	sorted_heap_init_meta_page_smgr(rlocator, rel->rd_backend,
+									persistence == RELPERSISTENCE_PERMANENT,
+									zone_pages);
+
+	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+}
+
+static void
+sorted_heap_relation_nontransactional_truncate(Relation rel)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+
+	heap->relation_nontransactional_truncate(rel);
+	sorted_heap_relinfo_invalidate(RelationGetRelid(rel));
+}
+
+static void
+sorted_heap_relation_copy_data(Relation rel,
+							   const RelFileLocator *newrlocator)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+
+	heap->relation_copy_data(rel, newrlocator);
+}
+
+/* ----------------------------------------------------------------
+ *  Vacuum callback — delegate to heap, then rebuild zone map if invalid
+ *  or if pages past it are being read unpruned
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_relation_vacuum(Relation rel, struct VacuumParams *params,
+							BufferAccessStrategy bstrategy)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+
+	/* Step 1: delegate to heap vacuum (actual tuple cleanup) */
+	heap->relation_vacuum(rel, params, bstrategy);
+
+	/* Step 2: rebuild zone map if invalid or short and GUC enabled */
+	if (sorted_heap_vacuum_rebuild_zonemap &&
+		RelationGetNumberOfBlocks(rel) > SORTED_HEAP_META_BLOCK)
+	{
+		Buffer		metabuf;
+		Page		metapage;
+		SortedHeapMetaPageData *meta;
+		bool		need_rebuild = false;
+
+		metabuf = ReadBufferExtended(rel, MAIN_FORKNUM,
+									 SORTED_HEAP_META_BLOCK, RBM_NORMAL,
+									 NULL);
+		LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+		metapage = BufferGetPage(metabuf);
+		meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+
+		if (meta->shm_magic == SORTED_HEAP_MAGIC &&
+			(!(meta->shm_flags & SHM_FLAG_ZONEMAP_VALID) ||
+			 (meta->shm_flags & SHM_FLAG_ZM_TAIL_UNSORTED)))
+			need_rebuild = true;
+
+		UnlockReleaseBuffer(metabuf);
+
+		if (need_rebuild)
+		{
+			SortedHeapRelInfo *info = sorted_heap_get_relinfo(rel);
+
+			if (info->zm_usable)
+				sorted_heap_rebuild_zonemap_internal(rel,
+					info->zm_pk_typid, info->attNums[0],
+					info->zm_col2_usable ? info->zm_pk_typid2 : InvalidOid,
+					info->zm_col2_usable ? info->attNums[1] : 0);
+		}
+	}
+}
+
+static void
+sorted_heap_relation_copy_for_cluster(Relation OldTable,
+									  Relation NewTable,
+									  Relation OldIndex,
+									  bool use_sort,
+									  TransactionId OldestXmin,
+									  TransactionId *xid_cutoff,
+									  MultiXactId *multi_cutoff,
+									  double *num_tuples,
+									  double *tups_vacuumed,
+									  double *tups_recently_dead)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	SortedHeapRelInfo *old_info;
+
+	/* Let heap copy data (sorted by OldIndex if use_sort) */
+	heap->relation_copy_for_cluster(OldTable, NewTable, OldIndex,
+									use_sort, OldestXmin,
+									xid_cutoff, multi_cutoff,
+									num_tuples, tups_vacuumed,
+									tups_recently_dead);
+
+	/*
+	 * Rebuild zone map on NewTable from actual page contents.
+	 * NewTable has no indexes yet (PG rebuilds them after this callback),
+	 * so we get PK metadata from OldTable which has the same schema.
+	 */
+	old_info = sorted_heap_get_relinfo(OldTable);
+	sorted_heap_set_zone_pages(NewTable, sorted_heap_meta_zone_pages(OldTable));
+	if (old_info->zm_usable)
+		sorted_heap_rebuild_zonemap_internal(NewTable,
+											 old_info->zm_pk_typid,
+											 old_info->attNums[0],
+											 old_info->zm_pk_typid2,
+											 old_info->zm_col2_usable ?
+											 old_info->attNums[1] : 0);
+}
+
+/* ----------------------------------------------------------------
+ *  Sorted multi_insert
+ *
+ *  If a PK exists, sort the incoming batch of slot pointers by PK
+ *  using qsort_arg + SortSupport, then delegate to heap's
+ *  multi_insert.  After placement, update zone map with per-page
+ *  min/max of the first PK column.
+ * ---------------------------------------------------------------- */
+
+/* Comparison context passed through qsort_arg */
+typedef struct SortedHeapCmpCtx
+{
+	SortedHeapRelInfo *info;
+	SortSupportData   *sortKeys;
+} SortedHeapCmpCtx;
+
+static int
+sorted_heap_cmp_slots(const void *a, const void *b, void *arg)
+{
+	SortedHeapCmpCtx *ctx = (SortedHeapCmpCtx *) arg;
+	TupleTableSlot *sa = *(TupleTableSlot *const *) a;
+	TupleTableSlot *sb = *(TupleTableSlot *const *) b;
+	int		i;
+
+	for (i = 0; i < ctx->info->nkeys; i++)
+	{
+		Datum	val1,
+				val2;
+		bool	null1,
+				null2;
+		int		cmp;
+
+		val1 = slot_getattr(sa, ctx->info->attNums[i], &null1);
+		val2 = slot_getattr(sb, ctx->info->attNums[i], &null2);
+
+		cmp = ApplySortComparator(val1, null1, val2, null2,
+								  &ctx->sortKeys[i]);
+		if (cmp != 0)
+			return cmp;
+	}
+	return 0;
+}
+
+static void
+sorted_heap_multi_insert(Relation rel, TupleTableSlot **slots,
+						 int nslots, CommandId cid, int options,
+						 struct BulkInsertStateData *bistate)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	SortedHeapRelInfo *info;
+
+	info = sorted_heap_get_relinfo(rel);
+
+	/* Phase 2: sort batch by PK */
+	if (OidIsValid(info->pk_index_oid) && nslots > 1)
+	{
+		SortSupportData *sortKeys;
+		SortedHeapCmpCtx ctx;
+		int				i;
+
+		sortKeys = palloc0(sizeof(SortSupportData) * info->nkeys);
+		for (i = 0; i < info->nkeys; i++)
+		{
+			sortKeys[i].ssup_cxt = CurrentMemoryContext;
+			sortKeys[i].ssup_collation = info->sortCollations[i];
+			sortKeys[i].ssup_nulls_first = info->nullsFirst[i];
+			sortKeys[i].ssup_attno = info->attNums[i];
+			PrepareSortSupportFromOrderingOp(info->sortOperators[i],
+											  &sortKeys[i]);
+		}
+
+		ctx.info = info;
+		ctx.sortKeys = sortKeys;
+
+		qsort_arg(slots, nslots, sizeof(TupleTableSlot *),
+				   sorted_heap_cmp_slots, &ctx);
+
+		pfree(sortKeys);
+	}
+
+	/* Delegate to heap */
+	heap->multi_insert(rel, slots, nslots, cid, options, bistate);
+
+	/*
+	 * Phase 3: update zone map from placed tuples.  Keys are read and
+	 * summed up per zone before the lock is taken, so it is held for a
+	 * few entries rather than the whole batch.  While the zone map is
+	 * valid for pruning, zones past the meta page's entries are covered
+	 * after the loop: appended from their pages while the meta page has
+	 * room, else widened in or appended to the overflow run.  If another
+	 * backend extended the run meanwhile, the batch is noted again
+	 * against the reloaded zone map.
+	 */
 	if (info->zm_usable)
 	{
-		bool	zm_dirty = false;
-		int		i;
+		uint32	zone_pages;
+		uint32 *zones;
+		SortedHeapZoneMapEntry *zone_by;
+		int		nzones = 0;
+		int		i;
+
+		if (!info->zm_loaded)
+			sorted_heap_zonemap_attach(rel, info);
+
+		/* Rows come sorted, so a zone's rows are mostly adjacent */
+		zone_pages = info->zm_zone_pages;
+		zones = palloc(nslots * sizeof(uint32));
+		zone_by = palloc(nslots * sizeof(SortedHeapZoneMapEntry));
+		for (i = 0; info->zm_loaded && i < nslots; i++)
+		{
+			BlockNumber	blk = ItemPointerGetBlockNumber(&slots[i]->tts_tid);
+			uint32		zmidx;
+
+			if (blk < 1)
+				continue;		/* skip meta page */
+			zmidx = sorted_heap_zone_of_block(info, blk);
+			if (nzones == 0 || zones[nzones - 1] != zmidx)
+			{
+				zones[nzones] = zmidx;
+				sorted_heap_entry_clear(&zone_by[nzones]);
+				nzones++;
+			}
+			(void) sorted_heap_entry_widen(info, &zone_by[nzones - 1],
+										   slots[i]);
+		}
+
+		for (;;)
+		{
+			bool	zm_dirty = false;
+			bool	zm_extend = false;
+			bool	zm_reload = false;
+			bool	zm_retry = false;
+			uint32	past_end = 0;
+			uint32	ovfl_first = PG_UINT32_MAX;
+			uint32	ovfl_end = 0;
+
+			sorted_heap_zonemap_lock(info);
+
+			/* Rebuilt with other zones meanwhile: the indexes are stale */
+			if (info->zm_loaded && info->zm_zone_pages != zone_pages)
+			{
+				sorted_heap_zonemap_invalidate(rel, info);
+				nzones = 0;
+			}
+
+			for (i = 0; info->zm_loaded && i < nzones; i++)
+			{
+				uint32					zmidx = zones[i];
+				SortedHeapZoneMapEntry *e;
+				bool					changed;
+
+				if (zmidx >= info->zm_nentries && info->zm_scan_valid)
+				{
+					if (zmidx < info->zm_total_entries)
+					{
+						ovfl_first = Min(ovfl_first, zmidx);
+						ovfl_end = Max(ovfl_end, zmidx + 1);
+					}
+					past_end = Max(past_end, zmidx + 1);
+					continue;
+				}
+				if (zmidx >= SORTED_HEAP_ZONEMAP_MAX)
+					continue;		/* beyond meta page capacity */
+				if (zone_by[i].zme_min == PG_INT64_MAX)
+					continue;		/* no trackable key */
+
+				e = &info->zm_entries[zmidx];
+				changed = sorted_heap_entry_merge(e, &zone_by[i]);
+				if (zmidx >= info->zm_nentries)
+				{
+					info->zm_nentries = zmidx + 1;
+					zm_dirty = true;		/* new entries are written now */
+				}
+				else if (!changed)
+					continue;
+				if (info->zm_super != NULL)
+					sorted_heap_superzone_widen(&info->zm_super[zmidx / SORTED_HEAP_SUPERZONE_PAGES],
+												e);
+				sorted_heap_zonemap_defer(rel, info, zmidx, &zone_by[i]);
+			}
+
+			if (zm_dirty)
+				sorted_heap_zonemap_flush(rel, info);
+
+			if (past_end > 0 && info->zm_loaded && info->zm_scan_valid)
+			{
+				if (info->zm_overflow_nentries == 0 &&
+					past_end <= SORTED_HEAP_ZONEMAP_MAX)
+					sorted_heap_zonemap_append(rel, info, past_end - 1);
+				else
+				{
+					SortedHeapZoneMapEntry *by = NULL;
+					uint32		n = 0;
+
+					if (ovfl_end > 0)
+					{
+						n = ovfl_end - ovfl_first;
+						by = palloc(n * sizeof(SortedHeapZoneMapEntry));
+						for (uint32 j = 0; j < n; j++)
+							sorted_heap_entry_clear(&by[j]);
+						for (i = 0; i < nzones; i++)
+						{
+							if (zones[i] >= ovfl_first && zones[i] < ovfl_end)
+								(void) sorted_heap_entry_merge(&by[zones[i] - ovfl_first],
+															   &zone_by[i]);
+						}
+					}
+					zm_extend = sorted_heap_zonemap_note_overflow(rel, info,
+																  ovfl_first, by,
+																  n, past_end);
+					if (by != NULL)
+						pfree(by);
+				}
+			}
+			sorted_heap_zonemap_unlock(info);
+
+			/*
+			 * Give the zones past the run entries of their own.  That reads
+			 * their pages, so it runs without the entry's lock: the meta
+			 * page lock orders it against every other overflow writer, and
+			 * it gives up if the run is no longer as info has it.  What it
+			 * cannot take is left to sorted_heap_zonemap_mark_tail.  If
+			 * another backend extended the run over these zones meanwhile,
+			 * they are noted again.
+			 */
+			if (zm_extend)
+			{
+				uint32		seen_total = info->zm_total_entries;
+
+				if (sorted_heap_zonemap_extend_overflow(rel, info, past_end))
+					zm_reload = true;
+				else
+				{
+					sorted_heap_zonemap_lock(info);
+					if (info->zm_loaded && info->zm_scan_valid)
+					{
+						if (info->zm_total_entries != seen_total)
+							zm_retry = true;
+						else if (!sorted_heap_zonemap_mark_tail(rel, info))
+							zm_reload = zm_retry = true;
+					}
+					sorted_heap_zonemap_unlock(info);
+				}
+			}
+
+			/* The overflow run grew: no copy of the zone map covers it */
+			if (zm_reload)
+			{
+				sorted_heap_zmcache_forget(RelationGetRelid(rel));
+				sorted_heap_zonemap_release(info);
+			}
+
+			if (!zm_retry)
+				break;
+
+			/* Another backend extended the run over some of these zones */
+			sorted_heap_zonemap_attach(rel, info);
+		}
+
+		pfree(zones);
+		pfree(zone_by);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *  Observability: sorted_heap_zonemap_stats(regclass) → text
+ * ---------------------------------------------------------------- */
+Datum
+sorted_heap_zonemap_stats(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	Relation	rel;
+	Buffer		metabuf;
+	Page		metapage;
+	SortedHeapMetaPageData *meta;
+	StringInfoData buf;
+	int			show;
+	uint32		on_disk_version;
+	uint16		on_disk_nentries;
+	uint16		on_disk_ovfl_npages;
+	SortedHeapZoneMapEntry first_entries[5];
+	int			n_first_entries;
+	BlockNumber	last_meta_ovfl_blk = InvalidBlockNumber;
+
+	rel = table_open(relid, AccessShareLock);
+
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+	metapage = BufferGetPage(metabuf);
+	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+
+	/* Save values before releasing buffer */
+	on_disk_version = meta->shm_version;
+
+	initStringInfo(&buf);
+	if (on_disk_version >= 5)
+	{
+		on_disk_nentries = meta->shm_zonemap_nentries;
+		on_disk_ovfl_npages = meta->shm_overflow_npages;
+
+		{
+			const char *flags_str;
+			uint32		f = meta->shm_flags;
+			bool		fv = (f & SHM_FLAG_ZONEMAP_VALID) != 0;
+			bool		fs = (f & SHM_FLAG_ZM_SORTED) != 0;
+
+			if (fv && fs)
+				flags_str = "valid,sorted";
+			else if (fv)
+				flags_str = "valid";
+			else if (fs)
+				flags_str = "sorted";
+			else
+				flags_str = "0";
+
+			appendStringInfo(&buf, "version=%u nentries=%u pk_typid=%u"
+							 " pk_typid2=%u flags=%s",
+							 meta->shm_version,
+							 (unsigned) meta->shm_zonemap_nentries,
+							 (unsigned) meta->shm_zonemap_pk_typid,
+							 (unsigned) meta->shm_zonemap_pk_typid2,
+							 flags_str);
+
+			/* v7: pages from the entry count, runs from the directory */
+			if (on_disk_version >= 7)
+			{
+				bool		packed = (on_disk_version >= 8 &&
+									  (f & SHM_FLAG_ZM_PACKED) != 0);
+				uint32		per_page = packed ?
+					SORTED_HEAP_PACKED_ENTRIES_PER_PAGE :
+					SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+
+				appendStringInfo(&buf, " overflow_pages=%u overflow_runs=%u%s",
+								 (unsigned) ((meta->shm_overflow_nentries +
+											  per_page - 1) / per_page),
+								 (unsigned) meta->shm_overflow_npages,
+								 packed ? " packed" : "");
+			}
+			else
+				appendStringInfo(&buf, " overflow_pages=%u",
+								 (unsigned) meta->shm_overflow_npages);
+
+			if ((f & SHM_ZONE_PAGES_MASK) >> SHM_ZONE_PAGES_SHIFT > 1)
+				appendStringInfo(&buf, " zone_pages=%u",
+								 (f & SHM_ZONE_PAGES_MASK) >> SHM_ZONE_PAGES_SHIFT);
+			if (f & SHM_FLAG_ZM_TAIL_UNSORTED)
+				appendStringInfoString(&buf, " tail_unsorted");
+		}
+
+		/* Save first entries and last overflow block for after release */
+		n_first_entries = Min(on_disk_nentries, 5);
+		memcpy(first_entries, meta->shm_zonemap,
+			   n_first_entries * sizeof(SortedHeapZoneMapEntry));
+
+		if (on_disk_version < 7 && on_disk_ovfl_npages > 0)
+			last_meta_ovfl_blk =
+				meta->shm_overflow_blocks[on_disk_ovfl_npages - 1];
+
+		UnlockReleaseBuffer(metabuf);
+
+		/* v6: count chain pages beyond meta slots */
+		if (on_disk_version == 6 && on_disk_ovfl_npages > 0 &&
+			last_meta_ovfl_blk != InvalidBlockNumber)
+		{
+			uint32		total_overflow = on_disk_ovfl_npages;
+			BlockNumber	next_blk;
+			Buffer		ovfl_buf;
+			Page		ovfl_page;
+			SortedHeapOverflowPageData *ovfl;
+
+			ovfl_buf = ReadBufferExtended(rel, MAIN_FORKNUM,
+										  last_meta_ovfl_blk,
+										  RBM_NORMAL, NULL);
+			LockBuffer(ovfl_buf, BUFFER_LOCK_SHARE);
+			ovfl_page = BufferGetPage(ovfl_buf);
+			ovfl = (SortedHeapOverflowPageData *)
+				PageGetSpecialPointer(ovfl_page);
+			next_blk = ovfl->shmo_next_block;
+			UnlockReleaseBuffer(ovfl_buf);
+
+			while (next_blk != InvalidBlockNumber)
+			{
+				total_overflow++;
+				ovfl_buf = ReadBufferExtended(rel, MAIN_FORKNUM,
+											  next_blk, RBM_NORMAL, NULL);
+				LockBuffer(ovfl_buf, BUFFER_LOCK_SHARE);
+				ovfl_page = BufferGetPage(ovfl_buf);
+				ovfl = (SortedHeapOverflowPageData *)
+					PageGetSpecialPointer(ovfl_page);
+				next_blk = ovfl->shmo_next_block;
+				UnlockReleaseBuffer(ovfl_buf);
+			}
+
+			if (total_overflow > on_disk_ovfl_npages)
+				appendStringInfo(&buf, " total_overflow_pages=%u",
+								 total_overflow);
+		}
+
+		/* Show first few entries */
+		for (int i = 0; i < n_first_entries; i++)
+		{
+			appendStringInfo(&buf, " [%d:" INT64_FORMAT ".." INT64_FORMAT,
+							 i + 1,
+							 first_entries[i].zme_min,
+							 first_entries[i].zme_max);
+			if (first_entries[i].zme_min2 != PG_INT64_MAX)
+				appendStringInfo(&buf, " c2:" INT64_FORMAT ".." INT64_FORMAT,
+								 first_entries[i].zme_min2,
+								 first_entries[i].zme_max2);
+			appendStringInfoChar(&buf, ']');
+		}
+	}
+	else
+	{
+		/* v4 format: read via v4 struct to avoid misaligned access */
+		SortedHeapMetaPageDataV4 *meta4 =
+			(SortedHeapMetaPageDataV4 *) meta;
+
+		appendStringInfo(&buf, "version=%u nentries=%u pk_typid=%u flags=%u"
+						 " overflow_pages=%u",
+						 meta4->shm_version,
+						 (unsigned) meta4->shm_zonemap_nentries,
+						 (unsigned) meta4->shm_zonemap_pk_typid,
+						 meta4->shm_flags,
+						 (meta4->shm_version >= 4) ?
+						 (unsigned) meta4->shm_overflow_npages : 0);
+
+		show = Min(meta4->shm_zonemap_nentries, 5);
+		for (int i = 0; i < show; i++)
+		{
+			appendStringInfo(&buf, " [%d:" INT64_FORMAT ".." INT64_FORMAT "]",
+							 i + 1,
+							 meta4->shm_zonemap[i].zme_min,
+							 meta4->shm_zonemap[i].zme_max);
+		}
+
+		UnlockReleaseBuffer(metabuf);
+	}
+
+	table_close(rel, AccessShareLock);
+
+	PG_RETURN_TEXT_P(cstring_to_text(buf.data));
+}
+
+/* ----------------------------------------------------------------
+ *  Index build support — rd_tableam swap trick
+ *
+ *  Heap's index_build_range_scan checks rd_tableam internally and
+ *  takes optimized paths for heap.  We temporarily swap to heap AM
+ *  so the build succeeds, then restore.
+ * ---------------------------------------------------------------- */
+static double
+sorted_heap_index_build_range_scan(Relation tableRelation,
+								   Relation indexRelation,
+								   IndexInfo *indexInfo,
+								   bool allow_sync,
+								   bool anyvisible,
+								   bool progress,
+								   BlockNumber start_blockno,
+								   BlockNumber numblocks,
+								   IndexBuildCallback callback,
+								   void *callback_state,
+								   TableScanDesc scan)
+{
+	const TableAmRoutine *heap;
+	const TableAmRoutine *old_tableam;
+	double		result;
+
+	if (tableRelation == NULL || indexRelation == NULL || indexInfo == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sorted_heap index_build_range_scan requires valid arguments")));
+
+	heap = GetHeapamTableAmRoutine();
+	old_tableam = tableRelation->rd_tableam;
+
+	tableRelation->rd_tableam = heap;
+	PG_TRY();
+	{
+		result = heap->index_build_range_scan(tableRelation,
+											  indexRelation,
+											  indexInfo,
+											  allow_sync,
+											  anyvisible,
+											  progress,
+											  start_blockno,
+											  numblocks,
+											  callback,
+											  callback_state,
+											  scan);
+	}
+	PG_CATCH();
+	{
+		tableRelation->rd_tableam = old_tableam;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	tableRelation->rd_tableam = old_tableam;
+	return result;
+}
+
+static void
+sorted_heap_index_validate_scan(Relation tableRelation,
+								Relation indexRelation,
+								IndexInfo *indexInfo,
+								Snapshot snapshot,
+								ValidateIndexState *state)
+{
+	const TableAmRoutine *heap;
+	const TableAmRoutine *old_tableam;
+
+	if (tableRelation == NULL || indexRelation == NULL || indexInfo == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sorted_heap index_validate_scan requires valid arguments")));
+
+	heap = GetHeapamTableAmRoutine();
+	old_tableam = tableRelation->rd_tableam;
+
+	tableRelation->rd_tableam = heap;
+	PG_TRY();
+	{
+		heap->index_validate_scan(tableRelation,
+								  indexRelation,
+								  indexInfo,
+								  snapshot,
+								  state);
+	}
+	PG_CATCH();
+	{
+		tableRelation->rd_tableam = old_tableam;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	tableRelation->rd_tableam = old_tableam;
+}
+
+/* Reset e to the "no data" sentinel */
+static inline void
+sorted_heap_entry_clear(SortedHeapZoneMapEntry *e)
+{
+	e->zme_min = PG_INT64_MAX;
+	e->zme_max = PG_INT64_MIN;
+	e->zme_min2 = PG_INT64_MAX;
+	e->zme_max2 = PG_INT64_MIN;
+}
+
+/* Widen e to take in by's bounds, column by column.  True if e changed. */
+static bool
+sorted_heap_entry_merge(SortedHeapZoneMapEntry *e,
+						const SortedHeapZoneMapEntry *by)
+{
+	bool		changed = false;
+
+	if (by->zme_min != PG_INT64_MAX)
+	{
+		if (by->zme_min < e->zme_min)
+		{
+			e->zme_min = by->zme_min;
+			changed = true;
+		}
+		if (by->zme_max > e->zme_max)
+		{
+			e->zme_max = by->zme_max;
+			changed = true;
+		}
+	}
+	if (by->zme_min2 != PG_INT64_MAX)
+	{
+		if (by->zme_min2 < e->zme_min2)
+		{
+			e->zme_min2 = by->zme_min2;
+			changed = true;
+		}
+		if (by->zme_max2 > e->zme_max2)
+		{
+			e->zme_max2 = by->zme_max2;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/*
+ * Widen e by a row's PK column 1 (and column 2, when tracked) values.
+ * True if e changed.
+ */
+static bool
+sorted_heap_entry_widen_keys(SortedHeapRelInfo *info,
+							 SortedHeapZoneMapEntry *e,
+							 Datum val, bool isnull,
+							 Datum val2, bool isnull2)
+{
+	int64		key;
+	int64		key2;
+	bool		changed = false;
+
+	if (isnull || !sorted_heap_key_to_int64(val, info->zm_pk_typid, &key))
+		return false;
+
+	if (key < e->zme_min)
+	{
+		e->zme_min = key;
+		changed = true;
+	}
+	if (key > e->zme_max)
+	{
+		e->zme_max = key;
+		changed = true;
+	}
+
+	/* Track column 2 */
+	if (info->zm_col2_usable && !isnull2 &&
+		sorted_heap_key_to_int64(val2, info->zm_pk_typid2, &key2))
+	{
+		if (key2 < e->zme_min2 || e->zme_min2 == PG_INT64_MAX)
+		{
+			e->zme_min2 = key2;
+			changed = true;
+		}
+		if (key2 > e->zme_max2 || e->zme_max2 == PG_INT64_MIN)
+		{
+			e->zme_max2 = key2;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/* As above, for the row in slot */
+static bool
+sorted_heap_entry_widen(SortedHeapRelInfo *info, SortedHeapZoneMapEntry *e,
+						TupleTableSlot *slot)
+{
+	Datum		val;
+	Datum		val2 = (Datum) 0;
+	bool		isnull;
+	bool		isnull2 = true;
+
+	val = slot_getattr(slot, info->attNums[0], &isnull);
+	if (info->zm_col2_usable)
+		val2 = slot_getattr(slot, info->attNums[1], &isnull2);
+	return sorted_heap_entry_widen_keys(info, e, val, isnull, val2, isnull2);
+}
+
+/*
+ * Compute zone idx's entry from the tuples, live or dead, on its pages
+ * below nblocks.  Pages with special space (the meta page, overflow and
+ * super-zone pages) hold no tuples.
+ */
+static void
+sorted_heap_zone_from_pages(Relation rel, SortedHeapRelInfo *info,
+							uint32 idx, BlockNumber nblocks,
+							SortedHeapZoneMapEntry *e)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	BlockNumber	first = sorted_heap_zone_first_block(info, idx);
+	BlockNumber	end = Min(first + info->zm_zone_pages, nblocks);
+
+	sorted_heap_entry_clear(e);
+
+	for (BlockNumber blk = first; blk < end; blk++)
+	{
+		Buffer		buf;
+		Page		page;
+		OffsetNumber maxoff = InvalidOffsetNumber;
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, blk, RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		if (!PageIsNew(page) && PageGetSpecialSize(page) == 0)
+			maxoff = PageGetMaxOffsetNumber(page);
+
+		for (OffsetNumber off = FirstOffsetNumber; off <= maxoff; off++)
+		{
+			ItemId		lp = PageGetItemId(page, off);
+			HeapTupleData tup;
+			Datum		val;
+			Datum		val2 = (Datum) 0;
+			bool		isnull;
+			bool		isnull2 = true;
+
+			if (!ItemIdIsNormal(lp))
+				continue;
+			tup.t_data = (HeapTupleHeader) PageGetItem(page, lp);
+			tup.t_len = ItemIdGetLength(lp);
+			val = heap_getattr(&tup, info->attNums[0], tupdesc, &isnull);
+			if (info->zm_col2_usable)
+				val2 = heap_getattr(&tup, info->attNums[1], tupdesc, &isnull2);
+			(void) sorted_heap_entry_widen_keys(info, e, val, isnull,
+												val2, isnull2);
+		}
+		UnlockReleaseBuffer(buf);
+	}
+}
+
+/*
+ * A row landed in zone idx, past the end of a zone map that has no
+ * overflow run but room for idx in the meta page: append entries for
+ * zones [zm_nentries, idx], computed from their pages.  The zones in
+ * between were never covered, so they are read rather than assumed
+ * empty; a page already holding rows is covered just the same.
+ */
+static void
+sorted_heap_zonemap_append(Relation rel, SortedHeapRelInfo *info,
+						   uint32 idx)
+{
+	BlockNumber	nblocks = RelationGetNumberOfBlocks(rel);
+
+	for (uint32 i = info->zm_nentries; i <= idx; i++)
+	{
+		sorted_heap_zone_from_pages(rel, info, i, nblocks,
+									&info->zm_entries[i]);
+		if (info->zm_super != NULL &&
+			i / SORTED_HEAP_SUPERZONE_PAGES < info->zm_nsuper)
+			sorted_heap_superzone_widen(&info->zm_super[i / SORTED_HEAP_SUPERZONE_PAGES],
+										&info->zm_entries[i]);
+	}
+	info->zm_nentries = idx + 1;
+	info->zm_total_entries = idx + 1;
+	info->zm_sorted = false;
+	sorted_heap_zonemap_flush(rel, info);
+}
+
+/*
+ * A row landed past the overflow run, where there is no entry to widen.
+ * Pages past the zone map are always read unless the query's upper bound
+ * is below the last entry's max (they would hold later keys in a sorted
+ * load); SHM_FLAG_ZM_TAIL_UNSORTED turns that shortcut off instead of
+ * pruning being turned off for the whole table.
+ *
+ * info may predate another backend's sorted_heap_zonemap_extend_overflow,
+ * which may have read the row's page before the row landed.  That reads
+ * the new zones' pages and writes their entries under the meta page lock,
+ * so the run is checked under it here, after the row was placed: if it is
+ * still as info has it, a later extension reads the row; if not, false is
+ * returned and the caller reloads and widens the entry now covering it.
+ * The check needs only a share lock once the flag is set.
+ */
+static bool
+sorted_heap_zonemap_mark_tail(Relation rel, SortedHeapRelInfo *info)
+{
+	Buffer		metabuf;
+	SortedHeapMetaPageData *meta;
+	bool		current = true;
+	bool		set = false;
+
+	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
+								 RBM_NORMAL, NULL);
+	LockBuffer(metabuf, info->zm_tail_unsorted ? BUFFER_LOCK_SHARE :
+			   BUFFER_LOCK_EXCLUSIVE);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(BufferGetPage(metabuf));
+
+	if (meta->shm_magic == SORTED_HEAP_MAGIC)
+	{
+		uint32		novfl = (meta->shm_version >= 5) ?
+			meta->shm_overflow_nentries : 0;
+
+		set = (meta->shm_flags & SHM_FLAG_ZM_TAIL_UNSORTED) != 0;
+		current = novfl == info->zm_overflow_nentries;
+
+		/* A rebuild cleared the flag; it is set under the exclusive lock */
+		if (info->zm_tail_unsorted && !set)
+			current = false;
+	}
+
+	if (current && !set && meta->shm_magic == SORTED_HEAP_MAGIC)
+	{
+		xl_sorted_heap_meta_entries hdr;
+		SortedHeapZoneMapEntry *ents;
+
+		ents = palloc(SORTED_HEAP_ZONEMAP_CACHE_MAX *
+					  sizeof(SortedHeapZoneMapEntry));
+		if (sorted_heap_meta_get_entries(BufferGetPage(metabuf), &hdr,
+										 ents) > 0)
+		{
+			hdr.flags |= SHM_FLAG_ZM_TAIL_UNSORTED;
+			(void) sorted_heap_meta_write(rel, metabuf, &hdr, ents);
+		}
+		pfree(ents);
+	}
+	UnlockReleaseBuffer(metabuf);
+
+	if (current)
+		info->zm_tail_unsorted = true;
+	return current;
+}
+
+/*
+ * Widen overflow entries [idx, idx + n) by by[0..n), on disk and in the
+ * cache; they share an overflow page, and their super-zones a super-zone
+ * page.  The on-disk entries are the ones widened, since a backend-local
+ * cache may predate another backend's widening.  A plain page is patched
+ * in place, a packed one repacked, and the super-zone page widened
+ * alike.  The meta page (which drops SHM_FLAG_ZM_SORTED) and the run's
+ * first page go in the same record, so local copies elsewhere see the run
+ * as rewritten and reload it (see sorted_heap_zonemap_revalidate).  False
+ * if there is no v7 directory to find the page by, the page is not what
+ * it should be, or the widened entries no longer pack: the caller
+ * invalidates.
+ */
+static bool
+sorted_heap_zonemap_widen_overflow(Relation rel, SortedHeapRelInfo *info,
+								   uint32 idx, const SortedHeapZoneMapEntry *by,
+								   uint32 n)
+{
+	uint32		oidx = idx - info->zm_nentries;
+	uint32		page = oidx / info->zm_overflow_per_page;
+	uint32		off = oidx % info->zm_overflow_per_page;
+	uint32		sidx = idx / SORTED_HEAP_SUPERZONE_PAGES;
+	Size		special_size = info->zm_overflow_packed ?
+		SORTED_HEAP_PACKED_SPECIAL_SIZE :
+		MAXALIGN(sizeof(SortedHeapOverflowPageData));
+	BlockNumber	blks[4];
+	Buffer		bufs[4];
+	int			nbufs = 0;
+	int			target;
+	int			super = -1;
+	BlockNumber	blk;
+	Page		pg;
+	SortedHeapOverflowPageData *ovfl;
+	SortedHeapZoneMapEntry *e = NULL;
+	SortedHeapZoneMapEntry *unpacked = NULL;
+	uint32		count;
+	bool		changed = false;
+	GenericXLogState *state;
+	bool		ok = true;
+
+	Assert(off + n <= info->zm_overflow_per_page);
+	Assert(sidx / SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE ==
+		   (idx + n - 1) / SORTED_HEAP_SUPERZONE_PAGES /
+		   SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE);
+
+	if (!info->zm_overflow_dir)
+		return false;
+
+	/* Meta, the run's first page, the entries' page, their super-zone page */
+	blks[nbufs++] = SORTED_HEAP_META_BLOCK;
+	blks[nbufs++] = sorted_heap_overflow_dir_block(info, 0);
+	blk = sorted_heap_overflow_dir_block(info, page);
+	if (blk == InvalidBlockNumber || blks[1] == InvalidBlockNumber)
+		return false;
+	if (blk != blks[1])
+		blks[nbufs++] = blk;
+	target = nbufs - 1;
+	if (info->zm_super_npages > 0)
+	{
+		blk = sorted_heap_overflow_dir_block(info, info->zm_overflow_npages +
+											 sidx / SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE);
+		if (blk != InvalidBlockNumber)
+		{
+			super = nbufs;
+			blks[nbufs++] = blk;
+		}
+	}
+
+	/* Meta first, then ascending: extents are laid out in order */
+	for (int i = 0; i < nbufs; i++)
+	{
+		bufs[i] = ReadBufferExtended(rel, MAIN_FORKNUM, blks[i],
+									 RBM_NORMAL, NULL);
+		LockBuffer(bufs[i], BUFFER_LOCK_EXCLUSIVE);
+	}
+
+	pg = BufferGetPage(bufs[target]);
+	ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+	count = ovfl->shmo_nentries;
+	if (PageIsNew(pg) || PageGetSpecialSize(pg) != special_size ||
+		ovfl->shmo_magic != SORTED_HEAP_MAGIC ||
+		ovfl->shmo_page_index != (uint16) page || off + n > count)
+		ok = false;
+	else if (info->zm_overflow_packed)
+	{
+		unpacked = palloc(count * sizeof(SortedHeapZoneMapEntry));
+		ok = sorted_heap_unpack_overflow((SortedHeapPackedOverflowPageData *) ovfl,
+										 count, unpacked);
+		e = &unpacked[off];
+	}
+	else
+	{
+		e = palloc(n * sizeof(SortedHeapZoneMapEntry));
+		memcpy(e, &ovfl->shmo_entries[off], n * sizeof(SortedHeapZoneMapEntry));
+	}
 
-		if (!info->zm_loaded)
-			sorted_heap_zonemap_load(rel, info);
+	for (uint32 i = 0; ok && i < n; i++)
+		changed |= sorted_heap_entry_merge(&e[i], &by[i]);
 
-		for (i = 0; i < nslots; i++)
-		{
-			BlockNumber				blk;
-			uint32					zmidx;
-			Datum					val;
-			bool					isnull;
-			int64					key;
-			SortedHeapZoneMapEntry *e;
+	if (ok && changed)
+	{
+		SortedHeapMetaPageData *meta;
+		Page		pages[4];
 
-			blk = ItemPointerGetBlockNumber(&slots[i]->tts_tid);
-			if (blk < 1)
-				continue;		/* skip meta page */
-			zmidx = blk - 1;	/* data block 1 → index 0 */
-			if (zmidx >= SORTED_HEAP_ZONEMAP_MAX)
-				continue;		/* beyond meta page capacity */
+		state = GenericXLogStart(rel);
+		for (int i = 0; i < nbufs; i++)
+			pages[i] = GenericXLogRegisterBuffer(state, bufs[i], 0);
 
-			val = slot_getattr(slots[i], info->attNums[0], &isnull);
-			if (isnull)
-				continue;
-			if (!sorted_heap_key_to_int64(val, info->zm_pk_typid, &key))
-				continue;
+		ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pages[target]);
+		if (unpacked != NULL)
+		{
+			SortedHeapPackedOverflowPageData *po =
+				(SortedHeapPackedOverflowPageData *) ovfl;
 
-			e = &info->zm_entries[zmidx];
-			if (e->zme_min == PG_INT64_MAX)
-			{
-				/* First tuple tracked on this page */
-				e->zme_min = key;
-				e->zme_max = key;
-			}
-			else
-			{
-				if (key < e->zme_min)
-					e->zme_min = key;
-				if (key > e->zme_max)
-					e->zme_max = key;
-			}
+			ok = sorted_heap_pack_overflow(unpacked, count,
+										   (po->shpo_flags & SHPO_FLAG_COL2) != 0,
+										   po);
+		}
+		else
+			memcpy(&ovfl->shmo_entries[off], e,
+				   n * sizeof(SortedHeapZoneMapEntry));
 
-			/* Track column 2 */
-			if (info->zm_col2_usable)
+		if (!ok)
+			GenericXLogAbort(state);
+		else
+		{
+			if (super >= 0)
 			{
-				Datum	val2;
-				bool	isnull2;
-				int64	key2;
+				SortedHeapOverflowPageData *sp = (SortedHeapOverflowPageData *)
+					PageGetSpecialPointer(pages[super]);
 
-				val2 = slot_getattr(slots[i], info->attNums[1], &isnull2);
-				if (!isnull2 &&
-					sorted_heap_key_to_int64(val2, info->zm_pk_typid2, &key2))
+				for (uint32 i = 0; i < n && sp->shmo_magic == SORTED_HEAP_MAGIC; i++)
 				{
-					if (e->zme_min2 == PG_INT64_MAX)
-					{
-						e->zme_min2 = key2;
-						e->zme_max2 = key2;
-					}
-					else
-					{
-						if (key2 < e->zme_min2)
-							e->zme_min2 = key2;
-						if (key2 > e->zme_max2)
-							e->zme_max2 = key2;
-					}
+					uint32		soff = ((idx + i) / SORTED_HEAP_SUPERZONE_PAGES) %
+						SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+
+					if (soff < sp->shmo_nentries)
+						sorted_heap_superzone_widen(&sp->shmo_entries[soff], &e[i]);
 				}
 			}
 
-			if (zmidx >= info->zm_nentries)
-				info->zm_nentries = zmidx + 1;
-
-			zm_dirty = true;
+			meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(pages[0]);
+			meta->shm_flags &= ~SHM_FLAG_ZM_SORTED;
+			GenericXLogFinish(state);
+			info->zm_sorted = false;
 		}
+	}
+
+	for (int i = nbufs - 1; i >= 0; i--)
+		UnlockReleaseBuffer(bufs[i]);
 
-		if (zm_dirty)
-			sorted_heap_zonemap_flush(rel, info);
+	/* An overflow page not read yet will be read widened */
+	for (uint32 i = 0; ok && i < n; i++)
+	{
+		if (info->zm_overflow_loaded == NULL || info->zm_overflow_loaded[page])
+			info->zm_overflow[oidx + i] = e[i];
+		if (info->zm_super != NULL)
+			sorted_heap_superzone_widen(&info->zm_super[(idx + i) / SORTED_HEAP_SUPERZONE_PAGES],
+										&e[i]);
 	}
+
+	if (unpacked != NULL)
+		pfree(unpacked);
+	else if (e != NULL)
+		pfree(e);
+	return ok;
 }
 
-/* ----------------------------------------------------------------
- *  Observability: sorted_heap_zonemap_stats(regclass) → text
- * ---------------------------------------------------------------- */
-Datum
-sorted_heap_zonemap_stats(PG_FUNCTION_ARGS)
+/*
+ * Whether blk is a spare page sorted_heap_zonemap_extend_overflow left
+ * after the run: an overflow page of the run's format (special_size)
+ * holding no entries, page index PG_UINT16_MAX.
+ */
+static bool
+sorted_heap_overflow_is_spare(Relation rel, BlockNumber blk, Size special_size)
 {
-	Oid			relid = PG_GETARG_OID(0);
-	Relation	rel;
+	Buffer		buf;
+	Page		pg;
+	bool		spare;
+
+	buf = ReadBufferExtended(rel, MAIN_FORKNUM, blk, RBM_NORMAL, NULL);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	pg = BufferGetPage(buf);
+	spare = !PageIsNew(pg) && PageGetSpecialSize(pg) == special_size;
+	if (spare)
+	{
+		SortedHeapOverflowPageData *ovfl =
+			(SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+
+		spare = ovfl->shmo_magic == SORTED_HEAP_MAGIC &&
+			ovfl->shmo_nentries == 0 &&
+			ovfl->shmo_page_index == PG_UINT16_MAX;
+	}
+	UnlockReleaseBuffer(buf);
+	return spare;
+}
+
+/*
+ * Add npages blocks from blk on to directory dir[0..*ndir), extending the
+ * last extent if they follow it.  False if every slot is taken.
+ */
+static bool
+sorted_heap_overflow_dir_add(SortedHeapOverflowExtent *dir, int *ndir,
+							 BlockNumber blk, uint32 npages)
+{
+	if (npages == 0)
+		return true;
+	if (*ndir > 0 &&
+		dir[*ndir - 1].soe_start + dir[*ndir - 1].soe_npages == blk)
+	{
+		dir[*ndir - 1].soe_npages += npages;
+		return true;
+	}
+	if (*ndir == SORTED_HEAP_META_OVERFLOW_EXTENTS)
+		return false;
+	dir[*ndir].soe_start = blk;
+	dir[*ndir].soe_npages = npages;
+	(*ndir)++;
+	return true;
+}
+
+/*
+ * Append entries for zones [zm_total_entries, end), computed from their
+ * pages, to the overflow run, starting one if the table has none yet and
+ * filling the meta page first.  The run's partial last page takes what it
+ * has room for; further overflow pages come from spares an earlier
+ * extension left after the run, else from a batch of new pages at the
+ * end of the relation, WAL-logged together, with headroom so the next
+ * batches of a load only fill spares.  Super-zone pages are rewritten in
+ * place, or after the new pages when their count changes; their on-disk
+ * summaries (with the meta page entries folded in) are widened, not
+ * recomputed, since the overflow entries they cover are not read here.
+ *
+ * Each record before the final meta page one leaves the old run readable:
+ * pages only gain entries past its count, and super-zone pages only widen
+ * (or no longer match, and are dropped).  False, having written nothing,
+ * if the meta page no longer matches info, there is no v7 directory, the
+ * new entries do not pack or the directory is out of slots.  True if the
+ * run changed; every copy of the zone map is then out of date.
+ */
+static bool
+sorted_heap_zonemap_extend_overflow(Relation rel, SortedHeapRelInfo *info,
+									uint32 end)
+{
+	SortedHeapOverflowExtent *old_dir =
+		(SortedHeapOverflowExtent *) info->zm_overflow_blocks;
+	SortedHeapOverflowExtent dir[SORTED_HEAP_META_OVERFLOW_EXTENTS];
+	int			ndir = 0;
+	uint32		old_total = info->zm_total_entries;
+	uint32		old_ovfl = info->zm_overflow_nentries;
+	uint32		old_npages = info->zm_overflow_npages;
+	uint32		new_ovfl = end - SORTED_HEAP_ZONEMAP_MAX;
+	bool		fresh = (old_ovfl == 0);
+	bool		track_col2 = info->zm_col2_usable;
+	bool		packed = fresh || info->zm_overflow_packed;
+	uint32		per_page;
+	uint32		first_page;
+	uint32		new_npages = 0;
+	uint32		nsuper;
+	uint32		super_npages;
+	uint32		old_super_npages = 0;
+	uint32		nspare = 0;
+	uint32		nnew;
+	uint32		nalloc_ovfl;
+	uint32		nalloc;
+	bool		relocate;
+	BlockNumber	run_end = InvalidBlockNumber;
+	BlockNumber	nblocks;
+	SortedHeapZoneMapEntry *add;
+	SortedHeapZoneMapEntry *ents;
+	SortedHeapZoneMapEntry *super;
+	PGAlignedBlock *imgs = NULL;
+	PGAlignedBlock *super_imgs = NULL;
 	Buffer		metabuf;
-	Page		metapage;
 	SortedHeapMetaPageData *meta;
-	StringInfoData buf;
-	int			show;
-	uint32		on_disk_version;
-	uint16		on_disk_nentries;
-	uint16		on_disk_ovfl_npages;
-	SortedHeapZoneMapEntry first_entries[5];
-	int			n_first_entries;
-	BlockNumber	last_meta_ovfl_blk = InvalidBlockNumber;
+	bool		ok = true;
 
-	rel = table_open(relid, AccessShareLock);
+	Assert(end > SORTED_HEAP_ZONEMAP_MAX && end > old_total);
+
+	if (!fresh && (!info->zm_overflow_dir ||
+				   info->zm_nentries != SORTED_HEAP_ZONEMAP_MAX))
+		return false;
 
+	/* Every overflow page writer holds the meta page first */
 	metabuf = ReadBufferExtended(rel, MAIN_FORKNUM, SORTED_HEAP_META_BLOCK,
 								 RBM_NORMAL, NULL);
-	LockBuffer(metabuf, BUFFER_LOCK_SHARE);
-	metapage = BufferGetPage(metabuf);
-	meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+	meta = (SortedHeapMetaPageData *)
+		PageGetSpecialPointer(BufferGetPage(metabuf));
+	if (meta->shm_magic != SORTED_HEAP_MAGIC ||
+		meta->shm_version < (fresh ? 5 : 7) ||
+		!(meta->shm_flags & SHM_FLAG_ZONEMAP_VALID) ||
+		meta->shm_zonemap_nentries != info->zm_nentries ||
+		meta->shm_overflow_nentries != old_ovfl ||
+		(fresh && meta->shm_overflow_npages != 0) ||
+		(!fresh &&
+		 (((meta->shm_flags & SHM_FLAG_ZM_PACKED) != 0) != packed ||
+		  memcmp(meta->shm_overflow_blocks, info->zm_overflow_blocks,
+				 sizeof(info->zm_overflow_blocks)) != 0)))
+	{
+		UnlockReleaseBuffer(metabuf);
+		return false;
+	}
 
-	/* Save values before releasing buffer */
-	on_disk_version = meta->shm_version;
+	/*
+	 * Read the new zones with the meta page held.  A row placed in one of
+	 * them by a backend whose copy predates this extension is either on
+	 * its page by now, or placed after the new entries are written, which
+	 * its sorted_heap_zonemap_mark_tail then finds under this lock.
+	 */
+	nblocks = RelationGetNumberOfBlocks(rel);
+	add = palloc((end - old_total) * sizeof(SortedHeapZoneMapEntry));
+	for (uint32 i = old_total; i < end; i++)
+		sorted_heap_zone_from_pages(rel, info, i, nblocks, &add[i - old_total]);
 
-	initStringInfo(&buf);
-	if (on_disk_version >= 5)
+	/*
+	 * Overflow entries from the start of the run's partial last page: what
+	 * that page holds on disk (another backend may have widened it since
+	 * info was read), then the new zones.
+	 */
+	per_page = packed ? SORTED_HEAP_PACKED_ENTRIES_PER_PAGE :
+		SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+	first_page = old_ovfl / per_page;
+	ents = palloc((new_ovfl - first_page * per_page) *
+				  sizeof(SortedHeapZoneMapEntry));
+	memcpy(&ents[old_ovfl - first_page * per_page],
+		   &add[SORTED_HEAP_ZONEMAP_MAX + old_ovfl - old_total],
+		   (new_ovfl - old_ovfl) * sizeof(SortedHeapZoneMapEntry));
+	if (old_ovfl > first_page * per_page)
 	{
-		on_disk_nentries = meta->shm_zonemap_nentries;
-		on_disk_ovfl_npages = meta->shm_overflow_npages;
+		uint32		count = old_ovfl - first_page * per_page;
+		Buffer		buf;
+		Page		pg;
+		SortedHeapOverflowPageData *ovfl;
 
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM,
+								 sorted_heap_overflow_dir_block(info, first_page),
+								 RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		pg = BufferGetPage(buf);
+		ok = !PageIsNew(pg) &&
+			PageGetSpecialSize(pg) == (packed ?
+									   SORTED_HEAP_PACKED_SPECIAL_SIZE :
+									   MAXALIGN(sizeof(SortedHeapOverflowPageData)));
+		if (ok)
 		{
-			const char *flags_str;
-			uint32		f = meta->shm_flags;
-			bool		fv = (f & SHM_FLAG_ZONEMAP_VALID) != 0;
-			bool		fs = (f & SHM_FLAG_ZM_SORTED) != 0;
-
-			if (fv && fs)
-				flags_str = "valid,sorted";
-			else if (fv)
-				flags_str = "valid";
-			else if (fs)
-				flags_str = "sorted";
-			else
-				flags_str = "0";
-
-			appendStringInfo(&buf, "version=%u nentries=%u pk_typid=%u"
-							 " pk_typid2=%u flags=%s overflow_pages=%u",
-							 meta->shm_version,
-							 (unsigned) meta->shm_zonemap_nentries,
-							 (unsigned) meta->shm_zonemap_pk_typid,
-							 (unsigned) meta->shm_zonemap_pk_typid2,
-							 flags_str,
-							 (unsigned) meta->shm_overflow_npages);
+			ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+			ok = ovfl->shmo_magic == SORTED_HEAP_MAGIC &&
+				ovfl->shmo_page_index == (uint16) first_page &&
+				ovfl->shmo_nentries == count;
+			if (ok && packed)
+				ok = sorted_heap_unpack_overflow((SortedHeapPackedOverflowPageData *) ovfl,
+												 count, ents);
+			else if (ok)
+				memcpy(ents, ovfl->shmo_entries,
+					   count * sizeof(SortedHeapZoneMapEntry));
 		}
+		UnlockReleaseBuffer(buf);
+	}
 
-		/* Save first entries and last overflow block for after release */
-		n_first_entries = Min(on_disk_nentries, 5);
-		memcpy(first_entries, meta->shm_zonemap,
-			   n_first_entries * sizeof(SortedHeapZoneMapEntry));
+	/* Overflow page images; a new run is plain if some page does not pack */
+	while (ok)
+	{
+		per_page = packed ? SORTED_HEAP_PACKED_ENTRIES_PER_PAGE :
+			SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		new_npages = (new_ovfl + per_page - 1) / per_page;
+		imgs = palloc((new_npages - first_page) * sizeof(PGAlignedBlock));
+		for (uint32 p = first_page; ok && p < new_npages; p++)
+		{
+			uint32		start = (p - first_page) * per_page;
+
+			ok = sorted_heap_overflow_page_init((Page) imgs[p - first_page].data,
+												&ents[start],
+												Min(per_page,
+													new_ovfl - p * per_page),
+												p, packed, track_col2,
+												InvalidBlockNumber);
+		}
+		if (ok || !fresh || !packed)
+			break;
+		pfree(imgs);
+		imgs = NULL;
+		packed = false;
+		ok = true;
+	}
 
-		if (on_disk_ovfl_npages > 0)
-			last_meta_ovfl_blk =
-				meta->shm_overflow_blocks[on_disk_ovfl_npages - 1];
+	/*
+	 * Super-zones, from the pages on disk and the meta page entries; a new
+	 * run has every entry at hand.  Without a complete set on disk the run
+	 * goes on without them.
+	 */
+	nsuper = (end + SORTED_HEAP_SUPERZONE_PAGES - 1) /
+		SORTED_HEAP_SUPERZONE_PAGES;
+	super_npages = (nsuper + SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE - 1) /
+		SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+	super = palloc(nsuper * sizeof(SortedHeapZoneMapEntry));
+	for (uint32 s = 0; s < nsuper; s++)
+		sorted_heap_entry_clear(&super[s]);
+	if (ok && !fresh)
+	{
+		uint32		old_nsuper = (old_total + SORTED_HEAP_SUPERZONE_PAGES - 1) /
+			SORTED_HEAP_SUPERZONE_PAGES;
+		uint32		dir_npages = 0;
 
-		UnlockReleaseBuffer(metabuf);
+		old_super_npages = (old_nsuper + SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE - 1) /
+			SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+		for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+			dir_npages += old_dir[i].soe_npages;
+		if (dir_npages < old_npages + old_super_npages)
+			super_npages = 0;
 
-		/* v6: count chain pages beyond meta slots */
-		if (on_disk_version >= 6 && on_disk_ovfl_npages > 0 &&
-			last_meta_ovfl_blk != InvalidBlockNumber)
+		for (uint32 p = 0; super_npages > 0 && p < old_super_npages; p++)
 		{
-			uint32		total_overflow = on_disk_ovfl_npages;
-			BlockNumber	next_blk;
-			Buffer		ovfl_buf;
-			Page		ovfl_page;
+			uint32		at = old_npages + p;
+			uint32		start = p * SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+			uint32		count = Min(SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
+									old_nsuper - start);
+			Buffer		buf;
+			Page		pg;
 			SortedHeapOverflowPageData *ovfl;
 
-			ovfl_buf = ReadBufferExtended(rel, MAIN_FORKNUM,
-										  last_meta_ovfl_blk,
-										  RBM_NORMAL, NULL);
-			LockBuffer(ovfl_buf, BUFFER_LOCK_SHARE);
-			ovfl_page = BufferGetPage(ovfl_buf);
-			ovfl = (SortedHeapOverflowPageData *)
-				PageGetSpecialPointer(ovfl_page);
-			next_blk = ovfl->shmo_next_block;
-			UnlockReleaseBuffer(ovfl_buf);
-
-			while (next_blk != InvalidBlockNumber)
+			buf = ReadBufferExtended(rel, MAIN_FORKNUM,
+									 sorted_heap_overflow_dir_block(info, at),
+									 RBM_NORMAL, NULL);
+			LockBuffer(buf, BUFFER_LOCK_SHARE);
+			pg = BufferGetPage(buf);
+			if (PageIsNew(pg) ||
+				PageGetSpecialSize(pg) != MAXALIGN(sizeof(SortedHeapOverflowPageData)))
+				super_npages = 0;
+			else
 			{
-				total_overflow++;
-				ovfl_buf = ReadBufferExtended(rel, MAIN_FORKNUM,
-											  next_blk, RBM_NORMAL, NULL);
-				LockBuffer(ovfl_buf, BUFFER_LOCK_SHARE);
-				ovfl_page = BufferGetPage(ovfl_buf);
-				ovfl = (SortedHeapOverflowPageData *)
-					PageGetSpecialPointer(ovfl_page);
-				next_blk = ovfl->shmo_next_block;
-				UnlockReleaseBuffer(ovfl_buf);
+				ovfl = (SortedHeapOverflowPageData *) PageGetSpecialPointer(pg);
+				if (ovfl->shmo_magic == SORTED_HEAP_MAGIC &&
+					ovfl->shmo_page_index == (uint16) at &&
+					ovfl->shmo_nentries == count)
+					memcpy(&super[start], ovfl->shmo_entries,
+						   count * sizeof(SortedHeapZoneMapEntry));
+				else
+					super_npages = 0;
 			}
+			UnlockReleaseBuffer(buf);
+		}
+	}
+	for (uint32 i = 0; super_npages > 0 && i < info->zm_nentries; i++)
+		sorted_heap_superzone_widen(&super[i / SORTED_HEAP_SUPERZONE_PAGES],
+									&meta->shm_zonemap[i]);
+	for (uint32 i = old_total; super_npages > 0 && i < end; i++)
+		sorted_heap_superzone_widen(&super[i / SORTED_HEAP_SUPERZONE_PAGES],
+									&add[i - old_total]);
+	if (ok && super_npages > 0)
+	{
+		super_imgs = palloc(super_npages * sizeof(PGAlignedBlock));
+		for (uint32 p = 0; p < super_npages; p++)
+		{
+			uint32		start = p * SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+
+			(void) sorted_heap_overflow_page_init((Page) super_imgs[p].data,
+												  &super[start],
+												  Min(SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE,
+													  nsuper - start),
+												  new_npages + p, false,
+												  track_col2, InvalidBlockNumber);
+		}
+	}
 
-			if (total_overflow > on_disk_ovfl_npages)
-				appendStringInfo(&buf, " total_overflow_pages=%u",
-								 total_overflow);
+	/* Spares left after the run by an earlier extension */
+	if (ok && !fresh)
+	{
+		BlockNumber	rel_nblocks = RelationGetNumberOfBlocks(rel);
+		Size		special_size = packed ? SORTED_HEAP_PACKED_SPECIAL_SIZE :
+			MAXALIGN(sizeof(SortedHeapOverflowPageData));
+
+		run_end = sorted_heap_overflow_dir_block(info, old_npages - 1) + 1;
+		while (old_npages + nspare < new_npages &&
+			   run_end + nspare < rel_nblocks &&
+			   sorted_heap_overflow_is_spare(rel, run_end + nspare, special_size))
+			nspare++;
+	}
+	nnew = ok ? new_npages - old_npages - nspare : 0;
+	nalloc_ovfl = (nnew > 0) ? Max(nnew, Max(new_npages / 4, 8)) : 0;
+	relocate = super_npages > 0 && (fresh || super_npages != old_super_npages);
+	nalloc = nalloc_ovfl + (relocate ? super_npages : 0);
+
+	/* The directory, less the new batch; fail before writing if it is full */
+	for (int i = 0; i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+	{
+		dir[i].soe_start = InvalidBlockNumber;
+		dir[i].soe_npages = 0;
+	}
+	if (ok)
+	{
+		uint32		left = old_npages;
+		int			reserve = ((nnew > 0) ? 1 : 0) + (relocate ? 1 : 0);
+
+		for (int i = 0; ok && left > 0 && i < SORTED_HEAP_META_OVERFLOW_EXTENTS; i++)
+		{
+			uint32		k = Min(old_dir[i].soe_npages, left);
+
+			ok = sorted_heap_overflow_dir_add(dir, &ndir, old_dir[i].soe_start, k);
+			left -= k;
+		}
+		if (left > 0)
+			ok = false;			/* the directory does not hold the run */
+		if (ok)
+			ok = sorted_heap_overflow_dir_add(dir, &ndir, run_end, nspare);
+		if (ok && super_npages > 0 && !relocate)
+		{
+			SortedHeapOverflowExtent sdir[SORTED_HEAP_META_OVERFLOW_EXTENTS];
+			int			nsdir = 0;
+
+			for (uint32 p = 0; ok && p < super_npages; p++)
+				ok = sorted_heap_overflow_dir_add(sdir, &nsdir,
+												  sorted_heap_overflow_dir_block(info, old_npages + p),
+												  1);
+			reserve += nsdir;
 		}
+		if (ok && ndir + reserve > SORTED_HEAP_META_OVERFLOW_EXTENTS)
+			ok = false;
+	}
 
-		/* Show first few entries */
-		for (int i = 0; i < n_first_entries; i++)
+	if (ok && nalloc > 0)
+	{
+		Page	   *pages = palloc(nalloc * sizeof(Page));
+		BlockNumber *blknos = palloc(nalloc * sizeof(BlockNumber));
+		PGAlignedBlock *spare_imgs = palloc(nalloc_ovfl * sizeof(PGAlignedBlock));
+		SMgrRelation srel;
+		BlockNumber	alloc_start;
+
+		/* New pages: [overflow pages][spares][super-zone pages, if moved] */
+		for (uint32 i = 0; i < nalloc; i++)
 		{
-			appendStringInfo(&buf, " [%d:" INT64_FORMAT ".." INT64_FORMAT,
-							 i + 1,
-							 first_entries[i].zme_min,
-							 first_entries[i].zme_max);
-			if (first_entries[i].zme_min2 != PG_INT64_MAX)
-				appendStringInfo(&buf, " c2:" INT64_FORMAT ".." INT64_FORMAT,
-								 first_entries[i].zme_min2,
-								 first_entries[i].zme_max2);
-			appendStringInfoChar(&buf, ']');
+			if (i < nnew)
+				pages[i] = (Page) imgs[old_npages + nspare + i - first_page].data;
+			else if (i < nalloc_ovfl)
+			{
+				pages[i] = (Page) spare_imgs[i].data;
+				(void) sorted_heap_overflow_page_init(pages[i], ents, 0,
+													  PG_UINT16_MAX, packed,
+													  track_col2,
+													  InvalidBlockNumber);
+			}
+			else
+				pages[i] = (Page) super_imgs[i - nalloc_ovfl].data;
+		}
+
+		LockRelationForExtension(rel, ExclusiveLock);
+		srel = RelationGetSmgr(rel);
+		alloc_start = smgrnblocks(srel, MAIN_FORKNUM);
+		for (uint32 i = 0; i < nalloc; i++)
+			blknos[i] = alloc_start + i;
+
+		/* WAL-log the batch, then checksum and write each page */
+		if (RelationNeedsWAL(rel))
+			log_newpages(&rel->rd_locator, MAIN_FORKNUM, nalloc,
+						 blknos, pages, true);
+		for (uint32 i = 0; i < nalloc; i++)
+		{
+			PageSetChecksumInplace(pages[i], blknos[i]);
+			smgrextend(srel, MAIN_FORKNUM, blknos[i], pages[i], false);
 		}
+		UnlockRelationForExtension(rel, ExclusiveLock);
+
+		(void) sorted_heap_overflow_dir_add(dir, &ndir, alloc_start, nnew);
+		if (relocate)
+			(void) sorted_heap_overflow_dir_add(dir, &ndir,
+												alloc_start + nalloc_ovfl,
+												super_npages);
+		pfree(spare_imgs);
+		pfree(blknos);
+		pfree(pages);
 	}
-	else
+
+	if (ok)
 	{
-		/* v4 format: read via v4 struct to avoid misaligned access */
-		SortedHeapMetaPageDataV4 *meta4 =
-			(SortedHeapMetaPageDataV4 *) meta;
+		Buffer		bufs[MAX_GENERIC_XLOG_PAGES];
+		uint32		nexist = 0;
+		uint32		done = 0;
+		BlockNumber *eblks;
+		Page	   *esrcs;
+
+		/* Existing pages: the partial last page, spares, supers in place */
+		eblks = palloc((1 + nspare + super_npages) * sizeof(BlockNumber));
+		esrcs = palloc((1 + nspare + super_npages) * sizeof(Page));
+		if (first_page < old_npages)
+		{
+			eblks[nexist] = sorted_heap_overflow_dir_block(info, first_page);
+			esrcs[nexist++] = (Page) imgs[0].data;
+		}
+		for (uint32 i = 0; i < nspare; i++)
+		{
+			eblks[nexist] = run_end + i;
+			esrcs[nexist++] = (Page) imgs[old_npages + i - first_page].data;
+		}
+		for (uint32 p = 0; super_npages > 0 && !relocate && p < super_npages; p++)
+		{
+			eblks[nexist] = sorted_heap_overflow_dir_block(info, old_npages + p);
+			esrcs[nexist++] = (Page) super_imgs[p].data;
+		}
+		if (super_npages > 0 && !relocate)
+		{
+			for (uint32 p = 0; p < super_npages; p++)
+				(void) sorted_heap_overflow_dir_add(dir, &ndir,
+													sorted_heap_overflow_dir_block(info, old_npages + p),
+													1);
+		}
 
-		appendStringInfo(&buf, "version=%u nentries=%u pk_typid=%u flags=%u"
-						 " overflow_pages=%u",
-						 meta4->shm_version,
-						 (unsigned) meta4->shm_zonemap_nentries,
-						 (unsigned) meta4->shm_zonemap_pk_typid,
-						 meta4->shm_flags,
-						 (meta4->shm_version >= 4) ?
-						 (unsigned) meta4->shm_overflow_npages : 0);
+		/*
+		 * Whole-page images, MAX_GENERIC_XLOG_PAGES to a record; the last
+		 * record also carries the meta page, which makes them the run.
+		 */
+		for (;;)
+		{
+			GenericXLogState *state;
+			bool		last = (nexist - done < MAX_GENERIC_XLOG_PAGES);
+			int			nbufs = Min(nexist - done, MAX_GENERIC_XLOG_PAGES);
 
-		show = Min(meta4->shm_zonemap_nentries, 5);
-		for (int i = 0; i < show; i++)
+			for (int i = 0; i < nbufs; i++)
+			{
+				bufs[i] = ReadBufferExtended(rel, MAIN_FORKNUM, eblks[done + i],
+											 RBM_NORMAL, NULL);
+				LockBuffer(bufs[i], BUFFER_LOCK_EXCLUSIVE);
+			}
+
+			state = GenericXLogStart(rel);
+			for (int i = 0; i < nbufs; i++)
+				memcpy(GenericXLogRegisterBuffer(state, bufs[i],
+												 GENERIC_XLOG_FULL_IMAGE),
+					   esrcs[done + i], BLCKSZ);
+			if (last)
+			{
+				Page		metapage = GenericXLogRegisterBuffer(state, metabuf, 0);
+
+				meta = (SortedHeapMetaPageData *) PageGetSpecialPointer(metapage);
+				if (fresh)
+				{
+					for (uint32 i = old_total; i < SORTED_HEAP_ZONEMAP_MAX; i++)
+						meta->shm_zonemap[i] = add[i - old_total];
+					meta->shm_zonemap_nentries = SORTED_HEAP_ZONEMAP_MAX;
+					meta->shm_version = SORTED_HEAP_VERSION;
+					if (packed)
+						meta->shm_flags |= SHM_FLAG_ZM_PACKED;
+					else
+						meta->shm_flags &= ~SHM_FLAG_ZM_PACKED;
+				}
+				meta->shm_flags &= ~SHM_FLAG_ZM_SORTED;
+				meta->shm_overflow_npages = 1;
+				meta->shm_overflow_nentries = new_ovfl;
+				memcpy(meta->shm_overflow_blocks, dir, sizeof(dir));
+			}
+			GenericXLogFinish(state);
+
+			for (int i = nbufs - 1; i >= 0; i--)
+				UnlockReleaseBuffer(bufs[i]);
+			done += nbufs;
+			if (last)
+				break;
+		}
+		pfree(esrcs);
+		pfree(eblks);
+	}
+
+	UnlockReleaseBuffer(metabuf);
+
+	if (super_imgs != NULL)
+		pfree(super_imgs);
+	if (imgs != NULL)
+		pfree(imgs);
+	pfree(super);
+	pfree(ents);
+	pfree(add);
+	return ok;
+}
+
+/*
+ * An overflow page could not be rewritten: clear SHM_FLAG_ZONEMAP_VALID.
+ * Conservative: can't prune without zone map data.
+ */
+static void
+sorted_heap_zonemap_invalidate(Relation rel, SortedHeapRelInfo *info)
+{
+	info->zm_scan_valid = false;
+
+	/* table empty or meta-only: nothing to invalidate */
+	if (RelationGetNumberOfBlocks(rel) <= SORTED_HEAP_META_BLOCK)
+		return;
+
+	sorted_heap_meta_update_flags(rel, 0, SHM_FLAG_ZONEMAP_VALID);
+}
+
+/*
+ * Account for rows a multi_insert placed past the meta page's entries:
+ * widen overflow entries [first, first + n) by by[0..n), one overflow
+ * page and super-zone page at a time.  As for single rows, an overflow
+ * page that cannot be rewritten invalidates.  True if zones up to end
+ * still need entries of their own: the caller extends the run after
+ * unlocking (sorted_heap_zonemap_extend_overflow reads every new zone's
+ * pages), and leaves what it cannot take to sorted_heap_zonemap_mark_tail.
+ */
+static bool
+sorted_heap_zonemap_note_overflow(Relation rel, SortedHeapRelInfo *info,
+								  uint32 first, const SortedHeapZoneMapEntry *by,
+								  uint32 n, uint32 end)
+{
+	uint32		super_span = SORTED_HEAP_SUPERZONE_PAGES *
+		SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE;
+	uint32		i = 0;
+
+	if (!info->zm_loaded || !info->zm_scan_valid)
+		return false;
+
+	while (i < n)
+	{
+		uint32		idx = first + i;
+		uint32		page_end;
+		uint32		k;
+
+		if (by[i].zme_min == PG_INT64_MAX)
+		{
+			i++;				/* no row landed in this zone */
+			continue;
+		}
+		page_end = info->zm_nentries +
+			((idx - info->zm_nentries) / info->zm_overflow_per_page + 1) *
+			info->zm_overflow_per_page;
+		k = Min(n - i, Min(page_end, (idx / super_span + 1) * super_span) - idx);
+		if (!sorted_heap_zonemap_widen_overflow(rel, info, idx, &by[i], k))
 		{
-			appendStringInfo(&buf, " [%d:" INT64_FORMAT ".." INT64_FORMAT "]",
-							 i + 1,
-							 meta4->shm_zonemap[i].zme_min,
-							 meta4->shm_zonemap[i].zme_max);
+			sorted_heap_zonemap_invalidate(rel, info);
+			return false;
 		}
-
-		UnlockReleaseBuffer(metabuf);
+		i += k;
 	}
 
-	table_close(rel, AccessShareLock);
-
-	PG_RETURN_TEXT_P(cstring_to_text(buf.data));
+	return end > info->zm_total_entries;
 }
 
-/* ----------------------------------------------------------------
- *  Index build support — rd_tableam swap trick
- *
- *  Heap's index_build_range_scan checks rd_tableam internally and
- *  takes optimized paths for heap.  We temporarily swap to heap AM
- *  so the build succeeds, then restore.
- * ---------------------------------------------------------------- */
-static double
-sorted_heap_index_build_range_scan(Relation tableRelation,
-								   Relation indexRelation,
-								   IndexInfo *indexInfo,
-								   bool allow_sync,
-								   bool anyvisible,
-								   bool progress,
-								   BlockNumber start_blockno,
-								   BlockNumber numblocks,
-								   IndexBuildCallback callback,
-								   void *callback_state,
-								   TableScanDesc scan)
+#if defined(PG_HAVE_8BYTE_SINGLE_COPY_ATOMICITY) && \
+	!defined(PG_HAVE_ATOMIC_U64_SIMULATION)
+
+/* Lower (or raise) *field to v by compare-and-swap.  True if it moved. */
+static inline bool
+sorted_heap_atomic_extend(int64 *field, int64 v, bool lower)
 {
-	const TableAmRoutine *heap;
-	const TableAmRoutine *old_tableam;
-	double		result;
+	pg_atomic_uint64 *a = (pg_atomic_uint64 *) field;
+	uint64		old = pg_atomic_read_u64(a);
 
-	if (tableRelation == NULL || indexRelation == NULL || indexInfo == NULL)
-		ereport(ERROR,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				 errmsg("sorted_heap index_build_range_scan requires valid arguments")));
+	StaticAssertStmt(sizeof(pg_atomic_uint64) == sizeof(int64),
+					 "zone map bounds must be usable as atomics");
 
-	heap = GetHeapamTableAmRoutine();
-	old_tableam = tableRelation->rd_tableam;
+	while (lower ? v < (int64) old : v > (int64) old)
+	{
+		if (pg_atomic_compare_exchange_u64(a, &old, (uint64) v))
+			return true;
+	}
+	return false;
+}
 
-	tableRelation->rd_tableam = heap;
-	PG_TRY();
+/*
+ * sorted_heap_entry_merge for a non-empty entry other backends widen at
+ * the same time.  Each max moves before its min, so a reader never sees
+ * column 2 newly tracked without its upper bound.  If tracked_only,
+ * column 2 is left alone unless already tracked (super-zones).
+ */
+static bool
+sorted_heap_entry_merge_atomic(SortedHeapZoneMapEntry *e,
+							   const SortedHeapZoneMapEntry *by,
+							   bool tracked_only)
+{
+	bool		changed = false;
+
+	if (by->zme_min == PG_INT64_MAX)
+		return false;
+	changed |= sorted_heap_atomic_extend(&e->zme_max, by->zme_max, false);
+	changed |= sorted_heap_atomic_extend(&e->zme_min, by->zme_min, true);
+	if (by->zme_min2 != PG_INT64_MAX &&
+		!(tracked_only && e->zme_min2 == PG_INT64_MAX))
 	{
-		result = heap->index_build_range_scan(tableRelation,
-											  indexRelation,
-											  indexInfo,
-											  allow_sync,
-											  anyvisible,
-											  progress,
-											  start_blockno,
-											  numblocks,
-											  callback,
-											  callback_state,
-											  scan);
+		changed |= sorted_heap_atomic_extend(&e->zme_max2, by->zme_max2, false);
+		changed |= sorted_heap_atomic_extend(&e->zme_min2, by->zme_min2, true);
 	}
-	PG_CATCH();
+	return changed;
+}
+
+/*
+ * Single-row fast path: widen the shared copy's entry for blk under a
+ * shared lock, by compare-and-swap, so concurrent inserters do not queue
+ * on the exclusive lock (most rows need no change at all).  The meta
+ * page is written at commit as usual.  False if the exclusive path must
+ * run: no shared copy, a reload to adopt, a sorted zone map (clearing
+ * the flag must be published), an empty entry, or a page past the
+ * meta page's entries.
+ */
+static bool
+sorted_heap_zonemap_widen_shared(Relation rel, SortedHeapRelInfo *info,
+								 BlockNumber blk,
+								 const SortedHeapZoneMapEntry *by)
+{
+	SortedHeapZmShared *zs = info->zm_shared;
+	uint32		zmidx = 0;
+	bool		handled = false;
+	bool		changed = false;
+
+	if (zs == NULL)
+		return false;
+
+	LWLockAcquire(&zs->lock, LW_SHARED);
+	if (info->zm_loaded && info->zm_scan_valid && !zs->sorted &&
+		info->zm_generation == pg_atomic_read_u64(&zs->generation))
 	{
-		tableRelation->rd_tableam = old_tableam;
-		PG_RE_THROW();
+		zmidx = sorted_heap_zone_of_block(info, blk);
+		if (zmidx < info->zm_nentries &&
+			info->zm_entries[zmidx].zme_min != PG_INT64_MAX)
+		{
+			changed = sorted_heap_entry_merge_atomic(&info->zm_entries[zmidx],
+													 by, false);
+			if (changed && info->zm_super != NULL)
+				(void) sorted_heap_entry_merge_atomic(&info->zm_super[zmidx / SORTED_HEAP_SUPERZONE_PAGES],
+													  by, true);
+			handled = true;
+		}
 	}
-	PG_END_TRY();
+	LWLockRelease(&zs->lock);
 
-	tableRelation->rd_tableam = old_tableam;
-	return result;
+	if (changed)
+		sorted_heap_zonemap_defer(rel, info, zmidx, by);
+	return handled;
+}
+
+#else
+
+static bool
+sorted_heap_zonemap_widen_shared(Relation rel, SortedHeapRelInfo *info,
+								 BlockNumber blk,
+								 const SortedHeapZoneMapEntry *by)
+{
+	return false;
 }
 
+#endif
+
+/*
+ * Account for a tuple just placed at slot->tts_tid, preserving scan
+ * pruning validity:
+ * (a) widen its page's zone map entry, in the meta page or an overflow
+ *     page;
+ * (b) append entries up to its page, while the meta page has room and
+ *     there is no overflow run;
+ * (c) past the overflow run, leave the page uncovered but always read
+ *     (sorted_heap_zonemap_mark_tail), or, if another backend has since
+ *     extended the run over it, reload and start over.
+ * Only if its overflow page cannot be rewritten is SHM_FLAG_ZONEMAP_VALID
+ * cleared.
+ */
 static void
-sorted_heap_index_validate_scan(Relation tableRelation,
-								Relation indexRelation,
-								IndexInfo *indexInfo,
-								Snapshot snapshot,
-								ValidateIndexState *state)
+sorted_heap_zonemap_note_tuple(Relation rel, TupleTableSlot *slot)
 {
-	const TableAmRoutine *heap;
-	const TableAmRoutine *old_tableam;
+	SortedHeapRelInfo *info;
+	BlockNumber		blk = ItemPointerGetBlockNumber(&slot->tts_tid);
+	SortedHeapZoneMapEntry by;
+	bool			reload = false;
 
-	if (tableRelation == NULL || indexRelation == NULL || indexInfo == NULL)
-		ereport(ERROR,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				 errmsg("sorted_heap index_validate_scan requires valid arguments")));
+	info = sorted_heap_get_relinfo(rel);
+	if (!info->zm_usable || blk < 1)
+		return;
 
-	heap = GetHeapamTableAmRoutine();
-	old_tableam = tableRelation->rd_tableam;
+	sorted_heap_entry_clear(&by);
+	(void) sorted_heap_entry_widen(info, &by, slot);
+	if (sorted_heap_zonemap_widen_shared(rel, info, blk, &by))
+		return;
 
-	tableRelation->rd_tableam = heap;
-	PG_TRY();
+	sorted_heap_zonemap_lock(info);
+	if (info->zm_loaded && info->zm_scan_valid && info->zm_usable)
 	{
-		heap->index_validate_scan(tableRelation,
-								  indexRelation,
-								  indexInfo,
-								  snapshot,
-								  state);
+		uint32			zmidx = sorted_heap_zone_of_block(info, blk);
+
+		if (zmidx < info->zm_nentries)
+		{
+			/* Block within zone map coverage — update entry in-place */
+			SortedHeapZoneMapEntry *cached = &info->zm_entries[zmidx];
+
+			if (sorted_heap_entry_merge(cached, &by))
+			{
+				if (info->zm_super != NULL)
+					sorted_heap_superzone_widen(&info->zm_super[zmidx / SORTED_HEAP_SUPERZONE_PAGES],
+												cached);
+				/* Written to the meta page at commit */
+				sorted_heap_zonemap_defer(rel, info, zmidx, &by);
+			}
+			/* Zone map stays valid — pruning preserved */
+		}
+		else if (zmidx < info->zm_total_entries)
+		{
+			if (!sorted_heap_zonemap_widen_overflow(rel, info, zmidx, &by, 1))
+				sorted_heap_zonemap_invalidate(rel, info);
+		}
+		else if (zmidx < SORTED_HEAP_ZONEMAP_MAX &&
+				 info->zm_overflow_nentries == 0)
+			sorted_heap_zonemap_append(rel, info, zmidx);
+		else
+			reload = !sorted_heap_zonemap_mark_tail(rel, info);
 	}
-	PG_CATCH();
+	sorted_heap_zonemap_unlock(info);
+
+	if (reload)
 	{
-		tableRelation->rd_tableam = old_tableam;
-		PG_RE_THROW();
+		sorted_heap_zmcache_forget(RelationGetRelid(rel));
+		sorted_heap_zonemap_release(info);
+		sorted_heap_zonemap_note_tuple(rel, slot);
 	}
-	PG_END_TRY();
-
-	tableRelation->rd_tableam = old_tableam;
 }
 
 /* ----------------------------------------------------------------
  *  tuple_insert — incremental zone map update
  *
- *  Delegates to heap, then either:
- *  (a) updates the zone map entry in-place if the tuple landed in
- *      a block already covered by the zone map, preserving scan
- *      pruning validity; or
- *  (b) clears SHM_FLAG_ZONEMAP_VALID if the tuple landed outside
- *      zone map coverage (new/uncovered page).
+ *  Delegates to heap, then widens or invalidates the zone map
+ *  (sorted_heap_zonemap_note_tuple).
  * ---------------------------------------------------------------- */
 static void
 sorted_heap_tuple_insert(Relation rel, TupleTableSlot *slot,
@@ -1889,121 +5545,38 @@ sorted_heap_tuple_insert(Relation rel, TupleTableSlot *slot,
 						 struct BulkInsertStateData *bistate)
 {
 	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
-	SortedHeapRelInfo *info;
 
 	/* Let heap do the actual insert */
 	heap->tuple_insert(rel, slot, cid, options, bistate);
 
-	info = sorted_heap_get_relinfo(rel);
-	if (info->zm_scan_valid && info->zm_usable)
-	{
-		BlockNumber		blk = ItemPointerGetBlockNumber(&slot->tts_tid);
-		uint32			zmidx = (blk >= 1) ? (blk - 1) : 0;
-
-		if (blk >= 1 && zmidx < info->zm_nentries)
-		{
-			/*
-			 * Block within zone map coverage — update entry in-place.
-			 * Extract PK value and widen min/max if needed.
-			 */
-			Datum		val;
-			bool		isnull;
-			int64		key;
-
-			slot_getallattrs(slot);
-			val = slot_getattr(slot, info->attNums[0], &isnull);
-
-			if (!isnull && sorted_heap_key_to_int64(val, info->zm_pk_typid, &key))
-			{
-				SortedHeapZoneMapEntry *cached = &info->zm_entries[zmidx];
-				bool		need_update = false;
-
-				if (key < cached->zme_min)
-				{
-					cached->zme_min = key;
-					need_update = true;
-				}
-				if (key > cached->zme_max)
-				{
-					cached->zme_max = key;
-					need_update = true;
-				}
-
-				/* Track column 2 */
-				if (info->zm_col2_usable)
-				{
-					Datum	val2;
-					bool	isnull2;
-					int64	key2;
-
-					val2 = slot_getattr(slot, info->attNums[1], &isnull2);
-					if (!isnull2 &&
-						sorted_heap_key_to_int64(val2, info->zm_pk_typid2, &key2))
-					{
-						if (key2 < cached->zme_min2 || cached->zme_min2 == PG_INT64_MAX)
-						{
-							cached->zme_min2 = key2;
-							need_update = true;
-						}
-						if (key2 > cached->zme_max2 || cached->zme_max2 == PG_INT64_MIN)
-						{
-							cached->zme_max2 = key2;
-							need_update = true;
-						}
-					}
-				}
-
-				if (need_update)
-				{
-					/* Flush updated entry via version-aware flush */
-					sorted_heap_zonemap_flush(rel, info);
-					info->zm_sorted = false;
-				}
-			}
-			/* Zone map stays valid — pruning preserved */
-		}
-		else
-		{
-			/*
-			 * Block outside zone map coverage — invalidate.
-			 * Conservative: can't prune without zone map data.
-			 */
-			Buffer				metabuf;
-			Page				metapage;
-			SortedHeapMetaPageData *meta;
-			BlockNumber			nblocks;
-
-			nblocks = RelationGetNumberOfBlocks(rel);
-
-			if (nblocks <= SORTED_HEAP_META_BLOCK)
-			{
-				info->zm_scan_valid = false;
-				return; /* table empty or meta-only: nothing to invalidate */
-			}
-
-			metabuf = ReadBufferExtended(rel, MAIN_FORKNUM,
-										 SORTED_HEAP_META_BLOCK,
-										 RBM_NORMAL, NULL);
-			LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
-			metapage = BufferGetPage(metabuf);
-			meta = (SortedHeapMetaPageData *)
-				PageGetSpecialPointer(metapage);
-
-			if (meta->shm_flags & SHM_FLAG_ZONEMAP_VALID)
-			{
-				GenericXLogState *state = GenericXLogStart(rel);
+	sorted_heap_zonemap_note_tuple(rel, slot);
+}
 
-				metapage = GenericXLogRegisterBuffer(state, metabuf, 0);
-				meta = (SortedHeapMetaPageData *)
-					PageGetSpecialPointer(metapage);
-				meta->shm_flags &= ~SHM_FLAG_ZONEMAP_VALID;
-				GenericXLogFinish(state);
-			}
+/* ----------------------------------------------------------------
+ *  tuple_update — zone map maintenance for new row versions
+ *
+ *  heap_update keeps the new version on the old page whenever it fits
+ *  there (HOT when no indexed column changed), where an unchanged key
+ *  is already covered; fillfactor leaves it the room.  Otherwise it
+ *  lands wherever the FSM points, so its page's entry is widened just
+ *  as for an INSERT.
+ * ---------------------------------------------------------------- */
+static TM_Result
+sorted_heap_tuple_update(Relation rel, ItemPointer otid,
+						 TupleTableSlot *slot, CommandId cid,
+						 Snapshot snapshot, Snapshot crosscheck,
+						 bool wait, TM_FailureData *tmfd,
+						 LockTupleMode *lockmode,
+						 TU_UpdateIndexes *update_indexes)
+{
+	const TableAmRoutine *heap = GetHeapamTableAmRoutine();
+	TM_Result	result;
 
-			UnlockReleaseBuffer(metabuf);
-			info->zm_scan_valid = false;
-		}
-	}
+	result = heap->tuple_update(rel, otid, slot, cid, snapshot, crosscheck,
+								wait, tmfd, lockmode, update_indexes);
+	if (result == TM_Ok)
+		sorted_heap_zonemap_note_tuple(rel, slot);
+	return result;
 }
 
 /* ----------------------------------------------------------------
@@ -2106,6 +5679,149 @@ sorted_heap_rebuild_zonemap_sql(PG_FUNCTION_ARGS)
 	PG_RETURN_VOID();
 }
 
+/* ----------------------------------------------------------------
+ *  sorted_heap_set_zone_pages(regclass, int) → void
+ *
+ *  Set how many data pages each zone map entry covers, then rebuild
+ *  the zone map at that granularity.  ShareLock keeps inserts, which
+ *  widen entries by block, out until the new zone map is in place.
+ * ---------------------------------------------------------------- */
+Datum
+sorted_heap_set_zone_pages_sql(PG_FUNCTION_ARGS)
+{
+	Oid				relid = PG_GETARG_OID(0);
+	int32			zone_pages = PG_GETARG_INT32(1);
+	Relation		rel;
+	SortedHeapRelInfo *info;
+
+	if (zone_pages < 1 || zone_pages > SORTED_HEAP_ZONE_PAGES_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pages per zone must be between 1 and %d",
+						SORTED_HEAP_ZONE_PAGES_MAX)));
+
+	/* Verify ownership */
+	if (!object_ownercheck(RelationRelationId, relid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_TABLE, get_rel_name(relid));
+
+	rel = table_open(relid, ShareLock);
+
+	if (rel->rd_tableam != &sorted_heap_am_routine)
+	{
+		table_close(rel, ShareLock);
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a sorted_heap table",
+						RelationGetRelationName(rel))));
+	}
+
+	sorted_heap_set_zone_pages(rel, (uint32) zone_pages);
+
+	info = sorted_heap_get_relinfo(rel);
+	if (info->zm_usable)
+		sorted_heap_rebuild_zonemap_internal(rel, info->zm_pk_typid,
+											 info->attNums[0],
+											 info->zm_pk_typid2,
+											 info->zm_col2_usable ?
+											 info->attNums[1] : 0);
+
+	table_close(rel, NoLock);
+	PG_RETURN_VOID();
+}
+
+/* ----------------------------------------------------------------
+ *  sorted_heap_zonemap_memory() → setof (relid, entries, bytes, shared)
+ *
+ *  This backend's cached zone maps: entries covered, and bytes of local
+ *  memory held (zero for a shared copy, which lives in the DSA area and
+ *  counts once for the whole cluster).
+ * ---------------------------------------------------------------- */
+Datum
+sorted_heap_zonemap_memory(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	HASH_SEQ_STATUS status;
+	SortedHeapRelInfo *info;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (sorted_heap_relinfo_hash == NULL)
+		return (Datum) 0;
+
+	hash_seq_init(&status, sorted_heap_relinfo_hash);
+	while ((info = hash_seq_search(&status)) != NULL)
+	{
+		Datum		values[4];
+		bool		nulls[4] = {false, false, false, false};
+		Size		bytes = sorted_heap_zonemap_local_bytes(info);
+
+		if (!info->zm_loaded && bytes == 0)
+			continue;
+
+		values[0] = ObjectIdGetDatum(info->relid);
+		values[1] = Int64GetDatum((int64) info->zm_total_entries);
+		values[2] = Int64GetDatum((int64) bytes);
+		values[3] = BoolGetDatum(info->zm_shared != NULL);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/* ----------------------------------------------------------------
+ *  sorted_heap_zonemap_shared() → setof (relid, entries, bytes, backends)
+ *
+ *  This database's shared zone map cache entries: entries held (0 until
+ *  loaded, or after a drop or eviction let the block go), bytes of the
+ *  block, and backends pinning the entry.  Empty unless preloaded.
+ * ---------------------------------------------------------------- */
+Datum
+sorted_heap_zonemap_shared(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	dshash_seq_status status;
+	SortedHeapZmShared *zs;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (!sorted_heap_zmcache_attach())
+		return (Datum) 0;
+
+	dshash_seq_init(&status, sh_zm_table, false);
+	while ((zs = dshash_seq_next(&status)) != NULL)
+	{
+		Datum		values[4];
+		bool		nulls[4] = {false, false, false, false};
+		int64		entries = 0;
+		Size		bytes = 0;
+
+		if (zs->key.dbid != MyDatabaseId)
+			continue;
+
+		/* Unlocked: a snapshot for monitoring, as for the scan stats */
+		if (zs->loaded)
+		{
+			entries = zs->nentries + zs->overflow_nentries;
+			bytes = offsetof(SortedHeapZmBlock, entries) +
+				((Size) SORTED_HEAP_ZONEMAP_CACHE_MAX + zs->overflow_nentries +
+				 zs->nsuper) * sizeof(SortedHeapZoneMapEntry);
+			if (zs->overflow_lazy)
+				bytes += zs->overflow_npages * sizeof(bool);
+		}
+
+		values[0] = ObjectIdGetDatum(zs->key.relid);
+		values[1] = Int64GetDatum(entries);
+		values[2] = Int64GetDatum((int64) bytes);
+		values[3] = Int32GetDatum((int32) zs->npinned);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+	dshash_seq_term(&status);
+
+	return (Datum) 0;
+}
+
 /* ----------------------------------------------------------------
  *  sorted_heap_detect_sorted_prefix
  *
@@ -2116,6 +5832,8 @@ sorted_heap_rebuild_zonemap_sql(PG_FUNCTION_ARGS)
  *
  *  Returns the number of data pages in the sorted prefix (0-based
  *  entry index corresponds to data page = block entry_index + 1).
+ *  With several pages per zone, the pages inside a zone are not known
+ *  to be in order, so there is no prefix.
  * ---------------------------------------------------------------- */
 BlockNumber
 sorted_heap_detect_sorted_prefix(SortedHeapRelInfo *info)
@@ -2130,7 +5848,7 @@ sorted_heap_detect_sorted_prefix(SortedHeapRelInfo *info)
 	 * even after subsequent INSERTs clear the flag. If the zone map
 	 * hasn't been populated at all, prefix is 0 (full tuplesort fallback).
 	 */
-	if (info->zm_total_entries == 0)
+	if (info->zm_total_entries == 0 || info->zm_zone_pages > 1)
 		return 0;
 
 	/* First entry is always part of the prefix */
@@ -2439,7 +6157,8 @@ sorted_heap_merge(PG_FUNCTION_ARGS)
 	ExecDropSingleTupleTableSlot(tail_slot);
 	pfree(sortkeys);
 
-	/* Rebuild zone map on new table */
+	/* Rebuild zone map on new table, at the table's zone granularity */
+	sorted_heap_set_zone_pages(new_rel, sorted_heap_meta_zone_pages(rel));
 	if (info->zm_usable)
 		sorted_heap_rebuild_zonemap_internal(new_rel, info->zm_pk_typid,
 											 info->attNums[0],
@@ -5,11 +5,14 @@
 #include "fmgr.h"
 #include "access/attnum.h"
 #include "access/tableam.h"
+#include "access/xact.h"
+#include "access/xlogdefs.h"
 #include "port/atomics.h"
 #include "storage/block.h"
+#include "utils/dsa.h"
 
 #define SORTED_HEAP_MAGIC		0x534F5254	/* 'SORT' */
-#define SORTED_HEAP_VERSION		6
+#define SORTED_HEAP_VERSION		8
 #define SORTED_HEAP_META_BLOCK	0
 #define SORTED_HEAP_MAX_KEYS	INDEX_MAX_KEYS
 #define SORTED_HEAP_ZONEMAP_MAX	250		/* v5/v6 on-disk meta page entries */
@@ -18,6 +21,33 @@
 /* Meta page overflow slots: block numbers stored directly in meta page */
 #define SORTED_HEAP_META_OVERFLOW_SLOTS		32
 
+/*
+ * v7 overflow directory: the meta page's overflow slots hold runs of
+ * consecutive overflow pages rather than single block numbers, so the
+ * page holding any entry is known without reading another page, and all
+ * of them can be prefetched.  Rebuild writes every overflow page in one
+ * run.
+ */
+typedef struct SortedHeapOverflowExtent
+{
+	BlockNumber	soe_start;		/* block of the run's first page */
+	uint32		soe_npages;		/* pages in the run (0: slot unused) */
+} SortedHeapOverflowExtent;
+
+#define SORTED_HEAP_META_OVERFLOW_EXTENTS \
+	(SORTED_HEAP_META_OVERFLOW_SLOTS * sizeof(BlockNumber) / \
+	 sizeof(SortedHeapOverflowExtent))
+
+/*
+ * Super-zones: a summary entry per SORTED_HEAP_SUPERZONE_PAGES consecutive
+ * zone map entries, holding their combined min/max, so scans of a zone
+ * map that is not sorted skip whole runs of pages at once.  Rebuild
+ * writes them (overflow page format, page_index continuing after the
+ * overflow pages) at the end of the directory run.  Column 2 bounds are
+ * kept only if every page of the super-zone tracks column 2.
+ */
+#define SORTED_HEAP_SUPERZONE_PAGES			256
+
 /* v6 overflow pages: 254 entries + next_block pointer (linked list) */
 #define SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE 254
 /* No hard cap on overflow pages — linked list extends beyond meta slots */
@@ -33,6 +63,18 @@
 #define SORTED_HEAP_FLAG_ZONEMAP_STALE	0x0001
 #define SHM_FLAG_ZONEMAP_VALID			0x0002	/* zone map safe for scan pruning */
 #define SHM_FLAG_ZM_SORTED				0x0004	/* zone map entries monotonic (binary search ok) */
+#define SHM_FLAG_ZM_PACKED				0x0008	/* v8: overflow pages are packed */
+#define SHM_FLAG_ZM_TAIL_UNSORTED		0x0010	/* pages past the zone map hold any keys */
+
+/*
+ * Zone granularity: pages per zone map entry, kept in shm_flags bits
+ * 16-31 (zero on meta pages written before: one page per entry).  Entry
+ * i covers data blocks [i * N + 1, (i + 1) * N], so a huge cold table
+ * can trade some pruning precision for a zone map N times smaller.
+ */
+#define SHM_ZONE_PAGES_SHIFT			16
+#define SHM_ZONE_PAGES_MASK				0xFFFF0000
+#define SORTED_HEAP_ZONE_PAGES_MAX		4096
 
 /*
  * Per-page zone map entry: min/max of PK columns as int64.
@@ -62,13 +104,15 @@ typedef struct SortedHeapMetaPageData
 	uint32		shm_flags;
 	Oid			shm_pk_index_oid;		/* cached PK index OID */
 	uint16		shm_zonemap_nentries;	/* valid zone map entry count (in meta page) */
-	uint16		shm_overflow_npages;	/* number of overflow pages */
+	uint16		shm_overflow_npages;	/* number of overflow pages (v7:
+										 * directory runs in use) */
 	Oid			shm_zonemap_pk_typid;	/* type of first PK column */
 	Oid			shm_zonemap_pk_typid2;	/* type of second PK column (v5+) */
-	uint32		shm_padding;			/* align entries to 8 bytes */
+	uint32		shm_overflow_nentries;	/* entries in all overflow pages (v6;
+										 * 0 if written before this was kept) */
 	/* 32 bytes of header above */
 	SortedHeapZoneMapEntry shm_zonemap[SORTED_HEAP_ZONEMAP_MAX];
-	/* overflow page block numbers (128 bytes) */
+	/* overflow page block numbers (128 bytes; v7: SortedHeapOverflowExtent) */
 	BlockNumber	shm_overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS];
 } SortedHeapMetaPageData;
 
@@ -98,9 +142,53 @@ typedef struct SortedHeapOverflowPageData
 	SortedHeapZoneMapEntry shmo_entries[SORTED_HEAP_OVERFLOW_ENTRIES_PER_PAGE];
 } SortedHeapOverflowPageData;
 
+/*
+ * v8 packed overflow page (meta flag SHM_FLAG_ZM_PACKED): rebuild packs
+ * SORTED_HEAP_PACKED_ENTRIES_PER_PAGE entries into each overflow page
+ * instead of 254 when every page fits.  Per non-empty entry, the column 1
+ * min is stored as the zigzag delta from the previous non-empty entry's
+ * min (the first one's from shpo_base) and the max as max - min, each in
+ * that page's bit width; column 2 likewise for entries tracking it, and
+ * only on pages of tables with a column 2.  shpo_data holds a bitmap of
+ * empty entries, then (with column 2) one of entries not tracking it,
+ * then the bit stream.  The first 8 bytes match the other page formats.
+ */
+#define SORTED_HEAP_PACKED_ENTRIES_PER_PAGE	1016
+#define SHPO_FLAG_COL2			0x01	/* column 2 fields present */
+
+typedef struct SortedHeapPackedOverflowPageData
+{
+	uint32		shpo_magic;			/* SORTED_HEAP_MAGIC */
+	uint16		shpo_nentries;		/* entries in this page */
+	uint16		shpo_page_index;	/* 0-based index among overflow pages */
+	uint8		shpo_flags;
+	uint8		shpo_bits[4];		/* widths: min delta, max - min, then col 2 */
+	uint8		shpo_padding[3];
+	int64		shpo_base;			/* first non-empty entry's min */
+	int64		shpo_base2;			/* first entry's min2 tracking column 2 */
+	uint8		shpo_data[FLEXIBLE_ARRAY_MEMBER];
+} SortedHeapPackedOverflowPageData;
+
+/*
+ * Key order of a data page as last checked by a scan: whether its tuples'
+ * line pointers were in PK column 1 order while the page had LSN lsn.
+ * Every WAL-logged change to a heap page (insert, update, prune) moves
+ * its LSN on, so a stale slot is simply not matched.  Direct-mapped by
+ * block number; only kept for WAL-logged relations.
+ */
+#define SORTED_HEAP_PAGE_ORDER_SLOTS	1024
+
+typedef struct SortedHeapPageOrder
+{
+	BlockNumber	blkno;
+	bool		sorted;
+	XLogRecPtr	lsn;
+} SortedHeapPageOrder;
+
 /*
  * Per-relation PK info + zone map cache, backend-local hash table.
- * Populated lazily on first multi_insert call.
+ * Populated lazily on first multi_insert call.  With the shared zone
+ * map cache the zone map itself lives in a DSA area (see sorted_heap.c).
  */
 typedef struct SortedHeapRelInfo
 {
@@ -118,37 +206,142 @@ typedef struct SortedHeapRelInfo
 	bool		zm_loaded;			/* zone map read from meta page */
 	bool		zm_scan_valid;		/* zone map valid for scan pruning */
 	bool		zm_sorted;			/* zone map entries monotonically sorted */
+	bool		zm_tail_unsorted;	/* always read pages past the zone map */
 	Oid			zm_pk_typid;		/* type of first PK column */
 	bool		zm_col2_usable;		/* second PK col is int2/4/8/timestamp/date */
 	Oid			zm_pk_typid2;		/* type of second PK column */
+	uint32		zm_zone_pages;		/* data pages per entry (>= 1) */
 	uint16		zm_nentries;		/* entries in cache (max CACHE_MAX) */
-	SortedHeapZoneMapEntry zm_entries[SORTED_HEAP_ZONEMAP_CACHE_MAX];
+	SortedHeapZoneMapEntry *zm_entries;	/* CACHE_MAX slots, or NULL */
 
 	/* Overflow zone map (for tables > 500 data pages) */
 	SortedHeapZoneMapEntry *zm_overflow;	/* palloc'd, or NULL */
 	uint32		zm_overflow_nentries;		/* entries in overflow pages */
 	uint32		zm_total_entries;			/* zm_nentries + zm_overflow_nentries */
 	uint32		zm_overflow_npages;			/* number of overflow pages */
+	uint32		zm_overflow_per_page;		/* entries per overflow page */
+	bool		zm_overflow_packed;			/* v8 packed overflow pages */
+
+	/*
+	 * Lazily read overflow (v6 meta pages that record the overflow entry
+	 * count): per overflow page, whether it has been read into zm_overflow
+	 * yet; NULL once everything is read.  zm_overflow_blocks is the meta
+	 * page's slot array: a v7 directory (zm_overflow_dir), or v6 block
+	 * numbers, where overflow page i of a rebuilt table lives at
+	 * zm_overflow_blocks[0] + i unless that block says otherwise, in which
+	 * case the shmo_next_block chain is followed.
+	 */
+	bool	   *zm_overflow_loaded;
+	bool		zm_overflow_dir;
+	BlockNumber	zm_overflow_blocks[SORTED_HEAP_META_OVERFLOW_SLOTS];
+
+	/*
+	 * Super-zone summaries of entries [s * SUPERZONE_PAGES, (s + 1) *
+	 * SUPERZONE_PAGES), or NULL if the table has none.  Those covering
+	 * meta page entries are widened along with them.
+	 */
+	SortedHeapZoneMapEntry *zm_super;
+	uint32		zm_nsuper;
+	uint32		zm_super_npages;			/* summary pages on disk */
+
+	/*
+	 * Backend-local zone maps: the meta page LSN and relfilenumber they
+	 * were read at (InvalidXLogRecPtr if the relation is not WAL-logged).
+	 * A relcache invalidation only sets zm_stale; the next lookup checks
+	 * the meta page and re-reads just what changed.
+	 */
+	bool		zm_stale;
+	XLogRecPtr	zm_meta_lsn;
+	RelFileNumber zm_relnumber;
+	uint64		zm_last_used;				/* LRU stamp, for eviction */
+
+	/*
+	 * Shared zone map copy this backend reads in place, or NULL when the
+	 * zone map is backend-local.  zm_entries and zm_overflow then point
+	 * into zm_block.
+	 */
+	struct SortedHeapZmShared *zm_shared;
+	dsa_pointer	zm_block;					/* adopted block, or invalid */
+	uint64		zm_generation;				/* zm_shared generation adopted */
+
+	/* In-page key order, for binary search (palloc'd lazily, or NULL) */
+	SortedHeapPageOrder *page_order;
 } SortedHeapRelInfo;
 
+/*
+ * Closed query box for sorted_heap_zone_filter(): an entry qualifies if
+ * it holds data, its column 1 range meets [lo, hi], and its column 2
+ * range (when tracked) meets [lo2, hi2].
+ */
+typedef struct SortedHeapZoneBox
+{
+	int64		lo;
+	int64		hi;
+	int64		lo2;
+	int64		hi2;
+} SortedHeapZoneBox;
+
+/* Set bit i of bitmap ((n + 63) / 64 words) iff entries[i] meets box */
+extern void (*sorted_heap_zone_filter) (const SortedHeapZoneMapEntry *entries,
+										uint32 n,
+										const SortedHeapZoneBox *box,
+										uint64 *bitmap);
+extern Datum sorted_heap_zone_filter_selftest(PG_FUNCTION_ARGS);
+
+extern void sorted_heap_zonemap_fault(SortedHeapRelInfo *info, uint32 page);
+extern void sorted_heap_zonemap_prefetch(SortedHeapRelInfo *info,
+										 uint32 first_idx, uint32 end_idx);
+
 /*
  * Inline helper to access zone map entry by global index.
  * Entries 0..zm_nentries-1 are in the cache array; the rest in overflow.
- * (v4 stores up to 500 in cache, v5 stores up to 250.)
+ * (v4 stores up to 500 in cache, v5 stores up to 250.)  An overflow
+ * page not read yet is read on first access.
  */
 static inline SortedHeapZoneMapEntry *
 sorted_heap_get_zm_entry(SortedHeapRelInfo *info, uint32 idx)
 {
+	uint32		oidx;
+
 	if (idx < info->zm_nentries)
 		return &info->zm_entries[idx];
-	return &info->zm_overflow[idx - info->zm_nentries];
+
+	oidx = idx - info->zm_nentries;
+	if (info->zm_overflow_loaded != NULL)
+	{
+		uint32		page = oidx / info->zm_overflow_per_page;
+
+		if (unlikely(!info->zm_overflow_loaded[page]))
+			sorted_heap_zonemap_fault(info, page);
+		pg_read_barrier();		/* flag before entries (shared copy) */
+	}
+	return &info->zm_overflow[oidx];
+}
+
+/* Zone map entry covering data block blk (>= 1) */
+static inline uint32
+sorted_heap_zone_of_block(SortedHeapRelInfo *info, BlockNumber blk)
+{
+	return (blk - 1) / info->zm_zone_pages;
+}
+
+/* First data block covered by zone map entry idx */
+static inline BlockNumber
+sorted_heap_zone_first_block(SortedHeapRelInfo *info, uint32 idx)
+{
+	return (BlockNumber) idx * info->zm_zone_pages + 1;
 }
 
 extern Datum sorted_heap_tableam_handler(PG_FUNCTION_ARGS);
 extern Datum sorted_heap_zonemap_stats(PG_FUNCTION_ARGS);
 extern Datum sorted_heap_compact(PG_FUNCTION_ARGS);
 extern Datum sorted_heap_rebuild_zonemap_sql(PG_FUNCTION_ARGS);
+extern Datum sorted_heap_set_zone_pages_sql(PG_FUNCTION_ARGS);
+extern Datum sorted_heap_zonemap_memory(PG_FUNCTION_ARGS);
+extern Datum sorted_heap_zonemap_shared(PG_FUNCTION_ARGS);
 extern void sorted_heap_relcache_callback(Datum arg, Oid relid);
+extern void sorted_heap_xact_callback(XactEvent event, void *arg);
+extern void sorted_heap_rmgr_init(void);
 
 /* Exported for sorted_heap_scan.c */
 extern TableAmRoutine sorted_heap_am_routine;
@@ -163,6 +356,16 @@ extern Datum sorted_heap_merge(PG_FUNCTION_ARGS);
 extern Datum sorted_heap_merge_online(PG_FUNCTION_ARGS);
 extern BlockNumber sorted_heap_detect_sorted_prefix(SortedHeapRelInfo *info);
 extern void sorted_heap_zonemap_load(Relation rel, SortedHeapRelInfo *info);
+extern Size sorted_heap_zonemap_pending_size(Relation rel);
+extern void sorted_heap_zonemap_pending_save(Relation rel,
+											 SortedHeapZoneMapEntry *dest);
+extern void sorted_heap_zonemap_pending_adopt(Relation rel,
+											  const SortedHeapZoneMapEntry *src);
+extern void sorted_heap_zmcache_shmem_request(void);
+extern void sorted_heap_zmcache_shmem_startup(void);
+extern void sorted_heap_zmcache_init(void);
+extern uint32 sorted_heap_meta_zone_pages(Relation rel);
+extern void sorted_heap_set_zone_pages(Relation rel, uint32 zone_pages);
 extern void sorted_heap_rebuild_zonemap_internal(Relation rel, Oid pk_typid,
 												 AttrNumber pk_attnum,
 												 Oid pk_typid2,
@@ -179,5 +382,10 @@ typedef struct SortedHeapSharedStats
 /* GUC variables */
 extern bool sorted_heap_enable_scan_pruning;
 extern bool sorted_heap_vacuum_rebuild_zonemap;
+extern int	sorted_heap_zonemap_cache_size;
+extern bool sorted_heap_custom_wal;
+
+/* Holds backend-local zone maps; see sorted_heap_zonemap_memory() */
+extern MemoryContext sorted_heap_zonemap_context;
 
 #endif							/* SORTED_HEAP_H */
@@ -654,7 +654,8 @@ sorted_heap_compact_online(PG_FUNCTION_ARGS)
 							   &last_id, pk_tid_map,
 							   pk_attnum, pk_typid, pk_index_oid);
 
-		/* Rebuild zone map on new table */
+		/* Rebuild zone map on new table, at the table's zone granularity */
+		sorted_heap_set_zone_pages(new_rel, sorted_heap_meta_zone_pages(rel));
 		if (info->zm_usable)
 			sorted_heap_rebuild_zonemap_internal(new_rel, pk_typid, pk_attnum,
 												 info->zm_pk_typid2,
@@ -1087,7 +1088,8 @@ sorted_heap_merge_online(PG_FUNCTION_ARGS)
 							   &last_id, pk_tid_map,
 							   pk_attnum, pk_typid, pk_index_oid);
 
-		/* Rebuild zone map on new table */
+		/* Rebuild zone map on new table, at the table's zone granularity */
+		sorted_heap_set_zone_pages(new_rel, sorted_heap_meta_zone_pages(rel));
 		if (info->zm_usable)
 			sorted_heap_rebuild_zonemap_internal(new_rel, pk_typid, pk_attnum,
 												 info->zm_pk_typid2,
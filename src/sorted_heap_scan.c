@@ -6,16 +6,36 @@
  * Hooks into the planner via set_rel_pathlist_hook. When a query has
  * WHERE predicates on the first PK column of a sorted_heap table whose
  * zone map is valid (after COMPACT/REBUILD), we offer a CustomScan path
- * that restricts the heap scan to only matching blocks using
- * heap_setscanlimits().
+ * that reads only the matching blocks: the zone map is turned into a list
+ * of qualifying block ranges which feeds a read stream, so gaps between
+ * ranges are never read and upcoming blocks are prefetched.  Range bounds
+ * and "pk = ANY(array)" / IN-lists are both recognised; each key of an
+ * IN-list is looked up in the zone map separately.  Parallel
+ * scans share the same ranges through DSM and hand them out to
+ * participants in chunks.  Join clauses on the PK yield parameterized
+ * paths, so a nested loop can probe the table by key per outer row.
+ * Where the qualifying pages lie in the zone map's sorted prefix, ordered
+ * variants return rows in ascending or descending PK column 1 order and
+ * advertise the matching pathkeys, so ORDER BY, GROUP BY and merge joins
+ * need no Sort; a descending scan walks the ranges from their high end,
+ * so "ORDER BY pk DESC LIMIT n" reads only the last few pages.  Under a
+ * LIMIT on a single-table query the read stream is held to a block budget
+ * sized for the LIMIT, so keyset pagination prefetches nothing past the
+ * page or two it returns rows from.
  */
 #include "postgres.h"
 
 #include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/nbtree.h"
 #include "access/stratnum.h"
 #include "access/tableam.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_opclass.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#include "common/int.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
 #if PG_VERSION_NUM >= 180000
@@ -24,6 +44,7 @@
 #include "executor/executor.h"
 #include "nodes/extensible.h"
 #include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
 #include "nodes/pathnodes.h"
 #include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
@@ -31,17 +52,26 @@
 #include "optimizer/paths.h"
 #include "optimizer/restrictinfo.h"
 #include "miscadmin.h"
+#include "pgstat.h"
+#include "port/pg_bitutils.h"
+#include "storage/bufmgr.h"
 #include "storage/ipc.h"
+#include "storage/predicate.h"
+#include "storage/read_stream.h"
 #include "storage/shmem.h"
 #include "funcapi.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/tuplesort.h"
 
 #include "access/parallel.h"
 
 #include "sorted_heap.h"
 
+#include <math.h>
+
 /* ----------------------------------------------------------------
  *  Bounds extracted from WHERE clause
  * ---------------------------------------------------------------- */
@@ -62,32 +92,153 @@ typedef struct SortedHeapScanBounds
 	int64		hi2;
 } SortedHeapScanBounds;
 
+/*
+ * Column 1 as a union of closed intervals of zone map keys, sorted and
+ * disjoint: "pk = ANY(array)" / IN-lists give one point per key, OR trees
+ * of ranges one interval per branch.  Kept next to the bounds, which hold
+ * the union's hull.  SORTED_HEAP_NO_INTERVALS means no list applies.
+ */
+typedef struct SortedHeapInterval
+{
+	int64		lo;
+	int64		hi;
+} SortedHeapInterval;
+
+#define SORTED_HEAP_NO_INTERVALS	(-1)
+
+/* runtime_strategies marker for an "= ANY(array)" expression */
+#define SORTED_HEAP_STRATEGY_ANY	(BTMaxStrategyNumber + 1)
+
+/* ----------------------------------------------------------------
+ *  PK columns a clause may restrict, for bound extraction
+ * ---------------------------------------------------------------- */
+typedef struct SortedHeapExtractContext
+{
+	PlannerInfo *root;
+	Index		relid;
+	AttrNumber	pk_attno;
+	Oid			pk_typid;
+	Oid			opfamily;
+	AttrNumber	pk_attno2;		/* 0 if column 2 is not tracked */
+	Oid			pk_typid2;
+	Oid			opfamily2;
+	/* Output: Const bounds and intervals, deferred Param expressions */
+	SortedHeapScanBounds *bounds;
+	SortedHeapInterval **ivals;
+	int		   *nivals;
+	List	   *runtime_exprs;
+	List	   *runtime_meta;
+} SortedHeapExtractContext;
+
+/* ----------------------------------------------------------------
+ *  Qualifying data blocks: sorted, disjoint [start, start + nblocks)
+ * ---------------------------------------------------------------- */
+typedef struct SortedHeapBlockRange
+{
+	BlockNumber		start;
+	BlockNumber		nblocks;
+} SortedHeapBlockRange;
+
+/* ----------------------------------------------------------------
+ *  Parallel scan state in DSM
+ *
+ *  The leader publishes the qualifying block ranges and the bounds they
+ *  were computed from; participants claim fixed-size chunks of the
+ *  concatenated ranges through an atomic cursor, so no worker ever
+ *  visits a block outside them.  If a rescan produces more ranges than
+ *  the segment was sized for, a single covering range is published
+ *  instead and per-block zone map checks do the rest.  Those checks use
+ *  each worker's own zone map, so the leader's transaction's deferred
+ *  entries follow the ranges (sorted_heap_zonemap_pending_save) and
+ *  the workers adopt them.
+ * ---------------------------------------------------------------- */
+#define SORTED_HEAP_PARALLEL_MAX_CHUNK	64
+#define SORTED_HEAP_PARALLEL_MIN_RANGES	16
+
+typedef struct SortedHeapParallelScan
+{
+	BlockNumber		total_blocks;
+	BlockNumber		scan_nblocks;		/* sum of range lengths */
+	uint32			chunk_size;
+	pg_atomic_uint32 next_offset;		/* next unclaimed offset in ranges */
+	SortedHeapScanBounds bounds;
+	bool			ranges_sorted;		/* ranges lie in the sorted prefix */
+	int				max_ranges;			/* capacity of ranges[] */
+	Size			pending_size;		/* deferred entries after ranges[] */
+	int				nranges;
+	SortedHeapBlockRange ranges[FLEXIBLE_ARRAY_MEMBER];
+} SortedHeapParallelScan;
+
+/* Offset of the deferred entries, past room for max_ranges ranges */
+#define SORTED_HEAP_PARALLEL_PENDING_OFFSET(max_ranges) \
+	MAXALIGN(offsetof(SortedHeapParallelScan, ranges) + \
+			 (Size) (max_ranges) * sizeof(SortedHeapBlockRange))
+
+/* Zone map key of a visible tuple, for putting a page in PK order */
+typedef struct SortedHeapPageKey
+{
+	int64			key;
+	OffsetNumber	off;
+} SortedHeapPageKey;
+
 /* ----------------------------------------------------------------
  *  Custom scan state
  * ---------------------------------------------------------------- */
 typedef struct SortedHeapScanState
 {
 	CustomScanState css;
-	TableScanDesc	heap_scan;
 	SortedHeapScanBounds bounds;
+	SortedHeapInterval *ivals;			/* column 1 intervals, or NULL */
+	int				nivals;				/* SORTED_HEAP_NO_INTERVALS if none */
 	SortedHeapRelInfo *relinfo;
 	BlockNumber		total_blocks;
-	BlockNumber		scan_start;
-	BlockNumber		scan_nblocks;
+	/* Qualifying blocks computed from the zone map */
+	SortedHeapBlockRange *ranges;
+	int				nranges;
+	BlockNumber		scan_nblocks;		/* sum of range lengths */
+	/* Block cursor feeding the read stream */
+	ReadStream	   *stream;
+	BufferAccessStrategy strategy;
+	BlockNumber		next_pos;			/* offset into concatenated ranges */
+	BlockNumber		chunk_end;			/* parallel: end of claimed chunk */
+	int				cur_range;			/* range containing next_pos */
+	BlockNumber		range_base;			/* offset of cur_range's first block */
+	/* Current page: pinned buffer and its visible line pointers */
+	Buffer			cbuf;
+	BlockNumber		cblock;
+	int				ntuples;
+	int				cindex;
+	OffsetNumber	vistuples[MaxHeapTuplesPerPage];
+	HeapTupleData	ctup;
 	/* Per-scan stats for EXPLAIN ANALYZE */
-	BlockNumber		scanned_blocks;
-	BlockNumber		pruned_blocks;
-	BlockNumber		last_blk;			/* track block transitions */
-	/* Parallel support: PG's parallel table scan descriptor in DSM */
-	ParallelTableScanDesc pscan;		/* NULL for serial scans */
+	BlockNumber		scanned_blocks;		/* pages read */
+	BlockNumber		searched_blocks;	/* pages binary-searched */
+	BlockNumber		pruned_blocks;		/* pages never read */
+	bool			pass_counted;		/* range-level pruning accounted */
+	/* Parallel support: shared ranges/cursor in DSM */
+	SortedHeapParallelScan *pstate;		/* NULL for serial scans */
 	/* Runtime parameter resolution (Path B — prepared statements) */
 	bool			runtime_bounds;		/* true if bounds have Param nodes */
+	bool			runtime_ready;		/* Params evaluated for this pass */
 	int				n_runtime_exprs;
 	List		   *runtime_exprstates;	/* ExprState* list */
 	int			   *runtime_strategies;
 	bool		   *runtime_is_col2;
 	Oid			   *runtime_typids;
 	SortedHeapScanBounds const_bounds;	/* Const-only baseline for rescan */
+	SortedHeapInterval *const_ivals;
+	int				n_const_ivals;
+	/* Ordered scan: rows in PK column 1 order */
+	ScanDirection	order_dir;			/* NoMovement if no order promised */
+	bool			ranges_sorted;		/* pages come in PK order */
+	Tuplesortstate *tidsort;			/* else (key, tid) sort of the pass */
+	TupleDesc		tidsort_desc;
+	TupleTableSlot *tidsort_slot;
+	/* LIMIT pacing: blocks handed to the read stream per pass */
+	BlockNumber		block_budget;		/* planned budget, 0 if unbounded */
+	BlockNumber		issue_budget;		/* this pass's budget, 0 if none */
+	BlockNumber		issued_blocks;
+	bool			stream_paused;		/* stream ended on the budget */
 } SortedHeapScanState;
 
 /* ----------------------------------------------------------------
@@ -97,23 +248,68 @@ static void sorted_heap_set_rel_pathlist(PlannerInfo *root,
 										 RelOptInfo *rel,
 										 Index rti,
 										 RangeTblEntry *rte);
-static bool sorted_heap_extract_bounds(RelOptInfo *rel,
+static CustomPath *sorted_heap_create_path(PlannerInfo *root,
+											RelOptInfo *rel,
+											SortedHeapRelInfo *info,
+											BlockNumber total_blocks,
+											ParamPathInfo *param_info,
+											List *pathkeys,
+											ScanDirection order_dir,
+											BlockNumber *nblocks_out);
+static void sorted_heap_add_partial_path(RelOptInfo *rel, CustomPath *cpath,
+										 BlockNumber nblocks);
+static void sorted_heap_add_ordered_paths(PlannerInfo *root,
+										  RelOptInfo *rel,
+										  RangeTblEntry *rte,
+										  SortedHeapRelInfo *info,
+										  BlockNumber total_blocks,
+										  ScanDirection order_dir);
+static bool sorted_heap_is_text_type(Oid typid);
+static bool sorted_heap_ranges_sorted(SortedHeapRelInfo *info,
+									  SortedHeapBlockRange *ranges,
+									  int nranges);
+static void sorted_heap_add_param_paths(PlannerInfo *root, RelOptInfo *rel,
+										SortedHeapRelInfo *info,
+										BlockNumber total_blocks);
+static bool sorted_heap_extract_bounds(PlannerInfo *root,
+									   RelOptInfo *rel,
+									   List *clauses,
 									   AttrNumber pk_attno,
 									   Oid pk_typid,
 									   AttrNumber pk_attno2,
 									   Oid pk_typid2,
 									   SortedHeapScanBounds *bounds,
+									   SortedHeapInterval **ivals,
+									   int *nivals,
 									   List **runtime_exprs,
 									   List **runtime_meta,
 									   List **pk_clauses);
 static void sorted_heap_apply_bound(SortedHeapScanBounds *bounds,
 									int strategy, bool is_col2, int64 val);
+static void sorted_heap_apply_intervals(SortedHeapScanBounds *bounds,
+										SortedHeapInterval **ivalset,
+										int *nivalset, bool is_col2,
+										SortedHeapInterval *ivals,
+										int nivals);
+static bool sorted_heap_array_to_intervals(Datum arraydatum, Oid coltypid,
+										   SortedHeapInterval **ivals,
+										   int *nivals);
+static List *sorted_heap_pack_bounds(SortedHeapScanBounds *bounds);
+static void sorted_heap_unpack_bounds(List *list,
+									  SortedHeapScanBounds *bounds);
+static List *sorted_heap_pack_intervals(SortedHeapInterval *ivals,
+										int nivals);
+static SortedHeapInterval *sorted_heap_unpack_intervals(List *list,
+														int *nivals);
 static void sorted_heap_resolve_runtime_bounds(SortedHeapScanState *shstate);
-static void sorted_heap_compute_block_range(SortedHeapRelInfo *info,
-											SortedHeapScanBounds *bounds,
-											BlockNumber total_blocks,
-											BlockNumber *start_block,
-											BlockNumber *nblocks);
+static SortedHeapBlockRange *sorted_heap_compute_block_ranges(SortedHeapRelInfo *info,
+															  SortedHeapScanBounds *bounds,
+															  SortedHeapInterval *ivals,
+															  int nivals,
+															  BlockNumber total_blocks,
+															  int *nranges,
+															  BlockNumber *nblocks);
+static void sorted_heap_compute_scan_ranges(SortedHeapScanState *shstate);
 static bool sorted_heap_zone_overlaps(SortedHeapZoneMapEntry *e,
 									  SortedHeapScanBounds *bounds);
 
@@ -204,6 +400,7 @@ sorted_heap_shmem_request(void)
 	if (prev_shmem_request_hook)
 		prev_shmem_request_hook();
 	RequestAddinShmemSpace(MAXALIGN(sizeof(SortedHeapSharedStats)));
+	sorted_heap_zmcache_shmem_request();
 }
 
 static void
@@ -223,6 +420,8 @@ sorted_heap_shmem_startup(void)
 		pg_atomic_init_u64(&sh_shared_stats->blocks_scanned, 0);
 		pg_atomic_init_u64(&sh_shared_stats->blocks_pruned, 0);
 	}
+
+	sorted_heap_zmcache_shmem_startup();
 }
 
 /* ----------------------------------------------------------------
@@ -251,10 +450,8 @@ sorted_heap_set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 {
 	Relation			table_rel;
 	SortedHeapRelInfo  *info;
-	SortedHeapScanBounds bounds;
-	BlockNumber			start_block, nblocks, total_blocks;
+	BlockNumber			nblocks, total_blocks;
 	CustomPath		   *cpath;
-	double				sel;
 
 	/* Chain to previous hook */
 	if (prev_set_rel_pathlist_hook)
@@ -264,12 +461,12 @@ sorted_heap_set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 	if (!sorted_heap_enable_scan_pruning)
 		return;
 
-	/* Only base relations with restrictions */
+	/* Only base relations with restrictions, joins or a wanted order */
 	if (rel->reloptkind != RELOPT_BASEREL)
 		return;
 	if (rte->rtekind != RTE_RELATION)
 		return;
-	if (rel->baserestrictinfo == NIL)
+	if (rel->baserestrictinfo == NIL && !has_useful_pathkeys(root, rel))
 		return;
 
 	/* Check if this is a sorted_heap table */
@@ -294,176 +491,406 @@ sorted_heap_set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 		return;
 	}
 
-	/* Extract PK bounds from baserestrictinfo */
-	{
-		List	   *runtime_exprs = NIL;
-		List	   *runtime_meta = NIL;
-		List	   *pk_clauses = NIL;
+	total_blocks = RelationGetNumberOfBlocks(table_rel);
+	table_close(table_rel, NoLock);
+
+	if (total_blocks <= 1)
+		return;
 
-		if (!sorted_heap_extract_bounds(rel, info->attNums[0],
-										info->zm_pk_typid,
-										info->zm_col2_usable ?
-										info->attNums[1] : 0,
-										info->zm_pk_typid2,
-										&bounds,
-										&runtime_exprs,
-										&runtime_meta,
-										&pk_clauses))
+	/* Parameterized paths: probe the PK once per outer row */
+	if (rel->joininfo != NIL || rel->has_eclass_joins)
+		sorted_heap_add_param_paths(root, rel, info, total_blocks);
+
+	/* Unparameterized path from baserestrictinfo */
+	if (rel->baserestrictinfo != NIL)
+	{
+		cpath = sorted_heap_create_path(root, rel, info, total_blocks, NULL,
+										NIL, NoMovementScanDirection,
+										&nblocks);
+		if (cpath != NULL)
 		{
-			table_close(table_rel, NoLock);
-			return;
+			add_path(rel, &cpath->path);
+			sorted_heap_add_partial_path(rel, cpath, nblocks);
 		}
+	}
 
-		total_blocks = RelationGetNumberOfBlocks(table_rel);
-		table_close(table_rel, NoLock);
+	/* Ordered variants, if the query can use PK order either way */
+	sorted_heap_add_ordered_paths(root, rel, rte, info, total_blocks,
+								  ForwardScanDirection);
+	sorted_heap_add_ordered_paths(root, rel, rte, info, total_blocks,
+								  BackwardScanDirection);
+}
+
+/* ----------------------------------------------------------------
+ *  Offer a parallel partial copy of cpath if beneficial.  An ordered
+ *  path stays ordered per participant, which Gather Merge relies on.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_add_partial_path(RelOptInfo *rel, CustomPath *cpath,
+							 BlockNumber nblocks)
+{
+	int		pw;
+	CustomPath *ppath;
+
+	if (!rel->consider_parallel || nblocks == 0)
+		return;
+
+	pw = compute_parallel_worker(rel, (double) nblocks, -1,
+								 max_parallel_workers_per_gather);
+	if (pw <= 0)
+		return;
+
+	ppath = makeNode(CustomPath);
+	ppath->path.type = T_CustomPath;
+	ppath->path.pathtype = T_CustomScan;
+	ppath->path.parent = rel;
+	ppath->path.pathtarget = rel->reltarget;
+	ppath->path.param_info = NULL;
+	ppath->path.parallel_aware = true;
+	ppath->path.parallel_safe = true;
+	ppath->path.parallel_workers = pw;
+	ppath->path.pathkeys = cpath->path.pathkeys;
+
+	/* Per-worker cost: divide total among participants */
+	ppath->path.rows = cpath->path.rows;
+	ppath->path.startup_cost = 0;
+	ppath->path.total_cost = cpath->path.total_cost / (pw + 1);
+
+	ppath->flags = 0;
+	ppath->methods = &sorted_heap_path_methods;
+	ppath->custom_private = cpath->custom_private;
+
+	add_partial_path(rel, &ppath->path);
+}
+
+/* ----------------------------------------------------------------
+ *  Offer an ordered path in PK column 1 order (ascending for a forward
+ *  scan, descending for a backward one), if the query has a use for it.
+ *
+ *  Only exact key types qualify: page order is proven from zone map
+ *  keys, and a lossy key (uuid, text prefix) equal at a page boundary
+ *  says nothing about the order of the values behind it.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_add_ordered_paths(PlannerInfo *root, RelOptInfo *rel,
+							  RangeTblEntry *rte, SortedHeapRelInfo *info,
+							  BlockNumber total_blocks,
+							  ScanDirection order_dir)
+{
+	bool		reverse;
+	Oid			sortop = info->sortOperators[0];
+	Oid			typid;
+	int32		typmod;
+	Oid			collid;
+	Var		   *var;
+	List	   *pathkeys;
+	CustomPath *cpath;
+	BlockNumber nblocks;
+
+	if (!has_useful_pathkeys(root, rel))
+		return;
+	if (info->zm_pk_typid == UUIDOID ||
+		sorted_heap_is_text_type(info->zm_pk_typid))
+		return;
 
-		if (total_blocks <= 1)
+	/* A DESC PK column is compacted in descending order */
+	if (!OidIsValid(get_equality_op_for_ordering_op(sortop, &reverse)) ||
+		reverse)
+		return;
+	if (ScanDirectionIsBackward(order_dir))
+	{
+		sortop = get_commutator(sortop);
+		if (!OidIsValid(sortop))
 			return;
+	}
 
-		/* Create CustomPath */
-		cpath = makeNode(CustomPath);
-		cpath->path.type = T_CustomPath;
-		cpath->path.pathtype = T_CustomScan;
-		cpath->path.parent = rel;
-		cpath->path.pathtarget = rel->reltarget;
-		cpath->path.param_info = NULL;
-		cpath->path.parallel_aware = false;
-		cpath->path.parallel_safe = rel->consider_parallel;
-		cpath->path.parallel_workers = 0;
-		cpath->path.pathkeys = NIL;
-		cpath->flags = 0;
-		cpath->methods = &sorted_heap_path_methods;
-
-		if (runtime_exprs == NIL)
-		{
-			/* Path A: all Const — compute block range now */
-			sorted_heap_compute_block_range(info, &bounds, total_blocks,
-											&start_block, &nblocks);
+	get_atttypetypmodcoll(rte->relid, info->attNums[0],
+						  &typid, &typmod, &collid);
+	var = makeVar(rel->relid, info->attNums[0], typid, typmod, collid, 0);
 
-			if (nblocks >= total_blocks)
-				return;
+	pathkeys = build_expression_pathkey(root, (Expr *) var, sortop,
+										rel->relids, false);
+	pathkeys = truncate_useless_pathkeys(root, rel, pathkeys);
+	if (pathkeys == NIL)
+		return;
 
-			sel = (double) nblocks / (double) total_blocks;
-			cpath->path.rows = clamp_row_est(rel->rows * sel);
-			cpath->path.startup_cost = 0;
-			cpath->path.total_cost = seq_page_cost * nblocks +
-				cpu_tuple_cost * rel->tuples * sel +
-				cpu_operator_cost * rel->tuples * sel;
+	cpath = sorted_heap_create_path(root, rel, info, total_blocks, NULL,
+									pathkeys, order_dir, &nblocks);
+	if (cpath != NULL)
+	{
+		add_path(rel, &cpath->path);
+		sorted_heap_add_partial_path(rel, cpath, nblocks);
+	}
+}
 
-			/* Pack range + bounds into custom_private */
-			{
-				List *range_list = NIL;
-				List *bounds_list = NIL;
-
-				range_list = lappend_int(range_list, (int32) start_block);
-				range_list = lappend_int(range_list, (int32) nblocks);
-				range_list = lappend_int(range_list, (int32) total_blocks);
-
-				bounds_list = lappend_int(bounds_list, bounds.has_lo ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.has_hi ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.lo_inclusive ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.hi_inclusive ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.lo >> 32));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.lo & 0xFFFFFFFF));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.hi >> 32));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.hi & 0xFFFFFFFF));
-
-				bounds_list = lappend_int(bounds_list, bounds.has_lo2 ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.has_hi2 ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.lo2_inclusive ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, bounds.hi2_inclusive ? 1 : 0);
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.lo2 >> 32));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.lo2 & 0xFFFFFFFF));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.hi2 >> 32));
-				bounds_list = lappend_int(bounds_list, (int32) (bounds.hi2 & 0xFFFFFFFF));
-
-				cpath->custom_private = list_make2(range_list, bounds_list);
-			}
+/* ----------------------------------------------------------------
+ *  Build a SortedHeapScan path over baserestrictinfo plus, for a
+ *  parameterized path, the join clauses param_info moves down to the
+ *  scan.  Returns NULL if no clause bounds the PK (for a parameterized
+ *  path: no join clause does) or, for Const bounds, if the zone map
+ *  prunes nothing.  *nblocks_out gets the estimated blocks read.
+ *
+ *  With pathkeys the path is an ordered variant scanning in order_dir,
+ *  worth having even without any bound; it is only built if the pages
+ *  it may read are known to be in PK order.
+ * ---------------------------------------------------------------- */
+static CustomPath *
+sorted_heap_create_path(PlannerInfo *root, RelOptInfo *rel,
+						SortedHeapRelInfo *info, BlockNumber total_blocks,
+						ParamPathInfo *param_info, List *pathkeys,
+						ScanDirection order_dir, BlockNumber *nblocks_out)
+{
+	SortedHeapScanBounds bounds;
+	SortedHeapInterval *ivals;
+	int			nivals;
+	List	   *clauses = rel->baserestrictinfo;
+	List	   *runtime_exprs = NIL;
+	List	   *runtime_meta = NIL;
+	List	   *pk_clauses = NIL;
+	CustomPath *cpath;
+	BlockNumber nblocks;
+	BlockNumber budget = 0;
+	double		sel;
+
+	if (param_info != NULL)
+		clauses = list_concat_copy(clauses, param_info->ppi_clauses);
+
+	if (!sorted_heap_extract_bounds(root, rel, clauses,
+									info->attNums[0],
+									info->zm_pk_typid,
+									info->zm_col2_usable ?
+									info->attNums[1] : 0,
+									info->zm_pk_typid2,
+									&bounds,
+									&ivals, &nivals,
+									&runtime_exprs,
+									&runtime_meta,
+									&pk_clauses) &&
+		pathkeys == NIL)
+		return NULL;
+
+	if (param_info != NULL)
+	{
+		bool		join_bound = false;
+		ListCell   *lc;
+
+		foreach(lc, pk_clauses)
+		{
+			if (list_member_ptr(param_info->ppi_clauses, lfirst(lc)))
+				join_bound = true;
 		}
-		else
+		if (!join_bound)
+			return NULL;
+	}
+
+	/* Create CustomPath */
+	cpath = makeNode(CustomPath);
+	cpath->path.type = T_CustomPath;
+	cpath->path.pathtype = T_CustomScan;
+	cpath->path.parent = rel;
+	cpath->path.pathtarget = rel->reltarget;
+	cpath->path.param_info = param_info;
+	cpath->path.parallel_aware = false;
+	cpath->path.parallel_safe = rel->consider_parallel;
+	cpath->path.parallel_workers = 0;
+	cpath->path.pathkeys = pathkeys;
+	cpath->flags = 0;
+	cpath->methods = &sorted_heap_path_methods;
+
+	if (runtime_exprs == NIL)
+	{
+		/* Path A: all Const — estimate qualifying blocks now */
+		SortedHeapBlockRange *ranges;
+		int			nranges;
+
+		ranges = sorted_heap_compute_block_ranges(info, &bounds,
+												  ivals, nivals,
+												  total_blocks,
+												  &nranges, &nblocks);
+		/* Unordered: no point unless blocks are pruned */
+		if (pathkeys == NIL ? nblocks >= total_blocks :
+			!sorted_heap_ranges_sorted(info, ranges, nranges))
 		{
-			/* Path B: has Params — defer block range to executor */
-			Selectivity		pk_sel;
-			List		   *meta_list = NIL;
-			List		   *const_bounds_list = NIL;
-
-			pk_sel = clauselist_selectivity(root, pk_clauses,
-											0, JOIN_INNER, NULL);
-			nblocks = (BlockNumber) clamp_row_est(total_blocks * pk_sel);
-			if (nblocks < 1)
-				nblocks = 1;
-
-			sel = (double) nblocks / (double) total_blocks;
-			cpath->path.rows = clamp_row_est(rel->rows * sel);
-			cpath->path.startup_cost = 0;
-			cpath->path.total_cost = seq_page_cost * nblocks +
-				cpu_tuple_cost * rel->tuples * sel +
-				cpu_operator_cost * rel->tuples * sel;
-
-			/* Meta: [total_blocks, n_runtime_exprs] */
-			meta_list = lappend_int(meta_list, (int32) total_blocks);
-			meta_list = lappend_int(meta_list,
-									list_length(runtime_exprs));
-
-			/* Pack Const-only bounds (baseline for mixed Const+Param) */
-			const_bounds_list = lappend_int(const_bounds_list, bounds.has_lo ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.has_hi ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.lo_inclusive ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.hi_inclusive ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.lo >> 32));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.lo & 0xFFFFFFFF));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.hi >> 32));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.hi & 0xFFFFFFFF));
-
-			const_bounds_list = lappend_int(const_bounds_list, bounds.has_lo2 ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.has_hi2 ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.lo2_inclusive ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, bounds.hi2_inclusive ? 1 : 0);
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.lo2 >> 32));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.lo2 & 0xFFFFFFFF));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.hi2 >> 32));
-			const_bounds_list = lappend_int(const_bounds_list, (int32) (bounds.hi2 & 0xFFFFFFFF));
-
-			cpath->custom_private = list_make4(meta_list, runtime_meta,
-											   const_bounds_list,
-											   runtime_exprs);
+			pfree(ranges);
+			return NULL;
 		}
+		pfree(ranges);
+
+		sel = (double) nblocks / (double) total_blocks;
+		cpath->path.rows = clamp_row_est(rel->rows * sel);
+		cpath->path.startup_cost = 0;
+
+		/* Each range after the first costs a seek */
+		cpath->path.total_cost = seq_page_cost * nblocks +
+			(random_page_cost - seq_page_cost) * Max(nranges - 1, 0) +
+			cpu_tuple_cost * rel->tuples * sel +
+			cpu_operator_cost * rel->tuples * sel;
+	}
+	else
+	{
+		/* Path B: has Params — defer block range to executor */
+		Selectivity		pk_sel;
+		SortedHeapBlockRange all_pages;
+
+		/* Ordered: whichever pages the Params select must be in order */
+		all_pages.start = 1;
+		all_pages.nblocks = total_blocks - 1;
+		if (pathkeys != NIL &&
+			!sorted_heap_ranges_sorted(info, &all_pages, 1))
+			return NULL;
+
+		/* Outer values in join clauses are estimated as unknown constants */
+		pk_sel = clauselist_selectivity(root, pk_clauses,
+										rel->relid, JOIN_INNER, NULL);
+		nblocks = (BlockNumber) clamp_row_est(total_blocks * pk_sel);
+		if (nblocks < 1)
+			nblocks = 1;
+
+		sel = (double) nblocks / (double) total_blocks;
+		cpath->path.rows = param_info ? param_info->ppi_rows :
+			clamp_row_est(rel->rows * sel);
+		cpath->path.startup_cost = 0;
+		cpath->path.total_cost = seq_page_cost * nblocks +
+			cpu_tuple_cost * rel->tuples * sel +
+			cpu_operator_cost * rel->tuples * sel;
+
+		/* Each probe of a parameterized scan starts with a seek */
+		if (param_info != NULL)
+			cpath->path.total_cost += random_page_cost - seq_page_cost;
+	}
+
+	/* Ordered: each page's keys are read and checked for order */
+	if (pathkeys != NIL)
+		cpath->path.total_cost += cpu_operator_cost * rel->tuples * sel;
+
+	/*
+	 * A LIMIT bounds this scan's own output when the query reads just this
+	 * relation and the path already yields rows in the order the LIMIT is
+	 * taken in.  Keyset pagination ("id > $1 ORDER BY id LIMIT 10") then
+	 * needs only the first page or two of the range, so the read stream is
+	 * held to a block budget enough for the LIMIT at the estimated rows per
+	 * block, and widened if the rows run out first.  Only I/O is paced:
+	 * the scan still returns every row it is asked for.
+	 */
+	if (param_info == NULL && nblocks > 0 && root->limit_tuples > 0 &&
+		bms_equal(root->all_baserels, rel->relids) &&
+		pathkeys_contained_in(root->query_pathkeys, pathkeys))
+	{
+		double		rows_per_block = cpath->path.rows / (double) nblocks;
+		double		need = ceil(root->limit_tuples / rows_per_block) + 1;
+
+		if (need < (double) nblocks)
+			budget = (BlockNumber) need;
 	}
 
-	add_path(rel, &cpath->path);
+	/*
+	 * custom_private = [meta, runtime_meta, bounds, intervals,
+	 * runtime_exprs] with meta = [total_blocks, n_runtime_exprs,
+	 * order_dir, block_budget].  Path A has no runtime expressions; for
+	 * Path B the bounds and intervals are the Const-only baseline the
+	 * Params are merged into.  Block ranges are recomputed at executor
+	 * startup from the current zone map, so cached plans never scan with
+	 * a stale range.
+	 */
+	cpath->custom_private =
+		list_make5(list_make4_int((int32) total_blocks,
+								  list_length(runtime_exprs),
+								  (int) order_dir,
+								  (int32) budget),
+				   runtime_meta,
+				   sorted_heap_pack_bounds(&bounds),
+				   sorted_heap_pack_intervals(ivals, nivals),
+				   runtime_exprs);
+
+	if (nblocks_out)
+		*nblocks_out = nblocks;
+	return cpath;
+}
+
+/*
+ * generate_implied_equalities_for_column() callback: EC members that are
+ * PK column 1 of the scanned relation.
+ */
+static bool
+sorted_heap_ec_member_matches_pk(PlannerInfo *root, RelOptInfo *rel,
+								 EquivalenceClass *ec,
+								 EquivalenceMember *em, void *arg)
+{
+	AttrNumber	pk_attno = *(AttrNumber *) arg;
+	Var		   *var = (Var *) em->em_expr;
+
+	return IsA(var, Var) && var->varno == rel->relid &&
+		var->varattno == pk_attno && var->varlevelsup == 0;
+}
+
+/* ----------------------------------------------------------------
+ *  Offer parameterized paths for join clauses on the PK.
+ *
+ *  As an inner side of a nested loop, the scan turns each outer row's
+ *  join key into a bound and reads only the one or two blocks the zone
+ *  map admits.  Candidate clauses are equalities implied by equivalence
+ *  classes ("e.id = o.event_id") and other join clauses movable to this
+ *  scan ("e.id < o.until_id"); one path is offered per distinct set of
+ *  outer relations they need.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_add_param_paths(PlannerInfo *root, RelOptInfo *rel,
+							SortedHeapRelInfo *info,
+							BlockNumber total_blocks)
+{
+	List	   *candidates = NIL;
+	List	   *outer_sets = NIL;
+	ListCell   *lc;
+
+	if (rel->has_eclass_joins)
+		candidates = generate_implied_equalities_for_column(root, rel,
+															sorted_heap_ec_member_matches_pk,
+															&info->attNums[0],
+															rel->lateral_referencers);
+
+	foreach(lc, rel->joininfo)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+		if (join_clause_is_movable_to(rinfo, rel))
+			candidates = lappend(candidates, rinfo);
+	}
 
-	/* Also offer a parallel partial path if beneficial */
-	if (rel->consider_parallel && nblocks > 0)
+	foreach(lc, candidates)
 	{
-		int		pw;
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Relids		required_outer;
+		bool		seen = false;
+		ListCell   *lc2;
+
+		required_outer = bms_union(bms_difference(rinfo->clause_relids,
+												  rel->relids),
+								   rel->lateral_relids);
+		if (bms_is_empty(required_outer) ||
+			bms_overlap(required_outer, rel->lateral_referencers))
+			continue;
 
-		pw = compute_parallel_worker(rel, (double) nblocks, -1,
-									 max_parallel_workers_per_gather);
-		if (pw > 0)
+		foreach(lc2, outer_sets)
 		{
-			CustomPath *ppath = makeNode(CustomPath);
-
-			ppath->path.type = T_CustomPath;
-			ppath->path.pathtype = T_CustomScan;
-			ppath->path.parent = rel;
-			ppath->path.pathtarget = rel->reltarget;
-			ppath->path.param_info = NULL;
-			ppath->path.parallel_aware = true;
-			ppath->path.parallel_safe = true;
-			ppath->path.parallel_workers = pw;
-			ppath->path.pathkeys = NIL;
-
-			/* Per-worker cost: divide total among participants */
-			ppath->path.rows = cpath->path.rows;
-			ppath->path.startup_cost = 0;
-			ppath->path.total_cost = cpath->path.total_cost / (pw + 1);
-
-			ppath->flags = 0;
-			ppath->methods = &sorted_heap_path_methods;
-			ppath->custom_private = cpath->custom_private;
-
-			add_partial_path(rel, &ppath->path);
+			if (bms_equal((Relids) lfirst(lc2), required_outer))
+				seen = true;
 		}
+		if (!seen)
+			outer_sets = lappend(outer_sets, required_outer);
+	}
+
+	foreach(lc, outer_sets)
+	{
+		ParamPathInfo *param_info;
+		CustomPath *cpath;
+
+		param_info = get_baserel_parampathinfo(root, rel,
+											   (Relids) lfirst(lc));
+		cpath = sorted_heap_create_path(root, rel, info, total_blocks,
+										param_info, NIL,
+										NoMovementScanDirection, NULL);
+		if (cpath != NULL)
+			add_path(rel, &cpath->path);
 	}
 }
 
@@ -578,344 +1005,1419 @@ sorted_heap_apply_bound(SortedHeapScanBounds *bounds,
 }
 
 /* ----------------------------------------------------------------
- *  Extract PK bounds from baserestrictinfo
+ *  Column 1 interval lists
+ *
+ *  Intervals are closed: a strict bound on an exact key type is moved
+ *  one key inwards, and lossy key types only carry non-strict bounds
+ *  (see sorted_heap_relax_strategy), so open ends are never needed.
  * ---------------------------------------------------------------- */
-static bool
-sorted_heap_extract_bounds(RelOptInfo *rel, AttrNumber pk_attno,
-						   Oid pk_typid, AttrNumber pk_attno2,
-						   Oid pk_typid2,
-						   SortedHeapScanBounds *bounds,
-						   List **runtime_exprs,
-						   List **runtime_meta,
-						   List **pk_clauses_out)
+static int
+sorted_heap_cmp_interval(const void *a, const void *b)
 {
-	ListCell   *lc;
-	Oid			opfamily;
-	Oid			opcid;
-	Oid			opfamily2 = InvalidOid;
+	const SortedHeapInterval *ia = (const SortedHeapInterval *) a;
+	const SortedHeapInterval *ib = (const SortedHeapInterval *) b;
 
-	memset(bounds, 0, sizeof(SortedHeapScanBounds));
-	*runtime_exprs = NIL;
-	*runtime_meta = NIL;
-	*pk_clauses_out = NIL;
+	return pg_cmp_s64(ia->lo, ib->lo);
+}
 
-	/* Get btree opfamily for column 1 */
-	opcid = GetDefaultOpClass(pk_typid, BTREE_AM_OID);
-	if (!OidIsValid(opcid))
-		return false;
-	opfamily = get_opclass_family(opcid);
-	if (!OidIsValid(opfamily))
-		return false;
+/*
+ * Sort intervals and merge overlapping or adjacent ones in place;
+ * returns the new count.
+ */
+static int
+sorted_heap_intervals_normalize(SortedHeapInterval *ivals, int nivals)
+{
+	int			n = 0;
 
-	/* Get btree opfamily for column 2 (if available) */
-	if (OidIsValid(pk_typid2) && pk_attno2 != 0)
-	{
-		Oid		opcid2 = GetDefaultOpClass(pk_typid2, BTREE_AM_OID);
+	if (nivals <= 1)
+		return nivals;
 
-		if (OidIsValid(opcid2))
-			opfamily2 = get_opclass_family(opcid2);
-	}
+	qsort(ivals, nivals, sizeof(SortedHeapInterval),
+		  sorted_heap_cmp_interval);
 
-	foreach(lc, rel->baserestrictinfo)
+	for (int i = 0; i < nivals; i++)
 	{
-		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
-		OpExpr	   *opexpr;
-		Var		   *var;
-		Node	   *val_node;
-		int			strategy;
-		bool		varonleft;
-		bool		is_const;
-		bool		is_col2 = false;
-		Oid			match_typid;
-
-		if (!IsA(rinfo->clause, OpExpr))
-			continue;
-
-		opexpr = (OpExpr *) rinfo->clause;
-		if (list_length(opexpr->args) != 2)
-			continue;
-
-		/* Check for Var op {Const|Param} or {Const|Param} op Var */
-		if (IsA(linitial(opexpr->args), Var) &&
-			(IsA(lsecond(opexpr->args), Const) ||
-			 IsA(lsecond(opexpr->args), Param)))
-		{
-			var = (Var *) linitial(opexpr->args);
-			val_node = (Node *) lsecond(opexpr->args);
-			varonleft = true;
-		}
-		else if ((IsA(linitial(opexpr->args), Const) ||
-				  IsA(linitial(opexpr->args), Param)) &&
-				 IsA(lsecond(opexpr->args), Var))
-		{
-			val_node = (Node *) linitial(opexpr->args);
-			var = (Var *) lsecond(opexpr->args);
-			varonleft = false;
-		}
-		else
-			continue;
-
-		is_const = IsA(val_node, Const);
-
-		/* Match to PK column 1 or column 2 */
-		if (var->varattno == pk_attno)
-		{
-			is_col2 = false;
-			match_typid = pk_typid;
-		}
-		else if (pk_attno2 != 0 && var->varattno == pk_attno2 &&
-				 OidIsValid(opfamily2))
+		if (n > 0)
 		{
-			is_col2 = true;
-			match_typid = pk_typid2;
-		}
-		else
-			continue;
-
-		if (is_const && ((Const *) val_node)->constisnull)
-			continue;
-
-		/* Determine btree strategy */
-		strategy = get_op_opfamily_strategy(opexpr->opno,
-											is_col2 ? opfamily2 : opfamily);
-		if (strategy == 0)
-			continue;
+			SortedHeapInterval *last = &ivals[n - 1];
 
-		/* If var is on right, flip strategy */
-		if (!varonleft)
-		{
-			switch (strategy)
+			/* Adjacent means no key lies between the two */
+			if (last->hi == PG_INT64_MAX || ivals[i].lo <= last->hi + 1)
 			{
-				case BTLessStrategyNumber:
-					strategy = BTGreaterStrategyNumber;
-					break;
-				case BTLessEqualStrategyNumber:
-					strategy = BTGreaterEqualStrategyNumber;
-					break;
-				case BTGreaterStrategyNumber:
-					strategy = BTLessStrategyNumber;
-					break;
-				case BTGreaterEqualStrategyNumber:
-					strategy = BTLessEqualStrategyNumber;
-					break;
-			}
-		}
-
-		/* Collect matching RestrictInfo for selectivity estimation */
-		*pk_clauses_out = lappend(*pk_clauses_out, rinfo);
-
-		if (is_const)
-		{
-			/* Const: resolve at plan time */
-			int64	int_val;
-
-			if (!sorted_heap_key_to_int64(((Const *) val_node)->constvalue,
-										  match_typid, &int_val))
+				last->hi = Max(last->hi, ivals[i].hi);
 				continue;
-			sorted_heap_apply_bound(bounds, strategy, is_col2, int_val);
-		}
-		else
-		{
-			/* Param: defer to executor */
-			*runtime_exprs = lappend(*runtime_exprs, val_node);
-			*runtime_meta = lappend_int(*runtime_meta, strategy);
-			*runtime_meta = lappend_int(*runtime_meta, is_col2 ? 1 : 0);
-			*runtime_meta = lappend_int(*runtime_meta, (int) match_typid);
+			}
 		}
+		ivals[n++] = ivals[i];
 	}
-
-	return bounds->has_lo || bounds->has_hi ||
-		   bounds->has_lo2 || bounds->has_hi2 ||
-		   *runtime_exprs != NIL;
+	return n;
 }
 
-/* ----------------------------------------------------------------
- *  Binary search helpers for monotonic zone maps.
- *
- *  After compact, zone map entries have non-decreasing zme_min and
- *  zme_max values (data is physically sorted).  This enables O(log N)
- *  block range computation instead of O(N) linear scan.
- * ---------------------------------------------------------------- */
-
 /*
- * Find first entry index where zme_max >= lo (or > lo if !inclusive).
- * Returns count if no such entry exists.
+ * Narrow *ivals to its intersection with other (both normalized).
+ * SORTED_HEAP_NO_INTERVALS on the left adopts other; both inputs are
+ * consumed.
  */
-static uint32
-zm_bsearch_first(SortedHeapRelInfo *info, int64 lo, bool inclusive,
-				 uint32 count)
+static void
+sorted_heap_intervals_intersect(SortedHeapInterval **ivals, int *nivals,
+								SortedHeapInterval *other, int nother)
 {
-	uint32	low = 0, high = count;
+	SortedHeapInterval *cur = *ivals;
+	SortedHeapInterval *out;
+	int			i = 0,
+				j = 0,
+				n = 0;
 
-	while (low < high)
+	if (*nivals == SORTED_HEAP_NO_INTERVALS)
 	{
-		uint32	mid = low + (high - low) / 2;
-		SortedHeapZoneMapEntry *e = sorted_heap_get_zm_entry(info, mid);
-		bool	below;
+		*ivals = other;
+		*nivals = nother;
+		return;
+	}
 
-		below = inclusive ? (e->zme_max < lo) : (e->zme_max <= lo);
-		if (below)
-			low = mid + 1;
+	out = palloc(Max(*nivals + nother, 1) * sizeof(SortedHeapInterval));
+	while (i < *nivals && j < nother)
+	{
+		int64		lo = Max(cur[i].lo, other[j].lo);
+		int64		hi = Min(cur[i].hi, other[j].hi);
+
+		if (lo <= hi)
+		{
+			out[n].lo = lo;
+			out[n].hi = hi;
+			n++;
+		}
+
+		/* Advance whichever interval ends first */
+		if (cur[i].hi < other[j].hi)
+			i++;
 		else
-			high = mid;
+			j++;
 	}
-	return low;
+
+	if (cur)
+		pfree(cur);
+	if (other)
+		pfree(other);
+
+	*ivals = out;
+	*nivals = n;
 }
 
 /*
- * Find one-past-last entry index where zme_min <= hi (or < hi if !inclusive).
- * Returns 0 if no such entry exists.
+ * Closed interval of keys satisfying "key <strategy> val"; returns the
+ * number of intervals written (0 if no key can satisfy it).
  */
-static uint32
-zm_bsearch_last(SortedHeapRelInfo *info, int64 hi, bool inclusive,
-				uint32 count)
+static int
+sorted_heap_strategy_interval(int strategy, int64 val,
+							  SortedHeapInterval *iv)
 {
-	uint32	low = 0, high = count;
+	iv->lo = PG_INT64_MIN;
+	iv->hi = PG_INT64_MAX;
 
-	while (low < high)
+	switch (strategy)
 	{
-		uint32	mid = low + (high - low) / 2;
-		SortedHeapZoneMapEntry *e = sorted_heap_get_zm_entry(info, mid);
-		bool	above;
-
-		above = inclusive ? (e->zme_min > hi) : (e->zme_min >= hi);
-		if (above)
-			high = mid;
-		else
-			low = mid + 1;
+		case BTEqualStrategyNumber:
+			iv->lo = val;
+			iv->hi = val;
+			break;
+		case BTLessStrategyNumber:
+			if (val == PG_INT64_MIN)
+				return 0;
+			iv->hi = val - 1;
+			break;
+		case BTLessEqualStrategyNumber:
+			iv->hi = val;
+			break;
+		case BTGreaterStrategyNumber:
+			if (val == PG_INT64_MAX)
+				return 0;
+			iv->lo = val + 1;
+			break;
+		case BTGreaterEqualStrategyNumber:
+			iv->lo = val;
+			break;
+		default:
+			break;
 	}
-	return low;		/* one-past-last matching index */
+	return 1;
 }
 
 /* ----------------------------------------------------------------
- *  Resolve runtime bounds at executor startup (Path B).
+ *  Apply an interval list (normalized; consumed) to a PK column.
  *
- *  Evaluates Param expressions, merges with Const-only baseline bounds,
- *  and computes the block range from the zone map.
+ *  Column 1 narrows the scan's interval list to its intersection with
+ *  this one.  Either column gets the list's hull as a range bound, which
+ *  is what column 2, uncovered pages and per-block checks prune with.
+ *  An empty list matches nothing, whichever column it is on.
  * ---------------------------------------------------------------- */
 static void
-sorted_heap_resolve_runtime_bounds(SortedHeapScanState *shstate)
+sorted_heap_apply_intervals(SortedHeapScanBounds *bounds,
+							SortedHeapInterval **ivalset, int *nivalset,
+							bool is_col2,
+							SortedHeapInterval *ivals, int nivals)
 {
-	ExprContext *econtext = shstate->css.ss.ps.ps_ExprContext;
-	Relation	rel = shstate->css.ss.ss_currentRelation;
-	ListCell   *lc;
-	int			i;
+	if (nivals > 0)
+	{
+		if (ivals[0].lo != PG_INT64_MIN)
+			sorted_heap_apply_bound(bounds, BTGreaterEqualStrategyNumber,
+									is_col2, ivals[0].lo);
+		if (ivals[nivals - 1].hi != PG_INT64_MAX)
+			sorted_heap_apply_bound(bounds, BTLessEqualStrategyNumber,
+									is_col2, ivals[nivals - 1].hi);
+		if (is_col2)
+		{
+			pfree(ivals);
+			return;
+		}
+	}
+
+	sorted_heap_intervals_intersect(ivalset, nivalset, ivals, nivals);
+}
+
+/* ----------------------------------------------------------------
+ *  Bound value typing
+ *
+ *  Zone map keys are int64 images of the column's values, so a bound is
+ *  usable only if its value maps onto the same scale.  Integer types mix
+ *  freely (each value is widened from its own type), text and varchar
+ *  share one mapping, and anything else must match the column's type
+ *  exactly: date vs timestamp, say, are compared by cross-type operators
+ *  but their int64 images use different units.
+ * ---------------------------------------------------------------- */
+static bool
+sorted_heap_is_int_type(Oid typid)
+{
+	return typid == INT2OID || typid == INT4OID || typid == INT8OID;
+}
+
+static bool
+sorted_heap_is_text_type(Oid typid)
+{
+	return typid == TEXTOID || typid == VARCHAROID;
+}
+
+static bool
+sorted_heap_bound_type_ok(Oid coltypid, Oid valtypid)
+{
+	if (coltypid == valtypid)
+		return true;
+	if (sorted_heap_is_int_type(coltypid) && sorted_heap_is_int_type(valtypid))
+		return true;
+	if (sorted_heap_is_text_type(coltypid) && sorted_heap_is_text_type(valtypid))
+		return true;
+	return false;
+}
+
+/*
+ * uuid and text keys keep only a value's first 8 bytes: distinct values
+ * can share a key, so a strict bound would wrongly exclude the page whose
+ * min/max equals it.  Such bounds are applied as non-strict ones.
+ */
+static int
+sorted_heap_relax_strategy(int strategy, Oid coltypid)
+{
+	if (coltypid != UUIDOID && !sorted_heap_is_text_type(coltypid))
+		return strategy;
+	if (strategy == BTLessStrategyNumber)
+		return BTLessEqualStrategyNumber;
+	if (strategy == BTGreaterStrategyNumber)
+		return BTGreaterEqualStrategyNumber;
+	return strategy;
+}
+
+/*
+ * Text keys follow byte order, which matches the comparison only under
+ * the C collation (the one text PK columns need for a usable zone map).
+ */
+static bool
+sorted_heap_collation_ok(Oid coltypid, Oid inputcollid)
+{
+	return !sorted_heap_is_text_type(coltypid) ||
+		inputcollid == C_COLLATION_OID;
+}
+
+/* ----------------------------------------------------------------
+ *  Convert an array of PK values to a normalized list of point
+ *  intervals, one per distinct key.
+ *
+ *  NULL elements never satisfy "=" and are dropped.  Returns false if
+ *  the element type or some element has no zone map key, in which case
+ *  the array must not restrict the scan.
+ * ---------------------------------------------------------------- */
+static bool
+sorted_heap_array_to_intervals(Datum arraydatum, Oid coltypid,
+							   SortedHeapInterval **ivals, int *nivals)
+{
+	ArrayType  *arr = DatumGetArrayTypeP(arraydatum);
+	Oid			elemtype = ARR_ELEMTYPE(arr);
+	int16		elmlen;
+	bool		elmbyval;
+	char		elmalign;
+	Datum	   *elems;
+	bool	   *nulls;
+	int			nelems;
+	SortedHeapInterval *out;
+	int			n = 0;
+	bool		ok = true;
+
+	if (!sorted_heap_bound_type_ok(coltypid, elemtype))
+		return false;
+
+	get_typlenbyvalalign(elemtype, &elmlen, &elmbyval, &elmalign);
+	deconstruct_array(arr, elemtype, elmlen, elmbyval, elmalign,
+					  &elems, &nulls, &nelems);
+
+	out = palloc(Max(nelems, 1) * sizeof(SortedHeapInterval));
+	for (int i = 0; i < nelems && ok; i++)
+	{
+		if (nulls[i])
+			continue;
+		ok = sorted_heap_key_to_int64(elems[i], elemtype, &out[n].lo);
+		out[n].hi = out[n].lo;
+		n++;
+	}
+
+	pfree(elems);
+	pfree(nulls);
+	if ((Pointer) arr != DatumGetPointer(arraydatum))
+		pfree(arr);
+
+	if (!ok)
+	{
+		pfree(out);
+		return false;
+	}
+
+	*ivals = out;
+	*nivals = sorted_heap_intervals_normalize(out, n);
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *  Plan-time serialization of bounds and interval lists.
+ *
+ *  custom_private must survive copyObject, so int64 values are stored
+ *  as (high, low) int32 pairs in integer lists.
+ * ---------------------------------------------------------------- */
+static List *
+sorted_heap_pack_int64(List *list, int64 val)
+{
+	list = lappend_int(list, (int32) (val >> 32));
+	return lappend_int(list, (int32) (val & 0xFFFFFFFF));
+}
+
+static int64
+sorted_heap_unpack_int64(List *list, int n)
+{
+	return ((int64) list_nth_int(list, n) << 32) |
+		((int64) (uint32) list_nth_int(list, n + 1));
+}
+
+/* Bounds: 16 ints, column 1 then column 2 */
+static List *
+sorted_heap_pack_bounds(SortedHeapScanBounds *bounds)
+{
+	List	   *list = NIL;
+
+	list = lappend_int(list, bounds->has_lo ? 1 : 0);
+	list = lappend_int(list, bounds->has_hi ? 1 : 0);
+	list = lappend_int(list, bounds->lo_inclusive ? 1 : 0);
+	list = lappend_int(list, bounds->hi_inclusive ? 1 : 0);
+	list = sorted_heap_pack_int64(list, bounds->lo);
+	list = sorted_heap_pack_int64(list, bounds->hi);
+
+	list = lappend_int(list, bounds->has_lo2 ? 1 : 0);
+	list = lappend_int(list, bounds->has_hi2 ? 1 : 0);
+	list = lappend_int(list, bounds->lo2_inclusive ? 1 : 0);
+	list = lappend_int(list, bounds->hi2_inclusive ? 1 : 0);
+	list = sorted_heap_pack_int64(list, bounds->lo2);
+	list = sorted_heap_pack_int64(list, bounds->hi2);
+
+	return list;
+}
+
+static void
+sorted_heap_unpack_bounds(List *list, SortedHeapScanBounds *bounds)
+{
+	bounds->has_lo = list_nth_int(list, 0) != 0;
+	bounds->has_hi = list_nth_int(list, 1) != 0;
+	bounds->lo_inclusive = list_nth_int(list, 2) != 0;
+	bounds->hi_inclusive = list_nth_int(list, 3) != 0;
+	bounds->lo = sorted_heap_unpack_int64(list, 4);
+	bounds->hi = sorted_heap_unpack_int64(list, 6);
+
+	bounds->has_lo2 = list_nth_int(list, 8) != 0;
+	bounds->has_hi2 = list_nth_int(list, 9) != 0;
+	bounds->lo2_inclusive = list_nth_int(list, 10) != 0;
+	bounds->hi2_inclusive = list_nth_int(list, 11) != 0;
+	bounds->lo2 = sorted_heap_unpack_int64(list, 12);
+	bounds->hi2 = sorted_heap_unpack_int64(list, 14);
+}
+
+/* Interval list: [nivals, (lo, hi) pairs...] */
+static List *
+sorted_heap_pack_intervals(SortedHeapInterval *ivals, int nivals)
+{
+	List	   *list = list_make1_int(nivals);
+
+	for (int i = 0; i < nivals; i++)
+	{
+		list = sorted_heap_pack_int64(list, ivals[i].lo);
+		list = sorted_heap_pack_int64(list, ivals[i].hi);
+	}
+
+	return list;
+}
+
+static SortedHeapInterval *
+sorted_heap_unpack_intervals(List *list, int *nivals)
+{
+	SortedHeapInterval *ivals;
+
+	*nivals = linitial_int(list);
+	if (*nivals <= 0)
+		return NULL;
+
+	ivals = palloc(*nivals * sizeof(SortedHeapInterval));
+	for (int i = 0; i < *nivals; i++)
+	{
+		ivals[i].lo = sorted_heap_unpack_int64(list, 1 + 4 * i);
+		ivals[i].hi = sorted_heap_unpack_int64(list, 3 + 4 * i);
+	}
+
+	return ivals;
+}
+
+/* ----------------------------------------------------------------
+ *  Extract PK bounds from restriction and join clauses
+ * ---------------------------------------------------------------- */
+
+/*
+ * Match a Var to PK column 1 or 2 of the scanned relation.
+ */
+static bool
+sorted_heap_match_pk_var(SortedHeapExtractContext *cxt, Var *var,
+						 bool *is_col2)
+{
+	if (var->varno != cxt->relid || var->varlevelsup != 0)
+		return false;
+
+	if (var->varattno == cxt->pk_attno)
+	{
+		*is_col2 = false;
+		return true;
+	}
+	if (cxt->pk_attno2 != 0 && var->varattno == cxt->pk_attno2 &&
+		OidIsValid(cxt->opfamily2))
+	{
+		*is_col2 = true;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * A value the executor can compare the PK against: a Const, a Param, or
+ * (from a join clause) a non-volatile expression over other relations
+ * only, which becomes a nestloop Param once the plan is built.
+ */
+static bool
+sorted_heap_is_bound_value(SortedHeapExtractContext *cxt, Node *node)
+{
+	Relids		varnos;
+
+	if (IsA(node, Const) || IsA(node, Param))
+		return true;
+
+	varnos = pull_varnos(cxt->root, node);
+	return !bms_is_empty(varnos) && !bms_is_member(cxt->relid, varnos) &&
+		!contain_volatile_functions(node);
+}
+
+/*
+ * Decompose "pk op value" (either way round) into the PK column, the
+ * btree strategy as seen from the column and the value.  Returns false
+ * for anything zone map keys can't express.
+ */
+static bool
+sorted_heap_parse_opexpr(SortedHeapExtractContext *cxt, OpExpr *opexpr,
+						 bool *is_col2, int *strategy, Node **val_node)
+{
+	bool		varonleft;
+	Oid			coltypid;
+
+	if (list_length(opexpr->args) != 2)
+		return false;
+
+	/* Check for Var op value or value op Var */
+	if (IsA(linitial(opexpr->args), Var) &&
+		sorted_heap_match_pk_var(cxt, (Var *) linitial(opexpr->args),
+								 is_col2) &&
+		sorted_heap_is_bound_value(cxt, (Node *) lsecond(opexpr->args)))
+	{
+		*val_node = (Node *) lsecond(opexpr->args);
+		varonleft = true;
+	}
+	else if (IsA(lsecond(opexpr->args), Var) &&
+			 sorted_heap_match_pk_var(cxt, (Var *) lsecond(opexpr->args),
+									  is_col2) &&
+			 sorted_heap_is_bound_value(cxt, (Node *) linitial(opexpr->args)))
+	{
+		*val_node = (Node *) linitial(opexpr->args);
+		varonleft = false;
+	}
+	else
+		return false;
+
+	coltypid = *is_col2 ? cxt->pk_typid2 : cxt->pk_typid;
+	if (!sorted_heap_bound_type_ok(coltypid, exprType(*val_node)) ||
+		!sorted_heap_collation_ok(coltypid, opexpr->inputcollid))
+		return false;
+
+	if (IsA(*val_node, Const) && ((Const *) *val_node)->constisnull)
+		return false;
+
+	/* Determine btree strategy */
+	*strategy = get_op_opfamily_strategy(opexpr->opno,
+										 *is_col2 ? cxt->opfamily2 : cxt->opfamily);
+	if (*strategy == 0)
+		return false;
+
+	/* If var is on right, flip strategy */
+	if (!varonleft)
+		*strategy = BTCommuteStrategyNumber(*strategy);
+	*strategy = sorted_heap_relax_strategy(*strategy, coltypid);
+
+	return true;
+}
+
+/*
+ * An array the executor can evaluate without touching the scanned rel:
+ * a Const, a Param, or ARRAY[...] of those.
+ */
+static bool
+sorted_heap_is_array_value(Node *node)
+{
+	ListCell   *lc;
+
+	if (IsA(node, Const) || IsA(node, Param))
+		return true;
+	if (!IsA(node, ArrayExpr) || ((ArrayExpr *) node)->multidims)
+		return false;
+
+	foreach(lc, ((ArrayExpr *) node)->elements)
+	{
+		Node	   *elem = (Node *) lfirst(lc);
+
+		if (!IsA(elem, Const) && !IsA(elem, Param))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Decompose "pk = ANY(array)", which is also what IN-lists become, into
+ * the PK column and the array expression.
+ */
+static bool
+sorted_heap_parse_saop(SortedHeapExtractContext *cxt,
+					   ScalarArrayOpExpr *saop,
+					   bool *is_col2, Node **arr_node)
+{
+	Oid			coltypid;
+	Oid			elemtype;
+
+	if (!saop->useOr || list_length(saop->args) != 2 ||
+		!IsA(linitial(saop->args), Var))
+		return false;
+
+	*arr_node = (Node *) lsecond(saop->args);
+	if (!sorted_heap_is_array_value(*arr_node))
+		return false;
+
+	if (!sorted_heap_match_pk_var(cxt, (Var *) linitial(saop->args),
+								  is_col2))
+		return false;
+
+	coltypid = *is_col2 ? cxt->pk_typid2 : cxt->pk_typid;
+	elemtype = get_element_type(exprType(*arr_node));
+	if (!OidIsValid(elemtype) ||
+		!sorted_heap_bound_type_ok(coltypid, elemtype) ||
+		!sorted_heap_collation_ok(coltypid, saop->inputcollid))
+		return false;
+
+	return get_op_opfamily_strategy(saop->opno,
+									*is_col2 ? cxt->opfamily2 : cxt->opfamily) ==
+		BTEqualStrategyNumber;
+}
+
+/*
+ * Top-level "pk op value".  Returns true if the clause restricts the
+ * scan, now or at executor startup.
+ */
+static bool
+sorted_heap_extract_opexpr(SortedHeapExtractContext *cxt, OpExpr *opexpr)
+{
+	bool		is_col2;
+	int			strategy;
+	Node	   *val_node;
+	Oid			valtypid;
+
+	if (!sorted_heap_parse_opexpr(cxt, opexpr, &is_col2, &strategy,
+								  &val_node))
+		return false;
+
+	valtypid = exprType(val_node);
+	if (IsA(val_node, Const))
+	{
+		/* Const: resolve at plan time */
+		int64	int_val;
+
+		if (!sorted_heap_key_to_int64(((Const *) val_node)->constvalue,
+									  valtypid, &int_val))
+			return false;
+		sorted_heap_apply_bound(cxt->bounds, strategy, is_col2, int_val);
+	}
+	else
+	{
+		/* Param or outer relation value: defer to executor */
+		cxt->runtime_exprs = lappend(cxt->runtime_exprs, val_node);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta, strategy);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta, is_col2 ? 1 : 0);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta, (int) valtypid);
+	}
+
+	return true;
+}
+
+/*
+ * Top-level "pk = ANY(array)".  A Const array turns into point intervals
+ * now; anything else is evaluated by the executor.
+ */
+static bool
+sorted_heap_extract_saop(SortedHeapExtractContext *cxt,
+						 ScalarArrayOpExpr *saop)
+{
+	bool		is_col2;
+	Node	   *arr_node;
+	Oid			coltypid;
+
+	if (!sorted_heap_parse_saop(cxt, saop, &is_col2, &arr_node))
+		return false;
+
+	coltypid = is_col2 ? cxt->pk_typid2 : cxt->pk_typid;
+	if (IsA(arr_node, Const))
+	{
+		Const	   *c = (Const *) arr_node;
+		SortedHeapInterval *ivals = NULL;
+		int			nivals = 0;
+
+		/* "= ANY(NULL)" matches nothing: apply an empty list */
+		if (!c->constisnull &&
+			!sorted_heap_array_to_intervals(c->constvalue, coltypid,
+											&ivals, &nivals))
+			return false;
+		sorted_heap_apply_intervals(cxt->bounds, cxt->ivals, cxt->nivals,
+									is_col2, ivals, nivals);
+	}
+	else
+	{
+		cxt->runtime_exprs = lappend(cxt->runtime_exprs, arr_node);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta,
+										SORTED_HEAP_STRATEGY_ANY);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta, is_col2 ? 1 : 0);
+		cxt->runtime_meta = lappend_int(cxt->runtime_meta, (int) coltypid);
+	}
+
+	return true;
+}
+
+/*
+ * Column 1 intervals admitted by a Const-only clause tree: range and
+ * "= ANY" comparisons on column 1 under any nesting of AND and OR.  OR
+ * takes the union of its branches; AND the intersection of the branches
+ * it can express, since leaving a conjunct out only widens the result.
+ * Returns false if the clause does not restrict column 1 in a way that
+ * can be expressed, which also spoils any OR above it.
+ */
+static bool
+sorted_heap_clause_intervals(SortedHeapExtractContext *cxt, Node *clause,
+							 SortedHeapInterval **ivals, int *nivals)
+{
+	bool		is_col2;
+	ListCell   *lc;
+
+	if (IsA(clause, RestrictInfo))
+		clause = (Node *) ((RestrictInfo *) clause)->clause;
+
+	if (is_orclause(clause))
+	{
+		SortedHeapInterval *all = NULL;
+		int			nall = 0;
+
+		foreach(lc, ((BoolExpr *) clause)->args)
+		{
+			SortedHeapInterval *sub;
+			int			nsub;
+
+			if (!sorted_heap_clause_intervals(cxt, (Node *) lfirst(lc),
+											  &sub, &nsub))
+			{
+				if (all)
+					pfree(all);
+				return false;
+			}
+
+			if (nsub > 0)
+			{
+				Size		sz = (nall + nsub) * sizeof(SortedHeapInterval);
+
+				all = all ? repalloc(all, sz) : palloc(sz);
+				memcpy(all + nall, sub, nsub * sizeof(SortedHeapInterval));
+				nall += nsub;
+			}
+			if (sub)
+				pfree(sub);
+		}
+
+		*ivals = all;
+		*nivals = sorted_heap_intervals_normalize(all, nall);
+		return true;
+	}
+
+	if (is_andclause(clause))
+	{
+		*ivals = NULL;
+		*nivals = SORTED_HEAP_NO_INTERVALS;
+
+		foreach(lc, ((BoolExpr *) clause)->args)
+		{
+			SortedHeapInterval *sub;
+			int			nsub;
+
+			if (sorted_heap_clause_intervals(cxt, (Node *) lfirst(lc),
+											 &sub, &nsub))
+				sorted_heap_intervals_intersect(ivals, nivals, sub, nsub);
+		}
+		return *nivals != SORTED_HEAP_NO_INTERVALS;
+	}
+
+	if (IsA(clause, OpExpr))
+	{
+		int			strategy;
+		Node	   *val_node;
+		int64		val;
+
+		if (!sorted_heap_parse_opexpr(cxt, (OpExpr *) clause, &is_col2,
+									  &strategy, &val_node) ||
+			is_col2 || !IsA(val_node, Const) ||
+			!sorted_heap_key_to_int64(((Const *) val_node)->constvalue,
+									  exprType(val_node), &val))
+			return false;
+
+		*ivals = palloc(sizeof(SortedHeapInterval));
+		*nivals = sorted_heap_strategy_interval(strategy, val, *ivals);
+		return true;
+	}
+
+	if (IsA(clause, ScalarArrayOpExpr))
+	{
+		Node	   *arr_node;
+
+		if (!sorted_heap_parse_saop(cxt, (ScalarArrayOpExpr *) clause,
+									&is_col2, &arr_node) ||
+			is_col2 || !IsA(arr_node, Const))
+			return false;
+
+		if (((Const *) arr_node)->constisnull)
+		{
+			*ivals = NULL;
+			*nivals = 0;
+			return true;
+		}
+		return sorted_heap_array_to_intervals(((Const *) arr_node)->constvalue,
+											  cxt->pk_typid, ivals, nivals);
+	}
+
+	return false;
+}
+
+static bool
+sorted_heap_extract_bounds(PlannerInfo *root, RelOptInfo *rel,
+						   List *clauses, AttrNumber pk_attno,
+						   Oid pk_typid, AttrNumber pk_attno2,
+						   Oid pk_typid2,
+						   SortedHeapScanBounds *bounds,
+						   SortedHeapInterval **ivals, int *nivals,
+						   List **runtime_exprs,
+						   List **runtime_meta,
+						   List **pk_clauses_out)
+{
+	SortedHeapExtractContext cxt;
+	ListCell   *lc;
+	Oid			opcid;
+
+	memset(bounds, 0, sizeof(SortedHeapScanBounds));
+	*ivals = NULL;
+	*nivals = SORTED_HEAP_NO_INTERVALS;
+	*runtime_exprs = NIL;
+	*runtime_meta = NIL;
+	*pk_clauses_out = NIL;
+
+	memset(&cxt, 0, sizeof(cxt));
+	cxt.root = root;
+	cxt.relid = rel->relid;
+	cxt.pk_attno = pk_attno;
+	cxt.pk_typid = pk_typid;
+	cxt.bounds = bounds;
+	cxt.ivals = ivals;
+	cxt.nivals = nivals;
+
+	/* Get btree opfamily for column 1 */
+	opcid = GetDefaultOpClass(pk_typid, BTREE_AM_OID);
+	if (!OidIsValid(opcid))
+		return false;
+	cxt.opfamily = get_opclass_family(opcid);
+	if (!OidIsValid(cxt.opfamily))
+		return false;
+
+	/* Get btree opfamily for column 2 (if available) */
+	if (OidIsValid(pk_typid2) && pk_attno2 != 0)
+	{
+		Oid		opcid2 = GetDefaultOpClass(pk_typid2, BTREE_AM_OID);
+
+		if (OidIsValid(opcid2))
+		{
+			cxt.pk_attno2 = pk_attno2;
+			cxt.pk_typid2 = pk_typid2;
+			cxt.opfamily2 = get_opclass_family(opcid2);
+		}
+	}
+
+	foreach(lc, clauses)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		bool		matched;
+
+		if (IsA(rinfo->clause, OpExpr))
+			matched = sorted_heap_extract_opexpr(&cxt,
+												 (OpExpr *) rinfo->clause);
+		else if (IsA(rinfo->clause, ScalarArrayOpExpr))
+			matched = sorted_heap_extract_saop(&cxt,
+											   (ScalarArrayOpExpr *) rinfo->clause);
+		else if (is_orclause(rinfo->clause))
+		{
+			/* OR of column 1 ranges: a union of intervals */
+			SortedHeapInterval *or_ivals;
+			int			or_nivals;
+
+			matched = sorted_heap_clause_intervals(&cxt,
+												   (Node *) rinfo->clause,
+												   &or_ivals, &or_nivals);
+			if (matched)
+				sorted_heap_apply_intervals(bounds, ivals, nivals, false,
+											or_ivals, or_nivals);
+		}
+		else
+			matched = false;
+
+		/* Collect matching RestrictInfo for selectivity estimation */
+		if (matched)
+			*pk_clauses_out = lappend(*pk_clauses_out, rinfo);
+	}
+
+	*runtime_exprs = cxt.runtime_exprs;
+	*runtime_meta = cxt.runtime_meta;
+
+	return bounds->has_lo || bounds->has_hi ||
+		   bounds->has_lo2 || bounds->has_hi2 ||
+		   *nivals != SORTED_HEAP_NO_INTERVALS ||
+		   *runtime_exprs != NIL;
+}
+
+/* ----------------------------------------------------------------
+ *  Binary search helpers for monotonic zone maps.
+ *
+ *  After compact, zone map entries have non-decreasing zme_min and
+ *  zme_max values (data is physically sorted).  This enables O(log N)
+ *  block range computation instead of O(N) linear scan.
+ * ---------------------------------------------------------------- */
+
+/*
+ * Find first entry index where zme_max >= lo (or > lo if !inclusive).
+ * Returns count if no such entry exists.
+ */
+static uint32
+zm_bsearch_first(SortedHeapRelInfo *info, int64 lo, bool inclusive,
+				 uint32 count)
+{
+	uint32	low = 0, high = count;
+
+	while (low < high)
+	{
+		uint32	mid = low + (high - low) / 2;
+		SortedHeapZoneMapEntry *e = sorted_heap_get_zm_entry(info, mid);
+		bool	below;
+
+		below = inclusive ? (e->zme_max < lo) : (e->zme_max <= lo);
+		if (below)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * Find one-past-last entry index where zme_min <= hi (or < hi if !inclusive).
+ * Returns 0 if no such entry exists.
+ */
+static uint32
+zm_bsearch_last(SortedHeapRelInfo *info, int64 hi, bool inclusive,
+				uint32 count)
+{
+	uint32	low = 0, high = count;
+
+	while (low < high)
+	{
+		uint32	mid = low + (high - low) / 2;
+		SortedHeapZoneMapEntry *e = sorted_heap_get_zm_entry(info, mid);
+		bool	above;
+
+		above = inclusive ? (e->zme_min > hi) : (e->zme_min >= hi);
+		if (above)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return low;		/* one-past-last matching index */
+}
+
+/* ----------------------------------------------------------------
+ *  Resolve runtime bounds on the first fetch and on rescan (Path B).
+ *
+ *  Evaluates Param expressions, merges with Const-only baseline bounds
+ *  and intervals, and computes the qualifying block ranges from the zone
+ *  map.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_resolve_runtime_bounds(SortedHeapScanState *shstate)
+{
+	ExprContext *econtext = shstate->css.ss.ps.ps_ExprContext;
+	ListCell   *lc;
+	int			i;
 
 	/* Start from Const-only baseline */
 	shstate->bounds = shstate->const_bounds;
+	if (shstate->ivals)
+		pfree(shstate->ivals);
+	shstate->ivals = NULL;
+	shstate->nivals = shstate->n_const_ivals;
+	if (shstate->n_const_ivals > 0)
+	{
+		shstate->ivals = palloc(shstate->n_const_ivals *
+								sizeof(SortedHeapInterval));
+		memcpy(shstate->ivals, shstate->const_ivals,
+			   shstate->n_const_ivals * sizeof(SortedHeapInterval));
+	}
+
+	/* Evaluate each runtime Param expression and apply bound */
+	i = 0;
+	foreach(lc, shstate->runtime_exprstates)
+	{
+		ExprState  *exprstate = (ExprState *) lfirst(lc);
+		bool		isnull;
+		Datum		val;
+		int64		int_val;
+
+		val = ExecEvalExprSwitchContext(exprstate, econtext, &isnull);
+		if (shstate->runtime_strategies[i] == SORTED_HEAP_STRATEGY_ANY)
+		{
+			SortedHeapInterval *ivals = NULL;
+			int			nivals = 0;
+
+			/* A NULL array matches nothing, i.e. is an empty list */
+			if (isnull ||
+				sorted_heap_array_to_intervals(val, shstate->runtime_typids[i],
+											   &ivals, &nivals))
+				sorted_heap_apply_intervals(&shstate->bounds,
+											&shstate->ivals, &shstate->nivals,
+											shstate->runtime_is_col2[i],
+											ivals, nivals);
+		}
+		else if (!isnull &&
+				 sorted_heap_key_to_int64(val, shstate->runtime_typids[i],
+										  &int_val))
+		{
+			sorted_heap_apply_bound(&shstate->bounds,
+									shstate->runtime_strategies[i],
+									shstate->runtime_is_col2[i],
+									int_val);
+		}
+		i++;
+	}
+
+	/* Compute block ranges from zone map using resolved bounds */
+	sorted_heap_compute_scan_ranges(shstate);
+	shstate->runtime_ready = true;
+}
+
+/* ----------------------------------------------------------------
+ *  (Re)compute the scan's qualifying block ranges from shstate->bounds.
+ *
+ *  If the zone map stopped being usable since planning (e.g. an INSERT
+ *  landed on an uncovered page), fall back to scanning every data page.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_compute_scan_ranges(SortedHeapScanState *shstate)
+{
+	Relation	rel = shstate->css.ss.ss_currentRelation;
+	SortedHeapRelInfo *info;
+
+	/* Relcache invalidation may have reset the cached zone map */
+	info = sorted_heap_get_relinfo(rel);
+	shstate->relinfo = info;
+
+	if (shstate->ranges)
+		pfree(shstate->ranges);
+
+	shstate->total_blocks = RelationGetNumberOfBlocks(rel);
+
+	if (info->zm_usable && info->zm_loaded && info->zm_scan_valid &&
+		info->zm_total_entries > 0)
+	{
+		shstate->ranges = sorted_heap_compute_block_ranges(info,
+														   &shstate->bounds,
+														   shstate->ivals,
+														   shstate->nivals,
+														   shstate->total_blocks,
+														   &shstate->nranges,
+														   &shstate->scan_nblocks);
+		shstate->ranges_sorted =
+			!ScanDirectionIsNoMovement(shstate->order_dir) &&
+			sorted_heap_ranges_sorted(info, shstate->ranges,
+									  shstate->nranges);
+	}
+	else
+	{
+		shstate->ranges_sorted = false;
+		shstate->ranges = palloc(sizeof(SortedHeapBlockRange));
+		shstate->nranges = 0;
+		shstate->scan_nblocks = 0;
+		if (shstate->total_blocks > 1)
+		{
+			shstate->ranges[0].start = 1;
+			shstate->ranges[0].nblocks = shstate->total_blocks - 1;
+			shstate->nranges = 1;
+			shstate->scan_nblocks = shstate->total_blocks - 1;
+		}
+	}
+}
+
+/*
+ * True if every block of the ranges lies in the zone map's sorted prefix,
+ * where each page's keys start at or after the previous page's end: the
+ * ranges, read in order, then deliver pages in PK order.  Blocks past
+ * zone map coverage are never known to be in order.
+ */
+static bool
+sorted_heap_ranges_sorted(SortedHeapRelInfo *info,
+						  SortedHeapBlockRange *ranges, int nranges)
+{
+	SortedHeapBlockRange *last;
+	BlockNumber	prefix;
+
+	if (nranges == 0)
+		return true;
+
+	/* Pages inside a zone of several may hold keys in any order */
+	if (info->zm_zone_pages > 1)
+		return false;
+
+	/* Data block b is zone map entry b - 1 */
+	prefix = info->zm_sorted ? info->zm_total_entries :
+		sorted_heap_detect_sorted_prefix(info);
+	last = &ranges[nranges - 1];
+	return last->start + last->nblocks - 1 <= prefix;
+}
+
+/*
+ * Append block blk to a sorted range array, extending the last range when
+ * blk is adjacent to it.
+ */
+static void
+sorted_heap_range_append(SortedHeapBlockRange **ranges, int *nranges,
+						 int *maxranges, BlockNumber blk, BlockNumber count)
+{
+	SortedHeapBlockRange *last;
+
+	if (count == 0)
+		return;
+
+	if (*nranges > 0)
+	{
+		last = &(*ranges)[*nranges - 1];
+		if (last->start + last->nblocks == blk)
+		{
+			last->nblocks += count;
+			return;
+		}
+	}
+
+	if (*nranges >= *maxranges)
+	{
+		*maxranges *= 2;
+		*ranges = repalloc(*ranges, *maxranges * sizeof(SortedHeapBlockRange));
+	}
+
+	last = &(*ranges)[(*nranges)++];
+	last->start = blk;
+	last->nblocks = count;
+}
+
+/*
+ * Append blocks [start, end) to ranges, leaving out the overflow and
+ * super-zone pages listed in a v7 directory.  Rebuild writes them after
+ * the data it covered, so pages inserted into since lie beyond them.
+ */
+static void
+sorted_heap_range_append_data(SortedHeapRelInfo *info,
+							  SortedHeapBlockRange **ranges, int *nranges,
+							  int *maxranges, BlockNumber start,
+							  BlockNumber end)
+{
+	SortedHeapOverflowExtent *ext =
+		(SortedHeapOverflowExtent *) info->zm_overflow_blocks;
+
+	while (start < end)
+	{
+		BlockNumber stop = end;
+		bool		skipped = false;
+
+		for (int i = 0; info->zm_overflow_dir &&
+			 i < SORTED_HEAP_META_OVERFLOW_EXTENTS && ext[i].soe_npages > 0; i++)
+		{
+			BlockNumber	ext_end = ext[i].soe_start + ext[i].soe_npages;
+
+			if (ext[i].soe_start <= start && start < ext_end)
+			{
+				start = ext_end;
+				skipped = true;
+				break;
+			}
+			if (start < ext[i].soe_start && ext[i].soe_start < stop)
+				stop = ext[i].soe_start;
+		}
+		if (skipped)
+			continue;
+
+		sorted_heap_range_append(ranges, nranges, maxranges, start,
+								 stop - start);
+		start = stop;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *  Column 1 interval list checks
+ * ---------------------------------------------------------------- */
+
+/*
+ * Column 1 bounds as a closed interval; false if they admit no key.
+ * Strict bounds only remain on exact key types, so stepping one key
+ * inwards is exact.
+ */
+static bool
+sorted_heap_bounds_interval(SortedHeapScanBounds *bounds,
+							SortedHeapInterval *iv)
+{
+	iv->lo = PG_INT64_MIN;
+	iv->hi = PG_INT64_MAX;
 
-	/* Evaluate each runtime Param expression and apply bound */
-	i = 0;
-	foreach(lc, shstate->runtime_exprstates)
+	if (bounds->has_lo)
 	{
-		ExprState  *exprstate = (ExprState *) lfirst(lc);
-		bool		isnull;
-		Datum		val;
-		int64		int_val;
+		if (bounds->lo_inclusive)
+			iv->lo = bounds->lo;
+		else if (bounds->lo == PG_INT64_MAX)
+			return false;
+		else
+			iv->lo = bounds->lo + 1;
+	}
+	if (bounds->has_hi)
+	{
+		if (bounds->hi_inclusive)
+			iv->hi = bounds->hi;
+		else if (bounds->hi == PG_INT64_MIN)
+			return false;
+		else
+			iv->hi = bounds->hi - 1;
+	}
+	return iv->lo <= iv->hi;
+}
 
-		val = ExecEvalExprSwitchContext(exprstate, econtext, &isnull);
-		if (!isnull &&
-			sorted_heap_key_to_int64(val, shstate->runtime_typids[i], &int_val))
+/* Does a page's column 1 [min, max] meet any interval of the list? */
+static bool
+sorted_heap_zone_meets_intervals(SortedHeapZoneMapEntry *e,
+								 SortedHeapInterval *ivals, int nivals)
+{
+	int			low = 0,
+				high = nivals;
+
+	/* First interval ending at or after zme_min */
+	while (low < high)
+	{
+		int			mid = low + (high - low) / 2;
+
+		if (ivals[mid].hi < e->zme_min)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low < nivals && ivals[low].lo <= e->zme_max;
+}
+
+/*
+ * The bounds as a closed box for sorted_heap_zone_filter().  An empty
+ * column range becomes [MAX, MIN], which only an entry spanning every
+ * key can meet; such an entry is kept, which is merely conservative.
+ */
+static void
+sorted_heap_bounds_box(SortedHeapScanBounds *bounds, SortedHeapZoneBox *box)
+{
+	SortedHeapInterval iv;
+	SortedHeapScanBounds b2;
+
+	if (!sorted_heap_bounds_interval(bounds, &iv))
+	{
+		iv.lo = PG_INT64_MAX;
+		iv.hi = PG_INT64_MIN;
+	}
+	box->lo = iv.lo;
+	box->hi = iv.hi;
+
+	b2.has_lo = bounds->has_lo2;
+	b2.has_hi = bounds->has_hi2;
+	b2.lo_inclusive = bounds->lo2_inclusive;
+	b2.hi_inclusive = bounds->hi2_inclusive;
+	b2.lo = bounds->lo2;
+	b2.hi = bounds->hi2;
+	if (!sorted_heap_bounds_interval(&b2, &iv))
+	{
+		iv.lo = PG_INT64_MAX;
+		iv.hi = PG_INT64_MIN;
+	}
+	box->lo2 = iv.lo;
+	box->hi2 = iv.hi;
+}
+
+/* Entries filtered per sorted_heap_zone_filter() call */
+#define SORTED_HEAP_FILTER_CHUNK	512
+
+/*
+ * Append the blocks of entries [first_idx, end_idx) that meet the box
+ * (and the interval list, if any) to the ranges.  Entries are filtered a
+ * chunk at a time, each chunk within one array (the meta page's, or the
+ * overflow entries, one overflow page at a time when those are read on
+ * demand); only the survivors are checked against the interval list.
+ * A zone of several pages may span overflow or super-zone pages the run
+ * was extended into, which are left out as for uncovered pages.
+ */
+static void
+sorted_heap_collect_window(SortedHeapRelInfo *info,
+						   uint32 first_idx, uint32 end_idx,
+						   const SortedHeapZoneBox *box,
+						   SortedHeapInterval *ivals, int nivals,
+						   SortedHeapBlockRange **ranges, int *nranges,
+						   int *maxranges)
+{
+	uint64		bitmap[SORTED_HEAP_FILTER_CHUNK / 64];
+	uint32		i = first_idx;
+	BlockNumber	first;
+
+	while (i < end_idx)
+	{
+		uint32		n = Min(end_idx - i, SORTED_HEAP_FILTER_CHUNK);
+		SortedHeapZoneMapEntry *e;
+
+		if (i < info->zm_nentries)
+			n = Min(n, info->zm_nentries - i);
+		else if (info->zm_overflow_loaded != NULL)
 		{
-			sorted_heap_apply_bound(&shstate->bounds,
-									shstate->runtime_strategies[i],
-									shstate->runtime_is_col2[i],
-									int_val);
+			uint32		in_page = (i - info->zm_nentries) %
+				info->zm_overflow_per_page;
+
+			n = Min(n, info->zm_overflow_per_page - in_page);
 		}
-		i++;
-	}
 
-	/* Compute block range from zone map using resolved bounds */
-	shstate->total_blocks = RelationGetNumberOfBlocks(rel);
-	sorted_heap_compute_block_range(shstate->relinfo, &shstate->bounds,
-									shstate->total_blocks,
-									&shstate->scan_start,
-									&shstate->scan_nblocks);
+		e = sorted_heap_get_zm_entry(info, i);	/* reads the page if need be */
+		sorted_heap_zone_filter(e, n, box, bitmap);
+
+		for (uint32 w = 0; w < (n + 63) / 64; w++)
+		{
+			uint64		bits = bitmap[w];
+
+			while (bits != 0)
+			{
+				uint32		k = w * 64 + pg_rightmost_one_pos64(bits);
+
+				bits &= bits - 1;
+				if (nivals > 0 &&
+					!sorted_heap_zone_meets_intervals(&e[k], ivals, nivals))
+					continue;	/* page falls between intervals */
+				first = sorted_heap_zone_first_block(info, i + k);
+				sorted_heap_range_append_data(info, ranges, nranges, maxranges,
+											  first, first + info->zm_zone_pages);
+			}
+		}
+		i += n;
+	}
 }
 
 /* ----------------------------------------------------------------
- *  Compute block range from zone map
+ *  Compute qualifying block ranges from zone map
+ *
+ *  Returns a palloc'd array of sorted, disjoint block ranges covering
+ *  exactly the data blocks whose zone map entry overlaps the bounds (and
+ *  meets the interval list, if any), plus any data blocks beyond zone map
+ *  coverage.  *nblocks receives the total number of blocks in all ranges.
  * ---------------------------------------------------------------- */
-static void
-sorted_heap_compute_block_range(SortedHeapRelInfo *info,
-								SortedHeapScanBounds *bounds,
-								BlockNumber total_blocks,
-								BlockNumber *start_block,
-								BlockNumber *nblocks)
-{
-	BlockNumber		first_match = total_blocks;
-	BlockNumber		last_match = 0;
+static SortedHeapBlockRange *
+sorted_heap_compute_block_ranges(SortedHeapRelInfo *info,
+								 SortedHeapScanBounds *bounds,
+								 SortedHeapInterval *ivals,
+								 int nivals,
+								 BlockNumber total_blocks,
+								 int *nranges,
+								 BlockNumber *nblocks)
+{
+	SortedHeapBlockRange *ranges;
+	int				maxranges = 16;
 	uint32			i;
+	uint32			next;
 	uint32			zm_entries_count = info->zm_total_entries;
+	BlockNumber		covered_blocks;
+	SortedHeapZoneBox box;
+	uint32			first_idx = 0;
+	uint32			last_idx_excl = zm_entries_count;
 	BlockNumber		data_blocks;
+	BlockNumber		total = 0;
+
+	ranges = palloc(maxranges * sizeof(SortedHeapBlockRange));
+	*nranges = 0;
+	*nblocks = 0;
+
+	/* An empty interval list matches nothing, not even uncovered pages */
+	if (nivals == 0)
+		return ranges;
 
 	/*
-	 * Compute effective data page count by excluding meta page and
-	 * overflow pages from total_blocks.
+	 * Compute effective data page count by excluding meta page,
+	 * overflow pages and super-zone summary pages from total_blocks.
 	 */
-	data_blocks = (total_blocks > 1 + info->zm_overflow_npages) ?
-		total_blocks - 1 - info->zm_overflow_npages : 0;
+	data_blocks = (total_blocks >
+				   1 + info->zm_overflow_npages + info->zm_super_npages) ?
+		total_blocks - 1 - info->zm_overflow_npages - info->zm_super_npages : 0;
+	covered_blocks = sorted_heap_zone_first_block(info, zm_entries_count) - 1;
+
+	sorted_heap_bounds_box(bounds, &box);
 
-	if (info->zm_sorted)
+	if (info->zm_sorted && nivals > 0)
 	{
 		/*
-		 * Binary search: O(log N) for monotonic zone map.
-		 * Column 2 pruning is not applied here; the executor handles
-		 * per-block column 2 checks during scan.
+		 * One binary-searched window per interval, clipped to the bounds.
+		 * Intervals ascend, so windows do too; a window overlapping the
+		 * previous one (two intervals meeting on one page) is clipped so
+		 * that each entry is visited once.
 		 */
-		uint32	first_idx = 0;
-		uint32	last_idx_excl = zm_entries_count;
-
-		if (bounds->has_lo)
-			first_idx = zm_bsearch_first(info, bounds->lo,
-										 bounds->lo_inclusive,
-										 zm_entries_count);
-		if (bounds->has_hi)
-			last_idx_excl = zm_bsearch_last(info, bounds->hi,
-											bounds->hi_inclusive,
-											zm_entries_count);
-
-		if (first_idx < last_idx_excl)
+		SortedHeapInterval clip;
+		uint32		next_idx = 0;
+
+		if (!sorted_heap_bounds_interval(bounds, &clip))
+			nivals = 0;
+
+		for (int k = 0; k < nivals; k++)
 		{
-			first_match = first_idx + 1;	/* +1 for meta page */
-			last_match = last_idx_excl;		/* one-past = last block */
+			int64		lo = Max(ivals[k].lo, clip.lo);
+			int64		hi = Min(ivals[k].hi, clip.hi);
+			uint32		lo_idx;
+			uint32		hi_idx;
+
+			if (lo > hi)
+				continue;
+
+			lo_idx = zm_bsearch_first(info, lo, true, zm_entries_count);
+			hi_idx = zm_bsearch_last(info, hi, true, zm_entries_count);
+			lo_idx = Max(lo_idx, next_idx);
+			sorted_heap_zonemap_prefetch(info, lo_idx, hi_idx);
+			sorted_heap_collect_window(info, lo_idx, hi_idx, &box, NULL, 0,
+									   &ranges, nranges, &maxranges);
+			next_idx = Max(next_idx, hi_idx);
 		}
 	}
 	else
 	{
-		/* Linear scan: O(N) fallback for non-monotonic zone map */
-		for (i = 0; i < zm_entries_count; i++)
+		if (info->zm_sorted)
 		{
-			SortedHeapZoneMapEntry *e = sorted_heap_get_zm_entry(info, i);
-
-			if (e->zme_min == PG_INT64_MAX)
-				continue;			/* empty page */
-
-			if (!sorted_heap_zone_overlaps(e, bounds))
-				continue;			/* zone map says no match */
+			/*
+			 * Binary search: O(log N) for monotonic zone map narrows the
+			 * candidate window; entries inside it are still checked so that
+			 * empty pages and column 2 misses are left out.
+			 */
+			if (bounds->has_lo)
+				first_idx = zm_bsearch_first(info, bounds->lo,
+											 bounds->lo_inclusive,
+											 zm_entries_count);
+			if (bounds->has_hi)
+				last_idx_excl = zm_bsearch_last(info, bounds->hi,
+												bounds->hi_inclusive,
+												zm_entries_count);
+		}
 
-			if ((BlockNumber)(i + 1) < first_match)
-				first_match = i + 1;	/* +1 for meta page */
-			last_match = i + 1;
+		/*
+		 * Collect overlapping entries into ranges (+1 for meta page).  With
+		 * super-zones, a zone whose summary cannot match is skipped whole,
+		 * and only the overflow pages of matching zones are read.
+		 */
+		for (i = first_idx; i < last_idx_excl; i = next)
+		{
+			next = last_idx_excl;
+			if (info->zm_super != NULL)
+			{
+				uint32		z = i / SORTED_HEAP_SUPERZONE_PAGES;
+				SortedHeapZoneMapEntry *s = &info->zm_super[z];
+
+				next = Min((z + 1) * SORTED_HEAP_SUPERZONE_PAGES, last_idx_excl);
+				if (!sorted_heap_zone_overlaps(s, bounds) ||
+					(nivals > 0 &&
+					 !sorted_heap_zone_meets_intervals(s, ivals, nivals)))
+					continue;
+			}
+			sorted_heap_zonemap_prefetch(info, i, next);
+			sorted_heap_collect_window(info, i, next, &box, ivals, nivals,
+									   &ranges, nranges, &maxranges);
 		}
 	}
 
 	/*
 	 * Handle data pages beyond zone map capacity.  These have unknown
 	 * content, so we must include them unless the upper bound falls
-	 * entirely within the covered range.
+	 * entirely within the covered range.  A v7 directory says where the
+	 * overflow run is, so pages added after it are found too.
 	 */
-	if (zm_entries_count < data_blocks)
+	if (info->zm_overflow_dir && total_blocks > 0)
+		data_blocks = total_blocks - 1;
+	if (covered_blocks < data_blocks)
 	{
 		bool		uncovered_safe_to_skip = false;
-		BlockNumber first_uncovered = (BlockNumber) zm_entries_count + 1;
 
 		/*
 		 * Optimisation for sorted data: if the last covered entry has a
 		 * finite max, and the query's upper bound is at or below that max,
-		 * uncovered pages (which hold higher values) can't match.
+		 * uncovered pages (which hold higher values) can't match.  Not
+		 * once a single-row write has landed there (zm_tail_unsorted).
 		 */
-		if (bounds->has_hi && zm_entries_count > 0)
+		if (bounds->has_hi && zm_entries_count > 0 &&
+			!info->zm_tail_unsorted)
 		{
 			SortedHeapZoneMapEntry *last_e =
 				sorted_heap_get_zm_entry(info, zm_entries_count - 1);
@@ -927,29 +2429,28 @@ sorted_heap_compute_block_range(SortedHeapRelInfo *info,
 				uncovered_safe_to_skip = true;
 		}
 
+		/* Must scan all uncovered data pages (but not overflow pages) */
 		if (!uncovered_safe_to_skip)
-		{
-			/* Must scan all uncovered data pages (but not overflow pages) */
-			BlockNumber last_data_block = data_blocks;
-
-			if (first_uncovered < first_match)
-				first_match = first_uncovered;
-			if (last_data_block > last_match)
-				last_match = last_data_block;
-		}
+			sorted_heap_range_append_data(info, &ranges, nranges, &maxranges,
+										  covered_blocks + 1,
+										  data_blocks + 1);
 	}
 
-	if (first_match >= total_blocks)
-	{
-		/* No blocks match — minimal scan that finds nothing */
-		*start_block = 1;
-		*nblocks = 0;
-	}
-	else
+	/* The last zone may reach past the end of the relation */
+	while (*nranges > 0 && ranges[*nranges - 1].start >= total_blocks)
+		(*nranges)--;
+	if (*nranges > 0)
 	{
-		*start_block = first_match;
-		*nblocks = last_match - first_match + 1;
+		SortedHeapBlockRange *last = &ranges[*nranges - 1];
+
+		last->nblocks = Min(last->nblocks, total_blocks - last->start);
 	}
+
+	for (i = 0; i < (uint32) *nranges; i++)
+		total += ranges[i].nblocks;
+	*nblocks = total;
+
+	return ranges;
 }
 
 /* ----------------------------------------------------------------
@@ -1028,238 +2529,846 @@ sorted_heap_zone_overlaps(SortedHeapZoneMapEntry *e,
 		}
 	}
 
-	return true;
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *  PlanCustomPath: convert CustomPath to CustomScan plan node
+ * ---------------------------------------------------------------- */
+static Plan *
+sorted_heap_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
+							 struct CustomPath *best_path,
+							 List *tlist, List *clauses,
+							 List *custom_plans)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+
+	cscan->scan.scanrelid = rel->relid;
+	cscan->flags = best_path->flags;
+
+	/*
+	 * Move runtime_exprs from custom_private[4] to custom_exprs so that
+	 * setrefs processes the Param nodes and PG deep-copies them for
+	 * generic plan caching; the plan keeps [meta, runtime_meta, bounds,
+	 * intervals].
+	 */
+	cscan->custom_exprs = (List *) list_nth(best_path->custom_private, 4);
+	cscan->custom_private = list_make4(linitial(best_path->custom_private),
+									   lsecond(best_path->custom_private),
+									   lthird(best_path->custom_private),
+									   lfourth(best_path->custom_private));
+
+	cscan->custom_scan_tlist = NIL;
+	cscan->custom_plans = NIL;
+	cscan->scan.plan.targetlist = tlist;
+	cscan->scan.plan.qual = extract_actual_clauses(clauses, false);
+	cscan->methods = &sorted_heap_plan_methods;
+
+	return &cscan->scan.plan;
+}
+
+/* ----------------------------------------------------------------
+ *  CustomScan state creation
+ * ---------------------------------------------------------------- */
+static Node *
+sorted_heap_create_scan_state(CustomScan *cscan)
+{
+	SortedHeapScanState *shstate;
+
+	shstate = (SortedHeapScanState *) newNode(sizeof(SortedHeapScanState),
+											  T_CustomScanState);
+	shstate->css.methods = &sorted_heap_exec_methods;
+	shstate->css.slotOps = &TTSOpsBufferHeapTuple;
+	return (Node *) &shstate->css;
+}
+
+/* ----------------------------------------------------------------
+ *  BeginCustomScan
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_begin_custom_scan(CustomScanState *node, EState *estate,
+							  int eflags)
+{
+	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
+	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
+	Relation	rel = node->ss.ss_currentRelation;
+
+	/* Load relinfo for per-block zone map checks */
+	shstate->relinfo = sorted_heap_get_relinfo(rel);
+
+	/* Init per-scan stats, page cursor and parallel state */
+	shstate->scanned_blocks = 0;
+	shstate->searched_blocks = 0;
+	shstate->pruned_blocks = 0;
+	shstate->pass_counted = false;
+	shstate->ranges = NULL;
+	shstate->nranges = 0;
+	shstate->scan_nblocks = 0;
+	shstate->stream = NULL;
+	shstate->strategy = NULL;
+	shstate->next_pos = 0;
+	shstate->chunk_end = 0;
+	shstate->cur_range = 0;
+	shstate->range_base = 0;
+	shstate->cbuf = InvalidBuffer;
+	shstate->cblock = InvalidBlockNumber;
+	shstate->ntuples = 0;
+	shstate->cindex = 0;
+	shstate->ctup.t_tableOid = RelationGetRelid(rel);
+	shstate->pstate = NULL;
+	shstate->ivals = NULL;
+	shstate->nivals = SORTED_HEAP_NO_INTERVALS;
+	shstate->const_ivals = NULL;
+	shstate->n_const_ivals = SORTED_HEAP_NO_INTERVALS;
+	shstate->ranges_sorted = false;
+	shstate->tidsort = NULL;
+
+	/*
+	 * custom_private = [meta, runtime_meta, bounds, intervals];
+	 * runtime_exprs were moved to custom_exprs by plan_custom_path.  meta
+	 * holds [total_blocks, n_runtime_exprs, order_dir, block_budget]; any
+	 * runtime expression makes this Path B, where bounds and intervals are
+	 * the Const-only baseline.
+	 */
+	{
+		List	   *meta_list = (List *) linitial(cscan->custom_private);
+		List	   *runtime_meta = (List *) lsecond(cscan->custom_private);
+		List	   *bounds_list = (List *) lthird(cscan->custom_private);
+		List	   *ivals_list = (List *) lfourth(cscan->custom_private);
+		int			n_runtime = lsecond_int(meta_list);
+
+		shstate->total_blocks = (BlockNumber) linitial_int(meta_list);
+		shstate->n_runtime_exprs = n_runtime;
+		shstate->runtime_bounds = n_runtime > 0;
+		shstate->order_dir = (ScanDirection) lthird_int(meta_list);
+		shstate->block_budget = (BlockNumber) lfourth_int(meta_list);
+		shstate->issue_budget = shstate->block_budget;
+		shstate->issued_blocks = 0;
+		shstate->stream_paused = false;
+
+		/* Fallback sort of (PK column 1 key, TID) for unordered pages */
+		if (!ScanDirectionIsNoMovement(shstate->order_dir))
+		{
+			shstate->tidsort_desc = CreateTemplateTupleDesc(2);
+			TupleDescInitEntry(shstate->tidsort_desc, (AttrNumber) 1, "key",
+							   INT8OID, -1, 0);
+			TupleDescInitEntry(shstate->tidsort_desc, (AttrNumber) 2, "tid",
+							   TIDOID, -1, 0);
+			shstate->tidsort_slot =
+				ExecInitExtraTupleSlot(estate, shstate->tidsort_desc,
+									   &TTSOpsMinimalTuple);
+		}
+
+		if (shstate->runtime_bounds)
+		{
+			int			i;
+			ListCell   *lc;
+
+			/* Initialize ExprStates from custom_exprs */
+			shstate->runtime_exprstates =
+				ExecInitExprList(cscan->custom_exprs, &node->ss.ps);
+
+			/* Unpack runtime metadata: 3 ints per expression (strategy, is_col2, typid) */
+			shstate->runtime_strategies = palloc(sizeof(int) * n_runtime);
+			shstate->runtime_is_col2 = palloc(sizeof(bool) * n_runtime);
+			shstate->runtime_typids = palloc(sizeof(Oid) * n_runtime);
+
+			i = 0;
+			lc = list_head(runtime_meta);
+			while (i < n_runtime && lc != NULL)
+			{
+				shstate->runtime_strategies[i] = lfirst_int(lc);
+				lc = lnext(runtime_meta, lc);
+				shstate->runtime_is_col2[i] = lfirst_int(lc) != 0;
+				lc = lnext(runtime_meta, lc);
+				shstate->runtime_typids[i] = (Oid) lfirst_int(lc);
+				lc = lnext(runtime_meta, lc);
+				i++;
+			}
+
+			sorted_heap_unpack_bounds(bounds_list, &shstate->const_bounds);
+			shstate->const_ivals =
+				sorted_heap_unpack_intervals(ivals_list,
+											 &shstate->n_const_ivals);
+
+			/*
+			 * Params are evaluated on the first fetch, not here: a nestloop
+			 * sets the Params of a parameterized scan only once it has its
+			 * first outer row.  A parallel-aware leader resolves them in
+			 * InitializeDSM instead, before publishing the ranges, and its
+			 * workers take those ranges from DSM since not every Param
+			 * reaches them.
+			 */
+			shstate->runtime_ready = false;
+		}
+		else
+		{
+			/* Path A: all Const bounds */
+			sorted_heap_unpack_bounds(bounds_list, &shstate->bounds);
+			shstate->ivals = sorted_heap_unpack_intervals(ivals_list,
+														  &shstate->nivals);
+
+			/* Compute block ranges against the current zone map */
+			if (!(cscan->scan.plan.parallel_aware && IsParallelWorker()))
+				sorted_heap_compute_scan_ranges(shstate);
+		}
+	}
+
+	/*
+	 * The read stream is created lazily on the first fetch, once any
+	 * parallel state (InitializeDSM / InitializeWorker) has been attached.
+	 */
+}
+
+/* ----------------------------------------------------------------
+ *  Map an offset within the concatenated block ranges to a block.
+ *
+ *  Offsets handed to a participant only ever increase between resets,
+ *  so the range cursor moves forward monotonically.  A backward scan
+ *  reads the same offsets mirrored: from the last block of the last
+ *  range down to the first block of the first.
+ * ---------------------------------------------------------------- */
+static BlockNumber
+sorted_heap_range_block(SortedHeapScanState *shstate,
+						const SortedHeapBlockRange *ranges, int nranges,
+						BlockNumber pos)
+{
+	bool		backward = ScanDirectionIsBackward(shstate->order_dir);
+	const SortedHeapBlockRange *r;
+
+	while (shstate->cur_range < nranges)
+	{
+		r = &ranges[backward ? nranges - 1 - shstate->cur_range :
+					shstate->cur_range];
+		if (pos < shstate->range_base + r->nblocks)
+			break;
+		shstate->range_base += r->nblocks;
+		shstate->cur_range++;
+	}
+
+	if (shstate->cur_range >= nranges)
+		return InvalidBlockNumber;
+
+	r = &ranges[backward ? nranges - 1 - shstate->cur_range :
+				shstate->cur_range];
+	if (backward)
+		return r->start + r->nblocks - 1 - (pos - shstate->range_base);
+	return r->start + (pos - shstate->range_base);
+}
+
+/* ----------------------------------------------------------------
+ *  Next candidate block from the range list for this participant.
+ *
+ *  Serial scans walk their own range list.  Parallel participants claim
+ *  chunks of the shared range list through the DSM cursor.
+ * ---------------------------------------------------------------- */
+static BlockNumber
+sorted_heap_next_candidate(SortedHeapScanState *shstate)
+{
+	SortedHeapParallelScan *pstate = shstate->pstate;
+
+	if (pstate == NULL)
+	{
+		if (shstate->next_pos >= shstate->scan_nblocks)
+			return InvalidBlockNumber;
+		return sorted_heap_range_block(shstate, shstate->ranges,
+									   shstate->nranges,
+									   shstate->next_pos++);
+	}
+
+	if (shstate->next_pos >= shstate->chunk_end)
+	{
+		uint32		offset;
+
+		/* Cheap exit so the cursor can't wrap after the ranges drain */
+		if (pg_atomic_read_u32(&pstate->next_offset) >= pstate->scan_nblocks)
+			return InvalidBlockNumber;
+
+		offset = pg_atomic_fetch_add_u32(&pstate->next_offset,
+										 pstate->chunk_size);
+		if (offset >= pstate->scan_nblocks)
+			return InvalidBlockNumber;
+
+		shstate->next_pos = offset;
+		shstate->chunk_end = Min(offset + pstate->chunk_size,
+								 pstate->scan_nblocks);
+	}
+
+	return sorted_heap_range_block(shstate, pstate->ranges,
+								   pstate->nranges, shstate->next_pos++);
+}
+
+/* ----------------------------------------------------------------
+ *  Read stream callback — next block worth reading.
+ *
+ *  Each candidate block's zone map entry is checked once, here, before
+ *  the block is ever pinned: a page that cannot match is skipped without
+ *  I/O, locking or visibility checks.  Blocks without an entry (beyond
+ *  zone map coverage) are always read.
+ * ---------------------------------------------------------------- */
+static BlockNumber
+sorted_heap_stream_next_block(ReadStream *stream,
+							  void *callback_private_data,
+							  void *per_buffer_data)
+{
+	SortedHeapScanState *shstate = (SortedHeapScanState *) callback_private_data;
+	SortedHeapRelInfo *info = shstate->relinfo;
+	SortedHeapScanBounds *bounds = &shstate->bounds;
+	BlockNumber blk;
+
+	/* Leader's copy may predate a rescan; DSM holds the live bounds */
+	if (shstate->pstate)
+		bounds = &shstate->pstate->bounds;
+
+	/* Under a LIMIT, hold back blocks the scan may never need */
+	if (shstate->issue_budget > 0 &&
+		shstate->issued_blocks >= shstate->issue_budget)
+	{
+		shstate->stream_paused = true;
+		return InvalidBlockNumber;
+	}
+
+	while ((blk = sorted_heap_next_candidate(shstate)) != InvalidBlockNumber)
+	{
+		uint32		zone = (blk >= 1) ? sorted_heap_zone_of_block(info, blk) : 0;
+
+		if (blk >= 1 && zone < info->zm_total_entries &&
+			!sorted_heap_zone_overlaps(sorted_heap_get_zm_entry(info, zone),
+									   bounds))
+		{
+			shstate->pruned_blocks++;
+			continue;
+		}
+		shstate->issued_blocks++;
+		return blk;
+	}
+
+	return InvalidBlockNumber;
+}
+
+/* ----------------------------------------------------------------
+ *  Reset the block cursor and read stream for a fresh pass.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_reset_cursor(SortedHeapScanState *shstate)
+{
+	if (BufferIsValid(shstate->cbuf))
+	{
+		ReleaseBuffer(shstate->cbuf);
+		shstate->cbuf = InvalidBuffer;
+	}
+	shstate->cblock = InvalidBlockNumber;
+	shstate->ntuples = 0;
+	shstate->cindex = 0;
+	shstate->pass_counted = false;
+
+	shstate->next_pos = 0;
+	shstate->chunk_end = 0;
+	shstate->cur_range = 0;
+	shstate->range_base = 0;
+
+	shstate->issue_budget = shstate->block_budget;
+	shstate->issued_blocks = 0;
+	shstate->stream_paused = false;
+
+	if (shstate->tidsort)
+	{
+		tuplesort_end(shstate->tidsort);
+		shstate->tidsort = NULL;
+	}
+
+	if (shstate->stream)
+		read_stream_reset(shstate->stream);
+}
+
+static int
+sorted_heap_cmp_page_key(const void *a, const void *b)
+{
+	return pg_cmp_s64(((const SortedHeapPageKey *) a)->key,
+					  ((const SortedHeapPageKey *) b)->key);
+}
+
+/* Zone map key of a tuple's PK column 1; PG_INT64_MIN if it has none */
+static int64
+sorted_heap_page_key(SortedHeapScanState *shstate, Page page,
+					 OffsetNumber off)
+{
+	Relation	rel = shstate->css.ss.ss_currentRelation;
+	SortedHeapRelInfo *info = shstate->relinfo;
+	ItemId		lpp = PageGetItemId(page, off);
+	HeapTupleData tup;
+	Datum		val;
+	bool		isnull;
+	int64		key;
+
+	tup.t_data = (HeapTupleHeader) PageGetItem(page, lpp);
+	tup.t_len = ItemIdGetLength(lpp);
+	val = heap_getattr(&tup, info->attNums[0], RelationGetDescr(rel),
+					   &isnull);
+
+	/* PK columns are NOT NULL; exact key types always convert */
+	if (isnull || !sorted_heap_key_to_int64(val, info->zm_pk_typid, &key))
+		key = PG_INT64_MIN;
+	return key;
+}
+
+/* The page's slot in the backend-local in-page key order cache */
+static SortedHeapPageOrder *
+sorted_heap_page_order_slot(SortedHeapRelInfo *info, BlockNumber blkno)
+{
+	if (info->page_order == NULL)
+		info->page_order = (SortedHeapPageOrder *)
+			MemoryContextAllocZero(sorted_heap_zonemap_context,
+								   SORTED_HEAP_PAGE_ORDER_SLOTS *
+								   sizeof(SortedHeapPageOrder));
+	return &info->page_order[blkno % SORTED_HEAP_PAGE_ORDER_SLOTS];
+}
+
+/*
+ * Record whether the line pointers of the share-locked current page are
+ * in key order.  Dead tuples count too: which ones a search may skip
+ * depends on the snapshot, but their keys stay where they are.
+ */
+static void
+sorted_heap_note_page_order(SortedHeapScanState *shstate, Buffer buffer,
+							Page page)
+{
+	SortedHeapPageOrder *slot;
+	OffsetNumber lines = PageGetMaxOffsetNumber(page);
+	int64		prev = PG_INT64_MIN;
+	bool		sorted = true;
+
+	for (OffsetNumber off = FirstOffsetNumber; off <= lines; off++)
+	{
+		int64		key;
+
+		if (!ItemIdIsNormal(PageGetItemId(page, off)))
+			continue;
+		key = sorted_heap_page_key(shstate, page, off);
+		if (key < prev)
+		{
+			sorted = false;
+			break;
+		}
+		prev = key;
+	}
+
+	slot = sorted_heap_page_order_slot(shstate->relinfo, shstate->cblock);
+	slot->blkno = shstate->cblock;
+	slot->lsn = BufferGetLSNAtomic(buffer);
+	slot->sorted = sorted;
 }
 
-/* ----------------------------------------------------------------
- *  PlanCustomPath: convert CustomPath to CustomScan plan node
- * ---------------------------------------------------------------- */
-static Plan *
-sorted_heap_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
-							 struct CustomPath *best_path,
-							 List *tlist, List *clauses,
-							 List *custom_plans)
+/* First of normal[0..n) whose key is >= key (> key if after) */
+static int
+sorted_heap_page_bound(SortedHeapScanState *shstate, Page page,
+					   OffsetNumber *normal, int n, int64 key, bool after)
 {
-	CustomScan *cscan = makeNode(CustomScan);
-
-	cscan->scan.scanrelid = rel->relid;
-	cscan->flags = best_path->flags;
+	int			low = 0,
+				high = n;
 
-	/*
-	 * Detect Path B (runtime bounds): move runtime_exprs from
-	 * custom_private[3] to custom_exprs so PG deep-copies Param
-	 * nodes for generic plan caching.
-	 *
-	 * Path A: custom_private has 2 elements (range_list, bounds_list)
-	 * Path B: custom_private has 4 elements (meta, runtime_meta,
-	 *         const_bounds, runtime_exprs)
-	 */
+	while (low < high)
 	{
-		if (list_length(best_path->custom_private) == 4)
-		{
-			cscan->custom_exprs = (List *) lfourth(best_path->custom_private);
-			cscan->custom_private = list_make3(linitial(best_path->custom_private),
-											   lsecond(best_path->custom_private),
-											   lthird(best_path->custom_private));
-		}
+		int			mid = low + (high - low) / 2;
+		int64		k = sorted_heap_page_key(shstate, page, normal[mid]);
+
+		if (k < key || (after && k == key))
+			low = mid + 1;
 		else
-		{
-			cscan->custom_private = best_path->custom_private;
-		}
+			high = mid;
 	}
+	return low;
+}
 
-	cscan->custom_scan_tlist = NIL;
-	cscan->custom_plans = NIL;
-	cscan->scan.plan.targetlist = tlist;
-	cscan->scan.plan.qual = extract_actual_clauses(clauses, false);
-	cscan->methods = &sorted_heap_plan_methods;
+/*
+ * Line pointers of the share-locked current page that can hold a column
+ * 1 key within the scan's bounds (and interval list), in offset order.
+ *
+ * Compaction and merges leave each page's tuples in PK order, so once a
+ * page is known to still be in order a point or narrow-range lookup
+ * binary-searches its line pointers and checks visibility and quals for
+ * the matches only, instead of for every tuple on the page.  Returns -1
+ * if every line pointer has to be checked; *verify is then set if the
+ * page's key order is unknown and should be noted for next time.
+ */
+static int
+sorted_heap_page_candidates(SortedHeapScanState *shstate, Buffer buffer,
+							Page page, OffsetNumber *cand, bool *verify)
+{
+	Relation	rel = shstate->css.ss.ss_currentRelation;
+	SortedHeapRelInfo *info = shstate->relinfo;
+	SortedHeapScanBounds *bounds = &shstate->bounds;
+	SortedHeapInterval *ivals = shstate->ivals;
+	int			nivals = shstate->nivals;
+	BlockNumber blk = shstate->cblock;
+	SortedHeapZoneMapEntry *e;
+	SortedHeapInterval hull;
+	SortedHeapPageOrder *slot;
+	OffsetNumber normal[MaxHeapTuplesPerPage];
+	OffsetNumber lines;
+	int			nnormal = 0;
+	int			ncand = 0;
+
+	*verify = false;
+
+	/* Leader's copy may predate a rescan; DSM holds the live bounds */
+	if (shstate->pstate)
+	{
+		bounds = &shstate->pstate->bounds;
+		nivals = SORTED_HEAP_NO_INTERVALS;
+	}
 
-	return &cscan->scan.plan;
+	/* Page LSNs only track changes on WAL-logged relations */
+	if (!RelationNeedsWAL(rel) || (!bounds->has_lo && !bounds->has_hi))
+		return -1;
+	if (blk < 1 ||
+		sorted_heap_zone_of_block(info, blk) >= info->zm_total_entries ||
+		!sorted_heap_bounds_interval(bounds, &hull))
+		return -1;
+
+	/* Every key on the page (its zone) qualifies: nothing to skip */
+	e = sorted_heap_get_zm_entry(info, sorted_heap_zone_of_block(info, blk));
+	if (nivals == SORTED_HEAP_NO_INTERVALS &&
+		hull.lo <= e->zme_min && e->zme_max <= hull.hi)
+		return -1;
+
+	slot = sorted_heap_page_order_slot(info, blk);
+	if (slot->blkno != blk || slot->lsn != BufferGetLSNAtomic(buffer))
+	{
+		*verify = true;
+		return -1;
+	}
+	if (!slot->sorted)
+		return -1;
+
+	lines = PageGetMaxOffsetNumber(page);
+	for (OffsetNumber off = FirstOffsetNumber; off <= lines; off++)
+	{
+		if (ItemIdIsNormal(PageGetItemId(page, off)))
+			normal[nnormal++] = off;
+	}
+
+	if (nivals == SORTED_HEAP_NO_INTERVALS)
+	{
+		ivals = &hull;
+		nivals = 1;
+	}
+
+	/* Intervals are sorted and disjoint, so their windows are too */
+	for (int i = 0; i < nivals; i++)
+	{
+		int64		lo = Max(ivals[i].lo, hull.lo);
+		int64		hi = Min(ivals[i].hi, hull.hi);
+		int			first,
+					end;
+
+		if (lo > hi)
+			continue;
+		first = sorted_heap_page_bound(shstate, page, normal, nnormal,
+									   lo, false);
+		end = sorted_heap_page_bound(shstate, page, normal, nnormal,
+									 hi, true);
+		while (first < end)
+			cand[ncand++] = normal[first++];
+	}
+
+	return ncand;
 }
 
-/* ----------------------------------------------------------------
- *  CustomScan state creation
- * ---------------------------------------------------------------- */
-static Node *
-sorted_heap_create_scan_state(CustomScan *cscan)
+/*
+ * Put the page's visible tuples in PK column 1 order, descending for a
+ * backward scan.  Line pointer order is insertion order, which compaction
+ * makes PK order but later inserts and updates on the page don't keep;
+ * pages that are still in order are only checked.
+ */
+static void
+sorted_heap_order_page(SortedHeapScanState *shstate, Page page)
 {
-	SortedHeapScanState *shstate;
+	SortedHeapPageKey keys[MaxHeapTuplesPerPage];
+	bool		backward = ScanDirectionIsBackward(shstate->order_dir);
+	bool		in_order = true;
+	int			n = shstate->ntuples;
 
-	shstate = (SortedHeapScanState *) newNode(sizeof(SortedHeapScanState),
-											  T_CustomScanState);
-	shstate->css.methods = &sorted_heap_exec_methods;
-	shstate->css.slotOps = &TTSOpsBufferHeapTuple;
-	return (Node *) &shstate->css;
+	for (int i = 0; i < n; i++)
+	{
+		keys[i].key = sorted_heap_page_key(shstate, page,
+										   shstate->vistuples[i]);
+		keys[i].off = shstate->vistuples[i];
+		if (i > 0 && keys[i].key < keys[i - 1].key)
+			in_order = false;
+	}
+
+	if (!in_order)
+		qsort(keys, n, sizeof(SortedHeapPageKey), sorted_heap_cmp_page_key);
+	else if (!backward)
+		return;
+
+	for (int i = 0; i < n; i++)
+		shstate->vistuples[i] = keys[backward ? n - 1 - i : i].off;
 }
 
 /* ----------------------------------------------------------------
- *  BeginCustomScan
+ *  Read the next qualifying page and collect its visible tuples.
+ *
+ *  Mirrors heap's page-at-a-time mode: opportunistic pruning, then
+ *  visibility checks under a share lock; the pin keeps the collected
+ *  tuples valid after the lock is released.
  * ---------------------------------------------------------------- */
-static void
-sorted_heap_begin_custom_scan(CustomScanState *node, EState *estate,
-							  int eflags)
+static bool
+sorted_heap_fetch_page(SortedHeapScanState *shstate)
 {
-	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
-	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
-	Relation	rel = node->ss.ss_currentRelation;
-
-	/* Load relinfo for per-block zone map checks */
-	shstate->relinfo = sorted_heap_get_relinfo(rel);
+	Relation	rel = shstate->css.ss.ss_currentRelation;
+	Snapshot	snapshot = shstate->css.ss.ps.state->es_snapshot;
+	Buffer		buffer;
+	Page		page;
+	OffsetNumber lines;
+	OffsetNumber cand[MaxHeapTuplesPerPage];
+	int			ncand;
+	bool		verify;
+	bool		all_visible;
+	bool		check_serializable;
+	int			ntup = 0;
+
+	if (BufferIsValid(shstate->cbuf))
+	{
+		ReleaseBuffer(shstate->cbuf);
+		shstate->cbuf = InvalidBuffer;
+	}
+	shstate->ntuples = 0;
+	shstate->cindex = 0;
 
-	/* Init per-scan stats and parallel state */
-	shstate->scanned_blocks = 0;
-	shstate->pruned_blocks = 0;
-	shstate->last_blk = InvalidBlockNumber;
-	shstate->pscan = NULL;
-	shstate->runtime_bounds = false;
+	if (shstate->stream == NULL)
+	{
+		BlockNumber nblocks = shstate->pstate ?
+			shstate->pstate->scan_nblocks : shstate->scan_nblocks;
+
+		/* Same policy as heap: big scans must not flush shared buffers */
+		if (nblocks > (BlockNumber) (NBuffers / 4))
+			shstate->strategy = GetAccessStrategy(BAS_BULKREAD);
+
+		shstate->stream = read_stream_begin_relation(READ_STREAM_DEFAULT,
+													 shstate->strategy,
+													 rel, MAIN_FORKNUM,
+													 sorted_heap_stream_next_block,
+													 shstate, 0);
+
+		/* As for a seqscan: lock the relation against SSI writers */
+		PredicateLockRelation(rel, snapshot);
+		pgstat_count_heap_scan(rel);
+	}
 
 	/*
-	 * Path A: custom_private has 2 elements (range_list, bounds_list)
-	 * Path B: custom_private has 3 elements (meta_list, runtime_meta,
-	 *         const_bounds_list) — runtime_exprs moved to custom_exprs
-	 *         by plan_custom_path.
+	 * Blocks left out of the range list are never read either.  Workers
+	 * skip this so each pass is accounted for once, by the leader.
 	 */
-	if (list_length(cscan->custom_private) == 3)
+	if (!shstate->pass_counted)
 	{
-		/*
-		 * Path B: runtime bounds with Param nodes.
-		 * custom_private = list_make3(meta_list, runtime_meta, const_bounds_list)
-		 * custom_exprs = runtime Expr* nodes (Param/Const)
-		 */
-		List	   *meta_list = (List *) linitial(cscan->custom_private);
-		List	   *runtime_meta = (List *) lsecond(cscan->custom_private);
-		List	   *const_bounds_list = (List *) lthird(cscan->custom_private);
-		int			n_runtime;
-		int			i;
-		ListCell   *lc;
+		BlockNumber total = shstate->pstate ?
+			shstate->pstate->total_blocks : shstate->total_blocks;
+		BlockNumber listed = shstate->pstate ?
+			shstate->pstate->scan_nblocks : shstate->scan_nblocks;
+
+		if (!IsParallelWorker() && total > listed)
+			shstate->pruned_blocks += total - listed;
+		shstate->pass_counted = true;
+	}
 
-		shstate->runtime_bounds = true;
-		shstate->total_blocks = (BlockNumber) linitial_int(meta_list);
-		n_runtime = lsecond_int(meta_list);
-		shstate->n_runtime_exprs = n_runtime;
+	buffer = read_stream_next_buffer(shstate->stream, NULL);
 
-		/* Initialize ExprStates from custom_exprs */
-		shstate->runtime_exprstates =
-			ExecInitExprList(cscan->custom_exprs, &node->ss.ps);
+	/* Budget spent but rows still wanted: double it and resume */
+	while (!BufferIsValid(buffer) && shstate->stream_paused)
+	{
+		shstate->stream_paused = false;
+		shstate->issue_budget = shstate->issue_budget > MaxBlockNumber / 2 ?
+			0 : shstate->issue_budget * 2;
+		read_stream_reset(shstate->stream);
+		buffer = read_stream_next_buffer(shstate->stream, NULL);
+	}
+	if (!BufferIsValid(buffer))
+		return false;
 
-		/* Unpack runtime metadata: 3 ints per expression (strategy, is_col2, typid) */
-		shstate->runtime_strategies = palloc(sizeof(int) * n_runtime);
-		shstate->runtime_is_col2 = palloc(sizeof(bool) * n_runtime);
-		shstate->runtime_typids = palloc(sizeof(Oid) * n_runtime);
+	CHECK_FOR_INTERRUPTS();
 
-		i = 0;
-		lc = list_head(runtime_meta);
-		while (i < n_runtime && lc != NULL)
-		{
-			shstate->runtime_strategies[i] = lfirst_int(lc);
-			lc = lnext(runtime_meta, lc);
-			shstate->runtime_is_col2[i] = lfirst_int(lc) != 0;
-			lc = lnext(runtime_meta, lc);
-			shstate->runtime_typids[i] = (Oid) lfirst_int(lc);
-			lc = lnext(runtime_meta, lc);
-			i++;
-		}
+	shstate->cbuf = buffer;
+	shstate->cblock = BufferGetBlockNumber(buffer);
+	shstate->scanned_blocks++;
 
-		/* Unpack Const-only baseline bounds */
-		shstate->const_bounds.has_lo = list_nth_int(const_bounds_list, 0) != 0;
-		shstate->const_bounds.has_hi = list_nth_int(const_bounds_list, 1) != 0;
-		shstate->const_bounds.lo_inclusive = list_nth_int(const_bounds_list, 2) != 0;
-		shstate->const_bounds.hi_inclusive = list_nth_int(const_bounds_list, 3) != 0;
-		shstate->const_bounds.lo = ((int64) list_nth_int(const_bounds_list, 4) << 32) |
-			((int64) (uint32) list_nth_int(const_bounds_list, 5));
-		shstate->const_bounds.hi = ((int64) list_nth_int(const_bounds_list, 6) << 32) |
-			((int64) (uint32) list_nth_int(const_bounds_list, 7));
-
-		if (list_length(const_bounds_list) >= 16)
-		{
-			shstate->const_bounds.has_lo2 = list_nth_int(const_bounds_list, 8) != 0;
-			shstate->const_bounds.has_hi2 = list_nth_int(const_bounds_list, 9) != 0;
-			shstate->const_bounds.lo2_inclusive = list_nth_int(const_bounds_list, 10) != 0;
-			shstate->const_bounds.hi2_inclusive = list_nth_int(const_bounds_list, 11) != 0;
-			shstate->const_bounds.lo2 = ((int64) list_nth_int(const_bounds_list, 12) << 32) |
-				((int64) (uint32) list_nth_int(const_bounds_list, 13));
-			shstate->const_bounds.hi2 = ((int64) list_nth_int(const_bounds_list, 14) << 32) |
-				((int64) (uint32) list_nth_int(const_bounds_list, 15));
-		}
-		else
-		{
-			shstate->const_bounds.has_lo2 = false;
-			shstate->const_bounds.has_hi2 = false;
-		}
+	/* A spare overflow page a zone's span reaches holds no tuples */
+	if (PageGetSpecialSize(BufferGetPage(buffer)) != 0)
+		return true;
 
-		/* Resolve runtime bounds: evaluate Params, compute block range */
-		sorted_heap_resolve_runtime_bounds(shstate);
-	}
+	heap_page_prune_opt(rel, buffer);
+
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+
+	page = BufferGetPage(buffer);
+	lines = PageGetMaxOffsetNumber(page);
+	all_visible = PageIsAllVisible(page) && !snapshot->takenDuringRecovery;
+	check_serializable = CheckForSerializableConflictOutNeeded(rel, snapshot);
+
+	/* A page known to be in key order is searched, not walked */
+	ncand = sorted_heap_page_candidates(shstate, buffer, page, cand, &verify);
+	if (ncand >= 0)
+		shstate->searched_blocks++;
 	else
 	{
-		/*
-		 * Path A: all Const bounds — block range computed at plan time.
-		 * custom_private = list_make2(range_list, bounds_list)
-		 */
-		List	   *range_list = (List *) linitial(cscan->custom_private);
-		List	   *bounds_list = (List *) lsecond(cscan->custom_private);
-
-		shstate->scan_start = (BlockNumber) linitial_int(range_list);
-		shstate->scan_nblocks = (BlockNumber) lsecond_int(range_list);
-		shstate->total_blocks = (BlockNumber) lthird_int(range_list);
-
-		/* Extract bounds */
-		shstate->bounds.has_lo = list_nth_int(bounds_list, 0) != 0;
-		shstate->bounds.has_hi = list_nth_int(bounds_list, 1) != 0;
-		shstate->bounds.lo_inclusive = list_nth_int(bounds_list, 2) != 0;
-		shstate->bounds.hi_inclusive = list_nth_int(bounds_list, 3) != 0;
-		shstate->bounds.lo = ((int64) list_nth_int(bounds_list, 4) << 32) |
-			((int64) (uint32) list_nth_int(bounds_list, 5));
-		shstate->bounds.hi = ((int64) list_nth_int(bounds_list, 6) << 32) |
-			((int64) (uint32) list_nth_int(bounds_list, 7));
-
-		/* Column 2 bounds (indices 8-15) */
-		if (list_length(bounds_list) >= 16)
-		{
-			shstate->bounds.has_lo2 = list_nth_int(bounds_list, 8) != 0;
-			shstate->bounds.has_hi2 = list_nth_int(bounds_list, 9) != 0;
-			shstate->bounds.lo2_inclusive = list_nth_int(bounds_list, 10) != 0;
-			shstate->bounds.hi2_inclusive = list_nth_int(bounds_list, 11) != 0;
-			shstate->bounds.lo2 = ((int64) list_nth_int(bounds_list, 12) << 32) |
-				((int64) (uint32) list_nth_int(bounds_list, 13));
-			shstate->bounds.hi2 = ((int64) list_nth_int(bounds_list, 14) << 32) |
-				((int64) (uint32) list_nth_int(bounds_list, 15));
-		}
+		ncand = 0;
+		for (OffsetNumber off = FirstOffsetNumber; off <= lines; off++)
+			cand[ncand++] = off;
+	}
+
+	for (int i = 0; i < ncand; i++)
+	{
+		OffsetNumber lineoff = cand[i];
+		ItemId		lpp = PageGetItemId(page, lineoff);
+		HeapTupleData loctup;
+		bool		valid;
+
+		if (!ItemIdIsNormal(lpp))
+			continue;
+
+		loctup.t_data = (HeapTupleHeader) PageGetItem(page, lpp);
+		loctup.t_len = ItemIdGetLength(lpp);
+		loctup.t_tableOid = RelationGetRelid(rel);
+		ItemPointerSet(&loctup.t_self, shstate->cblock, lineoff);
+
+		if (all_visible)
+			valid = true;
 		else
+			valid = HeapTupleSatisfiesVisibility(&loctup, snapshot, buffer);
+
+		if (check_serializable)
+			HeapCheckForSerializableConflictOut(valid, rel, &loctup,
+												buffer, snapshot);
+
+		if (valid)
+			shstate->vistuples[ntup++] = lineoff;
+	}
+
+	if (verify)
+		sorted_heap_note_page_order(shstate, buffer, page);
+
+	LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+
+	shstate->ntuples = ntup;
+
+	/* Tuple data stays put while the page is pinned */
+	if (shstate->ranges_sorted)
+		sorted_heap_order_page(shstate, page);
+
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *  Next visible tuple from the blocks delivered by the read stream,
+ *  which has already skipped every block the zone map rules out.
+ * ---------------------------------------------------------------- */
+static bool
+sorted_heap_next_tuple(SortedHeapScanState *shstate, TupleTableSlot *slot)
+{
+	/* Pruning already happened per block, in the read stream callback */
+	for (;;)
+	{
+		Page		page;
+		ItemId		lpp;
+		OffsetNumber lineoff;
+
+		if (shstate->cindex >= shstate->ntuples)
 		{
-			shstate->bounds.has_lo2 = false;
-			shstate->bounds.has_hi2 = false;
+			if (!sorted_heap_fetch_page(shstate))
+				return false;
+			continue;
 		}
+
+		lineoff = shstate->vistuples[shstate->cindex++];
+		page = BufferGetPage(shstate->cbuf);
+		lpp = PageGetItemId(page, lineoff);
+
+		shstate->ctup.t_data = (HeapTupleHeader) PageGetItem(page, lpp);
+		shstate->ctup.t_len = ItemIdGetLength(lpp);
+		ItemPointerSet(&shstate->ctup.t_self, shstate->cblock, lineoff);
+
+		ExecStoreBufferHeapTuple(&shstate->ctup, slot, shstate->cbuf);
+		return true;
 	}
+}
 
-	/*
-	 * For parallel-aware scans, defer scan creation to the DSM
-	 * callbacks (InitializeDSM / InitializeWorker) which will open a
-	 * coordinated parallel scan.  For serial scans, open the heap scan
-	 * now and restrict it to the pruned block range.
-	 */
-	if (cscan->scan.plan.parallel_aware)
+/* ----------------------------------------------------------------
+ *  Ordered scan over pages not known to be in PK order.
+ *
+ *  Rare: the plan only promises order for pages that were in the
+ *  sorted prefix at planning time, but the zone map may have changed
+ *  since.  The pass's (key, TID) pairs are sorted, bounded by work_mem
+ *  like any sort, and the tuples fetched back by TID; a parallel
+ *  participant sorts just the chunks it claimed, which is all Gather
+ *  Merge needs.
+ * ---------------------------------------------------------------- */
+static bool
+sorted_heap_next_sorted(SortedHeapScanState *shstate, TupleTableSlot *slot)
+{
+	Relation	rel = shstate->css.ss.ss_currentRelation;
+	Snapshot	snapshot = shstate->css.ss.ps.state->es_snapshot;
+	TupleTableSlot *sortslot = shstate->tidsort_slot;
+
+	if (shstate->tidsort == NULL)
 	{
-		shstate->heap_scan = NULL;
+		SortedHeapRelInfo *info = shstate->relinfo;
+		AttrNumber	keyattno = 1;
+		Oid			keyop = Int8LessOperator;
+		Oid			keycoll = InvalidOid;
+		bool		nullsfirst = false;
+
+		if (ScanDirectionIsBackward(shstate->order_dir))
+			keyop = get_commutator(keyop);
+
+		/* The sort reads the whole pass: no point pacing it */
+		shstate->issue_budget = 0;
+
+		shstate->tidsort = tuplesort_begin_heap(shstate->tidsort_desc, 1,
+												&keyattno, &keyop, &keycoll,
+												&nullsfirst, work_mem, NULL,
+												TUPLESORT_NONE);
+
+		while (sorted_heap_next_tuple(shstate, slot))
+		{
+			Datum		val;
+			bool		isnull;
+			int64		key;
+
+			val = slot_getattr(slot, info->attNums[0], &isnull);
+			if (isnull || !sorted_heap_key_to_int64(val, info->zm_pk_typid,
+													&key))
+				key = PG_INT64_MIN;
+
+			ExecClearTuple(sortslot);
+			sortslot->tts_values[0] = Int64GetDatum(key);
+			sortslot->tts_isnull[0] = false;
+			sortslot->tts_values[1] = ItemPointerGetDatum(&slot->tts_tid);
+			sortslot->tts_isnull[1] = false;
+			ExecStoreVirtualTuple(sortslot);
+			tuplesort_puttupleslot(shstate->tidsort, sortslot);
+		}
+		tuplesort_performsort(shstate->tidsort);
 	}
-	else
+
+	while (tuplesort_gettupleslot(shstate->tidsort, true, false, sortslot,
+								  NULL))
 	{
-		shstate->heap_scan = table_beginscan(rel, estate->es_snapshot,
-											 0, NULL);
-		if (shstate->scan_nblocks > 0)
-			heap_setscanlimits(shstate->heap_scan,
-							   shstate->scan_start,
-							   shstate->scan_nblocks);
-		else
-			heap_setscanlimits(shstate->heap_scan, 1, 0);
+		bool		isnull;
+		ItemPointer tid;
+
+		tid = DatumGetItemPointer(slot_getattr(sortslot, 2, &isnull));
+		if (table_tuple_fetch_row_version(rel, tid, snapshot, slot))
+			return true;
 	}
+	return false;
 }
 
 /* ----------------------------------------------------------------
  *  Scan access method — return next zone-map-qualified scan tuple.
  *
  *  Called by ExecScan() as the "access method" callback.  Returns raw
- *  scan tuples from the heap with zone-map block pruning applied.
+ *  scan tuples, in PK column 1 order for an ordered scan.
  *  Qual evaluation and projection are handled by ExecScan itself.
  * ---------------------------------------------------------------- */
 static TupleTableSlot *
@@ -1268,38 +3377,20 @@ sorted_heap_scan_next(ScanState *ss)
 	CustomScanState *node = (CustomScanState *) ss;
 	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
 	TupleTableSlot *slot = ss->ss_ScanTupleSlot;
+	bool		found;
 
-	while (table_scan_getnextslot(shstate->heap_scan,
-								  ForwardScanDirection, slot))
-	{
-		BlockNumber blk = ItemPointerGetBlockNumber(&slot->tts_tid);
-		bool		new_block = (blk != shstate->last_blk);
-
-		/* Track block transitions for EXPLAIN ANALYZE */
-		if (new_block)
-		{
-			shstate->scanned_blocks++;
-			shstate->last_blk = blk;
-		}
-
-		/* Per-block zone map check for fine-grained pruning */
-		if (blk >= 1 && (blk - 1) < shstate->relinfo->zm_total_entries)
-		{
-			SortedHeapZoneMapEntry *e =
-				sorted_heap_get_zm_entry(shstate->relinfo, blk - 1);
-
-			if (!sorted_heap_zone_overlaps(e, &shstate->bounds))
-			{
-				if (new_block)
-					shstate->pruned_blocks++;
-				continue;
-			}
-		}
+	if (!ScanDirectionIsNoMovement(shstate->order_dir) &&
+		!shstate->ranges_sorted)
+		found = sorted_heap_next_sorted(shstate, slot);
+	else
+		found = sorted_heap_next_tuple(shstate, slot);
 
-		return slot;
+	if (!found)
+	{
+		ExecClearTuple(slot);
+		return NULL;
 	}
-
-	return NULL;
+	return slot;
 }
 
 /* ----------------------------------------------------------------
@@ -1321,6 +3412,11 @@ sorted_heap_scan_recheck(ScanState *ss, TupleTableSlot *slot)
 static TupleTableSlot *
 sorted_heap_exec_custom_scan(CustomScanState *node)
 {
+	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
+
+	if (shstate->runtime_bounds && !shstate->runtime_ready)
+		sorted_heap_resolve_runtime_bounds(shstate);
+
 	return ExecScan(&node->ss,
 					(ExecScanAccessMtd) sorted_heap_scan_next,
 					(ExecScanRecheckMtd) sorted_heap_scan_recheck);
@@ -1348,11 +3444,88 @@ sorted_heap_end_custom_scan(CustomScanState *node)
 								shstate->pruned_blocks);
 	}
 
-	if (shstate->heap_scan)
+	if (BufferIsValid(shstate->cbuf))
 	{
-		table_endscan(shstate->heap_scan);
-		shstate->heap_scan = NULL;
+		ReleaseBuffer(shstate->cbuf);
+		shstate->cbuf = InvalidBuffer;
 	}
+
+	if (shstate->stream)
+	{
+		read_stream_end(shstate->stream);
+		shstate->stream = NULL;
+	}
+
+	if (shstate->strategy)
+	{
+		FreeAccessStrategy(shstate->strategy);
+		shstate->strategy = NULL;
+	}
+
+	if (shstate->tidsort)
+	{
+		tuplesort_end(shstate->tidsort);
+		shstate->tidsort = NULL;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *  Publish the leader's block ranges into DSM and reset the cursor.
+ * ---------------------------------------------------------------- */
+static void
+sorted_heap_parallel_publish(SortedHeapScanState *shstate,
+							 SortedHeapParallelScan *pstate,
+							 int nworkers)
+{
+	uint32		chunk;
+
+	pstate->total_blocks = shstate->total_blocks;
+	pstate->bounds = shstate->bounds;
+	pstate->ranges_sorted = shstate->ranges_sorted;
+
+	if (shstate->nranges <= pstate->max_ranges)
+	{
+		memcpy(pstate->ranges, shstate->ranges,
+			   shstate->nranges * sizeof(SortedHeapBlockRange));
+		pstate->nranges = shstate->nranges;
+		pstate->scan_nblocks = shstate->scan_nblocks;
+	}
+	else
+	{
+		/* Too many ranges for the segment: publish one covering range */
+		SortedHeapBlockRange *last = &shstate->ranges[shstate->nranges - 1];
+
+		pstate->ranges[0].start = shstate->ranges[0].start;
+		pstate->ranges[0].nblocks = last->start + last->nblocks -
+			shstate->ranges[0].start;
+		pstate->nranges = 1;
+		pstate->scan_nblocks = pstate->ranges[0].nblocks;
+	}
+
+	/*
+	 * Aim for a few chunks per participant so stragglers can be balanced,
+	 * but keep chunks large enough for read-ahead to be useful.
+	 */
+	chunk = pstate->scan_nblocks / ((uint32) (nworkers + 1) * 4);
+	chunk = Max(chunk, 1);
+	chunk = Min(chunk, SORTED_HEAP_PARALLEL_MAX_CHUNK);
+	pstate->chunk_size = chunk;
+
+	pg_atomic_write_u32(&pstate->next_offset, 0);
+}
+
+/* ----------------------------------------------------------------
+ *  Number of ranges the DSM segment has room for.  Path B resolves its
+ *  ranges only after the segment is sized, and a rescan may resolve
+ *  more of them, so it gets the minimum; publish falls back to one
+ *  covering range when the resolved list does not fit.
+ * ---------------------------------------------------------------- */
+static int
+sorted_heap_parallel_max_ranges(SortedHeapScanState *shstate)
+{
+	if (shstate->runtime_bounds)
+		return SORTED_HEAP_PARALLEL_MIN_RANGES;
+	return Max(shstate->nranges, SORTED_HEAP_PARALLEL_MIN_RANGES);
 }
 
 /* ----------------------------------------------------------------
@@ -1361,27 +3534,50 @@ sorted_heap_end_custom_scan(CustomScanState *node)
 static Size
 sorted_heap_estimate_dsm(CustomScanState *node, ParallelContext *pcxt)
 {
-	return table_parallelscan_estimate(node->ss.ss_currentRelation,
-									   node->ss.ps.state->es_snapshot);
+	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
+	int			max_ranges = sorted_heap_parallel_max_ranges(shstate);
+	Size		pending = sorted_heap_zonemap_pending_size(node->ss.ss_currentRelation);
+
+	return add_size(SORTED_HEAP_PARALLEL_PENDING_OFFSET(max_ranges),
+					MAXALIGN(pending));
 }
 
 /* ----------------------------------------------------------------
- *  InitializeDSMCustomScan — leader sets up parallel table scan
+ *  InitializeDSMCustomScan — leader publishes the block ranges
  * ---------------------------------------------------------------- */
 static void
 sorted_heap_initialize_dsm(CustomScanState *node, ParallelContext *pcxt,
 							void *coordinate)
 {
 	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
+	SortedHeapParallelScan *pstate = (SortedHeapParallelScan *) coordinate;
 	Relation	rel = node->ss.ss_currentRelation;
-	ParallelTableScanDesc pscan = (ParallelTableScanDesc) coordinate;
 
-	table_parallelscan_initialize(rel, pscan,
-								  node->ss.ps.state->es_snapshot);
-	shstate->pscan = pscan;
+	/* Must match the size EstimateDSM reserved, so take it first */
+	pstate->max_ranges = sorted_heap_parallel_max_ranges(shstate);
+	pstate->pending_size = sorted_heap_zonemap_pending_size(rel);
+	pg_atomic_init_u32(&pstate->next_offset, 0);
+
+	/*
+	 * The leader's deferred entries, for the workers' zone maps.  Nothing
+	 * is written in parallel mode, so rescans can keep them as they are.
+	 */
+	if (pstate->pending_size > 0)
+		sorted_heap_zonemap_pending_save(rel, (SortedHeapZoneMapEntry *)
+										 ((char *) pstate +
+										  SORTED_HEAP_PARALLEL_PENDING_OFFSET(pstate->max_ranges)));
+
+	/*
+	 * Path B ranges are not known until the Params are evaluated, and the
+	 * workers take theirs from DSM, so resolve them before publishing.
+	 */
+	if (shstate->runtime_bounds && !shstate->runtime_ready)
+		sorted_heap_resolve_runtime_bounds(shstate);
+
+	sorted_heap_parallel_publish(shstate, pstate, pcxt->nworkers);
 
-	/* Open leader's parallel scan */
-	shstate->heap_scan = table_beginscan_parallel(rel, pscan);
+	shstate->pstate = pstate;
+	sorted_heap_reset_cursor(shstate);
 }
 
 /* ----------------------------------------------------------------
@@ -1392,34 +3588,46 @@ sorted_heap_reinitialize_dsm(CustomScanState *node, ParallelContext *pcxt,
 							  void *coordinate)
 {
 	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
-	Relation	rel = node->ss.ss_currentRelation;
-	ParallelTableScanDesc pscan = (ParallelTableScanDesc) coordinate;
+	SortedHeapParallelScan *pstate = (SortedHeapParallelScan *) coordinate;
 
-	table_parallelscan_reinitialize(rel, pscan);
+	/*
+	 * Params may have changed since the last execution; the leader's own
+	 * ReScan may not have run yet, so resolve the ranges here before the
+	 * workers are launched.
+	 */
+	if (shstate->runtime_bounds)
+		sorted_heap_resolve_runtime_bounds(shstate);
+	else
+		sorted_heap_compute_scan_ranges(shstate);
 
-	/* Reopen the leader's scan */
-	if (shstate->heap_scan)
-		table_endscan(shstate->heap_scan);
-	shstate->heap_scan = table_beginscan_parallel(rel, pscan);
+	sorted_heap_parallel_publish(shstate, pstate, pcxt->nworkers);
+	sorted_heap_reset_cursor(shstate);
 }
 
 /* ----------------------------------------------------------------
- *  InitializeWorkerCustomScan — worker opens parallel scan
+ *  InitializeWorkerCustomScan — worker adopts the leader's ranges
  * ---------------------------------------------------------------- */
 static void
 sorted_heap_initialize_worker(CustomScanState *node, shm_toc *toc,
 							   void *coordinate)
 {
 	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
-	Relation	rel = node->ss.ss_currentRelation;
-	ParallelTableScanDesc pscan = (ParallelTableScanDesc) coordinate;
-
-	shstate->pscan = pscan;
-
-	/* Open this worker's parallel scan */
-	if (shstate->heap_scan)
-		table_endscan(shstate->heap_scan);
-	shstate->heap_scan = table_beginscan_parallel(rel, pscan);
+	SortedHeapParallelScan *pstate = (SortedHeapParallelScan *) coordinate;
+
+	shstate->pstate = pstate;
+	shstate->total_blocks = pstate->total_blocks;
+	shstate->scan_nblocks = pstate->scan_nblocks;
+	shstate->bounds = pstate->bounds;
+	shstate->ranges_sorted = pstate->ranges_sorted;
+	shstate->runtime_ready = true;
+
+	/* Cover the leader's uncommitted rows before pruning any block */
+	if (pstate->pending_size > 0)
+		sorted_heap_zonemap_pending_adopt(node->ss.ss_currentRelation,
+										  (SortedHeapZoneMapEntry *)
+										  ((char *) pstate +
+										   SORTED_HEAP_PARALLEL_PENDING_OFFSET(pstate->max_ranges)));
+	sorted_heap_reset_cursor(shstate);
 }
 
 /* ----------------------------------------------------------------
@@ -1430,27 +3638,20 @@ sorted_heap_rescan_custom_scan(CustomScanState *node)
 {
 	SortedHeapScanState *shstate = (SortedHeapScanState *) node;
 
-	/* Path B: re-evaluate runtime bounds (params may change in NestLoop) */
-	if (shstate->runtime_bounds)
+	/*
+	 * Path B: re-evaluate runtime bounds (params may change in NestLoop).
+	 * Parallel scans take their ranges from DSM, which ReInitializeDSM
+	 * republishes.
+	 */
+	if (shstate->runtime_bounds && shstate->pstate == NULL)
 	{
 		sorted_heap_resolve_runtime_bounds(shstate);
 		shstate->scanned_blocks = 0;
+		shstate->searched_blocks = 0;
 		shstate->pruned_blocks = 0;
-		shstate->last_blk = InvalidBlockNumber;
 	}
 
-	if (shstate->heap_scan)
-	{
-		table_rescan(shstate->heap_scan, NULL);
-
-		/* Re-apply scan limits (rescan resets rs_inited) */
-		if (shstate->scan_nblocks > 0)
-			heap_setscanlimits(shstate->heap_scan,
-							   shstate->scan_start,
-							   shstate->scan_nblocks);
-		else
-			heap_setscanlimits(shstate->heap_scan, 1, 0);
-	}
+	sorted_heap_reset_cursor(shstate);
 }
 
 /* ----------------------------------------------------------------
@@ -1469,6 +3670,14 @@ sorted_heap_explain_custom_scan(CustomScanState *node, List *ancestors,
 		appendStringInfo(&buf, "%u total blocks (runtime bounds)",
 						 shstate->total_blocks);
 	}
+	else if (shstate->nranges > 1)
+	{
+		appendStringInfo(&buf, "%u of %u blocks in %d ranges (pruned %u)",
+						 shstate->scan_nblocks,
+						 shstate->total_blocks,
+						 shstate->nranges,
+						 shstate->total_blocks - shstate->scan_nblocks);
+	}
 	else
 	{
 		appendStringInfo(&buf, "%u of %u blocks (pruned %u)",
@@ -1479,12 +3688,19 @@ sorted_heap_explain_custom_scan(CustomScanState *node, List *ancestors,
 	ExplainPropertyText("Zone Map", buf.data, es);
 	pfree(buf.data);
 
+	if (shstate->block_budget > 0)
+		ExplainPropertyInteger("Block Budget", NULL,
+							   shstate->block_budget, es);
+
 	if (es->analyze)
 	{
 		ExplainPropertyInteger("Scanned Blocks", NULL,
 							   shstate->scanned_blocks, es);
 		ExplainPropertyInteger("Pruned Blocks", NULL,
 							   shstate->pruned_blocks, es);
+		if (shstate->searched_blocks > 0)
+			ExplainPropertyInteger("Searched Blocks", NULL,
+								   shstate->searched_blocks, es);
 	}
 }
 
@@ -0,0 +1,418 @@
+/*
+ * sorted_heap_zmfilter.c
+ *
+ * Vectorised zone map evaluation: test a run of zone map entries against
+ * a closed query box and return a bitmap of the entries that may hold
+ * matching rows.  A 32-byte entry is exactly one AVX2 register (two SSE
+ * or NEON registers), so each entry is tested with two compares and no
+ * branches.  The kernel is chosen on first call from what the CPU
+ * supports, and kept only if it agrees with the scalar version on the
+ * edge cases in sorted_heap_zone_filter_check(); the scalar version is
+ * branch-free C the compiler may vectorise itself.
+ */
+#include "postgres.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SORTED_HEAP_ZMFILTER_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SORTED_HEAP_ZMFILTER_NEON
+#include <arm_neon.h>
+#endif
+
+#include "funcapi.h"
+#include "utils/builtins.h"
+
+#include "sorted_heap.h"
+
+typedef void (*SortedHeapZoneFilterFn) (const SortedHeapZoneMapEntry *entries,
+										uint32 n,
+										const SortedHeapZoneBox *box,
+										uint64 *bitmap);
+
+typedef struct SortedHeapZoneKernel
+{
+	const char *name;
+	SortedHeapZoneFilterFn fn;
+} SortedHeapZoneKernel;
+
+/* Most kernels a CPU can offer: scalar plus up to two vector ones */
+#define SORTED_HEAP_ZONE_KERNELS_MAX	3
+
+static void sorted_heap_zone_filter_choose(const SortedHeapZoneMapEntry *entries,
+										   uint32 n,
+										   const SortedHeapZoneBox *box,
+										   uint64 *bitmap);
+
+void		(*sorted_heap_zone_filter) (const SortedHeapZoneMapEntry *entries,
+										uint32 n,
+										const SortedHeapZoneBox *box,
+										uint64 *bitmap) = sorted_heap_zone_filter_choose;
+
+/*
+ * Combine an entry's compare results into its bit.  fail has bit 0 for
+ * min > hi, bit 1 for max < lo, bits 2 and 3 likewise for column 2;
+ * unset has bit 0 if min is the "no data" sentinel and bit 2 if min2 is
+ * the "column 2 not tracked" one.
+ */
+static inline uint64
+sorted_heap_zone_bit(uint32 fail, uint32 unset)
+{
+	return (~unset & 1) &
+		~((fail | (fail >> 1)) & 1) &
+		((unset >> 2) | ~(((fail >> 2) | (fail >> 3)) & 1)) & 1;
+}
+
+static void
+sorted_heap_zone_filter_scalar(const SortedHeapZoneMapEntry *entries,
+							   uint32 n, const SortedHeapZoneBox *box,
+							   uint64 *bitmap)
+{
+	memset(bitmap, 0, ((n + 63) / 64) * sizeof(uint64));
+
+	for (uint32 i = 0; i < n; i++)
+	{
+		const SortedHeapZoneMapEntry *e = &entries[i];
+		uint32		fail;
+		uint32		unset;
+
+		fail = (uint32) (e->zme_min > box->hi) |
+			((uint32) (e->zme_max < box->lo) << 1) |
+			((uint32) (e->zme_min2 > box->hi2) << 2) |
+			((uint32) (e->zme_max2 < box->lo2) << 3);
+		unset = (uint32) (e->zme_min == PG_INT64_MAX) |
+			((uint32) (e->zme_min2 == PG_INT64_MAX) << 2);
+		bitmap[i / 64] |= sorted_heap_zone_bit(fail, unset) << (i % 64);
+	}
+}
+
+#ifdef SORTED_HEAP_ZMFILTER_X86
+
+/*
+ * Lanes hold (min, max, min2, max2).  Comparing against (hi, MAX, hi2,
+ * MAX) flags min > hi and min2 > hi2; (MIN, lo, MIN, lo2) compared the
+ * other way flags max < lo and max2 < lo2.  The padding lanes never fire.
+ */
+__attribute__((target("avx2")))
+static void
+sorted_heap_zone_filter_avx2(const SortedHeapZoneMapEntry *entries,
+							 uint32 n, const SortedHeapZoneBox *box,
+							 uint64 *bitmap)
+{
+	__m256i		above = _mm256_set_epi64x(PG_INT64_MAX, box->hi2,
+										  PG_INT64_MAX, box->hi);
+	__m256i		below = _mm256_set_epi64x(box->lo2, PG_INT64_MIN,
+										  box->lo, PG_INT64_MIN);
+	__m256i		sentinel = _mm256_set1_epi64x(PG_INT64_MAX);
+
+	memset(bitmap, 0, ((n + 63) / 64) * sizeof(uint64));
+
+	for (uint32 i = 0; i < n; i++)
+	{
+		__m256i		v = _mm256_loadu_si256((const __m256i *) &entries[i]);
+		__m256i		f = _mm256_or_si256(_mm256_cmpgt_epi64(v, above),
+										_mm256_cmpgt_epi64(below, v));
+		uint32		fail = _mm256_movemask_pd(_mm256_castsi256_pd(f));
+		uint32		unset = _mm256_movemask_pd(
+			_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, sentinel)));
+
+		bitmap[i / 64] |= sorted_heap_zone_bit(fail, unset) << (i % 64);
+	}
+}
+
+/* As above, one column per 128-bit register (pcmpgtq is SSE4.2) */
+__attribute__((target("sse4.2")))
+static void
+sorted_heap_zone_filter_sse42(const SortedHeapZoneMapEntry *entries,
+							  uint32 n, const SortedHeapZoneBox *box,
+							  uint64 *bitmap)
+{
+	__m128i		above1 = _mm_set_epi64x(PG_INT64_MAX, box->hi);
+	__m128i		below1 = _mm_set_epi64x(box->lo, PG_INT64_MIN);
+	__m128i		above2 = _mm_set_epi64x(PG_INT64_MAX, box->hi2);
+	__m128i		below2 = _mm_set_epi64x(box->lo2, PG_INT64_MIN);
+	__m128i		sentinel = _mm_set1_epi64x(PG_INT64_MAX);
+
+	memset(bitmap, 0, ((n + 63) / 64) * sizeof(uint64));
+
+	for (uint32 i = 0; i < n; i++)
+	{
+		const __m128i *p = (const __m128i *) &entries[i];
+		__m128i		v1 = _mm_loadu_si128(p);
+		__m128i		v2 = _mm_loadu_si128(p + 1);
+		__m128i		f1 = _mm_or_si128(_mm_cmpgt_epi64(v1, above1),
+									  _mm_cmpgt_epi64(below1, v1));
+		__m128i		f2 = _mm_or_si128(_mm_cmpgt_epi64(v2, above2),
+									  _mm_cmpgt_epi64(below2, v2));
+		uint32		fail = _mm_movemask_pd(_mm_castsi128_pd(f1)) |
+			(_mm_movemask_pd(_mm_castsi128_pd(f2)) << 2);
+		uint32		unset = _mm_movemask_pd(
+			_mm_castsi128_pd(_mm_cmpeq_epi64(v1, sentinel))) |
+			(_mm_movemask_pd(
+				_mm_castsi128_pd(_mm_cmpeq_epi64(v2, sentinel))) << 2);
+
+		bitmap[i / 64] |= sorted_heap_zone_bit(fail, unset) << (i % 64);
+	}
+}
+
+#endif							/* SORTED_HEAP_ZMFILTER_X86 */
+
+#ifdef SORTED_HEAP_ZMFILTER_NEON
+
+static void
+sorted_heap_zone_filter_neon(const SortedHeapZoneMapEntry *entries,
+							 uint32 n, const SortedHeapZoneBox *box,
+							 uint64 *bitmap)
+{
+	int64_t		a1[2] = {box->hi, PG_INT64_MAX};
+	int64_t		b1[2] = {PG_INT64_MIN, box->lo};
+	int64_t		a2[2] = {box->hi2, PG_INT64_MAX};
+	int64_t		b2[2] = {PG_INT64_MIN, box->lo2};
+	int64x2_t	above1 = vld1q_s64(a1);
+	int64x2_t	below1 = vld1q_s64(b1);
+	int64x2_t	above2 = vld1q_s64(a2);
+	int64x2_t	below2 = vld1q_s64(b2);
+	int64x2_t	sentinel = vdupq_n_s64(PG_INT64_MAX);
+
+	memset(bitmap, 0, ((n + 63) / 64) * sizeof(uint64));
+
+	for (uint32 i = 0; i < n; i++)
+	{
+		const int64_t *p = (const int64_t *) &entries[i];
+		int64x2_t	v1 = vld1q_s64(p);
+		int64x2_t	v2 = vld1q_s64(p + 2);
+		uint64x2_t	f1 = vorrq_u64(vcgtq_s64(v1, above1),
+								   vcgtq_s64(below1, v1));
+		uint64x2_t	f2 = vorrq_u64(vcgtq_s64(v2, above2),
+								   vcgtq_s64(below2, v2));
+		uint64x2_t	u1 = vceqq_s64(v1, sentinel);
+		uint64x2_t	u2 = vceqq_s64(v2, sentinel);
+		uint32		fail;
+		uint32		unset;
+
+		fail = (uint32) (vgetq_lane_u64(f1, 0) & 1) |
+			((uint32) (vgetq_lane_u64(f1, 1) & 1) << 1) |
+			((uint32) (vgetq_lane_u64(f2, 0) & 1) << 2) |
+			((uint32) (vgetq_lane_u64(f2, 1) & 1) << 3);
+		unset = (uint32) (vgetq_lane_u64(u1, 0) & 1) |
+			((uint32) (vgetq_lane_u64(u2, 0) & 1) << 2);
+		bitmap[i / 64] |= sorted_heap_zone_bit(fail, unset) << (i % 64);
+	}
+}
+
+#endif							/* SORTED_HEAP_ZMFILTER_NEON */
+
+/*
+ * The kernels this CPU runs, scalar first and the preferred one last.
+ * Returns how many.
+ */
+static int
+sorted_heap_zone_kernels(SortedHeapZoneKernel *kernels)
+{
+	int			n = 0;
+
+	kernels[n].name = "scalar";
+	kernels[n++].fn = sorted_heap_zone_filter_scalar;
+#if defined(SORTED_HEAP_ZMFILTER_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		kernels[n].name = "sse4.2";
+		kernels[n++].fn = sorted_heap_zone_filter_sse42;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		kernels[n].name = "avx2";
+		kernels[n++].fn = sorted_heap_zone_filter_avx2;
+	}
+#elif defined(SORTED_HEAP_ZMFILTER_NEON)
+	kernels[n].name = "neon";
+	kernels[n++].fn = sorted_heap_zone_filter_neon;
+#endif
+	return n;
+}
+
+/* Entries per check case */
+#define SORTED_HEAP_ZONE_CHECK_N	200
+
+static const uint32 sorted_heap_zone_check_lengths[] = {
+	0, 1, 3, 63, 64, 65, 127, SORTED_HEAP_ZONE_CHECK_N
+};
+
+static const SortedHeapZoneBox sorted_heap_zone_check_boxes[] = {
+	{PG_INT64_MIN, PG_INT64_MAX, PG_INT64_MIN, PG_INT64_MAX},
+	{0, 0, PG_INT64_MIN, PG_INT64_MAX},
+	{-3, 3, 0, 0},
+	{5, -5, PG_INT64_MIN, PG_INT64_MAX},	/* empty */
+	{PG_INT64_MAX, PG_INT64_MAX, PG_INT64_MIN, PG_INT64_MIN},
+	{PG_INT64_MIN, PG_INT64_MIN, PG_INT64_MAX, PG_INT64_MAX}
+};
+
+/* Random boxes tried after the fixed ones */
+#define SORTED_HEAP_ZONE_CHECK_RANDOM_BOXES	8
+
+/* Small keys, so that entry and box bounds often coincide */
+static int64
+sorted_heap_zone_check_key(uint32 *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return (int64) ((*state >> 16) % 17) - 8;
+}
+
+/*
+ * Compare fn with the scalar loop on edge cases: no entries, a full
+ * bitmap word, partial last words, entries starting on and off a 32-byte
+ * boundary, unset entries (min at the PG_INT64_MAX sentinel, with or
+ * without a max), column 2 untracked, bounds equal to the box's, the
+ * extreme keys and empty boxes.  Bitmap words past the last entry must
+ * be left alone.  Sets *ncases to the cases run and returns how many
+ * disagreed.
+ */
+static int
+sorted_heap_zone_filter_check(SortedHeapZoneFilterFn fn, int *ncases)
+{
+	SortedHeapZoneMapEntry src[SORTED_HEAP_ZONE_CHECK_N];
+	SortedHeapZoneMapEntry buf[SORTED_HEAP_ZONE_CHECK_N + 2];
+	char	   *base = (char *) TYPEALIGN(32, buf);
+	int			nfixed = lengthof(sorted_heap_zone_check_boxes);
+	uint32		state = 1;
+	int			mismatches = 0;
+
+	*ncases = 0;
+
+	for (uint32 i = 0; i < SORTED_HEAP_ZONE_CHECK_N; i++)
+	{
+		SortedHeapZoneMapEntry *e = &src[i];
+		int64		a = sorted_heap_zone_check_key(&state);
+		int64		b = sorted_heap_zone_check_key(&state);
+		int64		c = sorted_heap_zone_check_key(&state);
+		int64		d = sorted_heap_zone_check_key(&state);
+
+		e->zme_min = Min(a, b);
+		e->zme_max = Max(a, b);
+		e->zme_min2 = Min(c, d);
+		e->zme_max2 = Max(c, d);
+		switch (i % 8)
+		{
+			case 0:				/* no data */
+				e->zme_min = PG_INT64_MAX;
+				e->zme_max = PG_INT64_MIN;
+				e->zme_min2 = PG_INT64_MAX;
+				e->zme_max2 = PG_INT64_MIN;
+				break;
+			case 1:				/* column 2 not tracked */
+				e->zme_min2 = PG_INT64_MAX;
+				e->zme_max2 = PG_INT64_MIN;
+				break;
+			case 6:				/* the extreme keys */
+				e->zme_min = PG_INT64_MIN;
+				e->zme_max = PG_INT64_MAX;
+				e->zme_min2 = PG_INT64_MIN;
+				e->zme_max2 = PG_INT64_MAX - 1;
+				break;
+			case 7:				/* sentinel min with a max */
+				e->zme_min = PG_INT64_MAX;
+				break;
+			default:
+				break;
+		}
+	}
+
+	for (int b = 0; b < nfixed + SORTED_HEAP_ZONE_CHECK_RANDOM_BOXES; b++)
+	{
+		SortedHeapZoneBox box;
+
+		if (b < nfixed)
+			box = sorted_heap_zone_check_boxes[b];
+		else
+		{
+			box.lo = sorted_heap_zone_check_key(&state);
+			box.hi = sorted_heap_zone_check_key(&state);
+			box.lo2 = sorted_heap_zone_check_key(&state);
+			box.hi2 = sorted_heap_zone_check_key(&state);
+		}
+
+		for (int l = 0; l < lengthof(sorted_heap_zone_check_lengths); l++)
+		{
+			for (int shift = 0; shift < 2; shift++)
+			{
+				uint32		n = sorted_heap_zone_check_lengths[l];
+				SortedHeapZoneMapEntry *ents = (SortedHeapZoneMapEntry *)
+					(base + shift * sizeof(int64));
+				uint64		want[(SORTED_HEAP_ZONE_CHECK_N + 63) / 64 + 1];
+				uint64		got[(SORTED_HEAP_ZONE_CHECK_N + 63) / 64 + 1];
+
+				memcpy(ents, src, n * sizeof(SortedHeapZoneMapEntry));
+				memset(want, 0xA5, sizeof(want));
+				memset(got, 0xA5, sizeof(got));
+				sorted_heap_zone_filter_scalar(ents, n, &box, want);
+				fn(ents, n, &box, got);
+				if (memcmp(want, got, sizeof(want)) != 0)
+					mismatches++;
+				(*ncases)++;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+/*
+ * First call: pick the best kernel this CPU runs that agrees with the
+ * scalar loop, then use it
+ */
+static void
+sorted_heap_zone_filter_choose(const SortedHeapZoneMapEntry *entries,
+							   uint32 n, const SortedHeapZoneBox *box,
+							   uint64 *bitmap)
+{
+	SortedHeapZoneKernel kernels[SORTED_HEAP_ZONE_KERNELS_MAX];
+	int			k = sorted_heap_zone_kernels(kernels) - 1;
+
+	for (; k > 0; k--)
+	{
+		int			ncases;
+
+		if (sorted_heap_zone_filter_check(kernels[k].fn, &ncases) == 0)
+			break;
+		elog(WARNING, "sorted_heap: %s zone map filter disagrees with the scalar one, not using it",
+			 kernels[k].name);
+	}
+	sorted_heap_zone_filter = kernels[k].fn;
+
+	sorted_heap_zone_filter(entries, n, box, bitmap);
+}
+
+/* ----------------------------------------------------------------
+ *  SQL-callable kernel check: each kernel this CPU runs, the cases it
+ *  was compared with the scalar loop on, and how many disagreed
+ * ---------------------------------------------------------------- */
+PG_FUNCTION_INFO_V1(sorted_heap_zone_filter_selftest);
+
+Datum
+sorted_heap_zone_filter_selftest(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	SortedHeapZoneKernel kernels[SORTED_HEAP_ZONE_KERNELS_MAX];
+	int			nkernels;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	nkernels = sorted_heap_zone_kernels(kernels);
+	for (int k = 0; k < nkernels; k++)
+	{
+		Datum		values[3];
+		bool		nulls[3] = {false, false, false};
+		int			ncases;
+		int			mismatches;
+
+		mismatches = sorted_heap_zone_filter_check(kernels[k].fn, &ncases);
+		values[0] = CStringGetTextDatum(kernels[k].name);
+		values[1] = Int32GetDatum(ncases);
+		values[2] = Int32GetDatum(mismatches);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}